@@ -6,6 +6,10 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <time.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 #include "bitmap_mgr.h"
 
@@ -16,9 +20,11 @@
 #define BITMAP_MGR_WARN_LOG MY_PRINT
 #define BITMAP_MGR_ERROR_LOG MY_PRINT
 
-#define BITMAP_POS_2_INDEX(pos) ((pos) >> 0x3) /* 查找pos的下标 */
-#define BITMAP_POS_2_OFFSET(pos) ((pos) & 0x7) /* 查找pos在8bit中的偏移 */
-#define BITMAP_POS_2_MASK(pos) (0x1 << BITMAP_POS_2_OFFSET(pos)) /* 获取pos在8bit中的掩码 */
+#define BITMAP_POS_2_WORD(pos) ((pos) >> 0x6) /* 查找pos所在的64位字 */
+#define BITMAP_POS_2_BIT(pos) (1ULL << ((pos) & 0x3F)) /* pos在64位字中的掩码 */
+#define BITMAP_SIZE_2_WORD(size) (((size) + 0x3F) >> 0x6) /* size个位占的64位字数 */
+#define BITMAP_WORD_MASK_FROM(pos) (~0ULL << ((pos) & 0x3F)) /* 字内pos及更高位的掩码 */
+#define BITMAP_WORD_MASK_TO(pos) (~0ULL >> (0x3F - ((pos) & 0x3F))) /* 字内pos及更低位的掩码 */
 #define m_size u.m_size
 #define m_next u.m_next
 
@@ -87,7 +93,8 @@ bitmap_mgr_t* bitmap_mgr_new(uint64_t size)
     if (!size) return NULL;
     bitmap_mgr_t *bm = NULL;
     bool is_freelist = false;
-    uint64_t align = (size + 8 * sizeof(uint8_t) - 1) >> 0x3;
+    /* 按64位字分配，小端机器上第pos位就是第pos / 64个字的第pos % 64位 */
+    uint64_t align = BITMAP_SIZE_2_WORD(size) * sizeof(uint64_t);
 
     if ((bm = _bitmap_mgr_freelist_pop())) is_freelist = true;
     else {
@@ -108,6 +115,7 @@ bitmap_mgr_t* bitmap_mgr_new(uint64_t size)
     }
 
     bm->m_size = size;
+    bm->m_hint = 0;
 	return bm;
 
 free_exit:
@@ -143,7 +151,8 @@ bool bitmap_mgr_free(bitmap_mgr_t *bm)
 bool bitmap_mgr_destroy(bitmap_mgr_t *bm)
 {
     if (!bm) return false;
-    bitmap_mgr_free(bm);
+    /* 不能走bitmap_mgr_free，它会把bm放进freelist，释放后freelist里就是野指针 */
+    if (bm->m_map) g_bitmap_mgr_free(bm->m_map);
     pthread_mutex_destroy(&bm->m_mutex);
     g_bitmap_mgr_free(bm);
     return true;
@@ -174,14 +183,11 @@ void bitmap_mgr_gc(void)
 bool bitmap_mgr_status_get(bitmap_mgr_t *bm, uint64_t pos, uint8_t *status)
 {
 	if(!bm || !status) return false;
-    uint32_t index = 0, offset = 0;
     bool ret = false;
 
     pthread_mutex_lock(&bm->m_mutex);
     if (bm->m_map && pos < bm->m_size) {
-        index = BITMAP_POS_2_INDEX(pos);
-        offset = BITMAP_POS_2_OFFSET(pos);
-        *status = (bm->m_map[index] >> offset) & 0X1;
+        *status = !!(__atomic_load_n((uint64_t*)bm->m_map + BITMAP_POS_2_WORD(pos), __ATOMIC_RELAXED) & BITMAP_POS_2_BIT(pos));
         ret = true;
     }
     pthread_mutex_unlock(&bm->m_mutex);
@@ -189,20 +195,35 @@ bool bitmap_mgr_status_get(bitmap_mgr_t *bm, uint64_t pos, uint8_t *status)
     return ret;
 }
 
+/* @func:
+ *  word之前的字有了空闲位，把m_hint往前调
+ */
+static void _bitmap_mgr_hint_lower(bitmap_mgr_t *bm, uint64_t word)
+{
+    uint64_t hint = __atomic_load_n(&bm->m_hint, __ATOMIC_RELAXED);
+
+    while (word < hint && !__atomic_compare_exchange_n(&bm->m_hint, &hint, word, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
 /* func:
- *      设定指定pos位
+ *      设定指定pos位，用原子操作，可以和无锁接口同时使用
  */
 bool bitmap_mgr_status_set(bitmap_mgr_t *bm, uint64_t pos, uint8_t status)
 {
 	if(!bm) return false;
-    uint32_t index = BITMAP_POS_2_INDEX(pos);
+    uint64_t *word = NULL;
     bool ret = false;
     status &= 0X1;
 
+    /* 和无锁接口一样按64位字做原子操作，不混用不同大小的原子操作 */
     pthread_mutex_lock(&bm->m_mutex);
     if (bm->m_map && pos < bm->m_size) {
-        if (0X1 == status) bm->m_map[index] |= BITMAP_POS_2_MASK(pos);
-        else bm->m_map[index] &= ~BITMAP_POS_2_MASK(pos);
+        word = (uint64_t*)bm->m_map + BITMAP_POS_2_WORD(pos);
+        if (0X1 == status) __atomic_fetch_or(word, BITMAP_POS_2_BIT(pos), __ATOMIC_RELAXED);
+        else {
+            __atomic_fetch_and(word, ~BITMAP_POS_2_BIT(pos), __ATOMIC_RELAXED);
+            _bitmap_mgr_hint_lower(bm, BITMAP_POS_2_WORD(pos));
+        }
         ret = true;
     }
     pthread_mutex_unlock(&bm->m_mutex);
@@ -210,6 +231,271 @@ bool bitmap_mgr_status_set(bitmap_mgr_t *bm, uint64_t pos, uint8_t status)
 	return ret;
 }
 
+/* @func:
+ *  设定[start, end]范围内的位，中间整字的部分直接memset
+ */
+static void _bitmap_mgr_word_fill(uint64_t *word, uint64_t start, uint64_t end, uint8_t status)
+{
+    uint64_t first = BITMAP_POS_2_WORD(start), last = BITMAP_POS_2_WORD(end);
+    uint64_t head = BITMAP_WORD_MASK_FROM(start), tail = BITMAP_WORD_MASK_TO(end);
+
+    if (first == last) head &= tail;
+    if (status) word[first] |= head;
+    else word[first] &= ~head;
+    if (first == last) return ;
+
+    memset(word + first + 1, status ? 0XFF : 0, (last - first - 1) * sizeof(uint64_t));
+    if (status) word[last] |= tail;
+    else word[last] &= ~tail;
+}
+
+/* @func:
+ *  n个字中为1的位数；AVX2时每个字节查表算半字节的位数，字节累加31轮后再横向加到64位里
+ */
+static uint64_t _bitmap_mgr_word_popcount(const uint64_t *word, uint64_t n)
+{
+    uint64_t i = 0, count = 0;
+
+#if defined(__AVX2__)
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0X0F), zero = _mm256_setzero_si256();
+    __m256i total = zero, local = zero, v;
+    int round = 0;
+
+    while (i + 4 <= n) {
+        /* 一个字节每轮最多加8，31轮不会溢出 */
+        for (local = zero, round = 0; round < 31 && i + 4 <= n; round++, i += 4) {
+            v = _mm256_loadu_si256((const __m256i*)(word + i));
+            local = _mm256_add_epi8(local, _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(v, low)),
+                        _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low))));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(local, zero));
+    }
+    count = _mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1)
+        + _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3);
+#endif
+    for (; i < n; i++) count += __builtin_popcountll(word[i]);
+    return count;
+}
+
+/* @func:
+ *  从第i个字开始跳过等于skip的字，返回第一个不等于skip的下标，都相等时返回n
+ */
+static uint64_t _bitmap_mgr_word_skip(const uint64_t *word, uint64_t i, uint64_t n, uint64_t skip)
+{
+#if defined(__AVX2__)
+    const __m256i s = _mm256_set1_epi64x(skip);
+
+    for (; i + 4 <= n; i += 4) {
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(word + i)), s)) != -1) break;
+    }
+#endif
+    while (i < n && word[i] == skip) i++;
+    return i;
+}
+
+/* @func:
+ *  dst和src的n个字按位运算
+ */
+static void _bitmap_mgr_word_op(uint64_t *dst, const uint64_t *src, uint64_t n, bitmap_mgr_op_t op)
+{
+    uint64_t i = 0;
+
+#if defined(__AVX2__)
+    __m256i a, b;
+
+    for (; i + 4 <= n; i += 4) {
+        a = _mm256_loadu_si256((const __m256i*)(dst + i));
+        b = _mm256_loadu_si256((const __m256i*)(src + i));
+        switch (op) {
+            case BITMAP_MGR_OP_AND: a = _mm256_and_si256(a, b); break;
+            case BITMAP_MGR_OP_OR: a = _mm256_or_si256(a, b); break;
+            case BITMAP_MGR_OP_XOR: a = _mm256_xor_si256(a, b); break;
+            case BITMAP_MGR_OP_ANDNOT: a = _mm256_andnot_si256(b, a); break;
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), a);
+    }
+#endif
+    for (; i < n; i++) {
+        switch (op) {
+            case BITMAP_MGR_OP_AND: dst[i] &= src[i]; break;
+            case BITMAP_MGR_OP_OR: dst[i] |= src[i]; break;
+            case BITMAP_MGR_OP_XOR: dst[i] ^= src[i]; break;
+            case BITMAP_MGR_OP_ANDNOT: dst[i] &= ~src[i]; break;
+        }
+    }
+}
+
+/* @func:
+ *      设定[pos, pos + cnt)范围内的位，超出m_size时返回false
+ */
+bool bitmap_mgr_range_set(bitmap_mgr_t *bm, uint64_t pos, uint64_t cnt, uint8_t status)
+{
+    if (!bm) return false;
+    bool ret = false;
+    status &= 0X1;
+
+    pthread_mutex_lock(&bm->m_mutex);
+    if (bm->m_map && pos <= bm->m_size && cnt <= bm->m_size - pos) {
+        if (cnt) _bitmap_mgr_word_fill((uint64_t*)bm->m_map, pos, pos + cnt - 1, status);
+        if (cnt && !status) _bitmap_mgr_hint_lower(bm, BITMAP_POS_2_WORD(pos));
+        ret = true;
+    }
+    pthread_mutex_unlock(&bm->m_mutex);
+
+    return ret;
+}
+
+/* @func:
+ *      统计[pos, pos + cnt)范围内为1的位数
+ */
+bool bitmap_mgr_popcount(bitmap_mgr_t *bm, uint64_t pos, uint64_t cnt, uint64_t *count)
+{
+    if (!bm || !count) return false;
+    uint64_t *word = NULL, first = 0, last = 0;
+    bool ret = false;
+
+    pthread_mutex_lock(&bm->m_mutex);
+    if (bm->m_map && pos <= bm->m_size && cnt <= bm->m_size - pos) {
+        word = (uint64_t*)bm->m_map;
+        first = BITMAP_POS_2_WORD(pos), last = BITMAP_POS_2_WORD(pos + cnt - 1);
+        if (!cnt) *count = 0;
+        else if (first == last) {
+            *count = __builtin_popcountll(word[first] & BITMAP_WORD_MASK_FROM(pos) & BITMAP_WORD_MASK_TO(pos + cnt - 1));
+        } else {
+            *count = __builtin_popcountll(word[first] & BITMAP_WORD_MASK_FROM(pos))
+                + _bitmap_mgr_word_popcount(word + first + 1, last - first - 1)
+                + __builtin_popcountll(word[last] & BITMAP_WORD_MASK_TO(pos + cnt - 1));
+        }
+        ret = true;
+    }
+    pthread_mutex_unlock(&bm->m_mutex);
+
+    return ret;
+}
+
+/* @func:
+ *      从pos开始找第一个状态为status的位，找到时保存到found中，没有时返回false
+ *      找0时把字取反再找1，m_size之后的位是0，取反后会被找到，要再判断是否越界
+ */
+bool bitmap_mgr_find(bitmap_mgr_t *bm, uint64_t pos, uint8_t status, uint64_t *found)
+{
+    if (!bm || !found) return false;
+    uint64_t *word = NULL, flip = (status & 0X1) ? 0 : ~0ULL, n = 0, i = 0, w = 0;
+    bool ret = false;
+
+    pthread_mutex_lock(&bm->m_mutex);
+    if (bm->m_map && pos < bm->m_size) {
+        word = (uint64_t*)bm->m_map;
+        n = BITMAP_SIZE_2_WORD(bm->m_size);
+        i = BITMAP_POS_2_WORD(pos);
+        if (!(w = (word[i] ^ flip) & BITMAP_WORD_MASK_FROM(pos))) {
+            if ((i = _bitmap_mgr_word_skip(word, i + 1, n, flip)) < n) w = word[i] ^ flip;
+        }
+        if (w && (i << 0x6) + __builtin_ctzll(w) < bm->m_size) {
+            *found = (i << 0x6) + __builtin_ctzll(w);
+            ret = true;
+        }
+    }
+    pthread_mutex_unlock(&bm->m_mutex);
+
+    return ret;
+}
+
+/* @func:
+ *      dst和src按位运算，结果放在dst中，两个bitmap的大小必须相同
+ *      按地址顺序加锁，避免两个线程反向运算时死锁
+ */
+bool bitmap_mgr_op(bitmap_mgr_t *dst, bitmap_mgr_t *src, bitmap_mgr_op_t op)
+{
+    if (!dst || !src || op > BITMAP_MGR_OP_ANDNOT) return false;
+    bitmap_mgr_t *first = dst < src ? dst : src, *second = dst < src ? src : dst;
+    bool ret = false;
+
+    pthread_mutex_lock(&first->m_mutex);
+    if (second != first) pthread_mutex_lock(&second->m_mutex);
+    if (dst->m_map && src->m_map && dst->m_size == src->m_size) {
+        _bitmap_mgr_word_op((uint64_t*)dst->m_map, (const uint64_t*)src->m_map, BITMAP_SIZE_2_WORD(dst->m_size), op);
+        if (op != BITMAP_MGR_OP_OR) _bitmap_mgr_hint_lower(dst, 0);
+        ret = true;
+    }
+    if (second != first) pthread_mutex_unlock(&second->m_mutex);
+    pthread_mutex_unlock(&first->m_mutex);
+
+    return ret;
+}
+
+/* @func:
+ *      无锁地把pos位置1，status保存原来的状态，可以为NULL
+ */
+bool bitmap_mgr_test_and_set(bitmap_mgr_t *bm, uint64_t pos, uint8_t *status)
+{
+    if (!bm || !bm->m_map || pos >= bm->m_size) return false;
+    uint64_t mask = BITMAP_POS_2_BIT(pos), old = 0;
+
+    old = __atomic_fetch_or((uint64_t*)bm->m_map + BITMAP_POS_2_WORD(pos), mask, __ATOMIC_ACQ_REL);
+    if (status) *status = !!(old & mask);
+    return true;
+}
+
+/* @func:
+ *      无锁地把pos位清0，status保存原来的状态，可以为NULL
+ */
+bool bitmap_mgr_test_and_clear(bitmap_mgr_t *bm, uint64_t pos, uint8_t *status)
+{
+    if (!bm || !bm->m_map || pos >= bm->m_size) return false;
+    uint64_t mask = BITMAP_POS_2_BIT(pos), old = 0;
+
+    old = __atomic_fetch_and((uint64_t*)bm->m_map + BITMAP_POS_2_WORD(pos), ~mask, __ATOMIC_ACQ_REL);
+    if (old & mask) _bitmap_mgr_hint_lower(bm, BITMAP_POS_2_WORD(pos));
+    if (status) *status = !!(old & mask);
+    return true;
+}
+
+/* @func:
+ *  在[from, to)个字中找空闲位并抢下来；字满了时把m_hint往后推，
+ *  fetch_or返回的旧值里这一位已经是1时说明被别的线程抢了，用旧值接着在这个字里找
+ */
+static bool _bitmap_mgr_alloc(bitmap_mgr_t *bm, uint64_t from, uint64_t to, uint64_t *pos)
+{
+    uint64_t *word = (uint64_t*)bm->m_map, i = from, w = 0, bit = 0, hint = 0;
+
+    for (w = __atomic_load_n(&word[i], __ATOMIC_RELAXED); i < to; ) {
+        if (!~w) {
+            hint = i;
+            __atomic_compare_exchange_n(&bm->m_hint, &hint, i + 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            if (++i < to) w = __atomic_load_n(&word[i], __ATOMIC_RELAXED);
+            continue;
+        }
+        bit = __builtin_ctzll(~w);
+        /* 最后一个字中m_size之后的位是0，找到它们说明前面都满了 */
+        if ((i << 0x6) + bit >= bm->m_size) return false;
+        w = __atomic_fetch_or(&word[i], 1ULL << bit, __ATOMIC_ACQ_REL);
+        if (!(w & (1ULL << bit))) {
+            *pos = (i << 0x6) + bit;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* @func:
+ *      无锁地找一个为0的位并置1，用来分配id；尽量返回最小的空闲位，都满了时返回false
+ *      从m_hint开始找，找不到再从头找一遍：并发释放时m_hint可能被推过了刚释放的位
+ */
+bool bitmap_mgr_alloc(bitmap_mgr_t *bm, uint64_t *pos)
+{
+    if (!bm || !pos || !bm->m_map) return false;
+    uint64_t n = BITMAP_SIZE_2_WORD(bm->m_size), hint = __atomic_load_n(&bm->m_hint, __ATOMIC_RELAXED);
+
+    if (hint >= n) hint = 0;
+    if (_bitmap_mgr_alloc(bm, hint, n, pos)) return true;
+    if (!hint || !_bitmap_mgr_alloc(bm, 0, hint, pos)) return false;
+    _bitmap_mgr_hint_lower(bm, BITMAP_POS_2_WORD(*pos));
+    return true;
+}
+
 /* @func:
  *  打印bitmap
  */
@@ -358,11 +644,272 @@ static void _bitmap_mgr_test_multiple_2(void)
     MY_PRINT("multiple threads_2 ok");
 }
 
+/* @func:
+ *  按字操作的接口，和逐位维护的数组对比
+ */
+static void _bitmap_mgr_test_word(void)
+{
+    uint64_t size[] = {1, 63, 64, 65, 200, 256, 1000, 4099};
+    static uint8_t ref[4099], ref_2[4099];
+    bitmap_mgr_t *bm = NULL, *bm_2 = NULL, *bm_3 = NULL;
+    uint64_t i = 0, j = 0, k = 0, pos = 0, cnt = 0, count = 0, found = 0, expect = 0;
+    unsigned int seed = 1;
+    uint8_t status = 0;
+
+    bitmap_mgr_init(NULL, NULL);
+    for (i = 0; i < sizeof(size) / sizeof(size[0]); i++) {
+        assert((bm = bitmap_mgr_new(size[i])) && (bm_2 = bitmap_mgr_new(size[i])) && (bm_3 = bitmap_mgr_new(size[i] + 1)));
+        memset(ref, 0, sizeof(ref));
+        memset(ref_2, 0, sizeof(ref_2));
+
+        for (j = 0; j < 2000; j++) {
+            pos = rand_r(&seed) % (size[i] + 1);
+            cnt = rand_r(&seed) % (size[i] - pos + 1);
+            /* 大范围的置1和置0交替，保证两种状态都有 */
+            status = rand_r(&seed) % 2;
+            assert(bitmap_mgr_range_set(bm, pos, cnt, status));
+            for (k = pos; k < pos + cnt; k++) ref[k] = status;
+            k = rand_r(&seed) % size[i];
+            assert(bitmap_mgr_status_set(bm_2, k, !ref_2[k]));
+            ref_2[k] = !ref_2[k];
+
+            pos = rand_r(&seed) % (size[i] + 1);
+            cnt = rand_r(&seed) % (size[i] - pos + 1);
+            for (expect = 0, k = pos; k < pos + cnt; k++) expect += ref[k];
+            assert(bitmap_mgr_popcount(bm, pos, cnt, &count) && count == expect);
+
+            pos = rand_r(&seed) % size[i];
+            status = rand_r(&seed) % 2;
+            for (k = pos; k < size[i] && ref[k] != status; k++);
+            if (k == size[i]) assert(!bitmap_mgr_find(bm, pos, status, &found));
+            else assert(bitmap_mgr_find(bm, pos, status, &found) && found == k);
+
+            if (j % 100) continue;
+            status = rand_r(&seed) % 4;
+            assert(bitmap_mgr_op(bm, bm_2, (bitmap_mgr_op_t)status));
+            for (k = 0; k < size[i]; k++) {
+                if (status == BITMAP_MGR_OP_AND) ref[k] &= ref_2[k];
+                else if (status == BITMAP_MGR_OP_OR) ref[k] |= ref_2[k];
+                else if (status == BITMAP_MGR_OP_XOR) ref[k] ^= ref_2[k];
+                else ref[k] &= !ref_2[k];
+            }
+            for (k = 0; k < size[i]; k++) assert(bitmap_mgr_status_get(bm, k, &status) && status == ref[k]);
+        }
+
+        /* 越界、大小不同 */
+        assert(!bitmap_mgr_range_set(bm, size[i], 1, 1) && !bitmap_mgr_range_set(bm, 1, size[i], 1));
+        assert(bitmap_mgr_range_set(bm, size[i], 0, 1));
+        assert(!bitmap_mgr_popcount(bm, 0, size[i] + 1, &count) && !bitmap_mgr_popcount(bm, -1, 2, &count));
+        assert(!bitmap_mgr_find(bm, size[i], 0, &found));
+        assert(!bitmap_mgr_op(bm, bm_3, BITMAP_MGR_OP_OR));
+        /* 全1时找不到0，m_size之后的位不会被当成0 */
+        assert(bitmap_mgr_range_set(bm, 0, size[i], 1));
+        assert(!bitmap_mgr_find(bm, 0, 0, &found));
+        assert(bitmap_mgr_popcount(bm, 0, size[i], &count) && count == size[i]);
+        assert(bitmap_mgr_op(bm, bm, BITMAP_MGR_OP_XOR));
+        assert(!bitmap_mgr_find(bm, 0, 1, &found));
+
+        bitmap_mgr_destroy(bm);
+        bitmap_mgr_destroy(bm_2);
+        bitmap_mgr_destroy(bm_3);
+    }
+    MY_PRINT("word test ok");
+}
+
+static double _bitmap_mgr_ms_since(const struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/* @func:
+ *  10亿位的bitmap，逐位和按字操作的耗时；逐位的太慢，只跑1/16再乘回去
+ */
+static void _bitmap_mgr_bench(void)
+{
+    #define bench_bits (1ULL << 30)
+    #define bench_slow (bench_bits / 16)
+    const char *op_name[] = {"and", "or", "xor", "andnot"};
+    bitmap_mgr_t *bm = NULL, *bm_2 = NULL;
+    struct timespec start;
+    uint64_t i = 0, count = 0, found = 0;
+    uint8_t status = 0;
+
+    bitmap_mgr_init(NULL, NULL);
+    assert((bm = bitmap_mgr_new(bench_bits)) && (bm_2 = bitmap_mgr_new(bench_bits)));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_slow; i++) bitmap_mgr_status_set(bm, i, 1);
+    MY_PRINT("status_set: %.1f ms/Gbit", _bitmap_mgr_ms_since(&start) * 16);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    assert(bitmap_mgr_range_set(bm, 0, bench_bits, 1));
+    MY_PRINT("range_set: %.1f ms/Gbit", _bitmap_mgr_ms_since(&start));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (count = 0, i = 0; i < bench_slow; i++) {
+        bitmap_mgr_status_get(bm, i, &status);
+        count += status;
+    }
+    assert(count == bench_slow);
+    MY_PRINT("status_get count: %.1f ms/Gbit", _bitmap_mgr_ms_since(&start) * 16);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    assert(bitmap_mgr_popcount(bm, 1, bench_bits - 1, &count) && count == bench_bits - 1);
+    MY_PRINT("popcount: %.1f ms/Gbit", _bitmap_mgr_ms_since(&start));
+
+    /* 只有最后一位是0 */
+    assert(bitmap_mgr_status_set(bm, bench_bits - 1, 0));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = bench_bits - bench_slow; i < bench_bits; i++) {
+        if (bitmap_mgr_status_get(bm, i, &status) && !status) break;
+    }
+    assert(i == bench_bits - 1);
+    MY_PRINT("status_get find zero: %.1f ms/Gbit", _bitmap_mgr_ms_since(&start) * 16);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    assert(bitmap_mgr_find(bm, 0, 0, &found) && found == bench_bits - 1);
+    MY_PRINT("find zero: %.1f ms/Gbit", _bitmap_mgr_ms_since(&start));
+
+    assert(bitmap_mgr_range_set(bm_2, 0, bench_bits / 2, 1));
+    for (i = 0; i < 4; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        assert(bitmap_mgr_op(bm, bm_2, (bitmap_mgr_op_t)i));
+        MY_PRINT("%s: %.1f ms/Gbit", op_name[i], _bitmap_mgr_ms_since(&start));
+    }
+
+    bitmap_mgr_destroy(bm);
+    bitmap_mgr_destroy(bm_2);
+}
+
+/* @func:
+ *  无锁接口：单线程的语义，多线程分配的id不重复
+ */
+static void _bitmap_mgr_test_lock_free(void)
+{
+    #define lf_size 1000
+    #define lf_threads 8
+    static uint64_t ids[lf_threads][lf_size];
+    static uint8_t seen[lf_size];
+    bitmap_mgr_t *bm = NULL;
+    pthread_t pt[lf_threads];
+    uint64_t i = 0, j = 0, pos = 0, count = 0;
+    uint8_t status = 0;
+
+    bitmap_mgr_init(NULL, NULL);
+    assert((bm = bitmap_mgr_new(lf_size)));
+    assert(bitmap_mgr_test_and_set(bm, 5, &status) && status == 0);
+    assert(bitmap_mgr_test_and_set(bm, 5, &status) && status == 1);
+    assert(bitmap_mgr_test_and_clear(bm, 5, &status) && status == 1);
+    assert(bitmap_mgr_test_and_clear(bm, 5, NULL));
+    assert(bitmap_mgr_status_get(bm, 5, &status) && status == 0);
+    assert(!bitmap_mgr_test_and_set(bm, lf_size, &status) && !bitmap_mgr_test_and_clear(bm, lf_size, &status));
+
+    /* 按顺序分配，满了以后释放的位从小到大再分配出去 */
+    for (i = 0; i < lf_size; i++) assert(bitmap_mgr_alloc(bm, &pos) && pos == i);
+    assert(!bitmap_mgr_alloc(bm, &pos));
+    assert(bitmap_mgr_test_and_clear(bm, 700, NULL) && bitmap_mgr_test_and_clear(bm, 3, NULL));
+    assert(bitmap_mgr_alloc(bm, &pos) && pos == 3);
+    assert(bitmap_mgr_alloc(bm, &pos) && pos == 700);
+    assert(!bitmap_mgr_alloc(bm, &pos));
+    assert(bitmap_mgr_status_set(bm, 64, 0) && bitmap_mgr_alloc(bm, &pos) && pos == 64);
+    assert(bitmap_mgr_range_set(bm, 10, 20, 0) && bitmap_mgr_alloc(bm, &pos) && pos == 10);
+    /* m_hint被推过了空闲位，也能从头找到 */
+    bm->m_hint = BITMAP_SIZE_2_WORD(lf_size) - 1;
+    assert(bitmap_mgr_alloc(bm, &pos) && pos == 11);
+    assert(bm->m_hint == BITMAP_POS_2_WORD(11));
+    assert(bitmap_mgr_range_set(bm, 0, lf_size, 0));
+
+    /* 多个线程同时分配，一共正好分完，每个id只出现一次 */
+    for (i = 0; i < lf_threads; i++) {
+        assert(!pthread_create(&pt[i], NULL, ({
+            void* _(void *arg) {
+                uint64_t k = 0, *id = ids[(uintptr_t)arg];
+                uint8_t old = 0;
+
+                for (k = 0; k < lf_size; k++) {
+                    if (!bitmap_mgr_alloc(bm, &id[k])) break;
+                    /* 一部分释放了再分配，和别的线程的分配交错；快满时释放的可能被别人抢走 */
+                    if (id[k] % 3 == 0) {
+                        assert(bitmap_mgr_test_and_clear(bm, id[k], &old) && old);
+                        if (!bitmap_mgr_alloc(bm, &id[k])) break;
+                    }
+                }
+                if (k < lf_size) id[k] = UINT64_MAX;
+                return NULL;
+            }; _; }), (void*)i));
+    }
+    for (i = 0; i < lf_threads; i++) pthread_join(pt[i], NULL);
+    for (i = 0; i < lf_threads; i++) {
+        for (j = 0; j < lf_size && ids[i][j] != UINT64_MAX; j++) {
+            assert(ids[i][j] < lf_size && !seen[ids[i][j]]);
+            seen[ids[i][j]] = 1;
+            count++;
+        }
+    }
+    assert(count == lf_size);
+    assert(bitmap_mgr_popcount(bm, 0, lf_size, &count) && count == lf_size);
+    bitmap_mgr_destroy(bm);
+    MY_PRINT("lock free test ok");
+}
+
+/* @func:
+ *  分配再释放一个id，无锁和用一把锁包住find加status_set两种方式，线程数逐渐增加
+ *  先占住前1024个id，分配要越过这些满了的字
+ */
+static void _bitmap_mgr_alloc_bench(void)
+{
+    #define alloc_size (1 << 20)
+    #define alloc_ops (1 << 20)
+    const char *name[] = {"mutex", "lock free"};
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    bitmap_mgr_t *bm = NULL;
+    pthread_t pt[8];
+    struct timespec start;
+    uint64_t thread_cnt = 0, i = 0, mode = 0;
+
+    bitmap_mgr_init(NULL, NULL);
+    for (mode = 0; mode < 2; mode++) {
+        for (thread_cnt = 1; thread_cnt <= 8; thread_cnt *= 2) {
+            assert((bm = bitmap_mgr_new(alloc_size)));
+            assert(bitmap_mgr_range_set(bm, 0, 1024, 1));
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (i = 0; i < thread_cnt; i++) {
+                assert(!pthread_create(&pt[i], NULL, ({
+                    void* _(void *arg) {
+                        uint64_t k = 0, pos = 0;
+
+                        (void)arg;
+                        for (k = 0; k < alloc_ops / thread_cnt; k++) {
+                            if (mode == 0) {
+                                pthread_mutex_lock(&mutex);
+                                assert(bitmap_mgr_find(bm, 0, 0, &pos) && bitmap_mgr_status_set(bm, pos, 1));
+                                pthread_mutex_unlock(&mutex);
+                                assert(bitmap_mgr_status_set(bm, pos, 0));
+                            } else {
+                                assert(bitmap_mgr_alloc(bm, &pos));
+                                assert(bitmap_mgr_test_and_clear(bm, pos, NULL));
+                            }
+                        }
+                        return NULL;
+                    }; _; }), NULL));
+            }
+            for (i = 0; i < thread_cnt; i++) pthread_join(pt[i], NULL);
+            MY_PRINT("%s alloc, %lu threads: %.1f ns/op", name[mode], thread_cnt,
+                    _bitmap_mgr_ms_since(&start) * 1e6 / (alloc_ops / thread_cnt * thread_cnt));
+            bitmap_mgr_destroy(bm);
+        }
+    }
+}
+
 int main(void)
 {
     _bitmap_mgr_test_single();
     _bitmap_mgr_test_multiple();
     _bitmap_mgr_test_multiple_2();
+    _bitmap_mgr_test_word();
+    _bitmap_mgr_bench();
+    _bitmap_mgr_test_lock_free();
+    _bitmap_mgr_alloc_bench();
 
     return 0;
 }
@@ -7,12 +7,21 @@
 typedef void* (*BITMAP_MGR_ALLOC_T) (size_t size);
 typedef void (*BITMAP_MGR_FREE_T) (void *ptr);
 
+/* 两个bitmap之间的运算，结果放在dst中 */
+typedef enum _bitmap_mgr_op {
+    BITMAP_MGR_OP_AND, /* dst &= src */
+    BITMAP_MGR_OP_OR, /* dst |= src */
+    BITMAP_MGR_OP_XOR, /* dst ^= src */
+    BITMAP_MGR_OP_ANDNOT, /* dst &= ~src */
+} bitmap_mgr_op_t;
+
 typedef struct _bitmap_mgr {
     union {
         uint64_t m_size; /* 这个bitmap的大小 */
         struct _bitmap_mgr *m_next; /* 用于freelist */
     } u;
-    uint8_t *m_map; /* bitmap */
+    uint8_t *m_map; /* bitmap，按64位对齐分配，可以按uint64_t访问，m_size之后的位始终为0 */
+    uint64_t m_hint; /* 无锁分配从这个字开始找，前面的字大概率都满了，原子操作 */
     pthread_mutex_t m_mutex;
 } bitmap_mgr_t;
 
@@ -47,6 +56,45 @@ bool bitmap_mgr_status_get(bitmap_mgr_t *bm, uint64_t pos, uint8_t *status);
  */
 bool bitmap_mgr_status_set(bitmap_mgr_t *bm, uint64_t pos, uint8_t status);
 
+/* @func:
+ *      设定[pos, pos + cnt)范围内的位，超出m_size时返回false
+ */
+bool bitmap_mgr_range_set(bitmap_mgr_t *bm, uint64_t pos, uint64_t cnt, uint8_t status);
+
+/* @func:
+ *      统计[pos, pos + cnt)范围内为1的位数
+ */
+bool bitmap_mgr_popcount(bitmap_mgr_t *bm, uint64_t pos, uint64_t cnt, uint64_t *count);
+
+/* @func:
+ *      从pos开始找第一个状态为status的位，找到时保存到found中，没有时返回false
+ */
+bool bitmap_mgr_find(bitmap_mgr_t *bm, uint64_t pos, uint8_t status, uint64_t *found);
+
+/* @func:
+ *      dst和src按位运算，结果放在dst中，两个bitmap的大小必须相同
+ */
+bool bitmap_mgr_op(bitmap_mgr_t *dst, bitmap_mgr_t *src, bitmap_mgr_op_t op);
+
+/* @func:
+ *      无锁地把pos位置1，status保存原来的状态，可以为NULL
+ * @warn:
+ *      无锁接口不加m_mutex，调用者要保证期间bitmap不会被释放；
+ *      可以和status_get/status_set同时使用，不能和range_set/op同时改同一个bitmap
+ */
+bool bitmap_mgr_test_and_set(bitmap_mgr_t *bm, uint64_t pos, uint8_t *status);
+
+/* @func:
+ *      无锁地把pos位清0，status保存原来的状态，可以为NULL
+ */
+bool bitmap_mgr_test_and_clear(bitmap_mgr_t *bm, uint64_t pos, uint8_t *status);
+
+/* @func:
+ *      无锁地找一个为0的位并置1，用来分配id；尽量返回最小的空闲位，都满了时返回false
+ *      用bitmap_mgr_test_and_clear释放
+ */
+bool bitmap_mgr_alloc(bitmap_mgr_t *bm, uint64_t *pos);
+
 /* func:
  *      输出bitmap信息
  */
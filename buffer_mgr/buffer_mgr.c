@@ -1,3 +1,4 @@
+#define _GNU_SOURCE /* splice */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,8 +9,14 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
 
 #include "buffer_mgr.h"
+#include "cache_mgr.h"
 
 #define MY_PRINTF(format, ...) printf(format"\n", ##__VA_ARGS__)
 #define BUFFER_MGR_TRACE_LOG MY_PRINTF
@@ -20,10 +27,32 @@
 
 #define BUFFER_MGR_INIT_CAPACITY 1024
 #define BUFFER_MGR_SIZEOF (sizeof(buffer_mgr_t))
+#define BUFFER_MGR_SPLICE_CHUNK (64 * 1024) /* 默认的管道容量 */
+#define BUFFER_MGR_ZEROCOPY_MIN (16 * 1024) /* 小于这个长度时MSG_ZEROCOPY的开销大于拷贝 */
+#define BUFFER_MGR_TIER_MAX 32
+
+/* 数据区的起始地址，可伸缩模式下数据在m_data中 */
+#define BUFFER_MGR_DATA(bm) ((bm)->m_growable ? (bm)->m_data : (void*)(bm))
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
 
 static buffer_mgr_alloc_t g_bm_alloc = NULL;
 static buffer_mgr_free_t g_bm_free = NULL;
 
+static size_t g_bm_tier_min = 0; /* 最小档位的容量 */
+static int g_bm_tier_cnt = 0; /* 档位的数量 */
+static int g_bm_tier_id[BUFFER_MGR_TIER_MAX]; /* 每个档位对应的cache_mgr */
+
 static void* _malloc2calloc(size_t size)
 {
 	return calloc(1, size);
@@ -40,6 +69,17 @@ void buffer_mgr_dump(buffer_mgr_t *bm)
 	BUFFER_MGR_TRACE_LOG("reserved: %lu", bm->m_reserved);
 	BUFFER_MGR_TRACE_LOG("rd_offset: %lu", bm->m_rd_offset);
 	BUFFER_MGR_TRACE_LOG("wr_offset: %lu", bm->m_wr_offset);
+	BUFFER_MGR_TRACE_LOG("pipe_len: %lu", bm->m_pipe_len);
+	BUFFER_MGR_TRACE_LOG("zc_state: %d", bm->m_zc_state);
+	BUFFER_MGR_TRACE_LOG("zc_pending: %u", bm->m_zc_seq - bm->m_zc_done);
+	if (bm->m_growable) {
+		BUFFER_MGR_TRACE_LOG("data: %p", bm->m_data);
+	}
+	if (bm->m_spsc) {
+		BUFFER_MGR_TRACE_LOG("spsc_capacity: %lu", bm->m_spsc->m_mask + 1);
+		BUFFER_MGR_TRACE_LOG("spsc_head: %lu", __atomic_load_n(&bm->m_spsc->m_head, __ATOMIC_ACQUIRE));
+		BUFFER_MGR_TRACE_LOG("spsc_tail: %lu", __atomic_load_n(&bm->m_spsc->m_tail, __ATOMIC_ACQUIRE));
+	}
 	BUFFER_MGR_TRACE_LOG("=================");
 	pthread_mutex_unlock(&bm->m_mutex);
 }
@@ -51,6 +91,7 @@ void buffer_mgr_init(buffer_mgr_alloc_t alloc, buffer_mgr_free_t dealloc)
 {
 	if (!alloc || !dealloc) g_bm_alloc = _malloc2calloc, g_bm_free = free;
 	else g_bm_alloc = alloc, g_bm_free = dealloc;
+	pipe_mgr_init(alloc, dealloc);
 }
 
 /* @func:
@@ -75,6 +116,7 @@ buffer_mgr_t* buffer_mgr_new(size_t capacity, size_t reserved)
 	bm->m_start = bm->m_reserved + reserved;
 	bm->m_rd_offset = bm->m_wr_offset = bm->m_start;
 	bm->m_end = bm->m_start + capacity;
+	bm->m_zc_fd = -1;
 	return bm;
 
 err:
@@ -83,15 +125,225 @@ err:
 }
 
 
+/* @func:
+ *	初始化可伸缩缓冲区使用的内存池
+ */
+bool buffer_mgr_tier_init(size_t min_size, size_t max_size, size_t cache_cnt)
+{
+	size_t size = 0;
+	int i = 0;
+
+	if (g_bm_tier_cnt) return false;
+	if (!min_size) min_size = BUFFER_MGR_INIT_CAPACITY;
+	for (size = 1; size < min_size; size <<= 1) ;
+	g_bm_tier_min = size;
+
+	for (i = 0; i < BUFFER_MGR_TIER_MAX && size <= max_size; i++, size <<= 1) ;
+	if (!i) return false;
+
+	if (!cache_mgr_init(i, true, g_bm_alloc, g_bm_free)) {
+		BUFFER_MGR_ERROR_LOG("cache_mgr_init error");
+		return false;
+	}
+
+	for (g_bm_tier_cnt = 0; g_bm_tier_cnt < i; g_bm_tier_cnt++) {
+		/* 多一个字节存放'\0' */
+		g_bm_tier_id[g_bm_tier_cnt] = cache_mgr_new((g_bm_tier_min << g_bm_tier_cnt) + 1, cache_cnt);
+	}
+	return true;
+}
+
+/* @func:
+ *	销毁内存池，所有可伸缩的缓冲区都必须已经释放
+ */
+void buffer_mgr_tier_destroy(void)
+{
+	if (!g_bm_tier_cnt) return ;
+	cache_mgr_destroy();
+	g_bm_tier_cnt = 0;
+}
+
+/* @func:
+ *	容量对应的档位
+ */
+static int _buffer_mgr_tier(size_t size)
+{
+	int tier = 0;
+
+	while (tier < g_bm_tier_cnt && (g_bm_tier_min << tier) < size) tier++;
+	return tier < g_bm_tier_cnt ? tier : -1;
+}
+
+/* @func:
+ *	将数据搬到能容纳want个字节的档位，want为0时归还全部容量
+ */
+static bool _buffer_mgr_resize(buffer_mgr_t *bm, size_t want)
+{
+	void *data = NULL;
+	size_t len = bm->m_wr_offset - bm->m_rd_offset;
+	int tier = -1;
+
+	/* 内核还在引用缓冲区的内存 */
+	if (bm->m_zc_seq != bm->m_zc_done) return false;
+
+	if (want) {
+		if (0 > (tier = _buffer_mgr_tier(want))) return false;
+		if ((g_bm_tier_min << tier) == bm->m_end - bm->m_start) return true;
+		if (!(data = cache_mgr_get(g_bm_tier_id[tier]))) return false;
+		if (len) memcpy(data, bm->m_data + bm->m_rd_offset, len);
+	}
+
+	if (bm->m_data) cache_mgr_ret(g_bm_tier_id[_buffer_mgr_tier(bm->m_end - bm->m_start)], bm->m_data);
+	bm->m_data = data;
+	bm->m_start = bm->m_rd_offset = 0;
+	bm->m_wr_offset = len;
+	bm->m_end = want ? g_bm_tier_min << tier : 0;
+	return true;
+}
+
+/* @func:
+ *	创建一个可伸缩的管理器
+ */
+buffer_mgr_t* buffer_mgr_growable_new(size_t reserved)
+{
+	buffer_mgr_t *bm = NULL;
+
+	if (!g_bm_tier_cnt) {
+		BUFFER_MGR_ERROR_LOG("buffer_mgr_tier_init first");
+		return NULL;
+	}
+
+	/* 数据在m_data中，第一次写入时才分配 */
+	if (!(bm = buffer_mgr_new(1, reserved))) return NULL;
+	bm->m_start = bm->m_end = bm->m_rd_offset = bm->m_wr_offset = 0;
+	bm->m_reserved_len = reserved;
+	bm->m_growable = true;
+	return bm;
+}
+
+/* @func:
+ *	将同一块内存连续映射两次
+ */
+static void* _buffer_mgr_ring_new(size_t size)
+{
+	void *ring = NULL;
+	int fd = -1;
+
+	if (0 > (fd = memfd_create("buffer_mgr", MFD_CLOEXEC))) {
+		BUFFER_MGR_ERROR_LOG("memfd_create error, errno: %d - %s", errno, strerror(errno));
+		return NULL;
+	}
+
+	if (ftruncate(fd, size)) {
+		BUFFER_MGR_ERROR_LOG("ftruncate error, errno: %d - %s", errno, strerror(errno));
+		goto err;
+	}
+
+	if (MAP_FAILED == (ring = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0))) {
+		BUFFER_MGR_ERROR_LOG("mmap error, errno: %d - %s", errno, strerror(errno));
+		goto err;
+	}
+
+	if (MAP_FAILED == mmap(ring, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0)
+			|| MAP_FAILED == mmap(ring + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0)) {
+		BUFFER_MGR_ERROR_LOG("mmap error, errno: %d - %s", errno, strerror(errno));
+		munmap(ring, size * 2);
+		goto err;
+	}
+
+	close(fd);
+	return ring;
+
+err:
+	close(fd);
+	return NULL;
+}
+
+/* @func:
+ *	创建一个单生产者/单消费者模式的管理器
+ */
+buffer_mgr_t* buffer_mgr_spsc_new(size_t capacity, size_t reserved)
+{
+	buffer_mgr_t *bm = NULL;
+	buffer_mgr_spsc_t *spsc = NULL;
+	size_t size = sysconf(_SC_PAGESIZE);
+
+	if (!capacity) capacity = BUFFER_MGR_INIT_CAPACITY;
+	while (size < capacity) size <<= 1;
+
+	if (posix_memalign((void**)&spsc, BUFFER_MGR_CACHE_LINE, sizeof(buffer_mgr_spsc_t))) {
+		BUFFER_MGR_ERROR_LOG("posix_memalign error");
+		return NULL;
+	}
+	memset(spsc, 0, sizeof(buffer_mgr_spsc_t));
+	spsc->m_mask = size - 1;
+	if (!(spsc->m_ring = _buffer_mgr_ring_new(size))) goto err;
+
+	/* 数据在m_ring中，管理器只保留reserved的内存 */
+	if (!(bm = buffer_mgr_new(1, reserved))) goto err;
+	bm->m_end = bm->m_start;
+	bm->m_spsc = spsc;
+	return bm;
+
+err:
+	if (spsc->m_ring) munmap(spsc->m_ring, size * 2);
+	free(spsc);
+	return NULL;
+}
+
+/* @func:
+ *	生产者可以写入的连续内存，缓存的空闲空间不够need时重新读取消费者的位置
+ */
+static size_t _buffer_mgr_spsc_writable(buffer_mgr_spsc_t *spsc, size_t need, void **ptr)
+{
+	size_t head = spsc->m_head;
+	size_t capacity = spsc->m_mask + 1;
+
+	if (capacity - (head - spsc->m_tail_cache) < need)
+		spsc->m_tail_cache = __atomic_load_n(&spsc->m_tail, __ATOMIC_ACQUIRE);
+
+	*ptr = spsc->m_ring + (head & spsc->m_mask);
+	return capacity - (head - spsc->m_tail_cache);
+}
+
+/* @func:
+ *	消费者可以读取的连续内存，缓存的数据不够need时重新读取生产者的位置
+ *	读取的接口都要取全部可读数据，按容量传need，只有缓存里已经满了时才不重新读
+ */
+static size_t _buffer_mgr_spsc_readable(buffer_mgr_spsc_t *spsc, size_t need, void **ptr)
+{
+	size_t tail = spsc->m_tail;
+
+	if (spsc->m_head_cache - tail < need)
+		spsc->m_head_cache = __atomic_load_n(&spsc->m_head, __ATOMIC_ACQUIRE);
+
+	*ptr = spsc->m_ring + (tail & spsc->m_mask);
+	return spsc->m_head_cache - tail;
+}
+
 /* @func:
  *	销毁一个管理器
  */
 void buffer_mgr_free(buffer_mgr_t *bm)
 {
 	if (!bm) return ;
+	if (bm->m_spsc) {
+		munmap(bm->m_spsc->m_ring, (bm->m_spsc->m_mask + 1) * 2);
+		free(bm->m_spsc);
+		bm->m_spsc = NULL;
+	}
 	pthread_mutex_lock(&bm->m_mutex);
-	g_bm_free(bm);
+	if (bm->m_growable) {
+		bm->m_rd_offset = bm->m_wr_offset;
+		_buffer_mgr_resize(bm, 0);
+	}
+	if (bm->m_pipe) {
+		bm->m_pipe->m_closer(bm->m_pipe, PIPE_MGR_WRITER);
+		bm->m_pipe->m_closer(bm->m_pipe, PIPE_MGR_READER);
+	}
+	pthread_mutex_unlock(&bm->m_mutex);
 	pthread_mutex_destroy(&bm->m_mutex);
+	g_bm_free(bm);
 }
 
 /* @func:
@@ -112,6 +364,48 @@ static ssize_t _read_all(int fd, void *buf, size_t len)
 	return byte;
 }
 
+/* @func:
+ *	读取MSG_ZEROCOPY的完成通知
+ */
+static void _buffer_mgr_zerocopy_reap(buffer_mgr_t *bm)
+{
+	if (!bm || bm->m_zc_fd < 0) return ;
+	char control[128];
+	struct msghdr msg;
+	struct cmsghdr *cm = NULL;
+	struct sock_extended_err *serr = NULL;
+
+	while (bm->m_zc_seq != bm->m_zc_done) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(bm->m_zc_fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+					&& !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) continue;
+			serr = (struct sock_extended_err*)CMSG_DATA(cm);
+			if (serr->ee_errno || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+			/* [ee_info, ee_data]是本次完成的序号区间 */
+			if ((int)(serr->ee_data + 1 - bm->m_zc_done) > 0) bm->m_zc_done = serr->ee_data + 1;
+		}
+	}
+}
+
+/* @func:
+ *	数据全部读取后将读写位置恢复到start处
+ */
+static void _buffer_mgr_rewind(buffer_mgr_t *bm)
+{
+	if (!bm) return ;
+	if (bm->m_rd_offset < bm->m_wr_offset) return ;
+	if (bm->m_zc_seq != bm->m_zc_done) return ;
+	bm->m_rd_offset = bm->m_wr_offset = bm->m_start;
+}
+
 /* @func:
  *	移动数据到start处
  */
@@ -120,17 +414,48 @@ static void _buffer_mgr_move(buffer_mgr_t *bm)
 	if (!bm) return ;
 	size_t offset = 0;
 
+	/* 内核还在引用缓冲区的内存 */
+	_buffer_mgr_zerocopy_reap(bm);
+	if (bm->m_zc_seq != bm->m_zc_done) return ;
+
 	if (bm->m_wr_offset <= bm->m_rd_offset) {
 		bm->m_rd_offset = bm->m_wr_offset = bm->m_start;
 		return ;
 	}
 
 	offset = bm->m_wr_offset - bm->m_rd_offset;
-	memmove((void*)bm + bm->m_start, (void*)bm + bm->m_rd_offset, offset);
+	memmove(BUFFER_MGR_DATA(bm) + bm->m_start, BUFFER_MGR_DATA(bm) + bm->m_rd_offset, offset);
 	bm->m_rd_offset = bm->m_start;
 	bm->m_wr_offset = bm->m_start + offset;
 }
 
+/* @func:
+ *	保证写入位置之后至少有len个字节的空间
+ */
+static bool _buffer_mgr_reserve(buffer_mgr_t *bm, size_t len)
+{
+	if (bm->m_end - bm->m_wr_offset >= len) return true;
+	_buffer_mgr_move(bm);
+	if (bm->m_end - bm->m_wr_offset >= len) return true;
+	if (!bm->m_growable) return false;
+	return _buffer_mgr_resize(bm, bm->m_wr_offset - bm->m_rd_offset + len);
+}
+
+
+/* @func:
+ *	归还空闲的容量
+ */
+void buffer_mgr_shrink(buffer_mgr_t *bm)
+{
+	if (!bm || !bm->m_growable) return ;
+	size_t len = 0;
+
+	pthread_mutex_lock(&bm->m_mutex);
+	_buffer_mgr_zerocopy_reap(bm);
+	len = bm->m_wr_offset - bm->m_rd_offset;
+	_buffer_mgr_resize(bm, len ? len + 1 : 0);
+	pthread_mutex_unlock(&bm->m_mutex);
+}
 
 /* @func:
  *	从套接字中读取内容
@@ -140,33 +465,85 @@ ssize_t buffer_mgr_read(buffer_mgr_t *bm, int fd)
 	if (!bm || fd < 0) return -1;
 	ssize_t byte = 0;
 	size_t count = 0;
+	void *ptr = NULL;
+
+	if (bm->m_spsc) {
+		if (!(count = _buffer_mgr_spsc_writable(bm->m_spsc, bm->m_spsc->m_mask + 1, &ptr))) {
+			errno = EAGAIN;
+			return -1;
+		}
+		if (0 < (byte = _read_all(fd, ptr, count)))
+			__atomic_store_n(&bm->m_spsc->m_head, bm->m_spsc->m_head + byte, __ATOMIC_RELEASE);
+		return byte;
+	}
 
 	pthread_mutex_lock(&bm->m_mutex);
-	if (bm->m_wr_offset >= bm->m_end) _buffer_mgr_move(bm);
+	if (!_buffer_mgr_reserve(bm, 1)) {
+		pthread_mutex_unlock(&bm->m_mutex);
+		errno = EAGAIN;
+		return -1;
+	}
 	count = bm->m_end - bm->m_wr_offset;
-	byte = _read_all(fd,  (void*)bm +  bm->m_wr_offset, count);
+	byte = _read_all(fd,  BUFFER_MGR_DATA(bm) + bm->m_wr_offset, count);
 	if (byte > 0) bm->m_wr_offset += byte;
-	*((char*)bm + bm->m_wr_offset) = '\0';
+	*((char*)BUFFER_MGR_DATA(bm) + bm->m_wr_offset) = '\0';
 	pthread_mutex_unlock(&bm->m_mutex);
 
 	return byte;
 }
 
+/* @func:
+ *	将一段数据整体写入缓冲区，空间不足时返回false
+ */
+bool buffer_mgr_append(buffer_mgr_t *bm, const void *data, size_t len)
+{
+	if (!bm || !data || !len) return false;
+	void *ptr = NULL;
+	bool ret = false;
+
+	if (bm->m_spsc) {
+		if (_buffer_mgr_spsc_writable(bm->m_spsc, len, &ptr) < len) return false;
+		memcpy(ptr, data, len);
+		__atomic_store_n(&bm->m_spsc->m_head, bm->m_spsc->m_head + len, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	pthread_mutex_lock(&bm->m_mutex);
+	if (_buffer_mgr_reserve(bm, len)) {
+		memcpy(BUFFER_MGR_DATA(bm) + bm->m_wr_offset, data, len);
+		bm->m_wr_offset += len;
+		*((char*)BUFFER_MGR_DATA(bm) + bm->m_wr_offset) = '\0';
+		ret = true;
+	}
+	pthread_mutex_unlock(&bm->m_mutex);
+
+	return ret;
+}
+
 /* @func:
  *	获取当前可读数据的副本
  */
 void* buffer_mgr_copy_new(buffer_mgr_t *bm, size_t *len)
 {
 	if (!bm || !len) return NULL;
-	void *ptr = NULL;
+	void *ptr = NULL, *data = NULL;
 	size_t offset = 0;
 	*len = 0;
 
+	if (bm->m_spsc) {
+		if ((offset = _buffer_mgr_spsc_readable(bm->m_spsc, bm->m_spsc->m_mask + 1, &data)) && (ptr = g_bm_alloc(offset + 1))) {
+			memcpy(ptr, data, offset);
+			*((char*)ptr + offset) = '\0';
+			*len = offset;
+		}
+		return ptr;
+	}
+
 	pthread_mutex_lock(&bm->m_mutex);
 	if (bm->m_wr_offset > bm->m_rd_offset) {
 		offset = bm->m_wr_offset - bm->m_rd_offset;
 		if((ptr = g_bm_alloc(offset + 1))) {
-			memcpy(ptr, (void*)bm + bm->m_rd_offset, offset);
+			memcpy(ptr, BUFFER_MGR_DATA(bm) + bm->m_rd_offset, offset);
 			*((char*)ptr + offset) = '\0';
 			*len = offset;
 		}
@@ -188,12 +565,23 @@ void buffer_mgr_copy_free(void *ptr)
 /* @func:
  *	重置读写的偏移位置
  */
-void buffer_mgr_reset(buffer_mgr_t *bm)
+bool buffer_mgr_reset(buffer_mgr_t *bm)
 {
-	if (!bm) return ;
+	if (!bm) return false;
+	bool ret = false;
+
+	if (bm->m_spsc) {
+		/* 由消费者调用，丢弃全部可读数据 */
+		bm->m_spsc->m_head_cache = __atomic_load_n(&bm->m_spsc->m_head, __ATOMIC_ACQUIRE);
+		__atomic_store_n(&bm->m_spsc->m_tail, bm->m_spsc->m_head_cache, __ATOMIC_RELEASE);
+		return true;
+	}
 	pthread_mutex_lock(&bm->m_mutex);
-	bm->m_rd_offset = bm->m_wr_offset = bm->m_start;
+	/* 内核还在发送缓冲区中的数据时不能复用这段内存 */
+	_buffer_mgr_zerocopy_reap(bm);
+	if ((ret = bm->m_zc_seq == bm->m_zc_done)) bm->m_rd_offset = bm->m_wr_offset = bm->m_start;
 	pthread_mutex_unlock(&bm->m_mutex);
+	return ret;
 }
 
 /* @func:
@@ -221,22 +609,42 @@ static ssize_t _write_all(int fd, const void *buf, size_t len)
 }
 
 /* @func:
- *	将缓冲区的数据写入套接字
+ *	将缓冲区的数据写入套接字，调用者持有锁
  */
-ssize_t buffer_mgr_write(buffer_mgr_t *bm, int fd)
+static ssize_t _buffer_mgr_flush(buffer_mgr_t *bm, int fd)
 {
-	if (fd < 0 || !bm) return -1;
 	ssize_t byte = 0;
 	size_t count = 0;
 
-	pthread_mutex_lock(&bm->m_mutex);
 	if (bm->m_wr_offset > bm->m_rd_offset) {
 		count =  bm->m_wr_offset - bm->m_rd_offset;
-		if (0 < (byte = _write_all(fd,  (void*)bm +  bm->m_rd_offset, count))) {
+		if (0 < (byte = _write_all(fd,  BUFFER_MGR_DATA(bm) + bm->m_rd_offset, count))) {
 			bm->m_rd_offset += byte;
-			if (bm->m_rd_offset >= bm->m_wr_offset) bm->m_rd_offset = bm->m_wr_offset = bm->m_start;
+			_buffer_mgr_rewind(bm);
 		}
 	}
+	return byte;
+}
+
+/* @func:
+ *	将缓冲区的数据写入套接字
+ */
+ssize_t buffer_mgr_write(buffer_mgr_t *bm, int fd)
+{
+	if (fd < 0 || !bm) return -1;
+	ssize_t byte = 0;
+	size_t count = 0;
+	void *ptr = NULL;
+
+	if (bm->m_spsc) {
+		if ((count = _buffer_mgr_spsc_readable(bm->m_spsc, bm->m_spsc->m_mask + 1, &ptr))
+				&& 0 < (byte = _write_all(fd, ptr, count)))
+			__atomic_store_n(&bm->m_spsc->m_tail, bm->m_spsc->m_tail + byte, __ATOMIC_RELEASE);
+		return byte;
+	}
+
+	pthread_mutex_lock(&bm->m_mutex);
+	byte = _buffer_mgr_flush(bm, fd);
 	pthread_mutex_unlock(&bm->m_mutex);
 
 	return byte;
@@ -250,13 +658,18 @@ ssize_t buffer_mgr_write(buffer_mgr_t *bm, int fd)
 void* buffer_mgr_filter(buffer_mgr_t *bm, buffer_mgr_filter_func_t filter_func, void *arg)
 {
 	if (!bm || !filter_func) return NULL;
-	void *ret = NULL;
+	void *ret = NULL, *ptr = NULL;
 	size_t offset = 0;
 
+	if (bm->m_spsc) {
+		if ((offset = _buffer_mgr_spsc_readable(bm->m_spsc, bm->m_spsc->m_mask + 1, &ptr))) ret = filter_func(ptr, offset, arg);
+		return ret;
+	}
+
 	pthread_mutex_lock(&bm->m_mutex);
 	if (bm->m_wr_offset > bm->m_rd_offset) {
 		offset = bm->m_wr_offset - bm->m_rd_offset;
-		ret = filter_func((void*)bm + bm->m_rd_offset, offset, arg);
+		ret = filter_func(BUFFER_MGR_DATA(bm) + bm->m_rd_offset, offset, arg);
 	}
 	pthread_mutex_unlock(&bm->m_mutex);
 
@@ -270,13 +683,22 @@ void buffer_mgr_update(buffer_mgr_t *bm, buffer_mgr_update_func_t update_func, v
 {
 	if (!bm || !update_func) return ;
 	size_t offset = 0, len = 0;
+	void *ptr = NULL;
+
+	if (bm->m_spsc) {
+		if ((offset = _buffer_mgr_spsc_readable(bm->m_spsc, bm->m_spsc->m_mask + 1, &ptr))) {
+			if ((len = update_func(ptr, offset, arg)) > offset) len = offset;
+			__atomic_store_n(&bm->m_spsc->m_tail, bm->m_spsc->m_tail + len, __ATOMIC_RELEASE);
+		}
+		return ;
+	}
 
 	pthread_mutex_lock(&bm->m_mutex);
 	if (bm->m_wr_offset > bm->m_rd_offset) {
 		offset = bm->m_wr_offset - bm->m_rd_offset;
-		len = update_func((void*)bm + bm->m_rd_offset, offset, arg);
+		len = update_func(BUFFER_MGR_DATA(bm) + bm->m_rd_offset, offset, arg);
 		bm->m_rd_offset += len;
-		if (bm->m_rd_offset >= bm->m_wr_offset) bm->m_rd_offset = bm->m_wr_offset = bm->m_start;
+		_buffer_mgr_rewind(bm);
 	}
 	pthread_mutex_unlock(&bm->m_mutex);
 }
@@ -288,9 +710,9 @@ bool buffer_mgr_reserved_set(buffer_mgr_t *bm, void *reserved, size_t len)
 {
 	if (!bm || !reserved) return false;
 	if (!bm->m_reserved) return false;
-	if (bm->m_start <= bm->m_reserved) return false;
-	size_t offset = bm->m_start - bm->m_reserved;
-	if (offset < len) return false;
+	/* 可伸缩模式下m_start是m_data中的偏移，保留内存的长度单独记录 */
+	size_t offset = bm->m_growable ? bm->m_reserved_len : bm->m_start - bm->m_reserved;
+	if (!offset || offset < len) return false;
 
 	pthread_mutex_lock(&bm->m_mutex);
 	memcpy((void*)bm + bm->m_reserved, reserved, len);
@@ -298,7 +720,232 @@ bool buffer_mgr_reserved_set(buffer_mgr_t *bm, void *reserved, size_t len)
 	return true;
 }
 
+/* @func:
+ *	使用缓冲区拷贝的方式转发，不支持零拷贝时使用
+ */
+static ssize_t _buffer_mgr_copy_forward(buffer_mgr_t *bm, int in_fd, int out_fd, off_t *offset, size_t len)
+{
+	ssize_t byte = 0, total = 0;
+	size_t count = 0;
+
+	do {
+		if (!_buffer_mgr_reserve(bm, 1)) break;
+		count = bm->m_end - bm->m_wr_offset;
+		if (len && count > len - total) count = len - total;
+		if (offset) {
+			/* 和sendfile一样，有offset时不改变in_fd的当前位置 */
+			do {
+				byte = pread(in_fd, BUFFER_MGR_DATA(bm) + bm->m_wr_offset, count, *offset);
+			} while (byte < 0 && errno == EINTR);
+			if (byte > 0) *offset += byte;
+		} else byte = _read_all(in_fd, BUFFER_MGR_DATA(bm) + bm->m_wr_offset, count);
+		if (0 >= byte) break;
+		bm->m_wr_offset += byte;
+		if (0 > _buffer_mgr_flush(bm, out_fd)) return total ? total : -1;
+		total += byte;
+	} while (!len || (size_t)total < len);
+
+	if (byte < 0 && !total) return -1;
+	return total;
+}
+
+/* @func:
+ *	将管道中剩余的数据写入out_fd
+ */
+static ssize_t _buffer_mgr_pipe_drain(buffer_mgr_t *bm, int out_fd)
+{
+	ssize_t byte = 0, total = 0;
+
+	while (bm->m_pipe_len > 0) {
+		byte = splice(bm->m_pipe->m_pipe[PIPE_MGR_READER], NULL, out_fd, NULL,
+				bm->m_pipe_len, SPLICE_F_MOVE | SPLICE_F_MORE);
+		if (byte < 0) {
+			if (errno == EINTR) continue;
+			return total ? total : byte;
+		}
+		if (!byte) break;
+		bm->m_pipe_len -= byte;
+		total += byte;
+	}
+	return total;
+}
+
+/* @func:
+ *	通过管道splice将in_fd的数据转发到out_fd，数据不经过用户空间
+ */
+ssize_t buffer_mgr_splice(buffer_mgr_t *bm, int in_fd, int out_fd, size_t len)
+{
+	if (!bm || in_fd < 0 || out_fd < 0) return -1;
+	ssize_t byte = 0, total = 0;
+	size_t count = 0;
+
+	if (bm->m_spsc) return -1;
+
+	pthread_mutex_lock(&bm->m_mutex);
+	if (0 > _buffer_mgr_flush(bm, out_fd)) goto err;
+
+	if (!bm->m_pipe && !(bm->m_pipe = pipe_mgr_new())) {
+		BUFFER_MGR_WARN_LOG("pipe_mgr_new error, fallback to copy");
+		total = _buffer_mgr_copy_forward(bm, in_fd, out_fd, NULL, len);
+		goto out;
+	}
+
+	/* 上次没有写完的数据 */
+	if (bm->m_pipe_len > 0 && (0 > _buffer_mgr_pipe_drain(bm, out_fd) || bm->m_pipe_len > 0)) goto err;
+
+	while (!len || (size_t)total < len) {
+		count = BUFFER_MGR_SPLICE_CHUNK;
+		if (len && count > len - total) count = len - total;
+
+		byte = splice(in_fd, NULL, bm->m_pipe->m_pipe[PIPE_MGR_WRITER], NULL,
+				count, SPLICE_F_MOVE | SPLICE_F_MORE);
+		if (byte < 0) {
+			if (errno == EINTR) continue;
+			if (errno == EINVAL && !total) {
+				/* 描述符不支持splice */
+				total = _buffer_mgr_copy_forward(bm, in_fd, out_fd, NULL, len);
+				goto out;
+			}
+			if (!total) goto err;
+			break;
+		}
+		if (!byte) break;
+
+		bm->m_pipe_len += byte;
+		total += byte;
+		/* 写不完的数据留在管道中，下次调用时再写出 */
+		if (0 > _buffer_mgr_pipe_drain(bm, out_fd) || bm->m_pipe_len > 0) break;
+	}
+
+out:
+	pthread_mutex_unlock(&bm->m_mutex);
+	return total;
+
+err:
+	pthread_mutex_unlock(&bm->m_mutex);
+	return -1;
+}
+
+/* @func:
+ *	通过sendfile将文件in_fd的内容发送到out_fd
+ */
+ssize_t buffer_mgr_sendfile(buffer_mgr_t *bm, int out_fd, int in_fd, off_t *offset, size_t len)
+{
+	if (!bm || in_fd < 0 || out_fd < 0 || !len) return -1;
+	ssize_t byte = 0, total = 0;
+
+	if (bm->m_spsc) return -1;
+
+	pthread_mutex_lock(&bm->m_mutex);
+	if (0 > _buffer_mgr_flush(bm, out_fd)) goto err;
+
+	while ((size_t)total < len) {
+		byte = sendfile(out_fd, in_fd, offset, len - total);
+		if (byte < 0) {
+			if (errno == EINTR) continue;
+			if ((errno == EINVAL || errno == ENOSYS) && !total) {
+				total = _buffer_mgr_copy_forward(bm, in_fd, out_fd, offset, len);
+				goto out;
+			}
+			if (!total) goto err;
+			break;
+		}
+		if (!byte) break;
+		total += byte;
+	}
+
+out:
+	pthread_mutex_unlock(&bm->m_mutex);
+	return total;
+
+err:
+	pthread_mutex_unlock(&bm->m_mutex);
+	return -1;
+}
+
+/* @func:
+ *	使用MSG_ZEROCOPY将缓冲区的数据写入套接字
+ */
+ssize_t buffer_mgr_write_zerocopy(buffer_mgr_t *bm, int fd)
+{
+	if (!bm || fd < 0) return -1;
+	ssize_t byte = 0, total = 0;
+	size_t count = 0;
+	int one = 1;
+
+	if (bm->m_spsc) return -1;
+
+	pthread_mutex_lock(&bm->m_mutex);
+	if (bm->m_zc_fd >= 0 && bm->m_zc_fd != fd && bm->m_zc_seq != bm->m_zc_done) {
+		BUFFER_MGR_WARN_LOG("zerocopy pending on fd: %d", bm->m_zc_fd);
+		goto copy;
+	}
+
+	if (bm->m_zc_fd != fd) {
+		bm->m_zc_fd = fd;
+		bm->m_zc_state = 0;
+		bm->m_zc_seq = bm->m_zc_done = 0;
+	}
+
+	if (!bm->m_zc_state) {
+		bm->m_zc_state = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) ? -1 : 1;
+	}
+
+	if (bm->m_zc_state < 0) goto copy;
+	if (bm->m_wr_offset - bm->m_rd_offset < BUFFER_MGR_ZEROCOPY_MIN) goto copy;
+
+	while (bm->m_wr_offset > bm->m_rd_offset) {
+		count = bm->m_wr_offset - bm->m_rd_offset;
+		byte = send(fd, BUFFER_MGR_DATA(bm) + bm->m_rd_offset, count, MSG_ZEROCOPY);
+		if (byte < 0) {
+			if (errno == EINTR) continue;
+			/* 超出optmem的限制时退回到拷贝方式 */
+			if (errno == ENOBUFS) {
+				if (0 < (byte = _buffer_mgr_flush(bm, fd))) total += byte;
+				break;
+			}
+			BUFFER_MGR_WARN_LOG("send error, errno: %d - %s", errno, strerror(errno));
+			if (!total) total = -1;
+			break;
+		}
+
+		bm->m_zc_seq++;
+		bm->m_rd_offset += byte;
+		total += byte;
+	}
+
+	_buffer_mgr_zerocopy_reap(bm);
+	_buffer_mgr_rewind(bm);
+	pthread_mutex_unlock(&bm->m_mutex);
+	return total;
+
+copy:
+	total = _buffer_mgr_flush(bm, fd);
+	pthread_mutex_unlock(&bm->m_mutex);
+	return total;
+}
+
+/* @func:
+ *	读取套接字错误队列中的完成通知，返回还未完成的MSG_ZEROCOPY发送次数
+ */
+size_t buffer_mgr_zerocopy_pending(buffer_mgr_t *bm)
+{
+	if (!bm) return 0;
+	size_t pending = 0;
+
+	pthread_mutex_lock(&bm->m_mutex);
+	_buffer_mgr_zerocopy_reap(bm);
+	_buffer_mgr_rewind(bm);
+	pending = bm->m_zc_seq - bm->m_zc_done;
+	pthread_mutex_unlock(&bm->m_mutex);
+
+	return pending;
+}
+
 #include <assert.h>
+#include <arpa/inet.h>
+#include <sched.h>
+#include <time.h>
 static size_t g_count_1 = 0;
 static size_t g_count_2 = 0;
 
@@ -319,6 +966,253 @@ static size_t _update_func(const void *ptr, size_t len, void *arg)
 	return 0;
 }
 
+static void _buffer_mgr_forward_test(void)
+{
+	const char *file = "./4_data.txt";
+	const char *file_2 = "./5_data.txt";
+	const size_t size = 1024 * 1024 + 7;
+	mode_t mode = S_IRWXU | S_IRWXG | S_IRWXO;
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+	char buf[4096];
+	size_t i = 0, pending = 0;
+	ssize_t byte = 0, total = 0;
+	off_t offset = 0;
+	buffer_mgr_t *bm = NULL;
+	pthread_t pt;
+	int fd = -1, fd_2 = -1, lfd = -1, cfd = -1, sfd = -1;
+
+	for (i = 0; i < sizeof(buf); i++) buf[i] = 'a' + i % 26;
+	assert((fd = open(file, O_CREAT|O_TRUNC|O_RDWR, mode)) >= 0);
+	for (i = 0; i < size; i += byte) {
+		byte = size - i < sizeof(buf) ? size - i : sizeof(buf);
+		assert(byte == write(fd, buf, byte));
+	}
+	assert((bm = buffer_mgr_new(64 * 1024, 0)));
+
+	/* splice: 文件 -> 文件 */
+	assert(0 == lseek(fd, 0, SEEK_SET));
+	assert((fd_2 = open(file_2, O_CREAT|O_TRUNC|O_RDWR, mode)) >= 0);
+	assert((ssize_t)size == buffer_mgr_splice(bm, fd, fd_2, 0));
+	assert((off_t)size == lseek(fd_2, 0, SEEK_END));
+	close(fd_2);
+
+	/* sendfile: 文件 -> 文件 */
+	assert((fd_2 = open(file_2, O_CREAT|O_TRUNC|O_RDWR, mode)) >= 0);
+	assert((ssize_t)size == buffer_mgr_sendfile(bm, fd_2, fd, &offset, size));
+	assert((off_t)size == offset && (off_t)size == lseek(fd_2, 0, SEEK_END));
+	assert(0 < pread(fd_2, buf, 26, 26 * 3) && buf[0] == 'a' && buf[25] == 'z');
+	close(fd_2);
+
+	/* sendfile不可用时的拷贝方式: 只推进offset，不改变in_fd的位置 */
+	assert((fd_2 = open(file_2, O_CREAT|O_TRUNC|O_RDWR, mode)) >= 0);
+	assert(100 == lseek(fd, 100, SEEK_SET));
+	offset = 26;
+	assert(4096 == _buffer_mgr_copy_forward(bm, fd, fd_2, &offset, 4096));
+	assert(26 + 4096 == offset && 100 == lseek(fd, 0, SEEK_CUR));
+	assert(26 == pread(fd_2, buf, 26, 0) && buf[0] == 'a' && buf[25] == 'z');
+	close(fd_2);
+
+	/* 还有未完成的MSG_ZEROCOPY发送时不能重置 */
+	assert(buffer_mgr_append(bm, "zc", 2));
+	bm->m_zc_seq = 1;
+	assert(!buffer_mgr_reset(bm) && 2 == bm->m_wr_offset - bm->m_rd_offset);
+	bm->m_zc_seq = 0;
+	assert(buffer_mgr_reset(bm) && bm->m_wr_offset == bm->m_rd_offset);
+
+	/* MSG_ZEROCOPY: 本地回环的tcp连接 */
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	assert((lfd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+	assert(!bind(lfd, (struct sockaddr*)&addr, sizeof(addr)));
+	assert(!listen(lfd, 1));
+	assert(!getsockname(lfd, (struct sockaddr*)&addr, &addrlen));
+	assert((cfd = socket(AF_INET, SOCK_STREAM, 0)) >= 0);
+	assert(!connect(cfd, (struct sockaddr*)&addr, sizeof(addr)));
+	assert((sfd = accept(lfd, NULL, NULL)) >= 0);
+
+	pthread_create(&pt, NULL, ({
+		void* _(void *arg) {
+			char rbuf[4096];
+			ssize_t rbyte = 0;
+			while (0 < (rbyte = read(sfd, rbuf, sizeof(rbuf)))) total += rbyte;
+			return arg;
+		}; _;}), NULL);
+
+	assert(0 == lseek(fd, 0, SEEK_SET));
+	while (0 < buffer_mgr_read(bm, fd)) {
+		assert(0 < buffer_mgr_write_zerocopy(bm, cfd));
+		for (i = 0; i < 1000 && (pending = buffer_mgr_zerocopy_pending(bm)); i++) usleep(1000);
+		assert(!pending);
+	}
+	buffer_mgr_dump(bm);
+	shutdown(cfd, SHUT_WR);
+	pthread_join(pt, NULL);
+	assert((ssize_t)size == total);
+
+	buffer_mgr_free(bm);
+	close(fd), close(lfd), close(cfd), close(sfd);
+	unlink(file), unlink(file_2);
+	MY_PRINTF("forward test ok");
+}
+
+static void _buffer_mgr_growable_test(void)
+{
+	char msg[80 * 1024];
+	buffer_mgr_t *bm = NULL;
+	void *ptr = NULL;
+	size_t len = 0;
+
+	memset(msg, 'g', sizeof(msg));
+	assert(buffer_mgr_tier_init(256, 64 * 1024, 4));
+	assert((bm = buffer_mgr_growable_new(8)));
+	assert(!bm->m_data && bm->m_end == bm->m_start);
+	assert(buffer_mgr_reserved_set(bm, "reserve", 8));
+	assert(!buffer_mgr_reserved_set(bm, "reserved", 9));
+
+	/* 第一次写入时获取最小的档位 */
+	assert(buffer_mgr_append(bm, msg, 100));
+	assert(bm->m_data && bm->m_end - bm->m_start == 256);
+
+	/* 超出当前容量时按2的幂增长，数据保持不变 */
+	assert(buffer_mgr_append(bm, msg, 10 * 1024));
+	assert(bm->m_end - bm->m_start == 16 * 1024);
+	assert((ptr = buffer_mgr_copy_new(bm, &len)) && len == 100 + 10 * 1024);
+	assert(!memcmp(ptr, msg, len));
+	buffer_mgr_copy_free(ptr);
+
+	/* 超过最大档位 */
+	assert(!buffer_mgr_append(bm, msg, sizeof(msg)));
+
+	/* 缩小到能容纳剩余数据的档位，清空后归还全部容量 */
+	buffer_mgr_update(bm, ({
+		size_t _(const void *ptr, size_t len, void *arg) {
+			(void)ptr, (void)arg;
+			return len - 1000;
+		}; _;}), NULL);
+	buffer_mgr_shrink(bm);
+	assert(bm->m_end - bm->m_start == 1024);
+	assert((ptr = buffer_mgr_copy_new(bm, &len)) && len == 1000 && !memcmp(ptr, msg, len));
+	buffer_mgr_copy_free(ptr);
+	buffer_mgr_reset(bm);
+	buffer_mgr_shrink(bm);
+	assert(!bm->m_data);
+	assert(!strcmp((char*)bm + bm->m_reserved, "reserve"));
+
+	buffer_mgr_free(bm);
+	buffer_mgr_tier_destroy();
+	MY_PRINTF("growable test ok");
+}
+
+/* @func:
+ *	SPSC模式下消息大小不能整除容量，写入和部分读取交错，缓存的位置要及时更新
+ */
+static void _buffer_mgr_spsc_test(void)
+{
+	char msg[3000], *ptr = NULL;
+	buffer_mgr_t *bm = NULL;
+	size_t i = 0, len = 0, appended = 0, consumed = 0;
+
+	assert((bm = buffer_mgr_spsc_new(4096, 0)) && bm->m_spsc->m_mask + 1 == 4096);
+
+	/* 写一条后剩下的空间不够第二条，读走一部分还是不够，全部读走后必须能写入 */
+	for (i = 0; i < sizeof(msg); i++) msg[i] = i % 251;
+	assert(buffer_mgr_append(bm, msg, sizeof(msg)));
+	assert(!buffer_mgr_append(bm, msg, sizeof(msg)));
+	buffer_mgr_update(bm, ({ size_t _(const void *ptr, size_t len, void *arg) { (void)ptr, (void)arg; return len < 1000 ? len : 1000; }; _;}), NULL);
+	assert(!buffer_mgr_append(bm, msg, sizeof(msg)));
+	buffer_mgr_update(bm, ({ size_t _(const void *ptr, size_t len, void *arg) { (void)ptr, (void)arg; assert(len == 2000); return len; }; _;}), NULL);
+	assert(buffer_mgr_append(bm, msg, sizeof(msg)));
+	buffer_mgr_reset(bm);
+
+	/* 按帧读取：只有半帧时不消费，补齐后消费者要看到整帧 */
+	assert(buffer_mgr_append(bm, msg, 50));
+	buffer_mgr_update(bm, ({ size_t _(const void *ptr, size_t len, void *arg) { (void)ptr, (void)arg; return len >= 100 ? 100 : 0; }; _;}), NULL);
+	assert(buffer_mgr_append(bm, msg + 50, 50));
+	assert((ptr = buffer_mgr_copy_new(bm, &len)) && len == 100 && !memcmp(ptr, msg, len));
+	buffer_mgr_copy_free(ptr);
+	buffer_mgr_update(bm, ({ size_t _(const void *ptr, size_t len, void *arg) { (void)ptr, (void)arg; assert(len == 100); return 100; }; _;}), NULL);
+	buffer_mgr_reset(bm);
+
+	/* 每次写入一条，读走不到一条；消费者看到的数据总量和内容都要和写入的一致 */
+	for (i = 0; i < 1000; i++) {
+		for (len = 0; len < sizeof(msg); len++) msg[len] = (appended + len) % 251;
+		if (buffer_mgr_append(bm, msg, 100 + i % 7 * 400)) appended += 100 + i % 7 * 400;
+		assert((ptr = buffer_mgr_copy_new(bm, &len)) && len == appended - consumed);
+		for (len = 0; len < appended - consumed; len++) assert(ptr[len] == (char)((consumed + len) % 251));
+		buffer_mgr_copy_free(ptr);
+		buffer_mgr_update(bm, ({ size_t _(const void *ptr, size_t len, void *arg) { (void)ptr, (void)arg; return len / 2 + 1; }; _;}), NULL);
+		consumed += (appended - consumed) / 2 + (appended > consumed);
+	}
+	assert(appended > 1000 * 100);
+	buffer_mgr_free(bm);
+	MY_PRINTF("spsc test ok");
+}
+
+struct _bench_arg {
+	size_t m_size; /* 消息的大小 */
+	size_t m_count; /* 已经取走的字节数 */
+};
+
+static size_t _bench_update_func(const void *ptr, size_t len, void *arg)
+{
+	struct _bench_arg *ba = arg;
+	(void)ptr;
+	len -= len % ba->m_size;
+	ba->m_count += len;
+	return len;
+}
+
+/* @func:
+ *	一个线程写入，一个线程读取，比较加锁模式和SPSC模式的吞吐量
+ */
+static void _buffer_mgr_spsc_bench(void)
+{
+	const size_t total = 64 * 1024 * 1024;
+	const size_t capacity = 256 * 1024;
+	size_t size = 0, mode = 0, count = 0;
+	struct _bench_arg ba;
+	double cost[2];
+	struct timespec start, end;
+	buffer_mgr_t *bm = NULL;
+	pthread_t pt;
+
+	for (size = 64; size <= 64 * 1024; size <<= 1) {
+		for (mode = 0; mode < 2; mode++) {
+			assert((bm = mode ? buffer_mgr_spsc_new(capacity, 0) : buffer_mgr_new(capacity, 0)));
+			clock_gettime(CLOCK_MONOTONIC, &start);
+
+			pthread_create(&pt, NULL, ({
+				void* _(void *arg) {
+					char msg[64 * 1024];
+					size_t count = 0;
+					memset(msg, 'x', size);
+					for (count = 0; count < total; count += size) {
+						while (!buffer_mgr_append(bm, msg, size)) sched_yield();
+					}
+					return arg;
+				}; _;}), NULL);
+
+			/* 消费者每次只取走完整的消息 */
+			ba.m_size = size, ba.m_count = 0;
+			while (ba.m_count < total) {
+				count = ba.m_count;
+				buffer_mgr_update(bm, _bench_update_func, &ba);
+				if (count == ba.m_count) sched_yield();
+			}
+
+			pthread_join(pt, NULL);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			cost[mode] = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+			buffer_mgr_free(bm);
+		}
+
+		MY_PRINTF("size: %6lu, mutex: %9.1f MB/s, spsc: %9.1f MB/s",
+				size, total / cost[0] / 1e6, total / cost[1] / 1e6);
+	}
+}
+
 int main()
 {
 	const char *file = "./1_data.txt";
@@ -371,5 +1265,10 @@ int main()
 	MY_PRINTF("g_count_2: %lu", g_count_2);
 
 	close(fd), close(fd_2), close(fd_3);
+
+	_buffer_mgr_forward_test();
+	_buffer_mgr_growable_test();
+	_buffer_mgr_spsc_test();
+	_buffer_mgr_spsc_bench();
 	return 0;
 }
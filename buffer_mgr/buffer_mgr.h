@@ -2,14 +2,40 @@
 #define _BUFFER_MGR_H_
 
 #include <stdbool.h>
+#include <sys/types.h>
+#include "pipe_mgr.h"
 
-/* 所有的偏移都是相对于系统分配的内存起始位置 */
+#define BUFFER_MGR_CACHE_LINE 64
+
+/* 单生产者/单消费者模式的控制块
+ * 生产者和消费者各自修改的下标放在不同的cache line，避免伪共享
+ */
+typedef struct _buffer_mgr_spsc {
+	void *m_ring; /* 同一块内存连续映射两次，跨越末尾的数据也是连续的 */
+	size_t m_mask; /* 容量减1，容量是2的幂 */
+	size_t m_head __attribute__((aligned(BUFFER_MGR_CACHE_LINE))); /* 写入的总字节数，只由生产者修改 */
+	size_t m_tail_cache; /* 生产者看到的m_tail */
+	size_t m_tail __attribute__((aligned(BUFFER_MGR_CACHE_LINE))); /* 读取的总字节数，只由消费者修改 */
+	size_t m_head_cache; /* 消费者看到的m_head */
+} __attribute__((aligned(BUFFER_MGR_CACHE_LINE))) buffer_mgr_spsc_t;
+
+/* 所有的偏移都是相对于系统分配的内存起始位置，可伸缩模式下数据的偏移相对于m_data */
 typedef struct _buffer_mgr {
 	size_t m_start; /* 指向缓冲区开始的位置， */
 	size_t m_end;	/* 指向缓冲区末尾的后一个位置 */
 	size_t m_rd_offset; /* 可读取的偏移位置 */
 	size_t m_wr_offset;	/* 可写入数据的偏移*/
 	size_t m_reserved; /* 执行保留位置的偏移 */
+	pipe_mgr_t *m_pipe; /* splice转发使用的管道，按需创建 */
+	size_t m_pipe_len; /* 管道中还未写出的数据长度 */
+	int m_zc_fd; /* MSG_ZEROCOPY发送使用的套接字 */
+	int m_zc_state; /* MSG_ZEROCOPY是否可用，0: 未探测，1: 可用，-1: 不支持 */
+	unsigned int m_zc_seq; /* 下一次MSG_ZEROCOPY发送的序号 */
+	unsigned int m_zc_done; /* 已经完成的序号，m_zc_seq != m_zc_done时缓冲区不能移动 */
+	buffer_mgr_spsc_t *m_spsc; /* 不为NULL时是单生产者/单消费者模式，不使用m_mutex */
+	bool m_growable; /* 是否是可伸缩模式 */
+	void *m_data; /* 可伸缩模式下从内存池中获取的数据区，容量是2的幂 */
+	size_t m_reserved_len; /* 可伸缩模式下保留内存的长度，保留内存仍在管理器结构之后 */
 	pthread_mutex_t m_mutex;
 } buffer_mgr_t;
 
@@ -34,6 +60,48 @@ void buffer_mgr_init(buffer_mgr_alloc_t alloc, buffer_mgr_free_t dealloc);
  */
 buffer_mgr_t* buffer_mgr_new(size_t capacity, size_t reserved);
 
+/* @func:
+ *	创建一个单生产者/单消费者模式的管理器
+ * @param:
+ *	capacity: 向上取整到页大小的2的幂
+ * @warn:
+ *	1. 只能有一个线程调用buffer_mgr_read/buffer_mgr_append(生产者)，
+ *	   一个线程调用buffer_mgr_write/buffer_mgr_filter/buffer_mgr_update/buffer_mgr_copy_new/buffer_mgr_reset(消费者)
+ *	2. 可读数据的后面不保证有'\0'，过滤函数需要使用len
+ *	3. 不支持splice/sendfile/MSG_ZEROCOPY的转发函数
+ */
+buffer_mgr_t* buffer_mgr_spsc_new(size_t capacity, size_t reserved);
+
+/* @func:
+ *	初始化可伸缩缓冲区使用的内存池，每个2的幂的容量是一个档位
+ * @param:
+ *	min_size: 最小档位的容量，向上取整到2的幂
+ *	max_size: 最大档位的容量
+ *	cache_cnt: 每个档位最多缓存的空闲内存数，超出的归还给系统
+ */
+bool buffer_mgr_tier_init(size_t min_size, size_t max_size, size_t cache_cnt);
+
+/* @func:
+ *	销毁内存池
+ * @warn:
+ *	所有可伸缩的管理器都必须已经释放
+ */
+void buffer_mgr_tier_destroy(void);
+
+/* @func:
+ *	创建一个可伸缩的管理器，第一次写入时才从内存池获取容量
+ * @warn:
+ *	必须先调用buffer_mgr_tier_init
+ */
+buffer_mgr_t* buffer_mgr_growable_new(size_t reserved);
+
+/* @func:
+ *	归还空闲的容量，缓冲区为空时归还全部容量，否则缩小到能容纳数据的最小档位
+ * @warn:
+ *	只对可伸缩的管理器有效，适合在连接空闲时调用
+ */
+void buffer_mgr_shrink(buffer_mgr_t *bm);
+
 /* @func:
  *	销毁一个管理器
  */
@@ -45,6 +113,11 @@ void buffer_mgr_free(buffer_mgr_t *bm);
  */
 ssize_t buffer_mgr_read(buffer_mgr_t *bm, int fd);
 
+/* @func:
+ *	将一段数据整体写入缓冲区，空间不足时返回false
+ */
+bool buffer_mgr_append(buffer_mgr_t *bm, const void *data, size_t len);
+
 /* @func:
  *	获取当前可读数据的副本
  */
@@ -57,8 +130,10 @@ void buffer_mgr_copy_free(void *ptr);
 
 /* @func:
  *	重置读写的偏移位置
+ * @warn:
+ *	还有MSG_ZEROCOPY发送没有完成时不重置并返回false，等buffer_mgr_zerocopy_pending返回0后再调用
  */
-void buffer_mgr_reset(buffer_mgr_t *bm);
+bool buffer_mgr_reset(buffer_mgr_t *bm);
 
 
 /* @func:
@@ -83,4 +158,39 @@ void buffer_mgr_update(buffer_mgr_t *bm, buffer_mgr_update_func_t update_func, v
  */
 bool buffer_mgr_reserved_set(buffer_mgr_t *bm, void *reserved, size_t len);
 
+/* @func:
+ *	通过管道splice将in_fd的数据转发到out_fd，数据不经过用户空间
+ * @param:
+ *	len: 最多转发的字节数，为0时转发到in_fd结束或者没有数据可读
+ * @warn:
+ *	1. 缓冲区中未写出的数据会先写入out_fd, 保证数据顺序
+ *	2. 描述符不支持splice时退回到buffer_mgr_read/buffer_mgr_write的拷贝方式
+ */
+ssize_t buffer_mgr_splice(buffer_mgr_t *bm, int in_fd, int out_fd, size_t len);
+
+/* @func:
+ *	通过sendfile将文件in_fd的内容发送到out_fd
+ * @param:
+ *	offset: 文件的读取位置，为NULL时使用并更新in_fd的当前位置
+ *	        不为NULL时只更新*offset，in_fd的当前位置不变(拷贝方式也一样)
+ *	len: 最多发送的字节数
+ * @warn:
+ *	不支持sendfile时退回到拷贝方式
+ */
+ssize_t buffer_mgr_sendfile(buffer_mgr_t *bm, int out_fd, int in_fd, off_t *offset, size_t len);
+
+/* @func:
+ *	使用MSG_ZEROCOPY将缓冲区的数据写入套接字
+ * @warn:
+ *	1. 发送完成之前缓冲区的内存不能被复用，需要通过buffer_mgr_zerocopy_pending回收完成通知
+ *	2. 套接字不支持或者数据量太小时退回到buffer_mgr_write的方式
+ *	3. 一个管理器同一时间只能对一个套接字使用MSG_ZEROCOPY
+ */
+ssize_t buffer_mgr_write_zerocopy(buffer_mgr_t *bm, int fd);
+
+/* @func:
+ *	读取套接字错误队列中的完成通知，返回还未完成的MSG_ZEROCOPY发送次数
+ */
+size_t buffer_mgr_zerocopy_pending(buffer_mgr_t *bm);
+
 #endif
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <sched.h>
 #include <errno.h>
 
 #include "hash_bucket_mgr.h"
@@ -15,52 +16,224 @@
 #define HASH_BUCKET_MGR_ERROR_LOG MY_PRINTF
 
 #define HASH_MGR_MEMBER_INIT_CAPACITY 0XF
+#define HASH_BUCKET_MGR_LOAD_MAX 1 /* 平均每个桶的节点数超过这个值就扩容 */
+#define HASH_BUCKET_MGR_SHRINK_RATIO 8 /* 节点数少于容量的1/8就缩容 */
+#define HASH_BUCKET_MGR_REHASH_STEP 4 /* 每次操作顺带迁移的旧桶个数 */
+#define HASH_BUCKET_MGR_RETIRE_MAX 256 /* 读多写少模式下待释放的节点超过这个数就等待读线程后释放 */
 
 /* 内存管理函数 */
 static hash_bucket_mgr_alloc_t g_hm_alloc = NULL;
 static hash_bucket_mgr_free_t g_hm_free = NULL;
 
+static size_t g_reader_seq = 0; /* 给读线程分配计数槽位 */
+static __thread size_t t_reader_index = 0; /* 本线程的计数槽位加1，0表示还没分配 */
+
 static void* _malloc2calloc(size_t size)
 {
 	return calloc(1, size);
 }
 
+static hash_bucket_mgr_stripe_t* _hash_bucket_mgr_stripe_get(hash_bucket_mgr_t *hm, size_t hash)
+{
+	return &hm->m_stripe[hash & (HASH_BUCKET_MGR_STRIPE - 1)];
+}
+
+static void _hash_bucket_mgr_lock_all(hash_bucket_mgr_t *hm)
+{
+	size_t i = 0;
+
+	for (i = 0; i < HASH_BUCKET_MGR_STRIPE; i++) pthread_mutex_lock(&hm->m_stripe[i].m_lock);
+}
+
+static void _hash_bucket_mgr_unlock_all(hash_bucket_mgr_t *hm)
+{
+	size_t i = 0;
+
+	for (i = 0; i < HASH_BUCKET_MGR_STRIPE; i++) pthread_mutex_unlock(&hm->m_stripe[i].m_lock);
+}
+
 /* @func:
- *	打印一个管理节点
+ *	持有锁时修改节点个数，判断负载时不加锁读取所有锁的节点个数
  */
-void hash_bucket_mgr_dump(hash_bucket_mgr_t *hm, bool is_dump_member)
+static void _hash_bucket_mgr_count_add(hash_bucket_mgr_stripe_t *stripe, long n)
+{
+	__atomic_store_n(&stripe->m_count, stripe->m_count + n, __ATOMIC_RELAXED);
+}
+
+static size_t _hash_bucket_mgr_count_total(hash_bucket_mgr_t *hm)
+{
+	size_t i = 0, total = 0;
+
+	for (i = 0; i < HASH_BUCKET_MGR_STRIPE; i++) total += __atomic_load_n(&hm->m_stripe[i].m_count, __ATOMIC_RELAXED);
+	return total;
+}
+
+/* @func:
+ *	链表头和m_next用release写，不加锁的查找能看到完整的节点；摘除的节点保留m_next，正在访问它的查找可以继续往后走
+ */
+static void _hash_bucket_mgr_link(hash_bucket_mgr_member_t **bucket, hash_bucket_mgr_member_t *hmm)
+{
+	hmm->m_prev = NULL;
+	hmm->m_next = *bucket;
+	if (*bucket) (*bucket)->m_prev = hmm;
+	__atomic_store_n(bucket, hmm, __ATOMIC_RELEASE);
+}
+
+static void _hash_bucket_mgr_unlink(hash_bucket_mgr_member_t **bucket, hash_bucket_mgr_member_t *hmm)
+{
+	if (!hmm->m_prev) __atomic_store_n(bucket, hmm->m_next, __ATOMIC_RELEASE);
+	else __atomic_store_n(&hmm->m_prev->m_next, hmm->m_next, __ATOMIC_RELEASE);
+	if (hmm->m_next) hmm->m_next->m_prev = hmm->m_prev;
+}
+
+/* @func:
+ *	换数组，调用者持有所有锁；前后各加一次序号，不加锁的查找发现序号变化就重读
+ */
+static void _hash_bucket_mgr_table_set(hash_bucket_mgr_t *hm, hash_bucket_mgr_member_t **member, size_t capacity, 
+								hash_bucket_mgr_member_t **old, size_t old_capacity)
+{
+	__atomic_store_n(&hm->m_table_seq, hm->m_table_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&hm->m_member, member, __ATOMIC_RELAXED);
+	__atomic_store_n(&hm->m_capacity, capacity, __ATOMIC_RELAXED);
+	__atomic_store_n(&hm->m_old, old, __ATOMIC_RELAXED);
+	__atomic_store_n(&hm->m_old_capacity, old_capacity, __ATOMIC_RELAXED);
+	__atomic_store_n(&hm->m_table_seq, hm->m_table_seq + 1, __ATOMIC_RELEASE);
+}
+
+/* @func:
+ *	不加锁查找前登记到当前纪元，返回要在结束时减掉的计数
+ *	登记后纪元已经变了说明等待线程可能没看到这次登记，撤销后重来
+ */
+static size_t* _hash_bucket_mgr_read_lock(hash_bucket_mgr_t *hm)
+{
+	hash_bucket_mgr_reader_t *reader = NULL;
+	size_t epoch = 0, *count = NULL;
+
+	if (!t_reader_index) t_reader_index = __atomic_add_fetch(&g_reader_seq, 1, __ATOMIC_RELAXED);
+	reader = &hm->m_reader[(t_reader_index - 1) % HASH_BUCKET_MGR_READER];
+	for (;;) {
+		epoch = __atomic_load_n(&hm->m_epoch, __ATOMIC_SEQ_CST);
+		count = &reader->m_count[epoch & 1];
+		__atomic_add_fetch(count, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&hm->m_epoch, __ATOMIC_SEQ_CST) == epoch) return count;
+		__atomic_sub_fetch(count, 1, __ATOMIC_RELEASE);
+	}
+}
+
+static void _hash_bucket_mgr_read_unlock(size_t *count)
+{
+	__atomic_sub_fetch(count, 1, __ATOMIC_RELEASE);
+}
+
+/* @func:
+ *	进入下一个纪元，等待上一个纪元登记的查找都结束，之后它们摘除的节点不会再被访问；调用者持有m_sync_mutex
+ */
+static void _hash_bucket_mgr_rcu_wait(hash_bucket_mgr_t *hm)
+{
+	size_t epoch = __atomic_fetch_add(&hm->m_epoch, 1, __ATOMIC_SEQ_CST), i = 0;
+
+	for (i = 0; i < HASH_BUCKET_MGR_READER; i++) {
+		while (__atomic_load_n(&hm->m_reader[i].m_count[epoch & 1], __ATOMIC_ACQUIRE)) sched_yield();
+	}
+}
+
+static void _hash_bucket_mgr_retire_free(hash_bucket_mgr_member_t *hmm)
+{
+	hash_bucket_mgr_member_t *prev = NULL;
+
+	for (; hmm; hmm = prev) {
+		prev = hmm->m_prev;
+		g_hm_free(hmm);
+	}
+}
+
+/* @func:
+ *	等待进行中的不加锁查找都结束，释放已删除的节点
+ */
+void hash_bucket_mgr_synchronize(hash_bucket_mgr_t *hm)
+{
+	if (!hm || !hm->m_is_rcu) return ;
+	hash_bucket_mgr_member_t *retire = NULL;
+
+	pthread_mutex_lock(&hm->m_sync_mutex);
+	pthread_mutex_lock(&hm->m_retire_mutex);
+	retire = hm->m_retire;
+	hm->m_retire = NULL;
+	hm->m_retire_cnt = 0;
+	pthread_mutex_unlock(&hm->m_retire_mutex);
+
+	_hash_bucket_mgr_rcu_wait(hm);
+	pthread_mutex_unlock(&hm->m_sync_mutex);
+	_hash_bucket_mgr_retire_free(retire);
+}
+
+/* @func:
+ *	读多写少模式下删除的节点先挂起来，攒够一批再等待读线程后释放
+ */
+static void _hash_bucket_mgr_retire(hash_bucket_mgr_t *hm, hash_bucket_mgr_member_t *hmm)
+{
+	bool is_full = false;
+
+	pthread_mutex_lock(&hm->m_retire_mutex);
+	hmm->m_prev = hm->m_retire;
+	hm->m_retire = hmm;
+	is_full = ++hm->m_retire_cnt >= HASH_BUCKET_MGR_RETIRE_MAX;
+	pthread_mutex_unlock(&hm->m_retire_mutex);
+
+	if (is_full) hash_bucket_mgr_synchronize(hm);
+}
+
+static void _hash_bucket_mgr_bucket_dump(hash_bucket_mgr_member_t **member, size_t capacity, const char *name)
 {
-	if (!hm) return ;
 	hash_bucket_mgr_member_t *hmm = NULL;
 	size_t i = 0, index = 0;
 	bool print_line = false;
+
+	for (i = 0; i < capacity; i++) {
+		print_line = false;
+		for (hmm = member[i], index = 1; hmm; hmm = hmm->m_next, index++) {
+			HASH_BUCKET_MGR_TRACE_LOG("%s index: %lu", name, i);
+			HASH_BUCKET_MGR_TRACE_LOG("linker index: %lu", index);
+			HASH_BUCKET_MGR_TRACE_LOG("ptr: %p", hmm->m_ptr);
+		//	HASH_BUCKET_MGR_TRACE_LOG("ptr_value: %lu", *(size_t*)hmm->m_ptr);
+			HASH_BUCKET_MGR_TRACE_LOG("hash: %lu", hmm->m_hash);
+			HASH_BUCKET_MGR_TRACE_LOG("prev: %p", hmm->m_prev);
+			HASH_BUCKET_MGR_TRACE_LOG("self: %p", hmm);
+			HASH_BUCKET_MGR_TRACE_LOG("next: %p", hmm->m_next);
+			print_line = true;
+		}
+		if (print_line) HASH_BUCKET_MGR_TRACE_LOG("");
+	}
+}
+
+/* @func:
+ *	打印一个管理节点
+ */
+void hash_bucket_mgr_dump(hash_bucket_mgr_t *hm, bool is_dump_member)
+{
+	if (!hm) return ;
 	
-	pthread_mutex_lock(&hm->m_mutex);
+	pthread_mutex_lock(&hm->m_rehash_mutex);
+	_hash_bucket_mgr_lock_all(hm);
 	HASH_BUCKET_MGR_TRACE_LOG("==============");
 	HASH_BUCKET_MGR_TRACE_LOG("capacity: %lu", hm->m_capacity);
+	HASH_BUCKET_MGR_TRACE_LOG("count: %lu", _hash_bucket_mgr_count_total(hm));
 	HASH_BUCKET_MGR_TRACE_LOG("hash_func: %p", hm->m_hash_func);
 	HASH_BUCKET_MGR_TRACE_LOG("compare_func: %p", hm->m_compare_func);
 	HASH_BUCKET_MGR_TRACE_LOG("member: %p", hm->m_member);
+	HASH_BUCKET_MGR_TRACE_LOG("old: %p", hm->m_old);
+	HASH_BUCKET_MGR_TRACE_LOG("old_capacity: %lu", hm->m_old_capacity);
+	HASH_BUCKET_MGR_TRACE_LOG("rehash_index: %lu", hm->m_rehash_index);
 	HASH_BUCKET_MGR_TRACE_LOG("");
 	
 	if (is_dump_member) {
-		for (i = 0; i < hm->m_capacity; i++) {
-			print_line = false;
-			for (hmm = hm->m_member[i], index = 1; hmm; hmm = hmm->m_next, index++) {
-				HASH_BUCKET_MGR_TRACE_LOG("hash bucket index: %lu", i);
-				HASH_BUCKET_MGR_TRACE_LOG("linker index: %lu", index);
-				HASH_BUCKET_MGR_TRACE_LOG("ptr: %p", hmm->m_ptr);
-			//	HASH_BUCKET_MGR_TRACE_LOG("ptr_value: %lu", *(size_t*)hmm->m_ptr);
-				HASH_BUCKET_MGR_TRACE_LOG("prev: %p", hmm->m_prev);
-				HASH_BUCKET_MGR_TRACE_LOG("self: %p", hmm);
-				HASH_BUCKET_MGR_TRACE_LOG("next: %p", hmm->m_next);
-				print_line = true;
-			}
-			if (print_line) HASH_BUCKET_MGR_TRACE_LOG("");
-		}
+		if (hm->m_old) _hash_bucket_mgr_bucket_dump(hm->m_old, hm->m_old_capacity, "old hash bucket");
+		_hash_bucket_mgr_bucket_dump(hm->m_member, hm->m_capacity, "hash bucket");
 	}
 	HASH_BUCKET_MGR_TRACE_LOG("==============");
-	pthread_mutex_unlock(&hm->m_mutex);
+	_hash_bucket_mgr_unlock_all(hm);
+	pthread_mutex_unlock(&hm->m_rehash_mutex);
 }
 
 /* @func:
@@ -72,97 +245,304 @@ void hash_bucket_mgr_init(hash_bucket_mgr_alloc_t hash_bucket_alloc, hash_bucket
 	else g_hm_alloc = hash_bucket_alloc, g_hm_free = hash_bucket_free;
 }
 
-/* @func:
- *	创建一个hash管理节点
- */
-hash_bucket_mgr_t* hash_bucket_mgr_new(size_t capacity, hash_bucket_hash_func_t hash_func, 
-								hash_bucket_compare_func_t compare_func)
+static hash_bucket_mgr_t* _hash_bucket_mgr_new(size_t capacity, hash_bucket_hash_func_t hash_func, 
+								hash_bucket_compare_func_t compare_func, bool is_rcu)
 {
 	if (!hash_func || !compare_func) return NULL;
 	if (!capacity) capacity = HASH_MGR_MEMBER_INIT_CAPACITY;
+	capacity = (capacity + HASH_BUCKET_MGR_STRIPE - 1) / HASH_BUCKET_MGR_STRIPE * HASH_BUCKET_MGR_STRIPE;
 	hash_bucket_mgr_t *hm = NULL;
+	size_t i = 0;
 	
 	if (!(hm = (hash_bucket_mgr_t*)g_hm_alloc(sizeof(hash_bucket_mgr_t)))) {
 		HASH_BUCKET_MGR_ERROR_LOG("g_hm_alloc error,errno: %d - %s", errno, strerror(errno));
-		return false;
+		return NULL;
 	}
+	memset(hm, 0, sizeof(hash_bucket_mgr_t));
 	if (!(hm->m_member = (hash_bucket_mgr_member_t**)g_hm_alloc(capacity * sizeof(hash_bucket_mgr_member_t*)))) {
 		HASH_BUCKET_MGR_ERROR_LOG("g_hm_alloc error, errno: %d - %s", errno, strerror(errno));
 		goto free_exit;
 	}
+	memset(hm->m_member, 0, capacity * sizeof(hash_bucket_mgr_member_t*));
+	if (is_rcu && !(hm->m_reader = (hash_bucket_mgr_reader_t*)g_hm_alloc(HASH_BUCKET_MGR_READER * sizeof(hash_bucket_mgr_reader_t)))) {
+		HASH_BUCKET_MGR_ERROR_LOG("g_hm_alloc error, errno: %d - %s", errno, strerror(errno));
+		goto free_exit;
+	}
+	if (hm->m_reader) memset(hm->m_reader, 0, HASH_BUCKET_MGR_READER * sizeof(hash_bucket_mgr_reader_t));
 	
-	if (pthread_mutex_init(&hm->m_mutex, NULL)) {
+	if (pthread_mutex_init(&hm->m_rehash_mutex, NULL) || pthread_mutex_init(&hm->m_retire_mutex, NULL)
+		|| pthread_mutex_init(&hm->m_sync_mutex, NULL)) {
 		HASH_BUCKET_MGR_ERROR_LOG("pthread_mutex_init error, errno: %d - %s", errno, strerror(errno));
 		goto free_exit;
 	}
+	for (i = 0; i < HASH_BUCKET_MGR_STRIPE; i++) pthread_mutex_init(&hm->m_stripe[i].m_lock, NULL);
 	
-	hm->m_capacity = capacity;
+	hm->m_capacity = hm->m_min_capacity = capacity;
 	hm->m_compare_func = compare_func;
 	hm->m_hash_func = hash_func;
+	hm->m_is_rcu = is_rcu;
 	return hm;
 	
 free_exit:
 	if (hm) {
 		if (hm->m_member) g_hm_free(hm->m_member);
+		if (hm->m_reader) g_hm_free(hm->m_reader);
 		g_hm_free(hm);
 	}
 	return NULL;
 }
 
+/* @func:
+ *	创建一个hash管理节点，capacity向上取整到锁个数的整数倍
+ */
+hash_bucket_mgr_t* hash_bucket_mgr_new(size_t capacity, hash_bucket_hash_func_t hash_func, 
+								hash_bucket_compare_func_t compare_func)
+{
+	return _hash_bucket_mgr_new(capacity, hash_func, compare_func, false);
+}
+
+/* @func:
+ *	创建一个读多写少的hash管理节点，hash_bucket_mgr_member_is_exist不加锁
+ *	删除的ptr可能还在被查找线程比较，调用hash_bucket_mgr_synchronize之后才能释放
+ */
+hash_bucket_mgr_t* hash_bucket_mgr_rcu_new(size_t capacity, hash_bucket_hash_func_t hash_func, 
+								hash_bucket_compare_func_t compare_func)
+{
+	return _hash_bucket_mgr_new(capacity, hash_func, compare_func, true);
+}
+
+static void _hash_bucket_mgr_bucket_free(hash_bucket_mgr_member_t **member, size_t capacity)
+{
+	hash_bucket_mgr_member_t *hmm = NULL, *next = NULL;
+	size_t i = 0;
+
+	for (i = 0; i < capacity; i++) {
+		for (hmm = member[i]; hmm; hmm = next) {
+			next = hmm->m_next;
+			g_hm_free(hmm);
+		}
+	}
+	g_hm_free(member);
+}
+
 /* @func:
  *	销毁一个管理节点，但不销毁真正ptr节点的内存
  */
 void hash_bucket_mgr_free(hash_bucket_mgr_t *hm)
 {
 	if (!hm) return ;
-	pthread_mutex_lock(&hm->m_mutex);
-	if (hm->m_member) g_hm_free(hm->m_member);
-	pthread_mutex_destroy(&hm->m_mutex);
+	size_t i = 0;
+
+	pthread_mutex_lock(&hm->m_rehash_mutex);
+	_hash_bucket_mgr_lock_all(hm);
+	if (hm->m_old) _hash_bucket_mgr_bucket_free(hm->m_old, hm->m_old_capacity);
+	if (hm->m_member) _hash_bucket_mgr_bucket_free(hm->m_member, hm->m_capacity);
+	_hash_bucket_mgr_retire_free(hm->m_retire);
+	if (hm->m_reader) g_hm_free(hm->m_reader);
+	_hash_bucket_mgr_unlock_all(hm);
+	for (i = 0; i < HASH_BUCKET_MGR_STRIPE; i++) pthread_mutex_destroy(&hm->m_stripe[i].m_lock);
+	pthread_mutex_unlock(&hm->m_rehash_mutex);
+	pthread_mutex_destroy(&hm->m_rehash_mutex);
+	pthread_mutex_destroy(&hm->m_retire_mutex);
+	pthread_mutex_destroy(&hm->m_sync_mutex);
 	g_hm_free(hm);
 }
 
-static bool _hash_bucket_mgr_member_add(hash_bucket_mgr_t *hm, void *ptr)
+/* @func:
+ *	换成新的数组，旧数组中的节点之后逐步迁移，调用者持有m_rehash_mutex
+ */
+static void _hash_bucket_mgr_rehash_start(hash_bucket_mgr_t *hm, size_t capacity)
 {
-	if (!hm || !ptr) return false;
-	hash_bucket_mgr_member_t *hmm = NULL;
-	size_t index = hm->m_hash_func(ptr) % hm->m_capacity;
-	
-	if (!(hmm = (hash_bucket_mgr_member_t*)g_hm_alloc(sizeof(hash_bucket_mgr_member_t)))) {
+	hash_bucket_mgr_member_t **member = NULL;
+
+	if (!(member = (hash_bucket_mgr_member_t**)g_hm_alloc(capacity * sizeof(hash_bucket_mgr_member_t*)))) {
 		HASH_BUCKET_MGR_ERROR_LOG("g_hm_alloc error, errno: %d - %s", errno, strerror(errno));
-		return false;
+		return ;
+	}
+	memset(member, 0, capacity * sizeof(hash_bucket_mgr_member_t*));
+
+	_hash_bucket_mgr_lock_all(hm);
+	hm->m_rehash_index = 0;
+	_hash_bucket_mgr_table_set(hm, member, capacity, hm->m_member, hm->m_capacity);
+	_hash_bucket_mgr_unlock_all(hm);
+}
+
+/* @func:
+ *	读多写少模式下把一个旧桶的节点复制到新数组，旧链表保持不变，查找到一半的线程不会被带到别的链表上
+ *	旧节点在迁移结束后统一释放，调用者持有桶对应的锁
+ */
+static bool _hash_bucket_mgr_bucket_copy(hash_bucket_mgr_t *hm, size_t index)
+{
+	hash_bucket_mgr_member_t *hmm = NULL, *copy = NULL, *list = NULL;
+
+	/* 先分配好所有的副本，失败时这个桶下次再迁移 */
+	for (hmm = hm->m_old[index]; hmm; hmm = hmm->m_next) {
+		if (!(copy = (hash_bucket_mgr_member_t*)g_hm_alloc(sizeof(hash_bucket_mgr_member_t)))) {
+			HASH_BUCKET_MGR_ERROR_LOG("g_hm_alloc error, errno: %d - %s", errno, strerror(errno));
+			_hash_bucket_mgr_retire_free(list);
+			return false;
+		}
+		copy->m_ptr = hmm->m_ptr;
+		copy->m_hash = hmm->m_hash;
+		copy->m_prev = list;
+		list = copy;
+	}
+	for (; list; list = copy) {
+		copy = list->m_prev;
+		_hash_bucket_mgr_link(&hm->m_member[list->m_hash % hm->m_capacity], list);
 	}
-	hmm->m_ptr = ptr;
-	hmm->m_next = hm->m_member[index];
-	if (hm->m_member[index]) hm->m_member[index]->m_prev = hmm;
-	hm->m_member[index] = hmm;
 	return true;
 }
 
-static hash_bucket_mgr_member_t* _hash_bucket_mgr_member_find(hash_bucket_mgr_t *hm, void *ptr)
+/* @func:
+ *	迁移几个旧桶，全部迁移完后释放旧数组；已经有线程在迁移时直接返回
+ *	新旧容量都是锁个数的整数倍，一个旧桶里的节点在新数组中仍由同一把锁保护
+ */
+static void _hash_bucket_mgr_rehash_step(hash_bucket_mgr_t *hm)
+{
+	hash_bucket_mgr_stripe_t *stripe = NULL;
+	hash_bucket_mgr_member_t *hmm = NULL, **old = NULL;
+	size_t i = 0, index = 0, old_capacity = 0;
+	bool is_done = true;
+
+	if (!__atomic_load_n(&hm->m_old, __ATOMIC_RELAXED) || pthread_mutex_trylock(&hm->m_rehash_mutex)) return ;
+
+	for (i = 0; hm->m_old && i < HASH_BUCKET_MGR_REHASH_STEP && hm->m_rehash_index < hm->m_old_capacity; i++) {
+		index = hm->m_rehash_index;
+		stripe = _hash_bucket_mgr_stripe_get(hm, index);
+		pthread_mutex_lock(&stripe->m_lock);
+		if (hm->m_is_rcu) is_done = _hash_bucket_mgr_bucket_copy(hm, index);
+		else while ((hmm = hm->m_old[index])) {
+			_hash_bucket_mgr_unlink(&hm->m_old[index], hmm);
+			_hash_bucket_mgr_link(&hm->m_member[hmm->m_hash % hm->m_capacity], hmm);
+		}
+		pthread_mutex_unlock(&stripe->m_lock);
+		if (!is_done) break;
+		hm->m_rehash_index++;
+	}
+
+	if (hm->m_old && hm->m_rehash_index == hm->m_old_capacity) {
+		old = hm->m_old, old_capacity = hm->m_old_capacity;
+		_hash_bucket_mgr_lock_all(hm);
+		_hash_bucket_mgr_table_set(hm, hm->m_member, hm->m_capacity, NULL, 0);
+		_hash_bucket_mgr_unlock_all(hm);
+		/* 旧链表中剩下的都是已经复制过的节点，等不加锁的查找离开后释放 */
+		if (hm->m_is_rcu) {
+			pthread_mutex_lock(&hm->m_sync_mutex);
+			_hash_bucket_mgr_rcu_wait(hm);
+			pthread_mutex_unlock(&hm->m_sync_mutex);
+			_hash_bucket_mgr_bucket_free(old, old_capacity);
+		} else g_hm_free(old);
+	}
+	pthread_mutex_unlock(&hm->m_rehash_mutex);
+}
+
+/* @func:
+ *	所在锁的负载越界后调用，按总节点数决定是否扩缩容
+ */
+static void _hash_bucket_mgr_resize_check(hash_bucket_mgr_t *hm)
+{
+	size_t total = 0;
+
+	if (pthread_mutex_trylock(&hm->m_rehash_mutex)) return ;
+	if (!hm->m_old) {
+		total = _hash_bucket_mgr_count_total(hm);
+		if (total > hm->m_capacity * HASH_BUCKET_MGR_LOAD_MAX)
+			_hash_bucket_mgr_rehash_start(hm, hm->m_capacity * 2);
+		else if (hm->m_capacity > hm->m_min_capacity && total < hm->m_capacity / HASH_BUCKET_MGR_SHRINK_RATIO)
+			_hash_bucket_mgr_rehash_start(hm, hm->m_capacity / 2);
+	}
+	pthread_mutex_unlock(&hm->m_rehash_mutex);
+}
+
+/* @func:
+ *	操作完成并释放锁后调用，迁移中则帮忙迁移，否则按需扩缩容
+ */
+static void _hash_bucket_mgr_maintain(hash_bucket_mgr_t *hm, bool is_rehashing, bool is_resize)
+{
+	if (is_rehashing) _hash_bucket_mgr_rehash_step(hm);
+	else if (is_resize) _hash_bucket_mgr_resize_check(hm);
+}
+
+/* @func:
+ *	在一个桶里查找节点，不加锁的查找也用，按acquire读链表
+ */
+static hash_bucket_mgr_member_t* _hash_bucket_mgr_chain_find(hash_bucket_mgr_t *hm, hash_bucket_mgr_member_t **bucket, 
+								void *ptr, size_t hash)
 {
-	if (!hm || !ptr) return NULL;
 	hash_bucket_mgr_member_t *hmm = NULL;
-	size_t index = hm->m_hash_func(ptr) % hm->m_capacity;
 
-	for (hmm = hm->m_member[index]; hmm; hmm = hmm->m_next) {
-		if (hm->m_compare_func(ptr, hmm->m_ptr)) return hmm;
+	for (hmm = __atomic_load_n(bucket, __ATOMIC_ACQUIRE); hmm; hmm = __atomic_load_n(&hmm->m_next, __ATOMIC_ACQUIRE)) {
+		if (hmm->m_hash == hash && hm->m_compare_func(ptr, __atomic_load_n(&hmm->m_ptr, __ATOMIC_ACQUIRE))) return hmm;
 	}
 	return NULL;
 }
 
+/* @func:
+ *	查找节点，先找旧数组再找新数组，调用者持有hash对应的锁
+ */
+static hash_bucket_mgr_member_t* _hash_bucket_mgr_member_find(hash_bucket_mgr_t *hm, void *ptr, size_t hash, 
+								hash_bucket_mgr_member_t ***bucket)
+{
+	hash_bucket_mgr_member_t *hmm = NULL, **member = NULL;
+
+	if (hm->m_old && (hmm = _hash_bucket_mgr_chain_find(hm, member = &hm->m_old[hash % hm->m_old_capacity], ptr, hash))) goto out;
+	if ((hmm = _hash_bucket_mgr_chain_find(hm, member = &hm->m_member[hash % hm->m_capacity], ptr, hash))) goto out;
+	return NULL;
+
+out:
+	if (bucket) *bucket = member;
+	return hmm;
+}
+
+/* @func:
+ *	读多写少模式下摘除节点，新数组中找到的是复制过的节点时，旧数组中对应的原节点也要摘除；调用者持有hash对应的锁
+ *	查找先找旧数组，摘除原节点之前查找都能找到，之后两边都找不到
+ */
+static hash_bucket_mgr_member_t* _hash_bucket_mgr_rcu_unlink(hash_bucket_mgr_t *hm, void *ptr, size_t hash, 
+								hash_bucket_mgr_member_t **origin)
+{
+	hash_bucket_mgr_member_t *hmm = NULL, **bucket = &hm->m_member[hash % hm->m_capacity], **old = NULL;
+
+	*origin = NULL;
+	if (hm->m_old) old = &hm->m_old[hash % hm->m_old_capacity];
+	if ((hmm = _hash_bucket_mgr_chain_find(hm, bucket, ptr, hash))) {
+		_hash_bucket_mgr_unlink(bucket, hmm);
+		for (*origin = old ? *old : NULL; *origin; *origin = (*origin)->m_next) {
+			if ((*origin)->m_ptr == hmm->m_ptr && (*origin)->m_hash == hash) break;
+		}
+		if (*origin) _hash_bucket_mgr_unlink(old, *origin);
+	} else if (old && (hmm = _hash_bucket_mgr_chain_find(hm, old, ptr, hash))) _hash_bucket_mgr_unlink(old, hmm);
+	return hmm;
+}
+
 /* @func:
  *	添加节点到hash bucket中
  */
 bool hash_bucket_mgr_member_add(hash_bucket_mgr_t *hm, void *ptr)
 {
 	if (!hm || !ptr) return false;
-	bool ret = false;
+	hash_bucket_mgr_member_t *hmm = NULL;
+	hash_bucket_mgr_stripe_t *stripe = NULL;
+	bool is_rehashing = false, is_resize = false;
 
-	pthread_mutex_lock(&hm->m_mutex);
-	ret = _hash_bucket_mgr_member_add(hm, ptr);
-	pthread_mutex_unlock(&hm->m_mutex);
+	if (!(hmm = (hash_bucket_mgr_member_t*)g_hm_alloc(sizeof(hash_bucket_mgr_member_t)))) {
+		HASH_BUCKET_MGR_ERROR_LOG("g_hm_alloc error, errno: %d - %s", errno, strerror(errno));
+		return false;
+	}
+	hmm->m_ptr = ptr;
+	hmm->m_hash = hm->m_hash_func(ptr);
+	stripe = _hash_bucket_mgr_stripe_get(hm, hmm->m_hash);
+
+	pthread_mutex_lock(&stripe->m_lock);
+	_hash_bucket_mgr_link(&hm->m_member[hmm->m_hash % hm->m_capacity], hmm);
+	_hash_bucket_mgr_count_add(stripe, 1);
+	is_rehashing = hm->m_old != NULL;
+	is_resize = stripe->m_count > hm->m_capacity / HASH_BUCKET_MGR_STRIPE * HASH_BUCKET_MGR_LOAD_MAX;
+	pthread_mutex_unlock(&stripe->m_lock);
 	
-	return ret;
+	_hash_bucket_mgr_maintain(hm, is_rehashing, is_resize);
+	return true;
 }
 
 /* @func:
@@ -170,24 +550,94 @@ bool hash_bucket_mgr_member_add(hash_bucket_mgr_t *hm, void *ptr)
  */
 void* hash_bucket_mgr_member_del(hash_bucket_mgr_t *hm, void *ptr)
 {
-	if (!hm || !ptr) return false;
+	if (!hm || !ptr) return NULL;
 	void *ret = NULL;
-	hash_bucket_mgr_member_t *hmm = NULL;
-	size_t index = 0;
+	hash_bucket_mgr_member_t *hmm = NULL, **bucket = NULL, *origin = NULL;
+	hash_bucket_mgr_stripe_t *stripe = NULL;
+	size_t hash = hm->m_hash_func(ptr);
+	bool is_rehashing = false, is_resize = false;
 	
-	pthread_mutex_lock(&hm->m_mutex);
-	index = hm->m_hash_func(ptr) % hm->m_capacity;
-	if ((hmm = _hash_bucket_mgr_member_find(hm, ptr))) {
+	stripe = _hash_bucket_mgr_stripe_get(hm, hash);
+	pthread_mutex_lock(&stripe->m_lock);
+	if (hm->m_is_rcu) hmm = _hash_bucket_mgr_rcu_unlink(hm, ptr, hash, &origin);
+	else if ((hmm = _hash_bucket_mgr_member_find(hm, ptr, hash, &bucket))) _hash_bucket_mgr_unlink(bucket, hmm);
+	if (hmm) {
 		ret = hmm->m_ptr;
-		if (!hmm->m_prev) {
-			hm->m_member[index] = hmm->m_next;
-			if (hmm->m_next) hmm->m_next->m_prev = NULL;
-		} else if (!hmm->m_next) hmm->m_prev->m_next = NULL;
-		else hmm->m_next->m_prev = hmm->m_prev, hmm->m_prev->m_next = hmm->m_next;
-		g_hm_free(hmm);
+		_hash_bucket_mgr_count_add(stripe, -1);
+		is_resize = hm->m_capacity > hm->m_min_capacity
+			&& stripe->m_count < hm->m_capacity / HASH_BUCKET_MGR_STRIPE / HASH_BUCKET_MGR_SHRINK_RATIO;
 	}
-	pthread_mutex_unlock(&hm->m_mutex);
+	is_rehashing = hm->m_old != NULL;
+	pthread_mutex_unlock(&stripe->m_lock);
 	
+	if (hm->m_is_rcu) {
+		if (origin) _hash_bucket_mgr_retire(hm, origin);
+		if (hmm) _hash_bucket_mgr_retire(hm, hmm);
+	} else if (hmm) g_hm_free(hmm);
+	_hash_bucket_mgr_maintain(hm, is_rehashing, is_resize);
+	return ret;
+}
+
+/* @func:
+ *	不加锁读到一致的数组和容量，调用者已经登记到纪元
+ */
+static void _hash_bucket_mgr_table_get(hash_bucket_mgr_t *hm, hash_bucket_mgr_member_t ***member, size_t *capacity, 
+								hash_bucket_mgr_member_t ***old, size_t *old_capacity)
+{
+	size_t seq = 0;
+
+	for (;;) {
+		seq = __atomic_load_n(&hm->m_table_seq, __ATOMIC_ACQUIRE);
+		*member = __atomic_load_n(&hm->m_member, __ATOMIC_RELAXED);
+		*capacity = __atomic_load_n(&hm->m_capacity, __ATOMIC_RELAXED);
+		*old = __atomic_load_n(&hm->m_old, __ATOMIC_RELAXED);
+		*old_capacity = __atomic_load_n(&hm->m_old_capacity, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (!(seq & 1) && __atomic_load_n(&hm->m_table_seq, __ATOMIC_RELAXED) == seq) break;
+		sched_yield();
+	}
+}
+
+/* @func:
+ *	读多写少模式下不加锁查找，先找旧数组后找新数组
+ */
+static void* _hash_bucket_mgr_rcu_find(hash_bucket_mgr_t *hm, hash_bucket_mgr_member_t **member, size_t capacity, 
+								hash_bucket_mgr_member_t **old, size_t old_capacity, void *ptr, size_t hash)
+{
+	hash_bucket_mgr_member_t *hmm = NULL;
+
+	if (old) hmm = _hash_bucket_mgr_chain_find(hm, &old[hash % old_capacity], ptr, hash);
+	if (!hmm) hmm = _hash_bucket_mgr_chain_find(hm, &member[hash % capacity], ptr, hash);
+	return hmm ? __atomic_load_n(&hmm->m_ptr, __ATOMIC_ACQUIRE) : NULL;
+}
+
+/* @func:
+ *	查找节点，返回添加时的ptr，不存在时返回NULL
+ */
+void* hash_bucket_mgr_member_find(hash_bucket_mgr_t *hm, void *ptr)
+{
+	if (!hm || !ptr) return NULL;
+	hash_bucket_mgr_member_t *hmm = NULL, **member = NULL, **old = NULL;
+	hash_bucket_mgr_stripe_t *stripe = NULL;
+	size_t hash = hm->m_hash_func(ptr), capacity = 0, old_capacity = 0, *count = NULL;
+	bool is_rehashing = false;
+	void *ret = NULL;
+
+	if (hm->m_is_rcu) {
+		count = _hash_bucket_mgr_read_lock(hm);
+		_hash_bucket_mgr_table_get(hm, &member, &capacity, &old, &old_capacity);
+		ret = _hash_bucket_mgr_rcu_find(hm, member, capacity, old, old_capacity, ptr, hash);
+		_hash_bucket_mgr_read_unlock(count);
+		return ret;
+	}
+
+	stripe = _hash_bucket_mgr_stripe_get(hm, hash);
+	pthread_mutex_lock(&stripe->m_lock);
+	if ((hmm = _hash_bucket_mgr_member_find(hm, ptr, hash, NULL))) ret = hmm->m_ptr;
+	is_rehashing = hm->m_old != NULL;
+	pthread_mutex_unlock(&stripe->m_lock);
+	
+	_hash_bucket_mgr_maintain(hm, is_rehashing, false);
 	return ret;
 }
 
@@ -196,16 +646,245 @@ void* hash_bucket_mgr_member_del(hash_bucket_mgr_t *hm, void *ptr)
  */
 bool hash_bucket_mgr_member_is_exist(hash_bucket_mgr_t *hm, void *ptr)
 {
-	if (!hm) return NULL;
-	bool ret = false;
-	pthread_mutex_lock(&hm->m_mutex);
-	ret = _hash_bucket_mgr_member_find(hm, ptr) ? true : false;
-	pthread_mutex_unlock(&hm->m_mutex);
-	
+	return hash_bucket_mgr_member_find(hm, ptr) ? true : false;
+}
+
+/* @func:
+ *	查找或添加，key相同的节点已经存在时把ptr替换进去；调用者持有hash对应的锁
+ *	读多写少模式下复制过的节点在新旧数组中各有一个，两个都要替换，之后删除时才能配对
+ */
+static bool _hash_bucket_mgr_member_put(hash_bucket_mgr_t *hm, hash_bucket_mgr_stripe_t *stripe, void *ptr, size_t hash, 
+								bool is_replace, void **old_ptr)
+{
+	hash_bucket_mgr_member_t *hmm = NULL, *other = NULL, **bucket = NULL;
+
+	if ((hmm = _hash_bucket_mgr_member_find(hm, ptr, hash, &bucket))) {
+		*old_ptr = hmm->m_ptr;
+		if (!is_replace) return true;
+		if (hm->m_is_rcu && hm->m_old) {
+			/* 找到的是旧数组中的原节点时，复制的节点在新数组中，反之亦然 */
+			bucket = bucket == &hm->m_old[hash % hm->m_old_capacity] ? &hm->m_member[hash % hm->m_capacity]
+				: &hm->m_old[hash % hm->m_old_capacity];
+			for (other = *bucket; other; other = other->m_next) {
+				if (other->m_ptr == hmm->m_ptr && other->m_hash == hash) 
+					__atomic_store_n(&other->m_ptr, ptr, __ATOMIC_RELEASE);
+			}
+		}
+		__atomic_store_n(&hmm->m_ptr, ptr, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	*old_ptr = NULL;
+	if (!(hmm = (hash_bucket_mgr_member_t*)g_hm_alloc(sizeof(hash_bucket_mgr_member_t)))) {
+		HASH_BUCKET_MGR_ERROR_LOG("g_hm_alloc error, errno: %d - %s", errno, strerror(errno));
+		return false;
+	}
+	hmm->m_ptr = ptr;
+	hmm->m_hash = hash;
+	_hash_bucket_mgr_link(&hm->m_member[hash % hm->m_capacity], hmm);
+	_hash_bucket_mgr_count_add(stripe, 1);
+	return true;
+}
+
+/* @func:
+ *	查找节点，不存在时添加，只计算一次hash、加一次锁
+ *	返回已经存在的ptr，添加时返回ptr本身，失败返回NULL
+ */
+void* hash_bucket_mgr_member_find_or_add(hash_bucket_mgr_t *hm, void *ptr)
+{
+	if (!hm || !ptr) return NULL;
+	hash_bucket_mgr_stripe_t *stripe = NULL;
+	size_t hash = hm->m_hash_func(ptr);
+	bool is_rehashing = false, is_resize = false;
+	void *ret = NULL;
+
+	stripe = _hash_bucket_mgr_stripe_get(hm, hash);
+	pthread_mutex_lock(&stripe->m_lock);
+	if (_hash_bucket_mgr_member_put(hm, stripe, ptr, hash, false, &ret) && !ret) ret = ptr;
+	is_rehashing = hm->m_old != NULL;
+	is_resize = stripe->m_count > hm->m_capacity / HASH_BUCKET_MGR_STRIPE * HASH_BUCKET_MGR_LOAD_MAX;
+	pthread_mutex_unlock(&stripe->m_lock);
+
+	_hash_bucket_mgr_maintain(hm, is_rehashing, is_resize);
 	return ret;
 }
 
+/* @func:
+ *	添加节点，key相同的节点已经存在时替换成ptr，old_ptr返回被替换的ptr，没有时为NULL
+ *	读多写少模式下被替换的ptr要在hash_bucket_mgr_synchronize之后才能释放
+ */
+bool hash_bucket_mgr_member_upsert(hash_bucket_mgr_t *hm, void *ptr, void **old_ptr)
+{
+	if (!hm || !ptr) return false;
+	hash_bucket_mgr_stripe_t *stripe = NULL;
+	size_t hash = hm->m_hash_func(ptr);
+	bool ret = false, is_rehashing = false, is_resize = false;
+	void *old = NULL;
+
+	stripe = _hash_bucket_mgr_stripe_get(hm, hash);
+	pthread_mutex_lock(&stripe->m_lock);
+	ret = _hash_bucket_mgr_member_put(hm, stripe, ptr, hash, true, &old);
+	is_rehashing = hm->m_old != NULL;
+	is_resize = stripe->m_count > hm->m_capacity / HASH_BUCKET_MGR_STRIPE * HASH_BUCKET_MGR_LOAD_MAX;
+	pthread_mutex_unlock(&stripe->m_lock);
+
+	_hash_bucket_mgr_maintain(hm, is_rehashing, is_resize);
+	if (old_ptr) *old_ptr = old;
+	return ret;
+}
+
+/* @func:
+ *	按锁分组，返回每组在order中的起始位置，start[HASH_BUCKET_MGR_STRIPE]是总数
+ */
+static void _hash_bucket_mgr_group(const size_t *hash, size_t cnt, size_t *order, size_t *start)
+{
+	size_t pos[HASH_BUCKET_MGR_STRIPE] = {0}, i = 0;
+
+	memset(start, 0, (HASH_BUCKET_MGR_STRIPE + 1) * sizeof(size_t));
+	for (i = 0; i < cnt; i++) start[(hash[i] & (HASH_BUCKET_MGR_STRIPE - 1)) + 1]++;
+	for (i = 0; i < HASH_BUCKET_MGR_STRIPE; i++) start[i + 1] += start[i];
+	for (i = 0; i < HASH_BUCKET_MGR_STRIPE; i++) pos[i] = start[i];
+	for (i = 0; i < cnt; i++) order[pos[hash[i] & (HASH_BUCKET_MGR_STRIPE - 1)]++] = i;
+}
+
+/* @func:
+ *	批量添加，按锁分组后每把锁只加一次，节点在加锁前分配好；遇到NULL跳过
+ *	返回添加的个数，分配内存失败时只添加前面的一部分
+ */
+size_t hash_bucket_mgr_member_add_batch(hash_bucket_mgr_t *hm, void **ptr, size_t cnt)
+{
+	if (!hm || !ptr || !cnt) return 0;
+	hash_bucket_mgr_member_t **node = NULL;
+	hash_bucket_mgr_stripe_t *stripe = NULL;
+	size_t *hash = NULL, *order = NULL, start[HASH_BUCKET_MGR_STRIPE + 1], i = 0, j = 0, n = 0;
+	bool is_rehashing = false, is_resize = false;
+
+	if (!(node = (hash_bucket_mgr_member_t**)g_hm_alloc(cnt * (sizeof(*node) + 2 * sizeof(size_t))))) {
+		HASH_BUCKET_MGR_ERROR_LOG("g_hm_alloc error, errno: %d - %s", errno, strerror(errno));
+		return 0;
+	}
+	hash = (size_t*)(node + cnt);
+	order = hash + cnt;
+
+	for (i = 0; i < cnt; i++) {
+		if (!ptr[i]) continue;
+		if (!(node[n] = (hash_bucket_mgr_member_t*)g_hm_alloc(sizeof(hash_bucket_mgr_member_t)))) {
+			HASH_BUCKET_MGR_ERROR_LOG("g_hm_alloc error, errno: %d - %s", errno, strerror(errno));
+			break;
+		}
+		node[n]->m_ptr = ptr[i];
+		hash[n] = node[n]->m_hash = hm->m_hash_func(ptr[i]);
+		n++;
+	}
+	_hash_bucket_mgr_group(hash, n, order, start);
+
+	for (i = 0; i < HASH_BUCKET_MGR_STRIPE; i++) {
+		if (start[i] == start[i + 1]) continue;
+		stripe = &hm->m_stripe[i];
+		pthread_mutex_lock(&stripe->m_lock);
+		for (j = start[i]; j < start[i + 1]; j++) {
+			if (j + 4 < start[i + 1]) __builtin_prefetch(&hm->m_member[hash[order[j + 4]] % hm->m_capacity], 1);
+			_hash_bucket_mgr_link(&hm->m_member[hash[order[j]] % hm->m_capacity], node[order[j]]);
+		}
+		_hash_bucket_mgr_count_add(stripe, start[i + 1] - start[i]);
+		is_rehashing = hm->m_old != NULL;
+		is_resize |= stripe->m_count > hm->m_capacity / HASH_BUCKET_MGR_STRIPE * HASH_BUCKET_MGR_LOAD_MAX;
+		pthread_mutex_unlock(&stripe->m_lock);
+	}
+	g_hm_free(node);
+
+	_hash_bucket_mgr_maintain(hm, is_rehashing, is_resize);
+	return n;
+}
+
+/* @func:
+ *	批量查找，result[i]是ptr[i]对应的节点，不存在时为NULL，返回找到的个数
+ *	按锁分组后每把锁只加一次，查找前预取后面几个桶的链表头和第一个节点
+ */
+size_t hash_bucket_mgr_member_find_batch(hash_bucket_mgr_t *hm, void **ptr, void **result, size_t cnt)
+{
+	if (!hm || !ptr || !result || !cnt) return 0;
+	hash_bucket_mgr_member_t *hmm = NULL, **member = NULL, **old = NULL;
+	hash_bucket_mgr_stripe_t *stripe = NULL;
+	size_t *hash = NULL, *order = NULL, start[HASH_BUCKET_MGR_STRIPE + 1], i = 0, j = 0, k = 0, found = 0;
+	size_t capacity = 0, old_capacity = 0, *count = NULL;
+
+	if (!(hash = (size_t*)g_hm_alloc(cnt * 2 * sizeof(size_t)))) {
+		for (i = 0; i < cnt; i++) found += (result[i] = hash_bucket_mgr_member_find(hm, ptr[i])) ? 1 : 0;
+		return found;
+	}
+	order = hash + cnt;
+	for (i = 0; i < cnt; i++) hash[i] = ptr[i] ? hm->m_hash_func(ptr[i]) : 0;
+
+	if (hm->m_is_rcu) {
+		count = _hash_bucket_mgr_read_lock(hm);
+		_hash_bucket_mgr_table_get(hm, &member, &capacity, &old, &old_capacity);
+		for (i = 0; i < cnt; i++) {
+			if (i + 8 < cnt) __builtin_prefetch(&member[hash[i + 8] % capacity]);
+			if (i + 4 < cnt && (hmm = __atomic_load_n(&member[hash[i + 4] % capacity], __ATOMIC_RELAXED))) __builtin_prefetch(hmm);
+			result[i] = ptr[i] ? _hash_bucket_mgr_rcu_find(hm, member, capacity, old, old_capacity, ptr[i], hash[i]) : NULL;
+			if (result[i]) found++;
+		}
+		_hash_bucket_mgr_read_unlock(count);
+		g_hm_free(hash);
+		return found;
+	}
+
+	_hash_bucket_mgr_group(hash, cnt, order, start);
+	for (i = 0; i < HASH_BUCKET_MGR_STRIPE; i++) {
+		if (start[i] == start[i + 1]) continue;
+		stripe = &hm->m_stripe[i];
+		pthread_mutex_lock(&stripe->m_lock);
+		for (j = start[i]; j < start[i + 1]; j++) {
+			if (j + 8 < start[i + 1]) __builtin_prefetch(&hm->m_member[hash[order[j + 8]] % hm->m_capacity]);
+			if (j + 4 < start[i + 1] && (hmm = hm->m_member[hash[order[j + 4]] % hm->m_capacity])) __builtin_prefetch(hmm);
+			k = order[j];
+			hmm = ptr[k] ? _hash_bucket_mgr_member_find(hm, ptr[k], hash[k], NULL) : NULL;
+			if ((result[k] = hmm ? hmm->m_ptr : NULL)) found++;
+		}
+		pthread_mutex_unlock(&stripe->m_lock);
+	}
+	g_hm_free(hash);
+
+	_hash_bucket_mgr_rehash_step(hm);
+	return found;
+}
+
+/* @func:
+ *	遍历所有节点，visit返回false时停止；一次锁一把锁，期间不会迁移
+ *	visit中不能再调用这个管理器的函数
+ */
+void hash_bucket_mgr_member_foreach(hash_bucket_mgr_t *hm, hash_bucket_mgr_visit_t visit, void *arg)
+{
+	if (!hm || !visit) return ;
+	hash_bucket_mgr_member_t *hmm = NULL;
+	size_t i = 0, j = 0;
+	bool is_stop = false;
+
+	pthread_mutex_lock(&hm->m_rehash_mutex);
+	for (i = 0; i < HASH_BUCKET_MGR_STRIPE && !is_stop; i++) {
+		pthread_mutex_lock(&hm->m_stripe[i].m_lock);
+		/* 读多写少模式下已经复制过的旧桶不再访问 */
+		j = hm->m_is_rcu ? hm->m_rehash_index : 0;
+		for (j += (i - j) & (HASH_BUCKET_MGR_STRIPE - 1); hm->m_old && j < hm->m_old_capacity && !is_stop; j += HASH_BUCKET_MGR_STRIPE) {
+			for (hmm = hm->m_old[j]; hmm && !is_stop; hmm = hmm->m_next) is_stop = !visit(hmm->m_ptr, arg);
+		}
+		for (j = i; j < hm->m_capacity && !is_stop; j += HASH_BUCKET_MGR_STRIPE) {
+			for (hmm = hm->m_member[j]; hmm && !is_stop; hmm = hmm->m_next) is_stop = !visit(hmm->m_ptr, arg);
+		}
+		pthread_mutex_unlock(&hm->m_stripe[i].m_lock);
+	}
+	pthread_mutex_unlock(&hm->m_rehash_mutex);
+}
+
 #include <assert.h>
+#include <time.h>
+#include <unistd.h>
+
+/* 每个节点约48字节，测1亿个节点需要五六G内存，编译时用-D指定 */
+#ifndef HASH_BUCKET_MGR_BENCH_MAX
+#define HASH_BUCKET_MGR_BENCH_MAX 10000000
+#endif
 static size_t _hash_func(void *ptr)
 {
 	if (!ptr) return 0;
@@ -219,6 +898,272 @@ static bool _compare_func(void *src, void *dst)
 	return (*(size_t*)src == *(size_t*)dst);
 }
 
+/* @func:
+ *	扩容后所有节点都能找到，删除后逐步缩容
+ */
+static void _hash_bucket_mgr_resize_test(void)
+{
+	const size_t count = 100000;
+	hash_bucket_mgr_t *hm = NULL;
+	size_t *keys = NULL, i = 0, capacity = 0;
+
+	assert((keys = malloc(count * sizeof(size_t))));
+	assert((hm = hash_bucket_mgr_new(0, _hash_func, _compare_func)));
+	for (i = 0; i < count; i++) {
+		keys[i] = i * 7;
+		assert(hash_bucket_mgr_member_add(hm, &keys[i]));
+		assert(hash_bucket_mgr_member_is_exist(hm, &keys[i]));
+	}
+	for (i = 0; i < count; i++) assert(hash_bucket_mgr_member_is_exist(hm, &keys[i]));
+	assert(!hm->m_old && hm->m_capacity >= count / HASH_BUCKET_MGR_LOAD_MAX / 2);
+	capacity = hm->m_capacity;
+
+	for (i = 0; i < count; i++) assert(hash_bucket_mgr_member_del(hm, &keys[i]) == &keys[i]);
+	for (i = 0; i < count; i++) assert(!hash_bucket_mgr_member_is_exist(hm, &keys[i]));
+	assert(hm->m_capacity < capacity);
+	MY_PRINTF("resize ok, capacity %lu -> %lu", capacity, hm->m_capacity);
+	hash_bucket_mgr_free(hm);
+	free(keys);
+}
+
+/* @func:
+ *	每个线程操作自己的key，9次查找1次增删，看吞吐随线程数的变化
+ */
+static void _hash_bucket_mgr_bench(void)
+{
+	const size_t count = 1000000, range = 10000;
+	hash_bucket_mgr_t *hm = NULL;
+	size_t thread_cnt = 0, i = 0;
+	struct timespec start, end;
+	pthread_t pt[8];
+
+	for (thread_cnt = 1; thread_cnt <= sizeof(pt) / sizeof(pt[0]); thread_cnt *= 2) {
+		assert((hm = hash_bucket_mgr_new(0, _hash_func, _compare_func)));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < thread_cnt; i++) {
+			pthread_create(&pt[i], NULL, ({
+			void* _(void *arg) {
+				size_t base = (size_t)arg * range, k = 0, key = 0, *keys = NULL;
+				assert((keys = malloc(range * sizeof(size_t))));
+				for (k = 0; k < range; k++) keys[k] = base + k, hash_bucket_mgr_member_add(hm, &keys[k]);
+				for (k = 0; k < count; k++) {
+					key = base + k * 7919 % range;
+					if (k % 10) hash_bucket_mgr_member_is_exist(hm, &key);
+					else if (hash_bucket_mgr_member_del(hm, &key)) hash_bucket_mgr_member_add(hm, &keys[key - base]);
+				}
+				for (k = 0; k < range; k++) hash_bucket_mgr_member_del(hm, &keys[k]);
+				free(keys);
+				return arg;
+			}; _;}), (void*)i);
+		}
+		for (i = 0; i < thread_cnt; i++) pthread_join(pt[i], NULL);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		MY_PRINTF("%lu threads: %.1f Mops/s", thread_cnt,
+			thread_cnt * (count + range * 2) / ((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3));
+		hash_bucket_mgr_free(hm);
+	}
+}
+
+static double _ns_since(const struct timespec *start, size_t count)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec)) / count;
+}
+
+/* @func:
+ *	一个线程反复增删奇数key触发扩缩容，其他线程查找，偶数key一直存在，必须都能找到
+ *	分别用加锁和不加锁的查找跑相同的时间，对比查找的吞吐
+ */
+static void _hash_bucket_mgr_rcu_test(void)
+{
+	const size_t range = 20000;
+	size_t *keys = NULL, i = 0, thread_cnt = 0, reads = 0;
+	hash_bucket_mgr_t *hm = NULL;
+	struct timespec start;
+	bool is_running = false;
+	int mode = 0;
+	pthread_t pt[9];
+
+	assert((keys = malloc(range * sizeof(size_t))));
+	for (i = 0; i < range; i++) keys[i] = i;
+	for (mode = 0; mode < 2; mode++) {
+		for (thread_cnt = 1; thread_cnt < sizeof(pt) / sizeof(pt[0]); thread_cnt *= 2) {
+			assert((hm = mode ? hash_bucket_mgr_rcu_new(0, _hash_func, _compare_func) : hash_bucket_mgr_new(0, _hash_func, _compare_func)));
+			for (i = 0; i < range; i += 2) assert(hash_bucket_mgr_member_add(hm, &keys[i]));
+			__atomic_store_n(&is_running, true, __ATOMIC_RELAXED);
+			reads = 0;
+
+			pthread_create(&pt[0], NULL, ({
+			void* _(void *arg) {
+				size_t k = 0;
+				while (__atomic_load_n(&is_running, __ATOMIC_RELAXED)) {
+					for (k = 1; k < range; k += 2) assert(hash_bucket_mgr_member_add(hm, &keys[k]));
+					for (k = 1; k < range; k += 2) assert(hash_bucket_mgr_member_del(hm, &keys[k]) == &keys[k]);
+				}
+				return arg;
+			}; _;}), NULL);
+			for (i = 1; i <= thread_cnt; i++) {
+				pthread_create(&pt[i], NULL, ({
+				void* _(void *arg) {
+					size_t k = (size_t)arg, key = 0, cnt = 0;
+					while (__atomic_load_n(&is_running, __ATOMIC_RELAXED)) {
+						k = k * 6364136223846793005ULL + 1442695040888963407ULL;
+						key = (k >> 33) % range;
+						if (key % 2 == 0) assert(hash_bucket_mgr_member_is_exist(hm, &key));
+						else hash_bucket_mgr_member_is_exist(hm, &key);
+						cnt++;
+					}
+					__atomic_add_fetch(&reads, cnt, __ATOMIC_RELAXED);
+					return arg;
+				}; _;}), (void*)i);
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			usleep(300 * 1000);
+			__atomic_store_n(&is_running, false, __ATOMIC_RELAXED);
+			for (i = 0; i <= thread_cnt; i++) pthread_join(pt[i], NULL);
+			MY_PRINTF("%s %lu readers: %.1f Mreads/s", mode ? "rcu" : "striped", thread_cnt, 1e3 / _ns_since(&start, reads));
+
+			for (i = 0; i < range; i++) assert(hash_bucket_mgr_member_is_exist(hm, &keys[i]) == (i % 2 == 0));
+			hash_bucket_mgr_synchronize(hm);
+			hash_bucket_mgr_free(hm);
+		}
+	}
+	free(keys);
+	MY_PRINTF("rcu ok");
+}
+
+/* @func:
+ *	批量增查、查找或添加、替换和遍历，两种模式都测，替换和删除时旧数组通常还在迁移
+ */
+static void _hash_bucket_mgr_api_test(void)
+{
+	const size_t count = 10000;
+	size_t *keys = NULL, *keys_2 = NULL, i = 0, visit_cnt = 0, visit_sum = 0, extra = count * 2;
+	void **ptr = NULL, **result = NULL, *old = NULL;
+	hash_bucket_mgr_t *hm = NULL;
+	int mode = 0;
+
+	assert((keys = malloc(count * sizeof(size_t))) && (keys_2 = malloc(count * sizeof(size_t))));
+	assert((ptr = malloc(count * 2 * sizeof(void*))) && (result = malloc(count * 2 * sizeof(void*))));
+	for (i = 0; i < count; i++) keys[i] = keys_2[i] = i;
+
+	for (mode = 0; mode < 2; mode++) {
+		assert((hm = mode ? hash_bucket_mgr_rcu_new(0, _hash_func, _compare_func) : hash_bucket_mgr_new(0, _hash_func, _compare_func)));
+		/* 偶数位置是NULL */
+		for (i = 0; i < count; i++) ptr[i * 2] = NULL, ptr[i * 2 + 1] = &keys[i];
+		assert(hash_bucket_mgr_member_add_batch(hm, ptr, count * 2) == count);
+		for (i = 0; i < count; i++) assert(hash_bucket_mgr_member_find(hm, &keys_2[i]) == &keys[i]);
+
+		/* 一半存在，一半不存在 */
+		for (i = 0; i < count * 2; i++) keys_2[i / 2] = i / 2, ptr[i] = i % 2 ? (void*)&keys_2[i / 2] : (void*)&extra;
+		assert(hash_bucket_mgr_member_find_batch(hm, ptr, result, count * 2) == count);
+		for (i = 0; i < count * 2; i++) assert(result[i] == (i % 2 ? (void*)&keys[i / 2] : NULL));
+
+		/* 已经存在时返回原来的ptr，不存在时添加 */
+		assert(hash_bucket_mgr_member_find_or_add(hm, &keys_2[0]) == &keys[0]);
+		assert(hash_bucket_mgr_member_find_or_add(hm, &extra) == &extra);
+		assert(hash_bucket_mgr_member_del(hm, &extra) == &extra);
+
+		for (i = 0; i < count; i++) {
+			assert(hash_bucket_mgr_member_upsert(hm, &keys_2[i], &old) && old == &keys[i]);
+			assert(hash_bucket_mgr_member_find(hm, &keys[i]) == &keys_2[i]);
+		}
+		assert(hash_bucket_mgr_member_upsert(hm, &extra, &old) && !old);
+
+		visit_cnt = visit_sum = 0;
+		hash_bucket_mgr_member_foreach(hm, ({
+		bool _(void *ptr, void *arg) {
+			visit_cnt++, visit_sum += *(size_t*)ptr;
+			return arg == NULL;
+		}; _;}), NULL);
+		assert(visit_cnt == count + 1 && visit_sum == count * (count - 1) / 2 + count * 2);
+		visit_cnt = 0;
+		hash_bucket_mgr_member_foreach(hm, ({
+		bool _(void *ptr, void *arg) {
+			return ++visit_cnt < *(size_t*)arg || !ptr;
+		}; _;}), (size_t[]){10});
+		assert(visit_cnt == 10);
+
+		assert(hash_bucket_mgr_member_del(hm, &extra) == &extra);
+		for (i = 0; i < count; i++) assert(hash_bucket_mgr_member_del(hm, &keys[i]) == &keys_2[i]);
+		for (i = 0; i < count; i++) assert(!hash_bucket_mgr_member_find(hm, &keys[i]));
+		hash_bucket_mgr_free(hm);
+	}
+	free(keys), free(keys_2), free(ptr), free(result);
+	MY_PRINTF("api ok");
+}
+
+/* @func:
+ *	批量和逐个添加、查找的耗时
+ */
+static void _hash_bucket_mgr_batch_bench(void)
+{
+	const size_t count = 1000000;
+	size_t *keys = NULL, i = 0;
+	void **ptr = NULL, **result = NULL;
+	hash_bucket_mgr_t *hm = NULL;
+	struct timespec start;
+
+	assert((keys = malloc(count * sizeof(size_t))) && (ptr = malloc(count * sizeof(void*))) && (result = malloc(count * sizeof(void*))));
+	for (i = 0; i < count; i++) keys[i] = i * 0x9e3779b97f4a7c15ULL, ptr[i] = &keys[i * 7919 % count];
+
+	assert((hm = hash_bucket_mgr_new(count, _hash_func, _compare_func)));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) hash_bucket_mgr_member_add(hm, ptr[i]);
+	MY_PRINTF("add: %.1f ns/op", _ns_since(&start, count));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) result[i] = hash_bucket_mgr_member_find(hm, ptr[i]);
+	MY_PRINTF("find: %.1f ns/op", _ns_since(&start, count));
+	hash_bucket_mgr_free(hm);
+
+	assert((hm = hash_bucket_mgr_new(count, _hash_func, _compare_func)));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i += 1000) assert(hash_bucket_mgr_member_add_batch(hm, ptr + i, 1000) == 1000);
+	MY_PRINTF("add_batch: %.1f ns/op", _ns_since(&start, count));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i += 1000) assert(hash_bucket_mgr_member_find_batch(hm, ptr + i, result + i, 1000) == 1000);
+	MY_PRINTF("find_batch: %.1f ns/op", _ns_since(&start, count));
+	hash_bucket_mgr_free(hm);
+
+	free(keys), free(ptr), free(result);
+}
+
+/* @func:
+ *	单线程的插入、命中、未命中和删除，输出格式和hash_table_mgr的自测相同，可以直接对比
+ *	查找和删除跳着访问，避免按分配顺序读节点时被预取掩盖指针跳转的开销
+ */
+static void _hash_bucket_mgr_single_bench(void)
+{
+	hash_bucket_mgr_t *hm = NULL;
+	size_t *keys = NULL, count = 0, i = 0, miss = 0;
+	struct timespec start;
+
+	for (count = 1000000; count <= HASH_BUCKET_MGR_BENCH_MAX; count *= 10) {
+		assert((keys = malloc(count * sizeof(size_t))));
+		for (i = 0; i < count; i++) keys[i] = i * 0x9e3779b97f4a7c15ULL;
+
+		assert((hm = hash_bucket_mgr_new(0, _hash_func, _compare_func)));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < count; i++) hash_bucket_mgr_member_add(hm, &keys[i]);
+		MY_PRINTF("%lu hash_bucket_mgr add: %.1f ns/op", count, _ns_since(&start, count));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < count; i++) assert(hash_bucket_mgr_member_is_exist(hm, &keys[i * 7919 % count]));
+		MY_PRINTF("%lu hash_bucket_mgr hit: %.1f ns/op", count, _ns_since(&start, count));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < count; i++) miss = keys[i * 7919 % count] + 1, assert(!hash_bucket_mgr_member_is_exist(hm, &miss));
+		MY_PRINTF("%lu hash_bucket_mgr miss: %.1f ns/op", count, _ns_since(&start, count));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < count; i++) hash_bucket_mgr_member_del(hm, &keys[i * 7919 % count]);
+		MY_PRINTF("%lu hash_bucket_mgr del: %.1f ns/op", count, _ns_since(&start, count));
+		hash_bucket_mgr_free(hm);
+
+		free(keys);
+	}
+}
+
 int main()
 {
 	size_t i = 0, j = 0, count = 1024, capacity = 50;
@@ -232,7 +1177,7 @@ int main()
 	
 	/* 单线程测试 */
 	for (i = 0; i < count; i++) {
-		if (!(num = malloc(sizeof(int)))) continue;
+		if (!(num = malloc(sizeof(size_t)))) continue;
 		num_2 = *num = i % 3;
 		assert(hash_bucket_mgr_member_add(hm, num));
 		assert(hash_bucket_mgr_member_is_exist(hm, &num_2));
@@ -257,7 +1202,7 @@ int main()
 			size_t k = 0;
 			size_t *num = NULL, num_2 = 0;
 			for (k = 0; k < count; k++) {
-				if (!(num = malloc(sizeof(int)))) continue;
+				if (!(num = malloc(sizeof(size_t)))) continue;
 				num_2 = *num = k;
 				assert(hash_bucket_mgr_member_add(hm, num));
 				assert(hash_bucket_mgr_member_is_exist(hm, &num_2));
@@ -265,6 +1210,7 @@ int main()
 				if (k % 5 == 0) {
 					assert((num = hash_bucket_mgr_member_del(hm, &num_2)));
 					assert(*(size_t*)num == num_2);
+					free(num);
 				}
 			}
 			return arg;
@@ -289,5 +1235,12 @@ int main()
 	hm = NULL;
 	
 	MY_PRINTF("mutiple thread OK");
+
+	_hash_bucket_mgr_resize_test();
+	_hash_bucket_mgr_bench();
+	_hash_bucket_mgr_rcu_test();
+	_hash_bucket_mgr_api_test();
+	_hash_bucket_mgr_batch_bench();
+	_hash_bucket_mgr_single_bench();
 	return 0;
 }
\ No newline at end of file
@@ -1,26 +1,63 @@
 #ifndef _HASH_BUCKET_MGR_H_
 #define _HASH_BUCKET_MGR_H_
 
+#include <stddef.h>
 #include <stdbool.h>
+#include <pthread.h>
+
+#define HASH_BUCKET_MGR_CACHE_LINE 64
+#define HASH_BUCKET_MGR_STRIPE 64 /* 锁的个数，必须是2的幂 */
+#define HASH_BUCKET_MGR_READER 64 /* 读多写少模式下读线程计数的槽位个数，线程多于槽位时共用 */
 
 typedef void* (*hash_bucket_mgr_alloc_t) (size_t size);
 typedef void (*hash_bucket_mgr_free_t) (void *ptr);
 typedef size_t (*hash_bucket_hash_func_t) (void *ptr);
 typedef bool (*hash_bucket_compare_func_t) (void *src, void *dst);
+typedef bool (*hash_bucket_mgr_visit_t) (void *ptr, void *arg); /* 返回false时停止遍历 */
 
 typedef struct _hash_bucket_mgr_member {
 	void *m_ptr;
-	struct _hash_bucket_mgr_member *m_prev;
+	size_t m_hash; /* 缓存的hash值，迁移时不用重新计算 */
+	struct _hash_bucket_mgr_member *m_prev; /* 读线程不访问，删除后用来串起待释放的节点 */
 	struct _hash_bucket_mgr_member *m_next;
 } hash_bucket_mgr_member_t;
 
-/* 全局节点管理器，一般用于套接字资源管理 */
+/* 按纪元奇偶分别计数的读线程，独占一个缓存行 */
+typedef struct _hash_bucket_mgr_reader {
+	size_t m_count[2];
+	char m_pad[HASH_BUCKET_MGR_CACHE_LINE - 2 * sizeof(size_t)];
+} hash_bucket_mgr_reader_t;
+
+/* 一把锁及其保护的节点个数，独占一个缓存行 */
+typedef struct _hash_bucket_mgr_stripe {
+	pthread_mutex_t m_lock;
+	size_t m_count;
+	char m_pad[HASH_BUCKET_MGR_CACHE_LINE - sizeof(pthread_mutex_t) - sizeof(size_t)];
+} hash_bucket_mgr_stripe_t;
+
+/* 全局节点管理器，一般用于套接字资源管理
+ * 容量是锁个数的整数倍，第i个桶由第i % HASH_BUCKET_MGR_STRIPE把锁保护，扩缩容前后同一个节点由同一把锁保护；
+ * 负载过高或过低时换成新数组，之后每次操作顺带迁移几个旧桶，不会一次性rehash整个表；
+ * 读多写少模式下查找不加锁，删除的节点等所有进行中的查找结束后再释放，迁移时复制节点而不是移动，旧链表一直完整 */
 typedef struct _hash_bucket_mgr {
 	size_t m_capacity; /* hash管理器的大小 */
-	pthread_mutex_t m_mutex;
+	size_t m_min_capacity; /* 缩容的下限 */
 	hash_bucket_mgr_member_t **m_member; /* hash节点数组 */
+	hash_bucket_mgr_member_t **m_old; /* 迁移中的旧数组，NULL表示没有在迁移 */
+	size_t m_old_capacity;
+	size_t m_rehash_index; /* 旧数组中下一个要迁移的桶 */
+	pthread_mutex_t m_rehash_mutex; /* 保证同时只有一个线程扩缩容和迁移，先于m_stripe加锁 */
 	hash_bucket_hash_func_t m_hash_func;
 	hash_bucket_compare_func_t m_compare_func;
+	bool m_is_rcu; /* 读多写少模式 */
+	size_t m_table_seq; /* 换数组时加1，奇数表示正在换，不加锁的查找据此读到一致的数组和容量 */
+	size_t m_epoch; /* 纪元，每次等待读线程时加1 */
+	hash_bucket_mgr_reader_t *m_reader; /* HASH_BUCKET_MGR_READER个读线程计数 */
+	pthread_mutex_t m_retire_mutex;
+	hash_bucket_mgr_member_t *m_retire; /* 已删除等待释放的节点，用m_prev串起来 */
+	size_t m_retire_cnt;
+	pthread_mutex_t m_sync_mutex; /* 同时只有一个线程等待读线程，后于m_rehash_mutex加锁 */
+	hash_bucket_mgr_stripe_t m_stripe[HASH_BUCKET_MGR_STRIPE];
 } hash_bucket_mgr_t;
 
 /* @func:
@@ -34,11 +71,23 @@ void hash_bucket_mgr_dump(hash_bucket_mgr_t *hm, bool is_dump_member);
 void hash_bucket_mgr_init(hash_bucket_mgr_alloc_t hash_bucket_alloc, hash_bucket_mgr_free_t hash_bucket_free);
 
 /* @func:
- *	创建一个hash管理节点
+ *	创建一个hash管理节点，capacity向上取整到锁个数的整数倍
  */
 hash_bucket_mgr_t* hash_bucket_mgr_new(size_t capacity, hash_bucket_hash_func_t hash_func, 
 								hash_bucket_compare_func_t compare_func);
 								
+/* @func:
+ *	创建一个读多写少的hash管理节点，hash_bucket_mgr_member_is_exist不加锁
+ *	删除的ptr可能还在被查找线程比较，调用hash_bucket_mgr_synchronize之后才能释放
+ */
+hash_bucket_mgr_t* hash_bucket_mgr_rcu_new(size_t capacity, hash_bucket_hash_func_t hash_func, 
+								hash_bucket_compare_func_t compare_func);
+
+/* @func:
+ *	等待进行中的不加锁查找都结束，释放已删除的节点
+ */
+void hash_bucket_mgr_synchronize(hash_bucket_mgr_t *hm);
+
 /* @func:
  *	销毁一个管理节点，但不销毁真正ptr节点的内存
  */
@@ -59,4 +108,36 @@ void* hash_bucket_mgr_member_del(hash_bucket_mgr_t *hm, void *ptr);
  */
 bool hash_bucket_mgr_member_is_exist(hash_bucket_mgr_t *hm, void *ptr);
 
+/* @func:
+ *	查找节点，返回添加时的ptr，不存在时返回NULL
+ */
+void* hash_bucket_mgr_member_find(hash_bucket_mgr_t *hm, void *ptr);
+
+/* @func:
+ *	查找节点，不存在时添加，只计算一次hash、加一次锁
+ *	返回已经存在的ptr，添加时返回ptr本身，失败返回NULL
+ */
+void* hash_bucket_mgr_member_find_or_add(hash_bucket_mgr_t *hm, void *ptr);
+
+/* @func:
+ *	添加节点，key相同的节点已经存在时替换成ptr，old_ptr返回被替换的ptr，没有时为NULL
+ *	读多写少模式下被替换的ptr要在hash_bucket_mgr_synchronize之后才能释放
+ */
+bool hash_bucket_mgr_member_upsert(hash_bucket_mgr_t *hm, void *ptr, void **old_ptr);
+
+/* @func:
+ *	批量添加，按锁分组后每把锁只加一次；遇到NULL跳过，返回添加的个数
+ */
+size_t hash_bucket_mgr_member_add_batch(hash_bucket_mgr_t *hm, void **ptr, size_t cnt);
+
+/* @func:
+ *	批量查找，result[i]是ptr[i]对应的节点，不存在时为NULL，返回找到的个数
+ */
+size_t hash_bucket_mgr_member_find_batch(hash_bucket_mgr_t *hm, void **ptr, void **result, size_t cnt);
+
+/* @func:
+ *	遍历所有节点，visit返回false时停止；visit中不能再调用这个管理器的函数
+ */
+void hash_bucket_mgr_member_foreach(hash_bucket_mgr_t *hm, hash_bucket_mgr_visit_t visit, void *arg);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,479 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "hash_table_mgr.h"
+
+#define MY_PRINTF(format, ...) printf(format"\n", ##__VA_ARGS__)
+#define HASH_TABLE_MGR_TRACE_LOG MY_PRINTF
+#define HASH_TABLE_MGR_ERROR_LOG MY_PRINTF
+
+#define HASH_TABLE_MGR_EMPTY ((signed char)-128)
+#define HASH_TABLE_MGR_DELETED ((signed char)-2)
+/* 满的控制字节是hash的低7位，最高位为0 */
+#define HASH_TABLE_MGR_IS_FULL(ctrl) ((ctrl) >= 0)
+#define HASH_TABLE_MGR_NOT_FOUND ((size_t)-1)
+
+static void* _malloc2calloc(size_t size);
+/* 内存管理函数 */
+static hash_table_mgr_alloc_t g_ht_alloc = _malloc2calloc;
+static hash_table_mgr_free_t g_ht_free = free;
+
+static void* _malloc2calloc(size_t size)
+{
+	return calloc(1, size);
+}
+
+typedef struct _hash_table_mgr_slot {
+	size_t m_hash;
+	void *m_ptr;
+	unsigned char m_key[];
+} hash_table_mgr_slot_t;
+
+/* @func:
+ *	一组控制字节中等于value的位置，第i位对应第i个字节
+ */
+static uint32_t _hash_table_mgr_group_match(const signed char *ctrl, signed char value)
+{
+#if defined(__AVX2__)
+	return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(value), _mm256_loadu_si256((const __m256i*)ctrl)));
+#elif defined(__SSE2__)
+	return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(value), _mm_loadu_si128((const __m128i*)ctrl)));
+#else
+	uint32_t mask = 0;
+	int i = 0;
+
+	for (i = 0; i < HASH_TABLE_MGR_GROUP; i++)
+		if (ctrl[i] == value) mask |= 1U << i;
+	return mask;
+#endif
+}
+
+/* @func:
+ *	一组控制字节中空或者已删除的位置，这两种控制字节的最高位为1
+ */
+static uint32_t _hash_table_mgr_group_match_free(const signed char *ctrl)
+{
+#if defined(__AVX2__)
+	return (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)ctrl));
+#elif defined(__SSE2__)
+	return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+	uint32_t mask = 0;
+	int i = 0;
+
+	for (i = 0; i < HASH_TABLE_MGR_GROUP; i++)
+		if (!HASH_TABLE_MGR_IS_FULL(ctrl[i])) mask |= 1U << i;
+	return mask;
+#endif
+}
+
+static uint64_t _hash_table_mgr_mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/* @func:
+ *	内置的hash函数，每次处理8个字节
+ */
+static uint64_t _hash_table_mgr_hash_bytes(const unsigned char *key, size_t len)
+{
+	uint64_t h = len * 0x9e3779b97f4a7c15ULL, word = 0;
+
+	for (; len >= sizeof(word); key += sizeof(word), len -= sizeof(word)) {
+		memcpy(&word, key, sizeof(word));
+		h = (h ^ _hash_table_mgr_mix(word)) * 0x9e3779b97f4a7c15ULL;
+	}
+	if (len) {
+		word = 0;
+		memcpy(&word, key, len);
+		h = (h ^ _hash_table_mgr_mix(word)) * 0x9e3779b97f4a7c15ULL;
+	}
+	return _hash_table_mgr_mix(h);
+}
+
+/* @func:
+ *	低7位放在控制字节里，其余的位决定探测的起点；用户的hash函数可能很差，再混合一次
+ */
+static size_t _hash_table_mgr_hash(hash_table_mgr_t *ht, const void *key)
+{
+	if (ht->m_hash_func) return _hash_table_mgr_mix(ht->m_hash_func(key));
+	return _hash_table_mgr_hash_bytes((const unsigned char*)key, ht->m_key_size);
+}
+
+static hash_table_mgr_slot_t* _hash_table_mgr_slot_get(hash_table_mgr_t *ht, unsigned char *slot, size_t index)
+{
+	return (hash_table_mgr_slot_t*)(slot + index * ht->m_slot_size);
+}
+
+/* @func:
+ *	设置控制字节，开头的一组同时写到末尾的副本，从任何位置都能读出完整的一组
+ */
+static void _hash_table_mgr_ctrl_set(signed char *ctrl, size_t capacity, size_t index, signed char value)
+{
+	ctrl[index] = value;
+	if (index < HASH_TABLE_MGR_GROUP) ctrl[capacity + index] = value;
+}
+
+/* @func:
+ *	最多能写入的槽位数，负载因子7/8
+ */
+static size_t _hash_table_mgr_growth(size_t capacity)
+{
+	return capacity - capacity / 8;
+}
+
+/* @func:
+ *	查找key所在的槽位，按组做三角探测，遇到有空槽位的组就停止
+ */
+static size_t _hash_table_mgr_find(hash_table_mgr_t *ht, const void *key, size_t hash)
+{
+	size_t mask = ht->m_capacity - 1, pos = (hash >> 7) & mask, step = 0, index = 0;
+	signed char h2 = hash & 0x7F;
+	hash_table_mgr_slot_t *slot = NULL;
+	uint32_t match = 0;
+
+	for (;;) {
+		for (match = _hash_table_mgr_group_match(ht->m_ctrl + pos, h2); match; match &= match - 1) {
+			index = (pos + __builtin_ctz(match)) & mask;
+			slot = _hash_table_mgr_slot_get(ht, ht->m_slot, index);
+			if (slot->m_hash == hash && !memcmp(slot->m_key, key, ht->m_key_size)) return index;
+		}
+		if (_hash_table_mgr_group_match(ht->m_ctrl + pos, HASH_TABLE_MGR_EMPTY)) return HASH_TABLE_MGR_NOT_FOUND;
+		step += HASH_TABLE_MGR_GROUP;
+		pos = (pos + step) & mask;
+	}
+}
+
+/* @func:
+ *	探测序列上第一个空或者已删除的槽位
+ */
+static size_t _hash_table_mgr_find_free(signed char *ctrl, size_t capacity, size_t hash)
+{
+	size_t mask = capacity - 1, pos = (hash >> 7) & mask, step = 0;
+	uint32_t match = 0;
+
+	while (!(match = _hash_table_mgr_group_match_free(ctrl + pos))) {
+		step += HASH_TABLE_MGR_GROUP;
+		pos = (pos + step) & mask;
+	}
+	return (pos + __builtin_ctz(match)) & mask;
+}
+
+/* @func:
+ *	已删除的槽位占了一半以上时原容量重建，否则容量翻倍；用缓存的hash值，不调用hash函数
+ */
+static bool _hash_table_mgr_resize(hash_table_mgr_t *ht)
+{
+	size_t capacity = ht->m_capacity, i = 0, index = 0;
+	signed char *ctrl = NULL;
+	unsigned char *slot = NULL;
+	hash_table_mgr_slot_t *src = NULL;
+
+	if (ht->m_size > _hash_table_mgr_growth(capacity) / 2) capacity *= 2;
+	if (!(ctrl = (signed char*)g_ht_alloc(capacity + HASH_TABLE_MGR_GROUP)) || !(slot = (unsigned char*)g_ht_alloc(capacity * ht->m_slot_size))) {
+		HASH_TABLE_MGR_ERROR_LOG("g_ht_alloc error, errno: %d - %s", errno, strerror(errno));
+		if (ctrl) g_ht_free(ctrl);
+		return false;
+	}
+	memset(ctrl, HASH_TABLE_MGR_EMPTY, capacity + HASH_TABLE_MGR_GROUP);
+
+	for (i = 0; i < ht->m_capacity; i++) {
+		if (!HASH_TABLE_MGR_IS_FULL(ht->m_ctrl[i])) continue;
+		src = _hash_table_mgr_slot_get(ht, ht->m_slot, i);
+		index = _hash_table_mgr_find_free(ctrl, capacity, src->m_hash);
+		_hash_table_mgr_ctrl_set(ctrl, capacity, index, ht->m_ctrl[i]);
+		memcpy(_hash_table_mgr_slot_get(ht, slot, index), src, ht->m_slot_size);
+	}
+
+	g_ht_free(ht->m_ctrl);
+	g_ht_free(ht->m_slot);
+	ht->m_ctrl = ctrl;
+	ht->m_slot = slot;
+	ht->m_capacity = capacity;
+	ht->m_growth_left = _hash_table_mgr_growth(capacity) - ht->m_size;
+	return true;
+}
+
+/* @func:
+ *	打印管理器
+ */
+void hash_table_mgr_dump(hash_table_mgr_t *ht)
+{
+	if (!ht) return ;
+	size_t i = 0, deleted = 0;
+
+	for (i = 0; i < ht->m_capacity; i++)
+		if (ht->m_ctrl[i] == HASH_TABLE_MGR_DELETED) deleted++;
+	HASH_TABLE_MGR_TRACE_LOG("==============");
+	HASH_TABLE_MGR_TRACE_LOG("group: %d", HASH_TABLE_MGR_GROUP);
+	HASH_TABLE_MGR_TRACE_LOG("capacity: %lu", ht->m_capacity);
+	HASH_TABLE_MGR_TRACE_LOG("size: %lu", ht->m_size);
+	HASH_TABLE_MGR_TRACE_LOG("deleted: %lu", deleted);
+	HASH_TABLE_MGR_TRACE_LOG("growth_left: %lu", ht->m_growth_left);
+	HASH_TABLE_MGR_TRACE_LOG("key_size: %lu", ht->m_key_size);
+	HASH_TABLE_MGR_TRACE_LOG("slot_size: %lu", ht->m_slot_size);
+	HASH_TABLE_MGR_TRACE_LOG("hash_func: %p", ht->m_hash_func);
+	HASH_TABLE_MGR_TRACE_LOG("==============");
+}
+
+/* @func:
+ *	初始化管理器
+ */
+void hash_table_mgr_init(hash_table_mgr_alloc_t hash_table_alloc, hash_table_mgr_free_t hash_table_free)
+{
+	if (!hash_table_alloc || !hash_table_free) g_ht_alloc = _malloc2calloc, g_ht_free = free;
+	else g_ht_alloc = hash_table_alloc, g_ht_free = hash_table_free;
+}
+
+/* @func:
+ *	创建一个hash表，hash_func为NULL时用内置的hash函数
+ */
+hash_table_mgr_t* hash_table_mgr_new(size_t capacity, size_t key_size, hash_table_mgr_hash_func_t hash_func)
+{
+	if (!key_size) return NULL;
+	hash_table_mgr_t *ht = NULL;
+	size_t size = HASH_TABLE_MGR_GROUP;
+
+	/* 按负载因子换算成槽位个数 */
+	while (_hash_table_mgr_growth(size) < capacity) size *= 2;
+
+	if (!(ht = (hash_table_mgr_t*)g_ht_alloc(sizeof(hash_table_mgr_t)))) {
+		HASH_TABLE_MGR_ERROR_LOG("g_ht_alloc error, errno: %d - %s", errno, strerror(errno));
+		return NULL;
+	}
+	memset(ht, 0, sizeof(hash_table_mgr_t));
+	ht->m_key_size = key_size;
+	ht->m_slot_size = (sizeof(hash_table_mgr_slot_t) + key_size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+	ht->m_hash_func = hash_func;
+	if (!(ht->m_ctrl = (signed char*)g_ht_alloc(size + HASH_TABLE_MGR_GROUP)) || !(ht->m_slot = (unsigned char*)g_ht_alloc(size * ht->m_slot_size))) {
+		HASH_TABLE_MGR_ERROR_LOG("g_ht_alloc error, errno: %d - %s", errno, strerror(errno));
+		goto free_exit;
+	}
+	memset(ht->m_ctrl, HASH_TABLE_MGR_EMPTY, size + HASH_TABLE_MGR_GROUP);
+	ht->m_capacity = size;
+	ht->m_growth_left = _hash_table_mgr_growth(size);
+	return ht;
+
+free_exit:
+	if (ht->m_ctrl) g_ht_free(ht->m_ctrl);
+	g_ht_free(ht);
+	return NULL;
+}
+
+/* @func:
+ *	销毁hash表，但不销毁ptr指向的内存
+ */
+void hash_table_mgr_free(hash_table_mgr_t *ht)
+{
+	if (!ht) return ;
+	g_ht_free(ht->m_ctrl);
+	g_ht_free(ht->m_slot);
+	g_ht_free(ht);
+}
+
+/* @func:
+ *	添加节点，key已经存在时返回false
+ */
+bool hash_table_mgr_member_add(hash_table_mgr_t *ht, const void *key, void *ptr)
+{
+	if (!ht || !key) return false;
+	size_t hash = _hash_table_mgr_hash(ht, key), index = 0;
+	hash_table_mgr_slot_t *slot = NULL;
+
+	if (_hash_table_mgr_find(ht, key, hash) != HASH_TABLE_MGR_NOT_FOUND) return false;
+
+	index = _hash_table_mgr_find_free(ht->m_ctrl, ht->m_capacity, hash);
+	/* 复用已删除的槽位不占用空槽位 */
+	if (!ht->m_growth_left && ht->m_ctrl[index] == HASH_TABLE_MGR_EMPTY) {
+		if (!_hash_table_mgr_resize(ht)) return false;
+		index = _hash_table_mgr_find_free(ht->m_ctrl, ht->m_capacity, hash);
+	}
+
+	if (ht->m_ctrl[index] == HASH_TABLE_MGR_EMPTY) ht->m_growth_left--;
+	_hash_table_mgr_ctrl_set(ht->m_ctrl, ht->m_capacity, index, hash & 0x7F);
+	slot = _hash_table_mgr_slot_get(ht, ht->m_slot, index);
+	slot->m_hash = hash;
+	slot->m_ptr = ptr;
+	memcpy(slot->m_key, key, ht->m_key_size);
+	ht->m_size++;
+	return true;
+}
+
+/* @func:
+ *	删除节点，返回添加时的ptr
+ *	槽位前后连续的满槽位不到一组时，没有探测会越过它，可以直接置空，否则标记为已删除
+ */
+void* hash_table_mgr_member_del(hash_table_mgr_t *ht, const void *key)
+{
+	if (!ht || !key) return NULL;
+	size_t hash = _hash_table_mgr_hash(ht, key), index = 0, mask = ht->m_capacity - 1;
+	uint32_t empty_before = 0, empty_after = 0;
+	bool is_never_full = true;
+	void *ptr = NULL;
+
+	if ((index = _hash_table_mgr_find(ht, key, hash)) == HASH_TABLE_MGR_NOT_FOUND) return NULL;
+	ptr = _hash_table_mgr_slot_get(ht, ht->m_slot, index)->m_ptr;
+
+	if (ht->m_capacity > HASH_TABLE_MGR_GROUP) {
+		empty_before = _hash_table_mgr_group_match(ht->m_ctrl + ((index - HASH_TABLE_MGR_GROUP) & mask), HASH_TABLE_MGR_EMPTY);
+		empty_after = _hash_table_mgr_group_match(ht->m_ctrl + index, HASH_TABLE_MGR_EMPTY);
+		is_never_full = empty_before && empty_after
+			&& (size_t)(__builtin_ctz(empty_after) + __builtin_clz(empty_before) - (32 - HASH_TABLE_MGR_GROUP)) < HASH_TABLE_MGR_GROUP;
+	}
+
+	if (is_never_full) {
+		_hash_table_mgr_ctrl_set(ht->m_ctrl, ht->m_capacity, index, HASH_TABLE_MGR_EMPTY);
+		ht->m_growth_left++;
+	} else _hash_table_mgr_ctrl_set(ht->m_ctrl, ht->m_capacity, index, HASH_TABLE_MGR_DELETED);
+	ht->m_size--;
+	return ptr;
+}
+
+/* @func:
+ *	判断一个节点是否存在
+ */
+bool hash_table_mgr_member_is_exist(hash_table_mgr_t *ht, const void *key)
+{
+	if (!ht || !key) return false;
+	return _hash_table_mgr_find(ht, key, _hash_table_mgr_hash(ht, key)) != HASH_TABLE_MGR_NOT_FOUND;
+}
+
+#if 1
+#include <assert.h>
+#include <time.h>
+
+/* 每个槽位24字节，测1亿个节点需要几G内存，编译时用-D指定 */
+#ifndef HASH_TABLE_MGR_BENCH_MAX
+#define HASH_TABLE_MGR_BENCH_MAX 10000000
+#endif
+
+static double _ns_since(const struct timespec *start, size_t count)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec)) / count;
+}
+
+/* @func:
+ *	随机增删查，和记录是否存在的数组对比，包括很差的hash函数和不是8字节整数倍的key
+ */
+static size_t _bad_hash_func(const void *key)
+{
+	return *(const unsigned char*)key;
+}
+
+static void _hash_table_mgr_test(void)
+{
+	const size_t range = 50000, count = 1000000;
+	hash_table_mgr_t *ht = NULL;
+	unsigned char key[12] = {0};
+	size_t i = 0, k = 0, size = 0, round = 0;
+	bool *is_exist = NULL;
+
+	assert((is_exist = calloc(range, sizeof(bool))));
+	for (round = 0; round < 2; round++) {
+		assert((ht = hash_table_mgr_new(0, sizeof(key), round ? _bad_hash_func : NULL)));
+		memset(is_exist, 0, range * sizeof(bool));
+		for (i = 0, size = 0, srand(round); i < count; i++) {
+			k = (size_t)rand() % (round ? range / 10 : range);
+			memcpy(key, &k, sizeof(k));
+			switch (rand() % 3) {
+			case 0:
+				assert(hash_table_mgr_member_add(ht, key, (void*)(k + 1)) == !is_exist[k]);
+				if (!is_exist[k]) is_exist[k] = true, size++;
+				break;
+			case 1:
+				assert(hash_table_mgr_member_del(ht, key) == (is_exist[k] ? (void*)(k + 1) : NULL));
+				if (is_exist[k]) is_exist[k] = false, size--;
+				break;
+			default:
+				assert(hash_table_mgr_member_is_exist(ht, key) == is_exist[k]);
+			}
+			assert(ht->m_size == size);
+		}
+		for (k = 0; k < range; k++) {
+			memcpy(key, &k, sizeof(k));
+			assert(hash_table_mgr_member_is_exist(ht, key) == is_exist[k]);
+		}
+		hash_table_mgr_dump(ht);
+		hash_table_mgr_free(ht);
+	}
+	free(is_exist);
+	MY_PRINTF("hash table ok");
+}
+
+/* @func:
+ *	单线程的插入、命中、未命中和删除，输出格式和hash_bucket_mgr的自测相同，可以直接对比
+ *	查找和删除跳着访问，和hash_bucket_mgr的测试一致
+ */
+static void _hash_table_mgr_bench(void)
+{
+	hash_table_mgr_t *ht = NULL;
+	size_t *keys = NULL, count = 0, i = 0, miss = 0;
+	struct timespec start;
+
+	for (count = 1000000; count <= HASH_TABLE_MGR_BENCH_MAX; count *= 10) {
+		assert((keys = malloc(count * sizeof(size_t))));
+		for (i = 0; i < count; i++) keys[i] = i * 0x9e3779b97f4a7c15ULL;
+
+		assert((ht = hash_table_mgr_new(0, sizeof(size_t), NULL)));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < count; i++) hash_table_mgr_member_add(ht, &keys[i], &keys[i]);
+		MY_PRINTF("%lu hash_table_mgr add: %.1f ns/op", count, _ns_since(&start, count));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < count; i++) assert(hash_table_mgr_member_is_exist(ht, &keys[i * 7919 % count]));
+		MY_PRINTF("%lu hash_table_mgr hit: %.1f ns/op", count, _ns_since(&start, count));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < count; i++) miss = keys[i * 7919 % count] + 1, assert(!hash_table_mgr_member_is_exist(ht, &miss));
+		MY_PRINTF("%lu hash_table_mgr miss: %.1f ns/op", count, _ns_since(&start, count));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < count; i++) hash_table_mgr_member_del(ht, &keys[i * 7919 % count]);
+		MY_PRINTF("%lu hash_table_mgr del: %.1f ns/op", count, _ns_since(&start, count));
+		hash_table_mgr_free(ht);
+
+		free(keys);
+	}
+}
+
+int main()
+{
+	size_t i = 0, alloc_cnt = 0, free_cnt = 0;
+	hash_table_mgr_t *ht = NULL;
+
+	/* 扩容时新旧数组都通过设置的内存管理函数分配和释放 */
+	hash_table_mgr_init(({
+		void* _(size_t size) {
+			alloc_cnt++;
+			return calloc(1, size);
+		}; _;}), ({
+		void _(void *ptr) {
+			free_cnt++;
+			free(ptr);
+		}; _;}));
+	assert((ht = hash_table_mgr_new(0, sizeof(i), NULL)));
+	for (i = 0; i < 1000; i++) assert(hash_table_mgr_member_add(ht, &i, NULL));
+	assert(ht->m_size == 1000 && alloc_cnt > 3);
+	hash_table_mgr_free(ht);
+	assert(alloc_cnt == free_cnt);
+	MY_PRINTF("alloc hook ok");
+
+	hash_table_mgr_init(NULL, NULL);
+	_hash_table_mgr_test();
+	_hash_table_mgr_bench();
+	return 0;
+}
+#endif
@@ -0,0 +1,68 @@
+#ifndef _HASH_TABLE_MGR_H_
+#define _HASH_TABLE_MGR_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* 一次比较的控制字节个数，编译时有AVX2用32，否则用SSE2的16 */
+#ifdef __AVX2__
+#define HASH_TABLE_MGR_GROUP 32
+#else
+#define HASH_TABLE_MGR_GROUP 16
+#endif
+
+typedef void* (*hash_table_mgr_alloc_t) (size_t size);
+typedef void (*hash_table_mgr_free_t) (void *ptr);
+typedef size_t (*hash_table_mgr_hash_func_t) (const void *key);
+
+/* 开放寻址的hash表，和hash_bucket_mgr的接口相同
+ * 每个槽位有一个控制字节：空、已删除或者hash的低7位，查找时用SIMD一次比较一组控制字节；
+ * 槽位里直接存key和完整的hash值，不用额外分配节点，比较key用memcmp而不是回调；
+ * 不加锁，多线程使用时由调用者加锁 */
+typedef struct _hash_table_mgr {
+	size_t m_capacity; /* 槽位个数，2的幂 */
+	size_t m_size; /* 节点个数 */
+	size_t m_growth_left; /* 还能写入多少个空槽位，为0时扩容或清理已删除的槽位 */
+	size_t m_key_size;
+	size_t m_slot_size; /* 一个槽位的字节数 */
+	signed char *m_ctrl; /* 控制字节，末尾多HASH_TABLE_MGR_GROUP个字节复制开头的控制字节 */
+	unsigned char *m_slot; /* 槽位数组 */
+	hash_table_mgr_hash_func_t m_hash_func;
+} hash_table_mgr_t;
+
+/* @func:
+ *	打印管理器
+ */
+void hash_table_mgr_dump(hash_table_mgr_t *ht);
+
+/* @func:
+ *	初始化管理器，参数为NULL时使用calloc/free
+ */
+void hash_table_mgr_init(hash_table_mgr_alloc_t hash_table_alloc, hash_table_mgr_free_t hash_table_free);
+
+/* @func:
+ *	创建一个hash表，hash_func为NULL时用内置的hash函数
+ */
+hash_table_mgr_t* hash_table_mgr_new(size_t capacity, size_t key_size, hash_table_mgr_hash_func_t hash_func);
+
+/* @func:
+ *	销毁hash表，但不销毁ptr指向的内存
+ */
+void hash_table_mgr_free(hash_table_mgr_t *ht);
+
+/* @func:
+ *	添加节点，key已经存在时返回false
+ */
+bool hash_table_mgr_member_add(hash_table_mgr_t *ht, const void *key, void *ptr);
+
+/* @func:
+ *	删除节点，返回添加时的ptr
+ */
+void* hash_table_mgr_member_del(hash_table_mgr_t *ht, const void *key);
+
+/* @func:
+ *	判断一个节点是否存在
+ */
+bool hash_table_mgr_member_is_exist(hash_table_mgr_t *ht, const void *key);
+
+#endif
@@ -5,6 +5,7 @@
 #include <errno.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
 
 #include "heap_mgr.h"
 
@@ -15,15 +16,17 @@
 #define HEAP_MGR_WARN_LOG MY_PRINT
 #define HEAP_MGR_ERROR_LOG MY_PRINT
 
-#define HEAP_MEMBER_ROOT 0X1
+#define HEAP_MGR_ARITY 4
+#define HEAP_MGR_ALIGN 64 /* 4个子节点正好一个cache line */
+#define HEAP_MEMBER_ROOT (HEAP_MGR_ARITY - 1)
 #define HEAP_MEMBER_INIT_CAPACITY   0XF
 
 #define HEAP_MGR_EXPAND_RATE 1.5f
 #define HEAP_MGR_SHRINK_RATE 0.5f
 
-#define HEAP_PARENT_2_LCHILD(pos) ((pos) << 0X1)
-#define HEAP_PARENT_2_RCHILD(pos) (((pos) << 0X1) + 1)
-#define HEAP_CHILD_2_PARENT(pos) ((pos) >> 0X1)
+/* 根放在ARITY-1，子节点从ARITY的倍数开始，一组兄弟节点不会跨cache line */
+#define HEAP_PARENT_2_FCHILD(pos) (HEAP_MGR_ARITY * ((pos) - HEAP_MGR_ARITY + 2))
+#define HEAP_CHILD_2_PARENT(pos) ((pos) / HEAP_MGR_ARITY + HEAP_MGR_ARITY - 2)
 #define HEAP_INDEX_IS_VALID(hm, index) ((hm)->m_offset > (index) ? true : false)
 
 static HEAP_MGR_ALLOC_T g_heap_mgr_alloc = NULL;
@@ -34,85 +37,146 @@ static void* _malloc2calloc(size_t size)
     return calloc(1, size);
 }
 
-static bool _heap_mgr_expand(heap_mgr_t *hm)
+/* @func:
+ *  重新分配数组，保留已有的节点，节点下标不变
+ */
+static bool _heap_mgr_resize(heap_mgr_t *hm, size_t capacity)
 {
-    if (!hm || !hm->m_heap) return false;
+    void *buf = NULL;
     heap_mgr_member_t *hmm = NULL;
-    size_t capacity = hm->m_capacity * HEAP_MGR_EXPAND_RATE + 1;
 
-    if (!(hmm = g_heap_mgr_alloc(capacity * sizeof(heap_mgr_member_t)))) {
+    if (!(buf = g_heap_mgr_alloc(capacity * sizeof(heap_mgr_member_t) + HEAP_MGR_ALIGN))) {
         HEAP_MGR_WARN_LOG("g_heap_mgr_alloc error, errno: %d - %s", errno, strerror(errno));
         return false;
     }
-    memcpy(hmm, hm->m_heap, hm->m_capacity * sizeof(heap_mgr_member_t));
-    g_heap_mgr_free(hm->m_heap);
+    hmm = (heap_mgr_member_t*)(((uintptr_t)buf + HEAP_MGR_ALIGN - 1) & ~(uintptr_t)(HEAP_MGR_ALIGN - 1));
+    if (hm->m_heap) {
+        memcpy(hmm, hm->m_heap, hm->m_offset * sizeof(heap_mgr_member_t));
+        g_heap_mgr_free(hm->m_buf);
+    }
     hm->m_capacity = capacity;
     hm->m_heap = hmm;
+    hm->m_buf = buf;
     return true;
 }
 
+static bool _heap_mgr_expand(heap_mgr_t *hm, size_t need)
+{
+    if (!hm || !hm->m_heap) return false;
+    size_t capacity = hm->m_capacity * HEAP_MGR_EXPAND_RATE + 1;
+
+    if (capacity < need) capacity = need;
+    return _heap_mgr_resize(hm, capacity);
+}
+
 static bool _heap_mgr_shrink(heap_mgr_t *hm)
 {
     if (!hm || !hm->m_heap) return false;
-    heap_mgr_member_t *hmm = NULL;
     size_t capacity = hm->m_capacity * HEAP_MGR_SHRINK_RATE;
 
     if ((hm->m_offset + HEAP_MEMBER_INIT_CAPACITY) >= capacity) return false;
-    if (!(hmm = g_heap_mgr_alloc(capacity * sizeof(heap_mgr_member_t)))) {
-        HEAP_MGR_WARN_LOG("g_heap_mgr_alloc error, errno: %d - %s", errno, strerror(errno));
-        return false;
+    return _heap_mgr_resize(hm, capacity);
+}
+
+/* @func:
+ *  把src放到index，同步句柄里的下标
+ */
+static inline void _heap_mgr_member_set(heap_mgr_member_t *hmm, size_t index, const heap_mgr_member_t *src)
+{
+    hmm[index] = *src;
+    if (src->m_node) src->m_node->m_index = index;
+}
+
+/* @func:
+ *  index处的节点往上调整，父节点往下移，最后再放入节点，返回最终的下标
+ */
+static size_t _heap_mgr_member_filter_up(heap_mgr_t *hm, size_t index)
+{
+    heap_mgr_member_t *hmm = hm->m_heap, tmp = hmm[index];
+    size_t parent_index = 0;
+
+    while (index > HEAP_MEMBER_ROOT) {
+        parent_index = HEAP_CHILD_2_PARENT(index);
+        if (!hm->m_compare(tmp.m_ptr, hmm[parent_index].m_ptr)) break;
+        _heap_mgr_member_set(hmm, index, &hmm[parent_index]);
+        index = parent_index;
     }
-    memcpy(hmm, hm->m_heap, (hm->m_offset + 1) * sizeof(heap_mgr_member_t));
-    g_heap_mgr_free(hm->m_heap);
-    hm->m_capacity = capacity;
-    hm->m_heap = hmm;
-    return true;
+    _heap_mgr_member_set(hmm, index, &tmp);
+    return index;
 }
 
-static bool _heap_mgr_member_filter_up(heap_mgr_t *hm)
+/* @func:
+ *  index处的节点往下调整，每层在最多4个子节点中选一个
+ */
+static void _heap_mgr_member_filter_down(heap_mgr_t *hm, size_t index)
 {
-    if (!hm || !hm->m_heap || !hm->m_compare) return false;
-    if (hm->m_offset == HEAP_MEMBER_ROOT) return true;
-    heap_mgr_member_t *hmm = hm->m_heap;
-    size_t parent_index = 0, child_index = hm->m_offset;
-    void *ptr = NULL;
+    heap_mgr_member_t *hmm = hm->m_heap, tmp = hmm[index];
+    size_t child_index = 0, first = 0, last = 0, i = 0;
+
+    while (HEAP_INDEX_IS_VALID(hm, first = HEAP_PARENT_2_FCHILD(index))) {
+        last = HEAP_INDEX_IS_VALID(hm, first + HEAP_MGR_ARITY) ? first + HEAP_MGR_ARITY : hm->m_offset;
+        /* 比较函数要解引用ptr，先一起预取，几个cache miss并行 */
+        for (i = first; i < last; i++) __builtin_prefetch(hmm[i].m_ptr);
+        for (child_index = first, i = first + 1; i < last; i++) {
+            if (hm->m_compare(hmm[i].m_ptr, hmm[child_index].m_ptr)) child_index = i;
+        }
+        if (!hm->m_compare(hmm[child_index].m_ptr, tmp.m_ptr)) break;
+        _heap_mgr_member_set(hmm, index, &hmm[child_index]);
+        index = child_index;
+    }
+    _heap_mgr_member_set(hmm, index, &tmp);
+}
 
-    while (child_index > HEAP_MEMBER_ROOT) {
-        parent_index = HEAP_CHILD_2_PARENT(child_index);
-        if (!hm->m_compare(hmm[child_index].m_ptr, hmm[parent_index].m_ptr)) break;
-        ptr = hmm[child_index].m_ptr;
-        hmm[child_index].m_ptr = hmm[parent_index].m_ptr;
-        hmm[parent_index].m_ptr = ptr;
-        child_index = parent_index;
+/* @func:
+ *  添加节点，调用者持有锁
+ */
+static bool _heap_mgr_member_push(heap_mgr_t *hm, void *ptr, heap_mgr_node_t *node)
+{
+    if (hm->m_offset >= hm->m_capacity) {
+        if (!_heap_mgr_expand(hm, hm->m_offset + 1)) return false;
     }
+
+    hm->m_heap[hm->m_offset].m_ptr = ptr;
+    hm->m_heap[hm->m_offset].m_node = node;
+    _heap_mgr_member_filter_up(hm, hm->m_offset++);
     return true;
 }
 
-
-static bool _heap_mgr_member_filter_down(heap_mgr_t *hm)
+/* @func:
+ *  删除index处的节点，用最后一个节点填上，再往上或往下调整；调用者持有锁
+ */
+static void* _heap_mgr_member_remove(heap_mgr_t *hm, size_t index)
 {
-    if (!hm || !hm->m_heap || !hm->m_compare) return false;
-    if (hm->m_offset <= HEAP_MEMBER_ROOT) return false;
     heap_mgr_member_t *hmm = hm->m_heap;
-    size_t parent_index = HEAP_MEMBER_ROOT, child_index = HEAP_MEMBER_ROOT, lchild_index = 0, rchild_index = 0;
-    void *ptr = NULL;
+    void *ptr = hmm[index].m_ptr;
 
-    while (true) {
-        lchild_index = HEAP_PARENT_2_LCHILD(parent_index);
-        rchild_index = HEAP_PARENT_2_RCHILD(parent_index);
-        if (HEAP_INDEX_IS_VALID(hm, lchild_index) && HEAP_INDEX_IS_VALID(hm, rchild_index)) {
-            if (hm->m_compare(hmm[lchild_index].m_ptr, hmm[rchild_index].m_ptr)) child_index = lchild_index;
-            else child_index = rchild_index;
-        } else if (!HEAP_INDEX_IS_VALID(hm, lchild_index) && !HEAP_INDEX_IS_VALID(hm, rchild_index))  break;
-        else child_index = lchild_index;
-
-        if (!hm->m_compare(hmm[child_index].m_ptr, hmm[parent_index].m_ptr)) break;
-        ptr = hmm[child_index].m_ptr;
-        hmm[child_index].m_ptr = hmm[parent_index].m_ptr;
-        hmm[parent_index].m_ptr = ptr;
-        parent_index = child_index;
+    if (hmm[index].m_node) hmm[index].m_node->m_index = 0;
+    hm->m_offset--;
+    if (index < hm->m_offset) {
+        _heap_mgr_member_set(hmm, index, &hmm[hm->m_offset]);
+        if (_heap_mgr_member_filter_up(hm, index) == index) _heap_mgr_member_filter_down(hm, index);
     }
-    return true;
+    _heap_mgr_shrink(hm);
+    return ptr;
+}
+
+/* @func:
+ *  句柄是否在这个heap中，调用者持有锁
+ */
+static bool _heap_mgr_node_is_valid(heap_mgr_t *hm, heap_mgr_node_t *node)
+{
+    return node->m_index >= HEAP_MEMBER_ROOT && HEAP_INDEX_IS_VALID(hm, node->m_index)
+        && hm->m_heap[node->m_index].m_node == node;
+}
+
+static inline void _heap_mgr_lock(heap_mgr_t *hm)
+{
+    if (!hm->m_is_unlocked) pthread_mutex_lock(&hm->m_mutex);
+}
+
+static inline void _heap_mgr_unlock(heap_mgr_t *hm)
+{
+    if (!hm->m_is_unlocked) pthread_mutex_unlock(&hm->m_mutex);
 }
 
 /* @func:
@@ -143,29 +207,36 @@ heap_mgr_t* heap_mgr_new(size_t capacity, HEAP_MEMBER_COMPARE_T compare)
         goto free_exit;
     }
 
-    if (!(hm->m_heap = (heap_mgr_member_t*)g_heap_mgr_alloc(capacity * sizeof(heap_mgr_member_t)))) {
-        HEAP_MGR_ERROR_LOG("calloc error, errno: %d-%s", errno, strerror(errno));
-        goto free_exit;
-	}
+    hm->m_offset = HEAP_MEMBER_ROOT;
+    if (!_heap_mgr_resize(hm, capacity + HEAP_MEMBER_ROOT)) goto free_exit;
 
     if(pthread_mutex_init(&hm->m_mutex, NULL)) {
         HEAP_MGR_ERROR_LOG("pthread_mutex_init error, errno: %d - %s", errno, strerror(errno));
         goto free_exit;
     }
 
-    hm->m_capacity = capacity;
     hm->m_compare = compare;
-    hm->m_offset = 1;
 	return hm;
 
 free_exit:
     if (hm) {
-        if (hm->m_heap) g_heap_mgr_free(hm->m_heap);
+        if (hm->m_buf) g_heap_mgr_free(hm->m_buf);
         g_heap_mgr_free(hm);
     }
     return NULL;
 }
 
+/* @func:
+ *  分配一个不加锁的heap_mgr
+ */
+heap_mgr_t* heap_mgr_unlocked_new(size_t capacity, HEAP_MEMBER_COMPARE_T compare)
+{
+    heap_mgr_t *hm = NULL;
+
+    if ((hm = heap_mgr_new(capacity, compare))) hm->m_is_unlocked = true;
+    return hm;
+}
+
 /* @func:
  *  销毁heap_mgr，释放内存
  * @warn:
@@ -175,9 +246,10 @@ bool heap_mgr_free(heap_mgr_t *hm)
 {
     if (!hm) return false;
 
-    pthread_mutex_lock(&hm->m_mutex);
-    if (hm->m_heap) g_heap_mgr_free(hm->m_heap);
+    _heap_mgr_lock(hm);
+    if (hm->m_buf) g_heap_mgr_free(hm->m_buf);
     hm->m_heap = NULL;
+    hm->m_buf = NULL;
     pthread_mutex_destroy(&hm->m_mutex);
     g_heap_mgr_free(hm);
 
@@ -192,18 +264,43 @@ bool heap_mgr_member_add(heap_mgr_t *hm, void *ptr)
 	if(!hm) return false;
     bool ret = false;
 
-    pthread_mutex_lock(&hm->m_mutex);
-    if (hm->m_offset >= hm->m_capacity) {
-        if (!_heap_mgr_expand(hm)) goto out;
+    _heap_mgr_lock(hm);
+    ret = _heap_mgr_member_push(hm, ptr, NULL);
+    _heap_mgr_unlock(hm);
+    return ret;
+}
+
+/* @func:
+ *  批量添加节点，批量比heap中已有的节点多时整体建堆，O(n)
+ */
+bool heap_mgr_member_add_batch(heap_mgr_t *hm, void **ptr, size_t cnt)
+{
+    if (!hm || (!ptr && cnt)) return false;
+    size_t i = 0, start = 0;
+    bool ret = false;
+
+    _heap_mgr_lock(hm);
+    if (hm->m_offset + cnt > hm->m_capacity) {
+        if (!_heap_mgr_expand(hm, hm->m_offset + cnt)) goto out;
     }
 
-    hm->m_heap[hm->m_offset].m_ptr = ptr;
-    _heap_mgr_member_filter_up(hm);
-    hm->m_offset++;
+    start = hm->m_offset;
+    for (i = 0; i < cnt; i++) {
+        hm->m_heap[start + i].m_ptr = ptr[i];
+        hm->m_heap[start + i].m_node = NULL;
+    }
+    hm->m_offset += cnt;
+
+    if (cnt && cnt >= start - HEAP_MEMBER_ROOT) {
+        /* 从最后一个有子节点的节点开始往前，逐个往下调整 */
+        for (i = HEAP_CHILD_2_PARENT(hm->m_offset - 1) + 1; i-- > HEAP_MEMBER_ROOT;) _heap_mgr_member_filter_down(hm, i);
+    } else {
+        for (i = start; i < hm->m_offset; i++) _heap_mgr_member_filter_up(hm, i);
+    }
     ret = true;
 
 out:
-    pthread_mutex_unlock(&hm->m_mutex);
+    _heap_mgr_unlock(hm);
     return ret;
 }
 
@@ -215,19 +312,27 @@ void* heap_mgr_member_del(heap_mgr_t *hm)
 	if(!hm) return NULL;
     void *ptr = NULL;
 
-    pthread_mutex_lock(&hm->m_mutex);
-    if (hm->m_offset > HEAP_MEMBER_ROOT) {
-        ptr = hm->m_heap[HEAP_MEMBER_ROOT].m_ptr;
-        hm->m_offset--;
-        hm->m_heap[HEAP_MEMBER_ROOT].m_ptr = hm->m_heap[hm->m_offset].m_ptr;
-        _heap_mgr_member_filter_down(hm);
-        _heap_mgr_shrink(hm);
-    }
-    pthread_mutex_unlock(&hm->m_mutex);
+    _heap_mgr_lock(hm);
+    if (hm->m_offset > HEAP_MEMBER_ROOT) ptr = _heap_mgr_member_remove(hm, HEAP_MEMBER_ROOT);
+    _heap_mgr_unlock(hm);
 
 	return ptr;
 }
 
+/* @func:
+ *  返回堆顶的节点但不删除，为空时返回NULL
+ */
+void* heap_mgr_member_top(heap_mgr_t *hm)
+{
+    if (!hm) return NULL;
+    void *ptr = NULL;
+
+    _heap_mgr_lock(hm);
+    if (hm->m_heap && hm->m_offset > HEAP_MEMBER_ROOT) ptr = hm->m_heap[HEAP_MEMBER_ROOT].m_ptr;
+    _heap_mgr_unlock(hm);
+    return ptr;
+}
+
 /* @func:
  *  判断heap是否为空
  */
@@ -236,12 +341,70 @@ bool heap_mgr_is_empty(heap_mgr_t *hm)
     if (!hm) return true;
     bool ret = false;
 
-    pthread_mutex_lock(&hm->m_mutex);
-    if (!hm->m_heap || hm->m_offset == 1) ret = true;
-    pthread_mutex_unlock(&hm->m_mutex);
+    _heap_mgr_lock(hm);
+    if (!hm->m_heap || hm->m_offset == HEAP_MEMBER_ROOT) ret = true;
+    _heap_mgr_unlock(hm);
+    return ret;
+}
+
+/* @func:
+ *  返回节点个数
+ */
+size_t heap_mgr_size(heap_mgr_t *hm)
+{
+    if (!hm) return 0;
+    size_t size = 0;
+
+    _heap_mgr_lock(hm);
+    size = hm->m_offset - HEAP_MEMBER_ROOT;
+    _heap_mgr_unlock(hm);
+    return size;
+}
+
+/* @func:
+ *  带句柄添加一个节点，node必须不在任何heap中
+ */
+bool heap_mgr_node_add(heap_mgr_t *hm, heap_mgr_node_t *node, void *ptr)
+{
+    if (!hm || !node || node->m_index) return false;
+    bool ret = false;
+
+    _heap_mgr_lock(hm);
+    ret = _heap_mgr_member_push(hm, ptr, node);
+    _heap_mgr_unlock(hm);
     return ret;
 }
 
+/* @func:
+ *  修改node对应节点的优先级之后调用，重新调整位置，升高降低都可以
+ */
+bool heap_mgr_node_update(heap_mgr_t *hm, heap_mgr_node_t *node)
+{
+    if (!hm || !node) return false;
+    bool ret = false;
+
+    _heap_mgr_lock(hm);
+    if ((ret = _heap_mgr_node_is_valid(hm, node))) {
+        if (_heap_mgr_member_filter_up(hm, node->m_index) == node->m_index) _heap_mgr_member_filter_down(hm, node->m_index);
+    }
+    _heap_mgr_unlock(hm);
+    return ret;
+}
+
+/* @func:
+ *  删除node对应的节点，返回添加时的ptr，不在heap中时返回NULL
+ */
+void* heap_mgr_node_del(heap_mgr_t *hm, heap_mgr_node_t *node)
+{
+    if (!hm || !node) return NULL;
+    void *ptr = NULL;
+
+    _heap_mgr_lock(hm);
+    if (_heap_mgr_node_is_valid(hm, node)) ptr = _heap_mgr_member_remove(hm, node->m_index);
+    _heap_mgr_unlock(hm);
+    return ptr;
+}
+
 /* func:
  *      输出heap信息
  */
@@ -252,7 +415,7 @@ void heap_mgr_dump(heap_mgr_t *hm)
     heap_mgr_member_t *hmm = NULL;
 
     HEAP_MGR_TRACE_LOG("===========");
-    pthread_mutex_lock(&hm->m_mutex);
+    _heap_mgr_lock(hm);
     HEAP_MGR_TRACE_LOG("capacity: %lu", hm->m_capacity);
     HEAP_MGR_TRACE_LOG("offset: %lu", hm->m_offset);
     HEAP_MGR_TRACE_LOG("compare: %p", hm->m_compare);
@@ -262,10 +425,11 @@ void heap_mgr_dump(heap_mgr_t *hm)
         hmm = &hm->m_heap[i];
         HEAP_MGR_TRACE_LOG("index: %lu", i);
         HEAP_MGR_TRACE_LOG("ptr: %p", hmm->m_ptr);
+        HEAP_MGR_TRACE_LOG("node: %p", hmm->m_node);
         /* HEAP_MGR_TRACE_LOG("ptr_value: %d", *(int*)hmm->m_ptr); */
         HEAP_MGR_TRACE_LOG();
     }
-    pthread_mutex_unlock(&hm->m_mutex);
+    _heap_mgr_unlock(hm);
     HEAP_MGR_TRACE_LOG("===========");
 }
 
@@ -297,7 +461,7 @@ static void _heap_mgr_test_single(void)
     assert(heap_mgr_member_add(hm, &a_4));
     assert(heap_mgr_member_add(hm, &a_5));
     assert(heap_mgr_member_add(hm, &a_6));
-    assert(!heap_mgr_is_empty(hm));
+    assert(!heap_mgr_is_empty(hm) && heap_mgr_size(hm) == 6);
 
     assert((ptr = heap_mgr_member_del(hm)));
     assert(ptr == &a_4);
@@ -357,7 +521,7 @@ static void _heap_mgr_test_multiple(void)
     ptr = heap_mgr_member_del(hm);
     max_num = *(int*)ptr;
     offset = hm->m_offset;
-    for (j = 1; j < offset; j++) {
+    for (j = HEAP_MEMBER_ROOT; j < offset; j++) {
         ptr = heap_mgr_member_del(hm);
         assert(max_num >= *(int*)ptr);
         max_num = *(int*)ptr;
@@ -369,10 +533,354 @@ static void _heap_mgr_test_multiple(void)
     MY_PRINT("multiple threads ok");
 }
 
+typedef struct _heap_mgr_test_item {
+    int m_key;
+    heap_mgr_node_t m_node;
+} heap_mgr_test_item_t;
+
+/* @func:
+ *  依次弹出所有节点，检查顺序和个数
+ */
+static void _heap_mgr_test_drain(heap_mgr_t *hm, size_t count)
+{
+    size_t i = 0;
+    int *ptr = NULL, last = 0;
+
+    for (i = 0; i < count; i++) {
+        assert((ptr = heap_mgr_member_del(hm)));
+        assert(i == 0 || last >= *ptr);
+        last = *ptr;
+    }
+    assert(heap_mgr_is_empty(hm));
+}
+
+/* @func:
+ *  句柄测试，随机调整优先级、删除任意节点，和批量建堆
+ */
+static void _heap_mgr_test_node(void)
+{
+    #define node_count 10000
+    heap_mgr_test_item_t *item = NULL;
+    heap_mgr_t *hm = NULL;
+    void **ptr = NULL;
+    size_t i = 0, count = node_count;
+
+    assert((item = calloc(node_count, sizeof(heap_mgr_test_item_t))));
+    assert((ptr = malloc(node_count * sizeof(void*))));
+    assert((hm = heap_mgr_new(0, _heap_mgr_test_compare)));
+    srand(1);
+    for (i = 0; i < node_count; i++) {
+        item[i].m_key = rand() % 100000;
+        assert(heap_mgr_node_add(hm, &item[i].m_node, &item[i]));
+        assert(item[i].m_node.m_index);
+    }
+    assert(!heap_mgr_node_add(hm, &item[0].m_node, &item[0]));
+
+    for (i = 0; i < node_count; i++) {
+        item[i].m_key += rand() % 2 ? rand() % 1000 : -(rand() % 1000);
+        assert(heap_mgr_node_update(hm, &item[i].m_node));
+    }
+    for (i = 0; i < node_count; i += 3, count--) {
+        assert(heap_mgr_node_del(hm, &item[i].m_node) == &item[i]);
+        assert(!item[i].m_node.m_index);
+        assert(!heap_mgr_node_del(hm, &item[i].m_node));
+        assert(!heap_mgr_node_update(hm, &item[i].m_node));
+    }
+    assert(*(int*)heap_mgr_member_del(hm) >= item[1].m_key);
+    _heap_mgr_test_drain(hm, count - 1);
+    for (i = 0; i < node_count; i++) assert(!item[i].m_node.m_index);
+
+    /* 空heap整体建堆，再批量加一小批逐个上浮 */
+    for (i = 0; i < node_count; i++) ptr[i] = &item[i];
+    assert(heap_mgr_member_add_batch(hm, ptr, node_count));
+    assert(heap_mgr_member_add_batch(hm, ptr, 10));
+    assert(heap_mgr_member_add_batch(hm, ptr, 0));
+    _heap_mgr_test_drain(hm, node_count + 10);
+
+    heap_mgr_free(hm);
+    free(item);
+    free(ptr);
+    MY_PRINT("node test ok");
+}
+
+/* 改动前的二叉堆，只用来做性能对比 */
+typedef struct _heap_mgr_binary {
+    size_t m_capacity;
+    size_t m_offset;
+    void **m_heap;
+    HEAP_MEMBER_COMPARE_T m_compare;
+    pthread_mutex_t m_mutex;
+} heap_mgr_binary_t;
+
+static void _heap_mgr_binary_add(heap_mgr_binary_t *bh, void *ptr)
+{
+    size_t child_index = 0, parent_index = 0;
+
+    pthread_mutex_lock(&bh->m_mutex);
+    if (bh->m_offset >= bh->m_capacity) {
+        bh->m_capacity = bh->m_capacity * HEAP_MGR_EXPAND_RATE + 1;
+        assert((bh->m_heap = realloc(bh->m_heap, bh->m_capacity * sizeof(void*))));
+    }
+    bh->m_heap[child_index = bh->m_offset++] = ptr;
+    while (child_index > 1) {
+        parent_index = child_index >> 1;
+        if (!bh->m_compare(bh->m_heap[child_index], bh->m_heap[parent_index])) break;
+        ptr = bh->m_heap[child_index];
+        bh->m_heap[child_index] = bh->m_heap[parent_index];
+        bh->m_heap[parent_index] = ptr;
+        child_index = parent_index;
+    }
+    pthread_mutex_unlock(&bh->m_mutex);
+}
+
+static void* _heap_mgr_binary_del(heap_mgr_binary_t *bh)
+{
+    size_t parent_index = 1, child_index = 0;
+    void *ret = NULL, *ptr = NULL;
+
+    pthread_mutex_lock(&bh->m_mutex);
+    if (bh->m_offset > 1) {
+        ret = bh->m_heap[1];
+        bh->m_heap[1] = bh->m_heap[--bh->m_offset];
+        while ((child_index = parent_index << 1) < bh->m_offset) {
+            if (child_index + 1 < bh->m_offset
+                && bh->m_compare(bh->m_heap[child_index + 1], bh->m_heap[child_index])) child_index++;
+            if (!bh->m_compare(bh->m_heap[child_index], bh->m_heap[parent_index])) break;
+            ptr = bh->m_heap[child_index];
+            bh->m_heap[child_index] = bh->m_heap[parent_index];
+            bh->m_heap[parent_index] = ptr;
+            parent_index = child_index;
+        }
+    }
+    pthread_mutex_unlock(&bh->m_mutex);
+    return ret;
+}
+
+static double _heap_mgr_ns_since(const struct timespec *start, size_t count)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec)) / count;
+}
+
+/* @func:
+ *  和改动前的二叉堆对比：逐个添加、弹出，批量建堆，以及调整优先级
+ */
+static void _heap_mgr_bench(void)
+{
+    #define bench_count (1024 * 1024)
+    heap_mgr_binary_t bh = {0, 1, NULL, _heap_mgr_test_compare, PTHREAD_MUTEX_INITIALIZER};
+    heap_mgr_test_item_t *item = NULL;
+    heap_mgr_t *hm = NULL;
+    void **ptr = NULL;
+    struct timespec start;
+    size_t i = 0;
+
+    assert((item = calloc(bench_count, sizeof(heap_mgr_test_item_t))));
+    assert((ptr = malloc(bench_count * sizeof(void*))));
+    srand(2);
+    for (i = 0; i < bench_count; i++) item[i].m_key = rand(), ptr[i] = &item[i];
+
+    /* 都预先分配好，只比较堆本身 */
+    assert((bh.m_heap = malloc((bh.m_capacity = bench_count + 1) * sizeof(void*))));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_count; i++) _heap_mgr_binary_add(&bh, ptr[i]);
+    MY_PRINT("binary add: %.1f ns/op", _heap_mgr_ns_since(&start, bench_count));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_count; i++) _heap_mgr_binary_del(&bh);
+    MY_PRINT("binary del: %.1f ns/op", _heap_mgr_ns_since(&start, bench_count));
+    free(bh.m_heap);
+
+    assert((hm = heap_mgr_new(bench_count, _heap_mgr_test_compare)));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_count; i++) heap_mgr_member_add(hm, ptr[i]);
+    MY_PRINT("4-ary add: %.1f ns/op", _heap_mgr_ns_since(&start, bench_count));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_count; i++) heap_mgr_member_del(hm);
+    MY_PRINT("4-ary del: %.1f ns/op", _heap_mgr_ns_since(&start, bench_count));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    heap_mgr_member_add_batch(hm, ptr, bench_count);
+    MY_PRINT("4-ary add_batch: %.1f ns/op", _heap_mgr_ns_since(&start, bench_count));
+    for (i = 0; i < bench_count; i++) heap_mgr_member_del(hm);
+
+    for (i = 0; i < bench_count; i++) heap_mgr_node_add(hm, &item[i].m_node, &item[i]);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_count; i++) {
+        item[i * 7919 % bench_count].m_key += rand() % 1024 - 512;
+        heap_mgr_node_update(hm, &item[i * 7919 % bench_count].m_node);
+    }
+    MY_PRINT("4-ary update: %.1f ns/op", _heap_mgr_ns_since(&start, bench_count));
+
+    heap_mgr_free(hm);
+    free(item);
+    free(ptr);
+}
+
+/* @func:
+ *  严格模式的顺序、多线程不丢不重，以及不同参数下弹出顺序偏离严格顺序的程度
+ */
+#include "multi_queue_mgr.h"
+static void _multi_queue_mgr_test(void)
+{
+    #define mq_count 100000
+    #define mq_thread 4
+    static int keys[mq_count];
+    static unsigned char seen[mq_count];
+    size_t i = 0, j = 0, popped = 0, choice[] = {2, 4, 8};
+    multi_queue_mgr_t *mq = NULL;
+    pthread_t pt[mq_thread * 2];
+    double error = 0;
+    int tmp = 0;
+
+    for (i = 0; i < mq_count; i++) keys[i] = i;
+    for (i = mq_count - 1; i > 0; i--) j = rand() % (i + 1), tmp = keys[i], keys[i] = keys[j], keys[j] = tmp;
+
+    assert((mq = multi_queue_mgr_new(1, 2, _heap_mgr_test_compare)));
+    assert(multi_queue_mgr_is_empty(mq) && !multi_queue_mgr_member_del(mq));
+    for (i = 0; i < mq_count; i++) assert(multi_queue_mgr_member_add(mq, &keys[i]));
+    for (i = 0; i < mq_count; i++) assert(*(int*)multi_queue_mgr_member_del(mq) == (int)(mq_count - 1 - i));
+    assert(multi_queue_mgr_is_empty(mq));
+    multi_queue_mgr_free(mq);
+
+    /* 一半线程添加，一半线程删除 */
+    assert((mq = multi_queue_mgr_new(mq_thread * 2, 2, _heap_mgr_test_compare)));
+    for (i = 0; i < mq_thread; i++) {
+        pthread_create(&pt[i], NULL, ({
+            void* _(void *arg) {
+                size_t k = 0;
+                for (k = (size_t)arg; k < mq_count; k += mq_thread) assert(multi_queue_mgr_member_add(mq, &keys[k]));
+                return NULL;
+            }; _; }), (void*)i);
+        pthread_create(&pt[mq_thread + i], NULL, ({
+            void* _(void *arg) {
+                int *p = NULL;
+                while (__atomic_load_n(&popped, __ATOMIC_RELAXED) < mq_count) {
+                    if (!(p = multi_queue_mgr_member_del(mq))) continue;
+                    assert(!__atomic_fetch_add(&seen[*p], 1, __ATOMIC_RELAXED));
+                    __atomic_add_fetch(&popped, 1, __ATOMIC_RELAXED);
+                }
+                return arg;
+            }; _; }), NULL);
+    }
+    for (i = 0; i < mq_thread * 2; i++) pthread_join(pt[i], NULL);
+    for (i = 0; i < mq_count; i++) assert(seen[i] == 1);
+    assert(multi_queue_mgr_is_empty(mq));
+    multi_queue_mgr_free(mq);
+
+    /* 第i个弹出的节点在严格顺序中应该是mq_count-1-i，统计平均偏差 */
+    for (j = 0; j < sizeof(choice) / sizeof(choice[0]); j++) {
+        assert((mq = multi_queue_mgr_new(16, choice[j], _heap_mgr_test_compare)));
+        for (i = 0; i < mq_count; i++) multi_queue_mgr_member_add(mq, &keys[i]);
+        for (i = 0, error = 0; i < mq_count; i++) error += labs((long)(mq_count - 1 - i) - *(int*)multi_queue_mgr_member_del(mq));
+        MY_PRINT("16 queues, choice %lu: mean rank error %.1f", choice[j], error / mq_count);
+        multi_queue_mgr_free(mq);
+    }
+    MY_PRINT("multi queue ok");
+}
+
+/* @func:
+ *  多线程同时添加删除的吞吐，heap_mgr一把锁和multi_queue_mgr对比
+ */
+static void _multi_queue_mgr_bench(void)
+{
+    #define mq_ops 200000
+    static int keys[mq_count];
+    size_t thread_cnt = 0, i = 0, j = 0;
+    multi_queue_mgr_t *mq = NULL;
+    heap_mgr_t *hm = NULL;
+    pthread_t pt[8];
+    struct timespec start;
+
+    for (i = 0; i < mq_count; i++) keys[i] = rand();
+    for (thread_cnt = 1; thread_cnt <= 8; thread_cnt *= 2) {
+        for (j = 0; j < 2; j++) {
+            if (j == 0) assert((hm = heap_mgr_new(mq_count, _heap_mgr_test_compare)));
+            else assert((mq = multi_queue_mgr_new(thread_cnt * 2, 2, _heap_mgr_test_compare)));
+            for (i = 0; i < mq_count; i++) j == 0 ? heap_mgr_member_add(hm, &keys[i]) : multi_queue_mgr_member_add(mq, &keys[i]);
+
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (i = 0; i < thread_cnt; i++) {
+                pthread_create(&pt[i], NULL, ({
+                    void* _(void *arg) {
+                        size_t k = 0;
+                        void *p = NULL;
+                        for (k = 0; k < mq_ops / thread_cnt; k++) {
+                            p = j == 0 ? heap_mgr_member_del(hm) : multi_queue_mgr_member_del(mq);
+                            j == 0 ? heap_mgr_member_add(hm, p) : multi_queue_mgr_member_add(mq, p);
+                        }
+                        return arg;
+                    }; _; }), NULL);
+            }
+            for (i = 0; i < thread_cnt; i++) pthread_join(pt[i], NULL);
+            MY_PRINT("%lu threads, %s: %.1f ns/op", thread_cnt, j == 0 ? "heap_mgr" : "multi_queue_mgr",
+                _heap_mgr_ns_since(&start, mq_ops / thread_cnt * thread_cnt * 2));
+            j == 0 ? heap_mgr_free(hm) : multi_queue_mgr_free(mq);
+        }
+    }
+}
+
+#include "heap_mgr_tmpl.h"
+HEAP_MGR_DEFINE(heap_mgr_int, int, void*, HEAP_MGR_GREATER)
+
+/* @func:
+ *  类型特化的堆，顺序和值都要对，再和heap_mgr比较同样的负载
+ */
+static void _heap_mgr_tmpl_test(void)
+{
+    heap_mgr_int_t *h = NULL;
+    heap_mgr_t *hm = NULL;
+    int *keys = NULL, key = 0, last = 0;
+    void *val = NULL;
+    size_t i = 0;
+    struct timespec start;
+
+    assert((keys = malloc(bench_count * sizeof(int))));
+    for (i = 0; i < bench_count; i++) keys[i] = rand() % (bench_count * 4);
+
+    assert((h = heap_mgr_int_new(0)));
+    assert(!heap_mgr_int_top(h, &key, &val) && !heap_mgr_int_del(h, &key, &val));
+    for (i = 0; i < 100000; i++) assert(heap_mgr_int_add(h, keys[i], &keys[i]));
+    assert(heap_mgr_int_size(h) == 100000);
+    for (i = 0; i < 100000; i++) {
+        assert(heap_mgr_int_del(h, &key, &val));
+        assert(*(int*)val == key && (i == 0 || last >= key));
+        last = key;
+    }
+    assert(!heap_mgr_int_size(h));
+    heap_mgr_int_free(h);
+    MY_PRINT("tmpl test ok");
+
+    assert((hm = heap_mgr_new(bench_count, _heap_mgr_test_compare)));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_count; i++) heap_mgr_member_add(hm, &keys[i]);
+    MY_PRINT("heap_mgr add: %.1f ns/op", _heap_mgr_ns_since(&start, bench_count));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_count; i++) heap_mgr_member_del(hm);
+    MY_PRINT("heap_mgr del: %.1f ns/op", _heap_mgr_ns_since(&start, bench_count));
+    heap_mgr_free(hm);
+
+    assert((h = heap_mgr_int_new(bench_count)));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_count; i++) heap_mgr_int_add(h, keys[i], &keys[i]);
+    MY_PRINT("tmpl add: %.1f ns/op", _heap_mgr_ns_since(&start, bench_count));
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < bench_count; i++) heap_mgr_int_del(h, &key, &val);
+    MY_PRINT("tmpl del: %.1f ns/op", _heap_mgr_ns_since(&start, bench_count));
+    heap_mgr_int_free(h);
+    free(keys);
+}
+
 int main(void)
 {
     _heap_mgr_test_single();
     _heap_mgr_test_multiple();
+    _heap_mgr_test_node();
+    _heap_mgr_bench();
+    _heap_mgr_tmpl_test();
+    _multi_queue_mgr_test();
+    _multi_queue_mgr_bench();
 
     return 0;
 }
@@ -7,15 +7,25 @@ typedef bool (*HEAP_MEMBER_COMPARE_T) (void *src, void *dst);
 typedef void* (*HEAP_MGR_ALLOC_T) (size_t size);
 typedef void (*HEAP_MGR_FREE_T) (void *ptr);
 
+/* 句柄，嵌入到调用者的结构体中，用来调整优先级或者删除任意节点
+ * 记录节点在数组中的下标，不在heap中时为0 */
+typedef struct _heap_mgr_node {
+    size_t m_index;
+} heap_mgr_node_t;
+
 typedef struct _heap_mgr_member {
     void *m_ptr;
+    heap_mgr_node_t *m_node; /* 不带句柄添加时为NULL */
 } heap_mgr_member_t;
 
+/* 4叉堆，根放在下标3，每个节点的4个子节点在同一个cache line里 */
 typedef struct _heap_mgr {
-    size_t m_capacity; /* 这个heap的大小 */
+    size_t m_capacity; /* 这个heap的大小，包括根前面空出来的位置 */
     size_t m_offset; /* 当前可以插入新节点的数组下标 */
     HEAP_MEMBER_COMPARE_T m_compare; /* 比较函数 */
-    heap_mgr_member_t *m_heap;
+    heap_mgr_member_t *m_heap; /* 按cache line对齐 */
+    void *m_buf; /* 分配的内存，m_heap在里面对齐 */
+    bool m_is_unlocked; /* 不使用m_mutex，由调用者保证互斥 */
     pthread_mutex_t m_mutex;
 } heap_mgr_t;
 
@@ -26,10 +36,15 @@ typedef struct _heap_mgr {
 void heap_mgr_init(HEAP_MGR_ALLOC_T alloc, HEAP_MGR_FREE_T dealloc);
 
 /* @param:
- *  分配一个heap_mgr
+ *  分配一个heap_mgr，capacity是初始的节点个数，放满后自动扩容
  */
 heap_mgr_t* heap_mgr_new(size_t capacity, HEAP_MEMBER_COMPARE_T compare);
 
+/* @func:
+ *  分配一个不加锁的heap_mgr，用在调用者已经持有自己的锁的地方，省掉内部的一次加解锁
+ */
+heap_mgr_t* heap_mgr_unlocked_new(size_t capacity, HEAP_MEMBER_COMPARE_T compare);
+
 /* @func:
  *  销毁heap_mgr，释放内存
  * @warn:
@@ -42,13 +57,43 @@ bool heap_mgr_free(heap_mgr_t *hm);
  */
 bool heap_mgr_member_add(heap_mgr_t *hm, void *ptr);
 
+/* @func:
+ *  批量添加节点，批量比heap中已有的节点多时整体建堆，O(n)
+ */
+bool heap_mgr_member_add_batch(heap_mgr_t *hm, void **ptr, size_t cnt);
+
 /* func:
  *  删除一个节点 */
 void* heap_mgr_member_del(heap_mgr_t *hm);
 
+/* @func:
+ *  返回堆顶的节点但不删除，为空时返回NULL
+ */
+void* heap_mgr_member_top(heap_mgr_t *hm);
+
 /* @func:
  *  判断heap是否为空
  */
 bool heap_mgr_is_empty(heap_mgr_t *hm);
 
+/* @func:
+ *  返回节点个数
+ */
+size_t heap_mgr_size(heap_mgr_t *hm);
+
+/* @func:
+ *  带句柄添加一个节点，node必须不在任何heap中
+ */
+bool heap_mgr_node_add(heap_mgr_t *hm, heap_mgr_node_t *node, void *ptr);
+
+/* @func:
+ *  修改node对应节点的优先级之后调用，重新调整位置，升高降低都可以
+ */
+bool heap_mgr_node_update(heap_mgr_t *hm, heap_mgr_node_t *node);
+
+/* @func:
+ *  删除node对应的节点，返回添加时的ptr，不在heap中时返回NULL
+ */
+void* heap_mgr_node_del(heap_mgr_t *hm, heap_mgr_node_t *node);
+
 #endif
@@ -0,0 +1,140 @@
+#ifndef _HEAP_MGR_TMPL_H_
+#define _HEAP_MGR_TMPL_H_
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* 按类型生成的4叉堆，key和值直接存在数组里，比较在编译时展开，不调用函数指针也不解引用
+ * 用法:
+ *  HEAP_MGR_DEFINE(timer_heap, uint64_t, void*, HEAP_MGR_LESS)
+ * 生成timer_heap_t和timer_heap_new/free/add/del/top/size，before(a, b)为真时a排在b前面
+ * 和heap_mgr一样根放在下标3、数组按cache line对齐，key和值一共16字节时4个子节点正好一个cache line
+ * 不加锁，多线程使用时由调用者加锁 */
+
+#define HEAP_MGR_LESS(a, b) ((a) < (b))
+#define HEAP_MGR_GREATER(a, b) ((a) > (b))
+
+#define HEAP_MGR_TMPL_ARITY 4
+#define HEAP_MGR_TMPL_ALIGN 64
+#define HEAP_MGR_TMPL_ROOT (HEAP_MGR_TMPL_ARITY - 1)
+#define HEAP_MGR_TMPL_INIT_CAPACITY 0XF
+#define HEAP_MGR_TMPL_FCHILD(pos) (HEAP_MGR_TMPL_ARITY * ((pos) - HEAP_MGR_TMPL_ARITY + 2))
+#define HEAP_MGR_TMPL_PARENT(pos) ((pos) / HEAP_MGR_TMPL_ARITY + HEAP_MGR_TMPL_ARITY - 2)
+
+#define HEAP_MGR_DEFINE(name, key_t, val_t, before)                                                     \
+typedef struct _##name##_member {                                                                       \
+    key_t m_key;                                                                                        \
+    val_t m_val;                                                                                        \
+} name##_member_t;                                                                                      \
+                                                                                                        \
+typedef struct _##name {                                                                                \
+    size_t m_capacity; /* 数组的大小，包括根前面空出来的位置 */                                         \
+    size_t m_offset; /* 当前可以插入新节点的数组下标 */                                                 \
+    name##_member_t *m_heap;                                                                            \
+} name##_t;                                                                                             \
+                                                                                                        \
+static inline bool _##name##_resize(name##_t *h, size_t capacity)                                       \
+{                                                                                                       \
+    void *heap = NULL;                                                                                  \
+                                                                                                        \
+    if (posix_memalign(&heap, HEAP_MGR_TMPL_ALIGN, capacity * sizeof(name##_member_t))) return false;  \
+    if (h->m_heap) {                                                                                    \
+        memcpy(heap, h->m_heap, h->m_offset * sizeof(name##_member_t));                                 \
+        free(h->m_heap);                                                                                \
+    }                                                                                                   \
+    h->m_heap = (name##_member_t*)heap;                                                                 \
+    h->m_capacity = capacity;                                                                           \
+    return true;                                                                                        \
+}                                                                                                       \
+                                                                                                        \
+/* @func:                                                                                               \
+ *  创建，capacity是初始的节点个数，放满后自动扩容                                                      \
+ */                                                                                                     \
+static inline name##_t* name##_new(size_t capacity)                                                     \
+{                                                                                                       \
+    name##_t *h = NULL;                                                                                 \
+                                                                                                        \
+    if (!(h = (name##_t*)calloc(1, sizeof(name##_t)))) return NULL;                                     \
+    h->m_offset = HEAP_MGR_TMPL_ROOT;                                                                   \
+    if (!_##name##_resize(h, (capacity ? capacity : HEAP_MGR_TMPL_INIT_CAPACITY) + HEAP_MGR_TMPL_ROOT)) { \
+        free(h);                                                                                        \
+        return NULL;                                                                                    \
+    }                                                                                                   \
+    return h;                                                                                           \
+}                                                                                                       \
+                                                                                                        \
+static inline void name##_free(name##_t *h)                                                             \
+{                                                                                                       \
+    if (!h) return ;                                                                                    \
+    free(h->m_heap);                                                                                    \
+    free(h);                                                                                            \
+}                                                                                                       \
+                                                                                                        \
+static inline size_t name##_size(const name##_t *h)                                                     \
+{                                                                                                       \
+    return h->m_offset - HEAP_MGR_TMPL_ROOT;                                                            \
+}                                                                                                       \
+                                                                                                        \
+/* @func:                                                                                               \
+ *  添加，父节点往下移，最后再放入新节点                                                                \
+ */                                                                                                     \
+static inline bool name##_add(name##_t *h, key_t key, val_t val)                                        \
+{                                                                                                       \
+    name##_member_t *hmm = NULL;                                                                        \
+    size_t index = h->m_offset, parent_index = 0;                                                       \
+                                                                                                        \
+    if (h->m_offset >= h->m_capacity && !_##name##_resize(h, h->m_capacity * 2)) return false;         \
+    hmm = h->m_heap;                                                                                    \
+    while (index > HEAP_MGR_TMPL_ROOT) {                                                                \
+        parent_index = HEAP_MGR_TMPL_PARENT(index);                                                     \
+        if (!(before(key, hmm[parent_index].m_key))) break;                                             \
+        hmm[index] = hmm[parent_index];                                                                 \
+        index = parent_index;                                                                           \
+    }                                                                                                   \
+    hmm[index].m_key = key;                                                                             \
+    hmm[index].m_val = val;                                                                             \
+    h->m_offset++;                                                                                      \
+    return true;                                                                                        \
+}                                                                                                       \
+                                                                                                        \
+/* @func:                                                                                               \
+ *  查看堆顶，为空时返回false，key和val可以为NULL                                                       \
+ */                                                                                                     \
+static inline bool name##_top(const name##_t *h, key_t *key, val_t *val)                                \
+{                                                                                                       \
+    if (h->m_offset == HEAP_MGR_TMPL_ROOT) return false;                                                \
+    if (key) *key = h->m_heap[HEAP_MGR_TMPL_ROOT].m_key;                                                \
+    if (val) *val = h->m_heap[HEAP_MGR_TMPL_ROOT].m_val;                                                \
+    return true;                                                                                        \
+}                                                                                                       \
+                                                                                                        \
+/* @func:                                                                                               \
+ *  弹出堆顶，为空时返回false；最后一个节点从根往下找位置，4个子节点都在时两两比较                      \
+ */                                                                                                     \
+static inline bool name##_del(name##_t *h, key_t *key, val_t *val)                                      \
+{                                                                                                       \
+    name##_member_t *hmm = h->m_heap, last;                                                             \
+    size_t index = HEAP_MGR_TMPL_ROOT, first = 0, child_index = 0, c1 = 0, c2 = 0, i = 0;              \
+                                                                                                        \
+    if (!name##_top(h, key, val)) return false;                                                         \
+    last = hmm[--h->m_offset];                                                                          \
+    while ((first = HEAP_MGR_TMPL_FCHILD(index)) < h->m_offset) {                                       \
+        if (first + HEAP_MGR_TMPL_ARITY <= h->m_offset) {                                               \
+            c1 = before(hmm[first + 1].m_key, hmm[first].m_key) ? first + 1 : first;                    \
+            c2 = before(hmm[first + 3].m_key, hmm[first + 2].m_key) ? first + 3 : first + 2;            \
+            child_index = before(hmm[c2].m_key, hmm[c1].m_key) ? c2 : c1;                               \
+        } else {                                                                                        \
+            for (child_index = first, i = first + 1; i < h->m_offset; i++) {                            \
+                if (before(hmm[i].m_key, hmm[child_index].m_key)) child_index = i;                      \
+            }                                                                                           \
+        }                                                                                               \
+        if (!(before(hmm[child_index].m_key, last.m_key))) break;                                       \
+        hmm[index] = hmm[child_index];                                                                  \
+        index = child_index;                                                                            \
+    }                                                                                                   \
+    if (index < h->m_offset) hmm[index] = last;                                                         \
+    return true;                                                                                        \
+}
+
+#endif
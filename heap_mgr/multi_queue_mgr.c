@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "multi_queue_mgr.h"
+
+#define MY_PRINT(format, ...) printf(format"\n", ##__VA_ARGS__)
+#define MULTI_QUEUE_MGR_TRACE_LOG MY_PRINT
+#define MULTI_QUEUE_MGR_ERROR_LOG MY_PRINT
+
+static __thread uint64_t t_seed = 0; /* 每个线程自己的随机数状态 */
+
+/* @func:
+ *  xorshift随机数，不用rand()是因为它内部有锁
+ */
+static size_t _multi_queue_mgr_rand(size_t max)
+{
+    if (!t_seed) t_seed = (uintptr_t)&t_seed * 0x9e3779b97f4a7c15ULL | 1;
+    t_seed ^= t_seed << 13;
+    t_seed ^= t_seed >> 7;
+    t_seed ^= t_seed << 17;
+    return t_seed % max;
+}
+
+/* @func:
+ *  创建，queue_cnt一般取线程数的2倍，choice至少为2
+ */
+multi_queue_mgr_t* multi_queue_mgr_new(size_t queue_cnt, size_t choice, HEAP_MEMBER_COMPARE_T compare)
+{
+    if (!queue_cnt || !compare) return NULL;
+    multi_queue_mgr_t *mq = NULL;
+    size_t i = 0;
+
+    if (!(mq = calloc(1, sizeof(multi_queue_mgr_t)))) {
+        MULTI_QUEUE_MGR_ERROR_LOG("calloc error, errno: %d - %s", errno, strerror(errno));
+        return NULL;
+    }
+    if (!(mq->m_queue = calloc(queue_cnt, sizeof(multi_queue_mgr_queue_t)))) {
+        MULTI_QUEUE_MGR_ERROR_LOG("calloc error, errno: %d - %s", errno, strerror(errno));
+        goto err;
+    }
+    for (mq->m_queue_cnt = 0; mq->m_queue_cnt < queue_cnt; mq->m_queue_cnt++) {
+        if (!(mq->m_queue[mq->m_queue_cnt].m_heap = heap_mgr_unlocked_new(0, compare))) goto err;
+        pthread_mutex_init(&mq->m_queue[mq->m_queue_cnt].m_lock, NULL);
+    }
+    mq->m_choice = choice < 2 ? 2 : choice;
+    return mq;
+
+err:
+    for (i = 0; mq->m_queue && i < mq->m_queue_cnt; i++) {
+        heap_mgr_free(mq->m_queue[i].m_heap);
+        pthread_mutex_destroy(&mq->m_queue[i].m_lock);
+    }
+    free(mq->m_queue);
+    free(mq);
+    return NULL;
+}
+
+/* @func:
+ *  销毁，不释放ptr指向的内存
+ * @warn:
+ *  非线程安全
+ */
+void multi_queue_mgr_free(multi_queue_mgr_t *mq)
+{
+    if (!mq) return ;
+    size_t i = 0;
+
+    for (i = 0; i < mq->m_queue_cnt; i++) {
+        heap_mgr_free(mq->m_queue[i].m_heap);
+        pthread_mutex_destroy(&mq->m_queue[i].m_lock);
+    }
+    free(mq->m_queue);
+    free(mq);
+}
+
+/* @func:
+ *  添加一个节点，随机选一个抢得到锁的队列，都抢不到时阻塞在最后选的队列上
+ */
+bool multi_queue_mgr_member_add(multi_queue_mgr_t *mq, void *ptr)
+{
+    if (!mq || !ptr) return false;
+    multi_queue_mgr_queue_t *queue = NULL;
+    size_t i = 0;
+    bool ret = false;
+
+    for (i = 0; i < mq->m_queue_cnt; i++) {
+        queue = &mq->m_queue[_multi_queue_mgr_rand(mq->m_queue_cnt)];
+        if (!pthread_mutex_trylock(&queue->m_lock)) break;
+    }
+    if (i == mq->m_queue_cnt) pthread_mutex_lock(&queue->m_lock);
+    if ((ret = heap_mgr_member_add(queue->m_heap, ptr))) __atomic_add_fetch(&mq->m_size, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&queue->m_lock);
+    return ret;
+}
+
+/* @func:
+ *  在随机的m_choice个队列中选堆顶最优先的，选中的队列持有锁
+ *  抢不到锁或者为空的队列直接跳过，同一个队列被选两次时第二次trylock失败，也跳过
+ */
+static multi_queue_mgr_queue_t* _multi_queue_mgr_choose(multi_queue_mgr_t *mq)
+{
+    multi_queue_mgr_queue_t *queue = NULL, *best = NULL;
+    void *top = NULL, *best_top = NULL;
+    size_t i = 0;
+
+    for (i = 0; i < mq->m_choice; i++) {
+        queue = &mq->m_queue[_multi_queue_mgr_rand(mq->m_queue_cnt)];
+        if (pthread_mutex_trylock(&queue->m_lock)) continue;
+        if ((top = heap_mgr_member_top(queue->m_heap)) && (!best || queue->m_heap->m_compare(top, best_top))) {
+            if (best) pthread_mutex_unlock(&best->m_lock);
+            best = queue, best_top = top;
+        } else pthread_mutex_unlock(&queue->m_lock);
+    }
+    return best;
+}
+
+/* @func:
+ *  删除一个优先级靠前的节点，所有队列都为空时返回NULL
+ *  随机选m_queue_cnt轮都没选到时，按顺序阻塞地找一个非空的队列，保证不会漏掉节点
+ */
+void* multi_queue_mgr_member_del(multi_queue_mgr_t *mq)
+{
+    if (!mq) return NULL;
+    multi_queue_mgr_queue_t *queue = NULL;
+    void *ptr = NULL;
+    size_t i = 0;
+
+    for (i = 0; i < mq->m_queue_cnt && __atomic_load_n(&mq->m_size, __ATOMIC_RELAXED); i++) {
+        if ((queue = _multi_queue_mgr_choose(mq))) goto out;
+    }
+    for (i = 0; i < mq->m_queue_cnt && __atomic_load_n(&mq->m_size, __ATOMIC_RELAXED); i++) {
+        queue = &mq->m_queue[i];
+        pthread_mutex_lock(&queue->m_lock);
+        if (!heap_mgr_is_empty(queue->m_heap)) goto out;
+        pthread_mutex_unlock(&queue->m_lock);
+    }
+    return NULL;
+
+out:
+    ptr = heap_mgr_member_del(queue->m_heap);
+    __atomic_sub_fetch(&mq->m_size, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&queue->m_lock);
+    return ptr;
+}
+
+/* @func:
+ *  判断是否为空
+ */
+bool multi_queue_mgr_is_empty(multi_queue_mgr_t *mq)
+{
+    return !mq || !__atomic_load_n(&mq->m_size, __ATOMIC_RELAXED);
+}
+
+/* @func:
+ *  打印管理器
+ */
+void multi_queue_mgr_dump(multi_queue_mgr_t *mq)
+{
+    if (!mq) return ;
+    size_t i = 0;
+
+    MULTI_QUEUE_MGR_TRACE_LOG("===========");
+    MULTI_QUEUE_MGR_TRACE_LOG("queue_cnt: %lu", mq->m_queue_cnt);
+    MULTI_QUEUE_MGR_TRACE_LOG("choice: %lu", mq->m_choice);
+    MULTI_QUEUE_MGR_TRACE_LOG("size: %lu", __atomic_load_n(&mq->m_size, __ATOMIC_RELAXED));
+    for (i = 0; i < mq->m_queue_cnt; i++) {
+        pthread_mutex_lock(&mq->m_queue[i].m_lock);
+        MULTI_QUEUE_MGR_TRACE_LOG("queue %lu: %lu", i, heap_mgr_size(mq->m_queue[i].m_heap));
+        pthread_mutex_unlock(&mq->m_queue[i].m_lock);
+    }
+    MULTI_QUEUE_MGR_TRACE_LOG("===========");
+}
@@ -0,0 +1,63 @@
+#ifndef _MULTI_QUEUE_MGR_H_
+#define _MULTI_QUEUE_MGR_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "heap_mgr.h"
+
+#define MULTI_QUEUE_MGR_CACHE_LINE 64
+
+/* 一个队列，独占一个缓存行 */
+typedef struct _multi_queue_mgr_queue {
+    pthread_mutex_t m_lock; /* 删除时只用trylock抢，抢不到换一个队列 */
+    heap_mgr_t *m_heap; /* 不加锁的heap_mgr，只由m_lock保护 */
+    char m_pad[MULTI_QUEUE_MGR_CACHE_LINE - sizeof(pthread_mutex_t) - sizeof(heap_mgr_t*)];
+} multi_queue_mgr_queue_t;
+
+/* 多个heap_mgr组成的并发优先队列，添加时随机放入一个队列，
+ * 删除时随机看m_choice个队列，弹出其中堆顶最优先的那个；
+ * 弹出的不一定是全局最优先的节点，队列越多吞吐越高、顺序越松，m_choice越大越接近严格顺序，
+ * 只有一个队列时就是严格的优先队列
+ * 使用前先调用heap_mgr_init */
+typedef struct _multi_queue_mgr {
+    size_t m_queue_cnt;
+    size_t m_choice;
+    size_t m_size; /* 所有队列的节点总数，原子操作 */
+    multi_queue_mgr_queue_t *m_queue;
+} multi_queue_mgr_t;
+
+/* @func:
+ *  创建，queue_cnt一般取线程数的2倍，choice至少为2
+ */
+multi_queue_mgr_t* multi_queue_mgr_new(size_t queue_cnt, size_t choice, HEAP_MEMBER_COMPARE_T compare);
+
+/* @func:
+ *  销毁，不释放ptr指向的内存
+ * @warn:
+ *  非线程安全
+ */
+void multi_queue_mgr_free(multi_queue_mgr_t *mq);
+
+/* @func:
+ *  添加一个节点
+ */
+bool multi_queue_mgr_member_add(multi_queue_mgr_t *mq, void *ptr);
+
+/* @func:
+ *  删除一个优先级靠前的节点，所有队列都为空时返回NULL
+ */
+void* multi_queue_mgr_member_del(multi_queue_mgr_t *mq);
+
+/* @func:
+ *  判断是否为空
+ */
+bool multi_queue_mgr_is_empty(multi_queue_mgr_t *mq);
+
+/* @func:
+ *  打印管理器
+ */
+void multi_queue_mgr_dump(multi_queue_mgr_t *mq);
+
+#endif
@@ -1,8 +1,12 @@
+#include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,7 +14,10 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sched.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include "log_mgr.h"
 
@@ -21,14 +28,92 @@
 #define LOG_MGR_WARN_LOG MY_PRINTF
 #define LOG_MGR_ERROR_LOG MY_PRINTF
 
+#define LOG_MGR_LINE_MAX 4096 /* 一条日志的最大长度 */
+#define LOG_MGR_IOV_MAX 64    /* 后台线程一次writev的最大块数 */
+#define LOG_MGR_CACHE_LINE 64
+
+/* 异步模式下每个线程的环形缓冲区，线程写入，后台线程读取
+ * 缓冲区中只保存完整的日志行
+ */
+typedef struct _log_mgr_ring {
+  struct _log_mgr_ring *m_next;
+  char *m_buf;
+  size_t m_size; /* 2的幂 */
+  int m_is_dead; /* 线程已经退出，读完后释放 */
+  size_t m_head __attribute__((aligned(LOG_MGR_CACHE_LINE))); /* 线程修改 */
+  size_t m_tail __attribute__((aligned(LOG_MGR_CACHE_LINE))); /* 后台线程修改 */
+} log_mgr_ring_t;
+
+/* 设置过级别的模块，只增加不释放，调用点会一直引用其中的m_mask */
+typedef struct _log_mgr_module {
+  struct _log_mgr_module *m_next;
+  unsigned char m_mask;
+  bool m_is_set; /* 取消后调用点改回使用全局级别 */
+  char m_name[];
+} log_mgr_module_t;
+
+/* 等待压缩的历史文件 */
+typedef struct _log_mgr_compress {
+  struct _log_mgr_compress *m_next;
+  bool m_is_prune; /* 压缩后清理多余的用时间命名的历史文件 */
+  bool m_is_shift; /* 序号命名时先把历史文件后移，再压缩成.1.gz */
+  char m_path[];
+} log_mgr_compress_t;
+
 log_mgr_t g_lm = {
     .m_path = {0},
     .m_rotate_size = 1024 * 1024,
+    .m_rotate_keep = 5,
+    .m_rotate_period = LOG_MGR_ROTATE_NONE,
+    .m_is_rotate_ts = false,
+    .m_is_compress = false,
     .m_log_mask = 63,
     .m_is_stdout = true,
+    .m_is_async = false,
+    .m_is_block = false,
+    .m_ring_size = 256 * 1024,
+    .m_flush_ms = 100,
+    .m_drop_count = 0,
+    .m_ts_precision = 0,
+    .m_level_gen = 1, /* 调用点的m_gen初始为0，第一次调用时查找级别 */
     .m_mutex = PTHREAD_MUTEX_INITIALIZER,
 };
 
+static __thread log_mgr_ring_t *tl_ring = NULL;
+static __thread char tl_rec[LOG_MGR_LINE_MAX]; /* 格式化日志使用的缓冲区 */
+static __thread struct {
+  time_t m_sec;
+  size_t m_len;
+  char m_buf[32];
+} tl_ts; /* 缓存的时间戳，精确到秒 */
+static log_mgr_ring_t *g_rings = NULL; /* 所有线程的环形缓冲区 */
+static pthread_mutex_t g_ring_mutex = PTHREAD_MUTEX_INITIALIZER; /* 保护g_rings */
+static pthread_key_t g_ring_key;
+static pthread_once_t g_ring_once = PTHREAD_ONCE_INIT;
+static pthread_t g_writer;
+static bool g_is_running = false;
+static int g_fd = -1;
+static size_t g_file_size = 0; /* 当前文件的大小，每次写入时原子累加，注册调用点的线程也会写入 */
+static time_t g_open_time = 0;  /* 当前文件开始写入的时间 */
+static time_t g_rotate_at = 0;  /* 按时间轮转的时间点，0表示不按时间轮转 */
+static pthread_mutex_t g_cond_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_cond = PTHREAD_COND_INITIALIZER;
+static bool g_is_binary = false;
+static log_mgr_fmt_t **g_fmts = NULL; /* 二进制模式下已经分配编号的调用点，下标加1是编号 */
+static unsigned int g_fmt_cnt = 0;
+static unsigned int g_fmt_max = 0;
+static log_mgr_module_t *g_modules = NULL;
+static pthread_mutex_t g_module_mutex = PTHREAD_MUTEX_INITIALIZER;
+static log_mgr_compress_t *g_compress_head = NULL;
+static log_mgr_compress_t **g_compress_tail = &g_compress_head;
+static size_t g_compress_pending = 0; /* 队列中和正在压缩的文件个数 */
+static bool g_compress_ok = false;    /* 压缩线程已经启动 */
+static unsigned int g_rotate_seq = 0; /* 交给压缩线程的文件的私有序号 */
+static pthread_once_t g_compress_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t g_compress_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_compress_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_compress_idle = PTHREAD_COND_INITIALIZER;
+
 static bool _is_dir_exsit(const char *dir) {
   if (!dir)
     return false;
@@ -92,146 +177,1696 @@ static char _level_char_get(unsigned char level) {
 }
 
 /* @func:
- *  获取日志管理节点
+ *  复制字符串，不超过end
  */
-log_mgr_t *log_mgr(void) { return &g_lm; }
+static inline char *_log_mgr_puts(char *ptr, const char *end, const char *str,
+                                  size_t len) {
+  if (len > (size_t)(end - ptr))
+    len = end - ptr;
+  memcpy(ptr, str, len);
+  return ptr + len;
+}
 
 /* @func:
- * 	初始化日志管理器
+ *  输出十进制整数，不超过end
  */
-void log_mgr_init(void) {
-  char path[PATH_MAX] = {0};
-  char *ptr = NULL;
-  size_t len = 0;
+static char *_log_mgr_putd(char *ptr, const char *end, int num) {
+  char tmp[16];
+  size_t i = sizeof(tmp);
+  unsigned int n = num < 0 ? -(unsigned int)num : (unsigned int)num;
 
-  if (g_lm.m_path[0] != '\0') {
-    if (ptr = strrchr(g_lm.m_path, '/'), ptr) {
-      len = (size_t)(ptr - g_lm.m_path);
-      memcpy(path, g_lm.m_path, len);
-    }
+  do {
+    tmp[--i] = '0' + n % 10;
+    n /= 10;
+  } while (n);
+  if (num < 0)
+    tmp[--i] = '-';
+  return _log_mgr_puts(ptr, end, tmp + i, sizeof(tmp) - i);
+}
 
-    if (!_is_dir_exsit(path))
-      _create_dir(path, 0755);
+/* @func:
+ *  输出时间戳，秒的部分每个线程缓存，只在秒变化时重新生成
+ */
+static char *_log_mgr_put_time(char *ptr, const char *end) {
+  struct timespec ts;
+  struct tm ltm;
+  long frac = 0;
+  int i = 0, precision = g_lm.m_ts_precision;
 
-  } else {
-    g_lm.m_is_stdout = true;
+  clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+  if (ts.tv_sec != tl_ts.m_sec || !tl_ts.m_len) {
+    localtime_r(&ts.tv_sec, &ltm);
+    tl_ts.m_len = strftime(tl_ts.m_buf, sizeof(tl_ts.m_buf), "%b %d %T", &ltm);
+    tl_ts.m_sec = ts.tv_sec;
   }
+  ptr = _log_mgr_puts(ptr, end, tl_ts.m_buf, tl_ts.m_len);
+
+  if (precision <= 0 || end - ptr < precision + 1)
+    return ptr;
+  if (precision > 9)
+    precision = 9;
+
+  for (frac = ts.tv_nsec, i = precision; i < 9; i++)
+    frac /= 10;
+  *ptr++ = '.';
+  for (i = precision - 1; i >= 0; i--, frac /= 10)
+    ptr[i] = '0' + frac % 10;
+  return ptr + precision;
 }
 
 /* @func:
- *	写日志文件
+ *  直接在buf中格式化一条日志，保证以换行结尾，返回长度
  */
-void log_mgr_do(unsigned char level, const char *file, const char *func,
-                int line, const char *format, ...) {
-  if (!(level & g_lm.m_log_mask))
+static size_t _log_mgr_format(char *buf, size_t size, unsigned char level,
+                              const char *file, const char *func, int line,
+                              const char *format, va_list vl) {
+  char *ptr = buf, *end = buf + size - 2; /* 留出换行和'\0' */
+  int ret = 0;
+
+  ptr = _log_mgr_puts(ptr, end, "[", 1);
+  if (ptr < end)
+    *ptr++ = _level_char_get(level);
+  ptr = _log_mgr_puts(ptr, end, "] [", 3);
+  ptr = _log_mgr_put_time(ptr, end);
+  ptr = _log_mgr_puts(ptr, end, "] [", 3);
+  ptr = _log_mgr_puts(ptr, end, file, strlen(file));
+  ptr = _log_mgr_puts(ptr, end, "] [", 3);
+  ptr = _log_mgr_puts(ptr, end, func, strlen(func));
+  ptr = _log_mgr_puts(ptr, end, ":", 1);
+  ptr = _log_mgr_putd(ptr, end, line);
+  ptr = _log_mgr_puts(ptr, end, "]: ", 3);
+
+  ret = vsnprintf(ptr, end - ptr + 1, format, vl);
+  if (ret > 0)
+    ptr += (size_t)ret < (size_t)(end - ptr) ? (size_t)ret : (size_t)(end - ptr);
+  *ptr++ = '\n';
+  *ptr = '\0';
+  return ptr - buf;
+}
+
+/* @func:
+ *  线程退出时标记环形缓冲区，由后台线程释放
+ */
+static void _log_mgr_ring_exit(void *arg) {
+  log_mgr_ring_t *ring = arg;
+  __atomic_store_n(&ring->m_is_dead, 1, __ATOMIC_RELEASE);
+}
+
+static void _log_mgr_ring_key_init(void) {
+  pthread_key_create(&g_ring_key, _log_mgr_ring_exit);
+}
+
+/* @func:
+ *  创建当前线程的环形缓冲区
+ */
+static log_mgr_ring_t *_log_mgr_ring_new(void) {
+  log_mgr_ring_t *ring = NULL;
+  size_t size = LOG_MGR_LINE_MAX;
+
+  while (size < g_lm.m_ring_size)
+    size <<= 1;
+
+  if (posix_memalign((void **)&ring, LOG_MGR_CACHE_LINE, sizeof(*ring))) {
+    LOG_MGR_WARN_LOG("posix_memalign error");
+    return NULL;
+  }
+  memset(ring, 0, sizeof(*ring));
+  ring->m_size = size;
+  if (!(ring->m_buf = malloc(size))) {
+    LOG_MGR_WARN_LOG("malloc error, errno: %d - %s", errno, strerror(errno));
+    free(ring);
+    return NULL;
+  }
+
+  pthread_once(&g_ring_once, _log_mgr_ring_key_init);
+  pthread_setspecific(g_ring_key, ring);
+
+  pthread_mutex_lock(&g_ring_mutex);
+  ring->m_next = g_rings;
+  __atomic_store_n(&g_rings, ring, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&g_ring_mutex);
+  return ring;
+}
+
+static void _log_mgr_writer_wakeup(void) { pthread_cond_signal(&g_cond); }
+
+/* @func:
+ *  将一条日志写入当前线程的环形缓冲区，不加锁
+ */
+static void _log_mgr_ring_put(const char *rec, size_t len) {
+  log_mgr_ring_t *ring = tl_ring;
+  size_t head = 0, tail = 0, pos = 0, first = 0;
+
+  if (!ring && !(ring = tl_ring = _log_mgr_ring_new())) {
+    __sync_fetch_and_add(&g_lm.m_drop_count, 1);
     return;
-  time_t nt = 0;
-  struct tm ltm;
-  char buf[64] = {0};
-  FILE *fp = NULL;
-  struct stat st;
-  va_list vl;
-  char level_c = 0;
+  }
+
+  head = ring->m_head;
+  for (;;) {
+    tail = __atomic_load_n(&ring->m_tail, __ATOMIC_ACQUIRE);
+    if (ring->m_size - (head - tail) >= len)
+      break;
+    if (!g_lm.m_is_block) {
+      __sync_fetch_and_add(&g_lm.m_drop_count, 1);
+      return;
+    }
+    _log_mgr_writer_wakeup();
+    sched_yield();
+  }
 
-  level_c = _level_char_get(level);
+  pos = head & (ring->m_size - 1);
+  first = ring->m_size - pos < len ? ring->m_size - pos : len;
+  memcpy(ring->m_buf + pos, rec, first);
+  memcpy(ring->m_buf, rec + first, len - first);
+  __atomic_store_n(&ring->m_head, head + len, __ATOMIC_RELEASE);
 
-  pthread_mutex_lock(&g_lm.m_mutex);
-  nt = time((time_t *)NULL);
-  localtime_r(&nt, &ltm);
+  /* 超过一半时提前唤醒后台线程 */
+  if ((head + len - tail) * 2 >= ring->m_size)
+    _log_mgr_writer_wakeup();
+}
 
-  strftime(buf, sizeof(buf), "%b %d %T", &ltm);
-  if (g_lm.m_is_stdout)
-    fp = stdout;
-  else {
-    if (lstat(g_lm.m_path, &st) == -1) {
-      // LOG_MGR_WARN_LOG("lstat %s error, errno: %d - %s", g_lm.m_path,
-      // errno,
-      // strerror(errno));
-      st.st_size = 0;
+/* @func:
+ *  写入全部数据
+ */
+static bool _log_mgr_writev_all(int fd, struct iovec *iov, int cnt) {
+  ssize_t byte = 0;
+
+  while (cnt > 0) {
+    if ((byte = writev(fd, iov, cnt)) < 0) {
+      if (errno == EINTR)
+        continue;
+      LOG_MGR_WARN_LOG("writev error, errno: %d - %s", errno, strerror(errno));
+      return false;
     }
 
-    if (g_lm.m_rotate_size > (size_t)st.st_size)
-      fp = fopen(g_lm.m_path, "ab+");
-    else
-      fp = fopen(g_lm.m_path, "wb");
+    while (cnt > 0 && (size_t)byte >= iov->iov_len) {
+      byte -= iov->iov_len;
+      iov++, cnt--;
+    }
+    if (cnt > 0) {
+      iov->iov_base = (char *)iov->iov_base + byte;
+      iov->iov_len -= byte;
+    }
+  }
+  return true;
+}
 
-    if (!fp) {
-      LOG_MGR_WARN_LOG("fopen %s error, errno: %d - %s", g_lm.m_path, errno,
-                       strerror(errno));
-      goto err;
+/* @func:
+ *  写入全部数据
+ */
+static bool _log_mgr_write_all(int fd, const void *buf, size_t len) {
+  struct iovec iov = {(void *)buf, len};
+  return _log_mgr_writev_all(fd, &iov, 1);
+}
+
+/* @func:
+ *  解析格式串得到参数类型
+ */
+static bool _log_mgr_fmt_parse(log_mgr_fmt_t *fmt) {
+  const char *ptr = fmt->m_format;
+  unsigned char type = 0;
+  int length = 0; /* 0: int, 1: long, 2: long double */
+
+#define _ARG_ADD(t)                                                            \
+  do {                                                                         \
+    if (fmt->m_arg_cnt >= LOG_MGR_ARG_MAX)                                     \
+      return false;                                                            \
+    fmt->m_arg_type[fmt->m_arg_cnt++] = (t);                                   \
+  } while (0)
+
+  fmt->m_arg_cnt = 0;
+  while ((ptr = strchr(ptr, '%'))) {
+    if (*++ptr == '%' || *ptr == 'm') {
+      ptr++;
+      continue;
+    }
+
+    while (*ptr && strchr("-+ #0'", *ptr))
+      ptr++;
+    if (*ptr == '*') {
+      _ARG_ADD(LOG_MGR_ARG_INT);
+      ptr++;
+    }
+    while (*ptr >= '0' && *ptr <= '9')
+      ptr++;
+    if (*ptr == '.') {
+      if (*++ptr == '*') {
+        _ARG_ADD(LOG_MGR_ARG_INT);
+        ptr++;
+      }
+      while (*ptr >= '0' && *ptr <= '9')
+        ptr++;
+    }
+
+    for (length = 0; *ptr && strchr("hlLqjzt", *ptr); ptr++) {
+      if (*ptr == 'L')
+        length = 2;
+      else if (*ptr != 'h')
+        length = 1;
+    }
+
+    switch (*ptr) {
+    case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+      type = length ? LOG_MGR_ARG_LONG : LOG_MGR_ARG_INT;
+      break;
+    case 'c':
+      type = LOG_MGR_ARG_INT;
+      break;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+      type = length == 2 ? LOG_MGR_ARG_LDOUBLE : LOG_MGR_ARG_DOUBLE;
+      break;
+    case 's':
+      type = length ? LOG_MGR_ARG_PTR : LOG_MGR_ARG_STR;
+      break;
+    case 'p': case 'n':
+      type = LOG_MGR_ARG_PTR;
+      break;
+    default:
+      return false;
     }
+    _ARG_ADD(type);
+    ptr++;
   }
+#undef _ARG_ADD
+  return true;
+}
 
-  va_start(vl, format);
-  /* fprintf(fp, "[%c] [%s] [%s] [%s:%d]: ", level_c, buf, __FILE__,
-   * __FUNCTION__, __LINE__); */
-  fprintf(fp, "[%c] [%s] [%s] [%s:%d]: ", level_c, buf, file, func, line);
-  vfprintf(fp, format, vl);
-  fprintf(fp, "\n");
-  fflush(fp);
-  va_end(vl);
-  if (!g_lm.m_is_stdout)
-    fclose(fp);
+/* @func:
+ *  生成格式串的定义记录
+ */
+static size_t _log_mgr_bin_def(char *buf, const log_mgr_fmt_t *fmt,
+                               unsigned int id) {
+  char *ptr = buf;
+  const char *str[3] = {fmt->m_file, fmt->m_func, fmt->m_format};
+  uint16_t len = 0;
+  int i = 0;
+
+  *ptr++ = LOG_MGR_BIN_DEF;
+  memcpy(ptr, &id, sizeof(id)), ptr += sizeof(id);
+  *ptr++ = fmt->m_level;
+  memcpy(ptr, &fmt->m_line, sizeof(fmt->m_line)), ptr += sizeof(fmt->m_line);
+  *ptr++ = fmt->m_arg_cnt;
+  memcpy(ptr, fmt->m_arg_type, fmt->m_arg_cnt), ptr += fmt->m_arg_cnt;
+  for (i = 0; i < 3; i++) {
+    len = strnlen(str[i], (LOG_MGR_LINE_MAX - 64) / 3);
+    memcpy(ptr, &len, sizeof(len)), ptr += sizeof(len);
+    memcpy(ptr, str[i], len), ptr += len;
+  }
+  return ptr - buf;
+}
+
+/* @func:
+ *  写入文件头和全部格式串的定义，调用者持有g_lm.m_mutex，返回写入的字节数
+ */
+static size_t _log_mgr_bin_head(int fd) {
+  char buf[LOG_MGR_LINE_MAX];
+  unsigned int magic = LOG_MGR_BIN_MAGIC, i = 0;
+  size_t len = 0, total = 0;
+
+  buf[0] = LOG_MGR_BIN_HEAD;
+  memcpy(buf + 1, &magic, sizeof(magic));
+  _log_mgr_write_all(fd, buf, total = 1 + sizeof(magic));
+  for (i = 0; i < g_fmt_cnt; i++) {
+    _log_mgr_write_all(fd, buf, len = _log_mgr_bin_def(buf, g_fmts[i], i + 1));
+    total += len;
+  }
+  return total;
+}
+
+/* @func:
+ *  为调用点分配编号，定义记录直接写入文件，保证在使用这个编号的日志之前
+ */
+static bool _log_mgr_bin_register(log_mgr_fmt_t *fmt) {
+  char buf[LOG_MGR_LINE_MAX];
+  log_mgr_fmt_t **fmts = NULL;
+  size_t len = 0;
+  bool ret = false;
+
+  pthread_mutex_lock(&g_lm.m_mutex);
+  if (fmt->m_id) {
+    ret = true;
+    goto out;
+  }
+
+  if (!_log_mgr_fmt_parse(fmt)) {
+    LOG_MGR_WARN_LOG("unsupported format: %s", fmt->m_format);
+    goto out;
+  }
+
+  if (g_fmt_cnt >= g_fmt_max) {
+    if (!(fmts = realloc(g_fmts, sizeof(*fmts) * (g_fmt_max * 2 + 64))))
+      goto out;
+    g_fmts = fmts, g_fmt_max = g_fmt_max * 2 + 64;
+  }
+  g_fmts[g_fmt_cnt++] = fmt;
+
+  /* 定义记录和日志一样计入文件大小，否则轮转会推迟 */
+  len = _log_mgr_bin_def(buf, fmt, g_fmt_cnt);
+  if (g_fd >= 0 && _log_mgr_write_all(g_fd, buf, len))
+    __atomic_add_fetch(&g_file_size, len, __ATOMIC_RELAXED);
+  __atomic_store_n(&fmt->m_id, g_fmt_cnt, __ATOMIC_RELEASE);
+  ret = true;
 
-err:
+out:
   pthread_mutex_unlock(&g_lm.m_mutex);
+  return ret;
 }
 
 /* @func:
- *		打印调试日志信息
+ *  二进制模式下只记录编号，时间和原始参数
  */
-void log_mgr_dump(void) {
-  LOG_MGR_TRACE_LOG("==================");
-  LOG_MGR_TRACE_LOG("path: %s", g_lm.m_path);
-  LOG_MGR_TRACE_LOG("rotate_size: %lu", g_lm.m_rotate_size);
-  ;
-  LOG_MGR_TRACE_LOG("log_mask: %u", g_lm.m_log_mask);
-  LOG_MGR_TRACE_LOG("is_stdout: %d", g_lm.m_is_stdout);
-  LOG_MGR_TRACE_LOG("==================");
+static void _log_mgr_bin_vdo(log_mgr_fmt_t *fmt, va_list vl) {
+  char *ptr = tl_rec, *args = NULL, *end = tl_rec + sizeof(tl_rec);
+  unsigned int id = __atomic_load_n(&fmt->m_id, __ATOMIC_ACQUIRE);
+  struct timespec ts;
+  uint64_t ns = 0;
+  uint16_t len = 0;
+  const char *str = NULL;
+  size_t reserve = 0;
+  int i = 0;
+
+  if (!id) {
+    if (!_log_mgr_bin_register(fmt))
+      return;
+    id = fmt->m_id;
+  }
+
+  clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+  ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+  *ptr++ = LOG_MGR_BIN_LOG;
+  memcpy(ptr, &id, sizeof(id)), ptr += sizeof(id);
+  memcpy(ptr, &ns, sizeof(ns)), ptr += sizeof(ns);
+  args = ptr += sizeof(len);
+
+#define _ARG_PUT(type)                                                         \
+  do {                                                                         \
+    type _v = va_arg(vl, type);                                                \
+    memcpy(ptr, &_v, sizeof(_v)), ptr += sizeof(_v);                           \
+  } while (0)
+
+  /* 固定长度的参数最多LOG_MGR_ARG_MAX * 16字节，不会越界 */
+  for (i = 0; i < fmt->m_arg_cnt; i++) {
+    switch (fmt->m_arg_type[i]) {
+    case LOG_MGR_ARG_INT:
+      _ARG_PUT(int);
+      break;
+    case LOG_MGR_ARG_LONG:
+      _ARG_PUT(long long);
+      break;
+    case LOG_MGR_ARG_DOUBLE:
+      _ARG_PUT(double);
+      break;
+    case LOG_MGR_ARG_LDOUBLE:
+      _ARG_PUT(long double);
+      break;
+    case LOG_MGR_ARG_PTR:
+      _ARG_PUT(void *);
+      break;
+    case LOG_MGR_ARG_STR:
+      if (!(str = va_arg(vl, const char *)))
+        str = "(null)";
+      /* 给后面的参数留出空间 */
+      reserve = (fmt->m_arg_cnt - i) * (sizeof(long double) + sizeof(len));
+      len = strnlen(str, end - ptr > (ptrdiff_t)reserve ? end - ptr - reserve
+                                                         : 0);
+      memcpy(ptr, &len, sizeof(len)), ptr += sizeof(len);
+      memcpy(ptr, str, len), ptr += len;
+      break;
+    }
+  }
+#undef _ARG_PUT
+
+  len = ptr - args;
+  memcpy(args - sizeof(len), &len, sizeof(len));
+  _log_mgr_ring_put(tl_rec, ptr - tl_rec);
 }
 
-#if 1
+/* @func:
+ *  计算base之后下一个整点或者零点，0表示不按时间轮转
+ */
+static time_t _log_mgr_rotate_at(time_t base) {
+  struct tm tm;
 
-#include <assert.h>
+  if (g_lm.m_rotate_period == LOG_MGR_ROTATE_NONE)
+    return 0;
+  localtime_r(&base, &tm);
+  tm.tm_min = tm.tm_sec = 0;
+  if (g_lm.m_rotate_period == LOG_MGR_ROTATE_DAILY)
+    tm.tm_hour = 0, tm.tm_mday++;
+  else
+    tm.tm_hour++;
+  tm.tm_isdst = -1;
+  return mktime(&tm);
+}
 
-int main() {
-  size_t i = 0;
-  size_t max_num = 10240;
-  pthread_t pt[10];
-  log_mgr_t *lm = log_mgr();
+/* @func:
+ *  打开日志文件，文件一直保持打开
+ */
+static int _log_mgr_file_open(void) {
+  struct stat st;
+  int fd = -1;
 
-  snprintf(lm->m_path, sizeof(lm->m_path), "%s", "/tmp/kk/test.dat");
-  lm->m_is_stdout = false;
-  lm->m_rotate_size = 1024 * 1024;
-  lm->m_log_mask = LOG_MGR_LV_WARN | LOG_MGR_LV_DEBUG;
+  if (g_lm.m_is_stdout)
+    return STDOUT_FILENO;
 
-  log_mgr_init();
-  log_mgr_dump();
+  if ((fd = open(g_lm.m_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                 0644)) < 0) {
+    LOG_MGR_WARN_LOG("open %s error, errno: %d - %s", g_lm.m_path, errno,
+                     strerror(errno));
+    return -1;
+  }
 
-  for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++) {
-    pthread_create(&pt[i], NULL, ({
-      void *_(void *arg) {
-        char *str = "hello";
-        size_t j = 0;
-        for (j = 0; j < max_num; j++) {
-          log_mgr_trace("%s:%d", str, j);
-          log_mgr_debug("%s:%d", str, j);
-          log_mgr_info("%s:%d", str, j);
-          log_mgr_warn("%s:%d", str, j);
-          log_mgr_error("%s:%d", str, j);
-          log_mgr_fatal("%s:%d", str, j);
-        }
-        return arg;
-      };
-      _;
-    }),
-                   NULL);
+  if (fstat(fd, &st))
+    st.st_size = 0;
+  __atomic_store_n(&g_file_size, st.st_size, __ATOMIC_RELAXED);
+  /* 文件里已经有上一个周期的日志时，第一次写入就会轮转 */
+  g_open_time = st.st_size > 0 ? st.st_mtime : time(NULL);
+  g_rotate_at = _log_mgr_rotate_at(g_open_time);
+  return fd;
+}
+
+/* @func:
+ *  是否需要轮转，只比较内存中的计数，不stat文件
+ */
+static inline bool _log_mgr_rotate_need(void) {
+  if (g_lm.m_is_stdout)
+    return false;
+  if (g_lm.m_rotate_size &&
+      __atomic_load_n(&g_file_size, __ATOMIC_RELAXED) >= g_lm.m_rotate_size)
+    return true;
+  return g_rotate_at && time(NULL) >= g_rotate_at;
+}
+
+static bool _log_mgr_path_exist(const char *path) {
+  char gz[PATH_MAX + 80];
+
+  snprintf(gz, sizeof(gz), "%s.gz", path);
+  return !access(path, F_OK) || !access(gz, F_OK);
+}
+
+/* @func:
+ *  将path压缩成to.gz，先写临时文件，成功后删除原文件
+ */
+static bool _log_mgr_gzip(const char *path, const char *to) {
+  char gz[PATH_MAX + 80], tmp[PATH_MAX + 80], buf[64 * 1024];
+  gzFile out = NULL;
+  ssize_t len = 0;
+  int fd = -1;
+
+  snprintf(gz, sizeof(gz), "%s.gz", to);
+  snprintf(tmp, sizeof(tmp), "%s.gz.tmp", to);
+  if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+    LOG_MGR_WARN_LOG("open %s error, errno: %d - %s", path, errno,
+                     strerror(errno));
+    return false;
+  }
+  if (!(out = gzopen(tmp, "wb6"))) {
+    LOG_MGR_WARN_LOG("gzopen %s error", tmp);
+    close(fd);
+    return false;
   }
 
-  for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++)
-    pthread_join(pt[i], NULL);
+  while ((len = read(fd, buf, sizeof(buf))) > 0)
+    if (gzwrite(out, buf, len) != len)
+      break;
+  close(fd);
 
-  MY_PRINTF("OK");
+  if (gzclose(out) != Z_OK || len != 0) {
+    LOG_MGR_WARN_LOG("gzip %s error", path);
+    unlink(tmp);
+    return false;
+  }
+  if (rename(tmp, gz)) {
+    unlink(tmp);
+    return false;
+  }
+  unlink(path);
+  return true;
+}
+
+typedef struct _log_mgr_rotated {
+  char *m_name;
+  struct timespec m_mtime;
+} log_mgr_rotated_t;
+
+static int _log_mgr_rotated_cmp(const void *a, const void *b) {
+  const log_mgr_rotated_t *x = a, *y = b;
+
+  if (x->m_mtime.tv_sec != y->m_mtime.tv_sec)
+    return x->m_mtime.tv_sec < y->m_mtime.tv_sec ? -1 : 1;
+  if (x->m_mtime.tv_nsec != y->m_mtime.tv_nsec)
+    return x->m_mtime.tv_nsec < y->m_mtime.tv_nsec ? -1 : 1;
+  return strcmp(x->m_name, y->m_name);
+}
+
+/* @func:
+ *  删除多余的用时间命名的历史文件，按修改时间保留最新的m_rotate_keep个
+ *  同一秒内轮转的文件名带序号，不能按名字排序
+ */
+static void _log_mgr_rotate_prune(void) {
+  char dir[PATH_MAX] = ".", path[PATH_MAX * 2];
+  const char *base = g_lm.m_path, *ptr = NULL;
+  log_mgr_rotated_t *files = NULL, *tmp = NULL;
+  size_t cnt = 0, max = 0, len = 0, i = 0;
+  struct dirent *ent = NULL;
+  struct stat st;
+  DIR *dp = NULL;
+
+  if ((ptr = strrchr(g_lm.m_path, '/'))) {
+    len = ptr - g_lm.m_path;
+    snprintf(dir, sizeof(dir), "%.*s", len ? (int)len : 1, g_lm.m_path);
+    base = ptr + 1;
+  }
+  len = strlen(base);
+
+  if (!(dp = opendir(dir))) {
+    LOG_MGR_WARN_LOG("opendir %s error, errno: %d - %s", dir, errno,
+                     strerror(errno));
+    return;
+  }
+  /* base.YYYYmmdd-HHMMSS[-N][.gz] */
+  while ((ent = readdir(dp))) {
+    if (strncmp(ent->d_name, base, len) || ent->d_name[len] != '.' ||
+        strlen(ent->d_name) < len + 16 || !isdigit(ent->d_name[len + 1]) ||
+        ent->d_name[len + 9] != '-')
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+    if (stat(path, &st))
+      continue;
+    if (cnt == max) {
+      if (!(tmp = realloc(files, sizeof(*files) * (max = max * 2 + 16))))
+        break;
+      files = tmp;
+    }
+    if (!(files[cnt].m_name = strdup(ent->d_name)))
+      break;
+    files[cnt++].m_mtime = st.st_mtim;
+  }
+  closedir(dp);
+
+  if (cnt > g_lm.m_rotate_keep) {
+    qsort(files, cnt, sizeof(*files), _log_mgr_rotated_cmp);
+    for (i = 0; i < cnt - g_lm.m_rotate_keep; i++) {
+      snprintf(path, sizeof(path), "%s/%s", dir, files[i].m_name);
+      unlink(path);
+    }
+  }
+  for (i = 0; i < cnt; i++)
+    free(files[i].m_name);
+  free(files);
+}
+
+/* @func:
+ *  序号命名的历史文件整体后移一位，超过保留个数的删除，再把from改名成.1
+ *  is_compress时压缩成.1.gz，压缩失败时保持不压缩
+ */
+static void _log_mgr_rotate_shift(const char *from, bool is_compress) {
+  char src[PATH_MAX + 80], dst[PATH_MAX + 80];
+  const char *gz[] = {"", ".gz"};
+  unsigned int i = 0, j = 0;
+
+  for (j = 0; j < sizeof(gz) / sizeof(gz[0]); j++) {
+    snprintf(dst, sizeof(dst), "%s.%u%s", g_lm.m_path, g_lm.m_rotate_keep,
+             gz[j]);
+    unlink(dst);
+  }
+  for (i = g_lm.m_rotate_keep; i > 1; i--) {
+    for (j = 0; j < sizeof(gz) / sizeof(gz[0]); j++) {
+      snprintf(src, sizeof(src), "%s.%u%s", g_lm.m_path, i - 1, gz[j]);
+      snprintf(dst, sizeof(dst), "%s.%u%s", g_lm.m_path, i, gz[j]);
+      rename(src, dst);
+    }
+  }
+  snprintf(dst, sizeof(dst), "%s.1", g_lm.m_path);
+  if (!is_compress || !_log_mgr_gzip(from, dst))
+    rename(from, dst);
+}
+
+/* @func:
+ *  压缩线程，按轮转的顺序逐个处理
+ */
+static void *_log_mgr_compressor(void *arg) {
+  log_mgr_compress_t *cur = NULL;
+
+  for (;;) {
+    pthread_mutex_lock(&g_compress_mutex);
+    while (!g_compress_head)
+      pthread_cond_wait(&g_compress_cond, &g_compress_mutex);
+    cur = g_compress_head;
+    if (!(g_compress_head = cur->m_next))
+      g_compress_tail = &g_compress_head;
+    pthread_mutex_unlock(&g_compress_mutex);
+
+    if (cur->m_is_shift)
+      _log_mgr_rotate_shift(cur->m_path, true);
+    else
+      _log_mgr_gzip(cur->m_path, cur->m_path);
+    if (cur->m_is_prune)
+      _log_mgr_rotate_prune();
+    free(cur);
+
+    pthread_mutex_lock(&g_compress_mutex);
+    if (!--g_compress_pending)
+      pthread_cond_broadcast(&g_compress_idle);
+    pthread_mutex_unlock(&g_compress_mutex);
+  }
+  return arg;
+}
+
+static void _log_mgr_compressor_init(void) {
+  pthread_t tid;
+
+  if (pthread_create(&tid, NULL, _log_mgr_compressor, NULL)) {
+    LOG_MGR_WARN_LOG("pthread_create error, errno: %d - %s", errno,
+                     strerror(errno));
+    return;
+  }
+  pthread_detach(tid);
+  g_compress_ok = true;
+}
+
+/* @func:
+ *  交给压缩线程，返回false时文件保持不压缩
+ */
+static bool _log_mgr_compress_put(const char *path, bool is_prune,
+                                  bool is_shift) {
+  log_mgr_compress_t *cur = NULL;
+  size_t len = strlen(path);
+
+  pthread_once(&g_compress_once, _log_mgr_compressor_init);
+  if (!g_compress_ok || !(cur = malloc(sizeof(*cur) + len + 1)))
+    return false;
+  cur->m_next = NULL;
+  cur->m_is_prune = is_prune;
+  cur->m_is_shift = is_shift;
+  memcpy(cur->m_path, path, len + 1);
+
+  pthread_mutex_lock(&g_compress_mutex);
+  *g_compress_tail = cur;
+  g_compress_tail = &cur->m_next;
+  g_compress_pending++;
+  pthread_cond_signal(&g_compress_cond);
+  pthread_mutex_unlock(&g_compress_mutex);
+  return true;
+}
+
+/* @func:
+ *  等待所有历史文件压缩完成
+ */
+static void _log_mgr_compress_wait(void) {
+  pthread_mutex_lock(&g_compress_mutex);
+  while (g_compress_pending)
+    pthread_cond_wait(&g_compress_idle, &g_compress_mutex);
+  pthread_mutex_unlock(&g_compress_mutex);
+}
+
+/* @func:
+ *  关闭当前文件，改名成历史文件后重新打开
+ *  同步模式下调用者持有m_mutex，异步模式下只在后台线程中调用
+ */
+static void _log_mgr_rotate(void) {
+  char to[PATH_MAX + 80];
+  struct tm tm;
+  unsigned int i = 0;
+  size_t len = 0;
+
+  close(g_fd);
+  g_fd = -1;
+
+  if (!g_lm.m_rotate_keep) {
+    unlink(g_lm.m_path);
+  } else if (g_lm.m_is_rotate_ts) {
+    localtime_r(&g_open_time, &tm);
+    len = snprintf(to, sizeof(to), "%s.", g_lm.m_path);
+    len += strftime(to + len, sizeof(to) - len, "%Y%m%d-%H%M%S", &tm);
+    for (i = 1; _log_mgr_path_exist(to); i++)
+      snprintf(to + len, sizeof(to) - len, "-%u", i);
+    rename(g_lm.m_path, to);
+    if (!g_lm.m_is_compress || !_log_mgr_compress_put(to, true, false))
+      _log_mgr_rotate_prune();
+  } else if (!g_lm.m_is_compress) {
+    _log_mgr_rotate_shift(g_lm.m_path, false);
+  } else {
+    /* 先改成私有的名字，序号后移和压缩都在压缩线程中按顺序处理，写线程不等待 */
+    snprintf(to, sizeof(to), "%s.rotating-%u", g_lm.m_path, g_rotate_seq++);
+    rename(g_lm.m_path, to);
+    if (!_log_mgr_compress_put(to, false, true))
+      _log_mgr_rotate_shift(to, false);
+  }
+
+  g_fd = _log_mgr_file_open();
+}
+
+/* @func:
+ *  将所有线程缓冲区中的日志写入文件，返回写入的字节数
+ */
+static size_t _log_mgr_drain(void) {
+  struct iovec iov[LOG_MGR_IOV_MAX];
+  log_mgr_ring_t *ring[LOG_MGR_IOV_MAX / 2];
+  size_t head[LOG_MGR_IOV_MAX / 2];
+  log_mgr_ring_t *cur = NULL;
+  size_t total = 0, len = 0, pos = 0, first = 0;
+  int cnt = 0, ring_cnt = 0, i = 0;
+
+  for (cur = __atomic_load_n(&g_rings, __ATOMIC_ACQUIRE); cur;
+       cur = cur->m_next) {
+    head[ring_cnt] = __atomic_load_n(&cur->m_head, __ATOMIC_ACQUIRE);
+    if (!(len = head[ring_cnt] - cur->m_tail))
+      goto next;
+
+    pos = cur->m_tail & (cur->m_size - 1);
+    first = cur->m_size - pos < len ? cur->m_size - pos : len;
+    iov[cnt].iov_base = cur->m_buf + pos, iov[cnt++].iov_len = first;
+    if (len > first)
+      iov[cnt].iov_base = cur->m_buf, iov[cnt++].iov_len = len - first;
+    ring[ring_cnt++] = cur;
+    total += len;
+
+  next:
+    if (cur->m_next && ring_cnt < LOG_MGR_IOV_MAX / 2)
+      continue;
+
+    /* 一批满了或者已经遍历完 */
+    if (cnt > 0) {
+      if (g_fd < 0 || _log_mgr_rotate_need()) {
+        /* 二进制模式下其他线程持有锁直接写格式串的定义 */
+        pthread_mutex_lock(&g_lm.m_mutex);
+        if (g_fd < 0)
+          g_fd = _log_mgr_file_open();
+        else
+          _log_mgr_rotate();
+        /* 新文件需要重新写入格式串的定义 */
+        if (g_is_binary && g_fd >= 0)
+          __atomic_add_fetch(&g_file_size, _log_mgr_bin_head(g_fd),
+                             __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&g_lm.m_mutex);
+      }
+      if (g_fd >= 0 && _log_mgr_writev_all(g_fd, iov, cnt))
+        for (i = 0; i < ring_cnt; i++)
+          __atomic_add_fetch(&g_file_size, head[i] - ring[i]->m_tail,
+                             __ATOMIC_RELAXED);
+    }
+    for (i = 0; i < ring_cnt; i++) {
+      __atomic_store_n(&ring[i]->m_tail, head[i], __ATOMIC_RELEASE);
+    }
+    cnt = ring_cnt = 0;
+  }
+  return total;
+}
+
+/* @func:
+ *  释放已经退出的线程的环形缓冲区
+ */
+static void _log_mgr_ring_gc(void) {
+  log_mgr_ring_t **pp = NULL, *cur = NULL;
+
+  /* log_mgr_flush持有锁时等待后台线程，这里不能阻塞 */
+  if (pthread_mutex_trylock(&g_ring_mutex))
+    return;
+  for (pp = &g_rings; (cur = *pp);) {
+    if (__atomic_load_n(&cur->m_is_dead, __ATOMIC_ACQUIRE) &&
+        cur->m_tail == __atomic_load_n(&cur->m_head, __ATOMIC_ACQUIRE)) {
+      *pp = cur->m_next;
+      free(cur->m_buf);
+      free(cur);
+      continue;
+    }
+    pp = &cur->m_next;
+  }
+  pthread_mutex_unlock(&g_ring_mutex);
+}
+
+/* @func:
+ *  后台线程，定时或者被唤醒时批量写日志
+ */
+static void *_log_mgr_writer(void *arg) {
+  struct timespec ts;
+
+  while (__atomic_load_n(&g_is_running, __ATOMIC_ACQUIRE)) {
+    if (_log_mgr_drain())
+      continue;
+    _log_mgr_ring_gc();
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += g_lm.m_flush_ms / 1000;
+    ts.tv_nsec += (g_lm.m_flush_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000)
+      ts.tv_sec++, ts.tv_nsec -= 1000000000;
+
+    pthread_mutex_lock(&g_cond_mutex);
+    pthread_cond_timedwait(&g_cond, &g_cond_mutex, &ts);
+    pthread_mutex_unlock(&g_cond_mutex);
+  }
+
+  while (_log_mgr_drain())
+    ;
+  return arg;
+}
+
+/* @func:
+ *  获取日志管理节点
+ */
+log_mgr_t *log_mgr(void) { return &g_lm; }
+
+/* @func:
+ * 	初始化日志管理器
+ */
+void log_mgr_init(void) {
+  char path[PATH_MAX] = {0};
+  char *ptr = NULL;
+  size_t len = 0;
+
+  if (g_lm.m_path[0] != '\0') {
+    if (ptr = strrchr(g_lm.m_path, '/'), ptr) {
+      len = (size_t)(ptr - g_lm.m_path);
+      memcpy(path, g_lm.m_path, len);
+    }
+
+    if (!_is_dir_exsit(path))
+      _create_dir(path, 0755);
+
+  } else {
+    g_lm.m_is_stdout = true;
+  }
+
+  if (g_is_running)
+    return;
+
+  /* 同步模式下文件在第一次写日志时打开，路径可能已经修改 */
+  pthread_mutex_lock(&g_lm.m_mutex);
+  if (g_fd >= 0 && g_fd != STDOUT_FILENO)
+    close(g_fd);
+  g_fd = -1;
+  pthread_mutex_unlock(&g_lm.m_mutex);
+
+  if (!g_lm.m_is_async)
+    return;
+
+  if ((g_fd = _log_mgr_file_open()) < 0)
+    return;
+
+  /* 二进制日志只能写文件 */
+  g_is_binary = g_lm.m_is_binary && !g_lm.m_is_stdout;
+  if (g_is_binary) {
+    pthread_mutex_lock(&g_lm.m_mutex);
+    __atomic_add_fetch(&g_file_size, _log_mgr_bin_head(g_fd), __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&g_lm.m_mutex);
+  }
+
+  g_is_running = true;
+  if (pthread_create(&g_writer, NULL, _log_mgr_writer, NULL)) {
+    LOG_MGR_WARN_LOG("pthread_create error, errno: %d - %s", errno,
+                     strerror(errno));
+    g_is_running = false;
+    if (!g_lm.m_is_stdout)
+      close(g_fd);
+    g_fd = -1;
+  }
+}
+
+/* @func:
+ *  调用点的模块是否是name，name可以是模块名或者文件路径的最后几级
+ */
+static bool _log_mgr_module_match(const char *module, const char *name) {
+  size_t len = 0, name_len = strlen(name);
+
+  if (!module || (len = strlen(module)) < name_len)
+    return false;
+  if (strcmp(module + len - name_len, name))
+    return false;
+  return len == name_len || module[len - name_len - 1] == '/';
+}
+
+/* @func:
+ *  查找调用点生效的日志级别，缓存在调用点中
+ */
+static unsigned char *_log_mgr_level_resolve(log_mgr_fmt_t *fmt) {
+  log_mgr_module_t *cur = NULL;
+  unsigned char *mask = &g_lm.m_log_mask;
+  unsigned int gen = 0;
+
+  pthread_mutex_lock(&g_module_mutex);
+  gen = g_lm.m_level_gen;
+  for (cur = g_modules; cur; cur = cur->m_next) {
+    if (cur->m_is_set && _log_mgr_module_match(fmt->m_module, cur->m_name)) {
+      mask = &cur->m_mask;
+      break;
+    }
+  }
+  __atomic_store_n(&fmt->m_mask, mask, __ATOMIC_RELAXED);
+  __atomic_store_n(&fmt->m_gen, gen, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&g_module_mutex);
+  return mask;
+}
+
+/* @func:
+ *  查找或者添加模块，调用者持有g_module_mutex
+ */
+static log_mgr_module_t *_log_mgr_module_get(const char *module, bool is_add) {
+  log_mgr_module_t *cur = NULL;
+  size_t len = strlen(module);
+
+  for (cur = g_modules; cur; cur = cur->m_next)
+    if (!strcmp(cur->m_name, module))
+      return cur;
+  if (!is_add)
+    return NULL;
+
+  if (!(cur = malloc(sizeof(*cur) + len + 1))) {
+    LOG_MGR_ERROR_LOG("malloc error, errno: %d - %s", errno, strerror(errno));
+    return NULL;
+  }
+  memcpy(cur->m_name, module, len + 1);
+  cur->m_mask = 0;
+  cur->m_is_set = false;
+  cur->m_next = g_modules;
+  g_modules = cur;
+  return cur;
+}
+
+/* @func:
+ *	设置模块的日志级别，覆盖全局的m_log_mask
+ */
+void log_mgr_level_set(const char *module, unsigned char mask) {
+  log_mgr_module_t *cur = NULL;
+
+  if (!module) {
+    __atomic_store_n(&g_lm.m_log_mask, mask, __ATOMIC_RELAXED);
+    return;
+  }
+
+  pthread_mutex_lock(&g_module_mutex);
+  if ((cur = _log_mgr_module_get(module, true))) {
+    __atomic_store_n(&cur->m_mask, mask, __ATOMIC_RELAXED);
+    if (!cur->m_is_set) {
+      cur->m_is_set = true;
+      __atomic_add_fetch(&g_lm.m_level_gen, 1, __ATOMIC_RELEASE);
+    }
+  }
+  pthread_mutex_unlock(&g_module_mutex);
+}
+
+/* @func:
+ *	取消模块的日志级别，恢复使用全局的m_log_mask
+ */
+void log_mgr_level_reset(const char *module) {
+  log_mgr_module_t *cur = NULL;
+
+  pthread_mutex_lock(&g_module_mutex);
+  if ((cur = _log_mgr_module_get(module, false)) && cur->m_is_set) {
+    cur->m_is_set = false;
+    __atomic_add_fetch(&g_lm.m_level_gen, 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&g_module_mutex);
+}
+
+/* @func:
+ *	异步模式下等待所有已经写入缓冲区的日志落盘
+ */
+void log_mgr_flush(void) {
+  log_mgr_ring_t *cur = NULL;
+
+  if (!__atomic_load_n(&g_is_running, __ATOMIC_ACQUIRE))
+    goto out;
+
+  /* 持有锁防止后台线程释放缓冲区 */
+  pthread_mutex_lock(&g_ring_mutex);
+  for (cur = g_rings; cur; cur = cur->m_next) {
+    while (__atomic_load_n(&cur->m_tail, __ATOMIC_ACQUIRE) !=
+           __atomic_load_n(&cur->m_head, __ATOMIC_ACQUIRE)) {
+      _log_mgr_writer_wakeup();
+      sched_yield();
+    }
+  }
+  pthread_mutex_unlock(&g_ring_mutex);
+
+out:
+  _log_mgr_compress_wait();
+}
+
+/* @func:
+ *	停止异步模式的后台线程，写出剩余的日志并关闭文件
+ */
+void log_mgr_destroy(void) {
+  if (!g_is_running)
+    return;
+
+  __atomic_store_n(&g_is_running, false, __ATOMIC_RELEASE);
+  _log_mgr_writer_wakeup();
+  pthread_join(g_writer, NULL);
+  g_is_binary = false;
+
+  if (!g_lm.m_is_stdout)
+    close(g_fd);
+  g_fd = -1;
+
+  /* 还在运行的线程保留缓冲区，下次初始化时继续使用 */
+  _log_mgr_ring_gc();
+  _log_mgr_compress_wait();
+}
+
+/* @func:
+ *	格式化一条文本日志，写入环形缓冲区或者文件
+ */
+static void _log_mgr_vdo(unsigned char level, const char *file,
+                         const char *func, int line, const char *format,
+                         va_list vl) {
+  size_t len = 0;
+  uint16_t text_len = 0;
+  char *rec = tl_rec;
+
+  /* 二进制模式下作为一条文本记录 */
+  if (g_is_binary)
+    rec += 1 + sizeof(text_len);
+  len = _log_mgr_format(rec, sizeof(tl_rec) - (rec - tl_rec), level, file, func,
+                        line, format, vl);
+
+  if (__atomic_load_n(&g_is_running, __ATOMIC_ACQUIRE)) {
+    if (g_is_binary) {
+      text_len = len;
+      tl_rec[0] = LOG_MGR_BIN_TEXT;
+      memcpy(tl_rec + 1, &text_len, sizeof(text_len));
+      len += rec - tl_rec;
+    }
+    _log_mgr_ring_put(tl_rec, len);
+    return;
+  }
+
+  pthread_mutex_lock(&g_lm.m_mutex);
+  if (g_lm.m_is_stdout) {
+    fwrite(tl_rec, 1, len, stdout);
+    fflush(stdout);
+    goto out;
+  }
+
+  /* 文件一直保持打开，按内存中的计数判断轮转 */
+  if (g_fd < 0)
+    g_fd = _log_mgr_file_open();
+  if (g_fd >= 0 && _log_mgr_rotate_need())
+    _log_mgr_rotate();
+  if (g_fd >= 0 && _log_mgr_write_all(g_fd, tl_rec, len))
+    __atomic_add_fetch(&g_file_size, len, __ATOMIC_RELAXED);
+
+out:
+  pthread_mutex_unlock(&g_lm.m_mutex);
+}
+
+/* @func:
+ *	写日志文件
+ */
+void log_mgr_do(unsigned char level, const char *file, const char *func,
+                int line, const char *format, ...) {
+  if (!(level & g_lm.m_log_mask))
+    return;
+  va_list vl;
+
+  va_start(vl, format);
+  _log_mgr_vdo(level, file, func, line, format, vl);
+  va_end(vl);
+}
+
+/* @func:
+ *	重新查找调用点的级别，返回调用点的级别是否打开
+ */
+bool log_mgr_fmt_resolve(log_mgr_fmt_t *fmt) {
+  return fmt->m_level & __atomic_load_n(_log_mgr_level_resolve(fmt),
+                                        __ATOMIC_RELAXED);
+}
+
+/* @func:
+ *	通过调用点的描述写日志，二进制模式下只记录编号和原始参数
+ */
+void log_mgr_fmt_do(log_mgr_fmt_t *fmt, ...) {
+  va_list vl;
+
+  if (!log_mgr_is_enabled(fmt))
+    return;
+
+  va_start(vl, fmt);
+  if (g_is_binary && __atomic_load_n(&g_is_running, __ATOMIC_ACQUIRE))
+    _log_mgr_bin_vdo(fmt, vl);
+  else
+    _log_mgr_vdo(fmt->m_level, fmt->m_file, fmt->m_func, fmt->m_line,
+                 fmt->m_format, vl);
+  va_end(vl);
+}
+
+/* @func:
+ *	按运行时的format写文本日志
+ */
+void log_mgr_text_do(log_mgr_fmt_t *fmt, const char *format, ...) {
+  va_list vl;
+
+  if (!format || !log_mgr_is_enabled(fmt))
+    return;
+
+  va_start(vl, format);
+  _log_mgr_vdo(fmt->m_level, fmt->m_file, fmt->m_func, fmt->m_line, format,
+               vl);
+  va_end(vl);
+}
+
+/* @func:
+ *		打印调试日志信息
+ */
+void log_mgr_dump(void) {
+  LOG_MGR_TRACE_LOG("==================");
+  LOG_MGR_TRACE_LOG("path: %s", g_lm.m_path);
+  LOG_MGR_TRACE_LOG("rotate_size: %lu", g_lm.m_rotate_size);
+  LOG_MGR_TRACE_LOG("rotate_keep: %u", g_lm.m_rotate_keep);
+  LOG_MGR_TRACE_LOG("rotate_period: %u", g_lm.m_rotate_period);
+  LOG_MGR_TRACE_LOG("is_rotate_ts: %d", g_lm.m_is_rotate_ts);
+  LOG_MGR_TRACE_LOG("is_compress: %d", g_lm.m_is_compress);
+  LOG_MGR_TRACE_LOG("log_mask: %u", g_lm.m_log_mask);
+  LOG_MGR_TRACE_LOG("is_stdout: %d", g_lm.m_is_stdout);
+  LOG_MGR_TRACE_LOG("is_async: %d", g_lm.m_is_async);
+  LOG_MGR_TRACE_LOG("is_block: %d", g_lm.m_is_block);
+  LOG_MGR_TRACE_LOG("ring_size: %lu", g_lm.m_ring_size);
+  LOG_MGR_TRACE_LOG("flush_ms: %u", g_lm.m_flush_ms);
+  LOG_MGR_TRACE_LOG("drop_count: %lu", g_lm.m_drop_count);
+  LOG_MGR_TRACE_LOG("is_binary: %d", g_lm.m_is_binary);
+  LOG_MGR_TRACE_LOG("ts_precision: %u", g_lm.m_ts_precision);
+  LOG_MGR_TRACE_LOG("==================");
+}
+
+#if 1
+
+#include <assert.h>
+
+static size_t _line_count(const char *path) {
+  FILE *fp = NULL;
+  size_t count = 0;
+  int ch = 0;
+
+  if (!(fp = fopen(path, "rb")))
+    return 0;
+  while ((ch = fgetc(fp)) != EOF)
+    if (ch == '\n')
+      count++;
+  fclose(fp);
+  return count;
+}
+
+static void _log_mgr_async_test(void) {
+  size_t i = 0;
+  size_t max_num = 10240;
+  pthread_t pt[10];
+  log_mgr_t *lm = log_mgr();
+
+  snprintf(lm->m_path, sizeof(lm->m_path), "%s", "/tmp/kk/test_async.dat");
+  unlink(lm->m_path);
+  lm->m_is_stdout = false;
+  lm->m_is_async = true;
+  lm->m_is_block = true;
+  lm->m_ring_size = 64 * 1024;
+  lm->m_rotate_size = 1024 * 1024 * 1024;
+  lm->m_log_mask = LOG_MGR_LV_WARN | LOG_MGR_LV_DEBUG;
+
+  log_mgr_init();
+  log_mgr_dump();
+
+  for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++) {
+    pthread_create(&pt[i], NULL, ({
+      void *_(void *arg) {
+        char *str = "hello";
+        size_t j = 0;
+        for (j = 0; j < max_num; j++) {
+          log_mgr_trace("%s:%d", str, j);
+          log_mgr_debug("%s:%d", str, j);
+          log_mgr_info("%s:%d", str, j);
+          log_mgr_warn("%s:%d", str, j);
+          log_mgr_error("%s:%d", str, j);
+          log_mgr_fatal("%s:%d", str, j);
+        }
+        return arg;
+      };
+      _;
+    }),
+                   NULL);
+  }
+
+  for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++)
+    pthread_join(pt[i], NULL);
+
+  log_mgr_flush();
+  log_mgr_destroy();
+  log_mgr_dump();
+
+  /* 阻塞模式下不会丢日志 */
+  assert(!lm->m_drop_count);
+  assert(_line_count(lm->m_path) == max_num * 2 * sizeof(pt) / sizeof(pt[0]));
+  lm->m_is_async = false;
+  MY_PRINTF("async OK");
+}
+
+/* @func:
+ *  统计二进制日志文件中各类记录的条数
+ */
+static void _bin_count(const char *path, size_t count[4]) {
+  char buf[LOG_MGR_LINE_MAX];
+  FILE *fp = NULL;
+  uint16_t len = 0;
+  int type = 0;
+  unsigned char arg_cnt = 0;
+  size_t i = 0;
+
+  memset(count, 0, sizeof(size_t) * 4);
+  assert((fp = fopen(path, "rb")));
+  while ((type = fgetc(fp)) != EOF) {
+    assert(type <= LOG_MGR_BIN_TEXT);
+    count[type]++;
+    switch (type) {
+    case LOG_MGR_BIN_HEAD:
+      assert(1 == fread(buf, 4, 1, fp));
+      break;
+    case LOG_MGR_BIN_DEF:
+      assert(1 == fread(buf, 4 + 1 + 4, 1, fp));
+      assert(1 == fread(&arg_cnt, 1, 1, fp));
+      assert(!arg_cnt || 1 == fread(buf, arg_cnt, 1, fp));
+      for (i = 0; i < 3; i++) {
+        assert(1 == fread(&len, sizeof(len), 1, fp));
+        assert(!len || 1 == fread(buf, len, 1, fp));
+      }
+      break;
+    case LOG_MGR_BIN_LOG:
+      assert(1 == fread(buf, 4 + 8, 1, fp));
+      assert(1 == fread(&len, sizeof(len), 1, fp));
+      assert(!len || 1 == fread(buf, len, 1, fp));
+      break;
+    case LOG_MGR_BIN_TEXT:
+      assert(1 == fread(&len, sizeof(len), 1, fp));
+      assert(1 == fread(buf, len, 1, fp));
+      break;
+    }
+  }
+  fclose(fp);
+}
+
+static void _log_mgr_binary_test(void) {
+  size_t i = 0;
+  size_t max_num = 10240;
+  size_t count[4];
+  pthread_t pt[4];
+  log_mgr_t *lm = log_mgr();
+
+  snprintf(lm->m_path, sizeof(lm->m_path), "%s", "/tmp/kk/test_bin.dat");
+  unlink(lm->m_path);
+  lm->m_is_stdout = false;
+  lm->m_is_async = true;
+  lm->m_is_block = true;
+  lm->m_is_binary = true;
+  lm->m_rotate_size = 1024 * 1024 * 1024;
+  lm->m_log_mask = LOG_MGR_LV_ALL;
+
+  log_mgr_init();
+  for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++) {
+    pthread_create(&pt[i], NULL, ({
+      void *_(void *arg) {
+        size_t j = 0;
+        for (j = 0; j < max_num; j++) {
+          log_mgr_info("int: %d, long: %lu, str: %s, double: %.3f", (int)j, j,
+                       "hello", j / 3.0);
+          log_mgr_warn("width: [%*d] [%-8s] [%5.1Lf] %p 100%%", 6, (int)j,
+                       "ab", (long double)j, arg);
+        }
+        log_mgr_do(LOG_MGR_LV_ERROR, __FILE__, __FUNCTION__, __LINE__,
+                   "text %d", (int)j);
+        return arg;
+      };
+      _;
+    }),
+                   (void *)i);
+  }
+
+  for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++)
+    pthread_join(pt[i], NULL);
+  log_mgr_destroy();
+
+  _bin_count(lm->m_path, count);
+  assert(count[LOG_MGR_BIN_HEAD] == 1);
+  assert(count[LOG_MGR_BIN_DEF] == 2);
+  assert(count[LOG_MGR_BIN_LOG] == max_num * 2 * sizeof(pt) / sizeof(pt[0]));
+  assert(count[LOG_MGR_BIN_TEXT] == sizeof(pt) / sizeof(pt[0]));
+
+  /* 再次打开时重新写入文件头和全部的定义 */
+  log_mgr_init();
+  log_mgr_info("int: %d, long: %lu, str: %s, double: %.3f", 1, 2UL, "again",
+               4.0);
+  log_mgr_destroy();
+  _bin_count(lm->m_path, count);
+  assert(count[LOG_MGR_BIN_HEAD] == 2);
+  assert(count[LOG_MGR_BIN_DEF] == 5);
+
+  lm->m_is_async = false;
+  lm->m_is_binary = false;
+  MY_PRINTF("binary OK, decode with: ./lmd %s", lm->m_path);
+}
+
+/* 原来的格式化方式: 每次调用time, localtime_r, strftime */
+static size_t _legacy_format(char *buf, size_t size, unsigned char level,
+                             const char *file, const char *func, int line,
+                             const char *format, ...) {
+  time_t nt = 0;
+  struct tm ltm;
+  char tbuf[64] = {0};
+  va_list vl;
+  int len = 0;
+
+  nt = time((time_t *)NULL);
+  localtime_r(&nt, &ltm);
+  strftime(tbuf, sizeof(tbuf), "%b %d %T", &ltm);
+  len = snprintf(buf, size, "[%c] [%s] [%s] [%s:%d]: ", _level_char_get(level),
+                 tbuf, file, func, line);
+  va_start(vl, format);
+  len += vsnprintf(buf + len, size - len, format, vl);
+  va_end(vl);
+  return len;
+}
+
+static size_t _fast_format(char *buf, size_t size, unsigned char level,
+                           const char *file, const char *func, int line,
+                           const char *format, ...) {
+  va_list vl;
+  size_t len = 0;
+
+  va_start(vl, format);
+  len = _log_mgr_format(buf, size, level, file, func, line, format, vl);
+  va_end(vl);
+  return len;
+}
+
+static double _ns_since(const struct timespec *start, size_t count) {
+  struct timespec end;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  return ((end.tv_sec - start->tv_sec) * 1e9 +
+          (end.tv_nsec - start->tv_nsec)) /
+         count;
+}
+
+/* @func:
+ *  模块级别的覆盖和关闭级别时参数不求值
+ */
+static void _log_mgr_level_test(void) {
+  log_mgr_t *lm = log_mgr();
+  int i = 0, eval = 0;
+
+  snprintf(lm->m_path, sizeof(lm->m_path), "%s", "/tmp/kk/test_level.dat");
+  lm->m_is_stdout = false;
+  lm->m_is_async = false;
+  lm->m_rotate_size = 1024 * 1024;
+  log_mgr_level_set(NULL, LOG_MGR_LV_WARN);
+  unlink(lm->m_path);
+  log_mgr_init();
+
+  for (i = 0; i < 4; i++) {
+    switch (i) {
+    case 1:
+      log_mgr_level_set("other.c", LOG_MGR_LV_ALL);
+      break;
+    case 2:
+      log_mgr_level_set(__FILE__, LOG_MGR_LV_TRACE | LOG_MGR_LV_WARN);
+      break;
+    case 3:
+      log_mgr_level_reset(__FILE__);
+      break;
+    }
+    log_mgr_trace("level %d trace %d", i, eval++);
+    log_mgr_warn("level %d warn", i);
+  }
+  /* 关闭的级别在第一次调用和级别修改后也不对参数求值 */
+  assert(eval == 1);
+  assert(_line_count(lm->m_path) == 4 + 1);
+
+  /* 运行时修改全局级别 */
+  log_mgr_level_set(NULL, LOG_MGR_LV_ERROR);
+  for (i = 0; i < 4; i++)
+    log_mgr_warn("level warn %d", eval++);
+  assert(eval == 1 && _line_count(lm->m_path) == 5);
+
+  log_mgr_none("none %d", eval++);
+  assert(eval == 1);
+
+  /* 运行时的format走文本路径，同样受模块级别控制 */
+  const char *format = eval ? "runtime %s %d" : "";
+  log_mgr_error(format, "error", eval++);
+  log_mgr_warn(format, "warn", eval++);
+  assert(eval == 1 + 1 && _line_count(lm->m_path) == 6);
+
+  unlink(lm->m_path);
+  MY_PRINTF("level test ok");
+}
+
+static size_t _file_size(const char *path) {
+  struct stat st;
+
+  return stat(path, &st) ? 0 : (size_t)st.st_size;
+}
+
+/* @func:
+ *  目录中以prefix开头的文件个数
+ */
+static size_t _file_count(const char *dir, const char *prefix) {
+  struct dirent *ent = NULL;
+  size_t count = 0;
+  DIR *dp = NULL;
+
+  if (!(dp = opendir(dir)))
+    return 0;
+  while ((ent = readdir(dp)))
+    if (!strncmp(ent->d_name, prefix, strlen(prefix)))
+      count++;
+  closedir(dp);
+  return count;
+}
+
+static void _rotate_clean(const char *dir) {
+  char path[PATH_MAX * 2];
+  struct dirent *ent = NULL;
+  DIR *dp = NULL;
+
+  if (!(dp = opendir(dir)))
+    return;
+  while ((ent = readdir(dp))) {
+    if (ent->d_name[0] == '.')
+      continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+    unlink(path);
+  }
+  closedir(dp);
+}
+
+/* @func:
+ *  按大小和时间轮转，序号和时间命名，压缩历史文件
+ */
+static void _log_mgr_rotate_test(void) {
+  const char *dir = "/tmp/kk/rotate";
+  log_mgr_t *lm = log_mgr();
+  char path[PATH_MAX + 32];
+  struct tm tm;
+  time_t now = 0, at = 0;
+  size_t i = 0;
+
+  snprintf(lm->m_path, sizeof(lm->m_path), "%s/test.dat", dir);
+  lm->m_is_stdout = false;
+  lm->m_is_async = false;
+  lm->m_log_mask = LOG_MGR_LV_ALL;
+  lm->m_rotate_size = 4096;
+  lm->m_rotate_keep = 3;
+  log_mgr_init();
+  _rotate_clean(dir);
+
+  /* 序号命名，.1是最新的，超过保留个数的删除 */
+  for (i = 0; i < 400; i++)
+    log_mgr_info("rotate %zu", i);
+  for (i = 1; i <= 3; i++) {
+    snprintf(path, sizeof(path), "%s.%zu", lm->m_path, i);
+    assert(_file_size(path) >= lm->m_rotate_size);
+    assert(_file_size(path) < lm->m_rotate_size + LOG_MGR_LINE_MAX);
+  }
+  assert(_file_count(dir, "test.dat") == 4);
+
+  /* 压缩 */
+  lm->m_is_compress = true;
+  for (i = 0; i < 400; i++)
+    log_mgr_info("rotate %zu", i);
+  log_mgr_flush();
+  for (i = 1; i <= 3; i++) {
+    snprintf(path, sizeof(path), "%s.%zu.gz", lm->m_path, i);
+    assert(_file_size(path) > 0);
+    snprintf(path, sizeof(path), "%s.%zu", lm->m_path, i);
+    assert(_file_size(path) == 0);
+  }
+  assert(_file_count(dir, "test.dat") == 4);
+
+  /* 时间命名，异步模式 */
+  _rotate_clean(dir);
+  lm->m_is_rotate_ts = true;
+  lm->m_is_async = true;
+  lm->m_is_block = true;
+  log_mgr_init();
+  for (i = 0; i < 400; i++) {
+    log_mgr_info("rotate %zu", i);
+    if (i % 20 == 0)
+      log_mgr_flush();
+  }
+  log_mgr_destroy();
+  assert(_file_count(dir, "test.dat.") == 3);
+  lm->m_is_async = false;
+  lm->m_is_compress = false;
+
+  /* 按时间轮转 */
+  now = time(NULL);
+  localtime_r(&now, &tm);
+  lm->m_rotate_period = LOG_MGR_ROTATE_HOURLY;
+  at = _log_mgr_rotate_at(now);
+  assert(at > now && at - now <= 3600 && at % 60 == 0);
+  lm->m_rotate_period = LOG_MGR_ROTATE_DAILY;
+  at = _log_mgr_rotate_at(now);
+  localtime_r(&at, &tm);
+  assert(at > now && at - now <= 25 * 3600 && !tm.tm_hour && !tm.tm_min);
+
+  _rotate_clean(dir);
+  lm->m_rotate_size = 0;
+  lm->m_rotate_keep = 2;
+  log_mgr_init();
+  log_mgr_info("period 0");
+  g_rotate_at = now - 1;
+  log_mgr_info("period 1");
+  log_mgr_info("period 1");
+  assert(_line_count(lm->m_path) == 2);
+  assert(_file_count(dir, "test.dat.") == 1);
+
+  _rotate_clean(dir);
+  lm->m_rotate_period = LOG_MGR_ROTATE_NONE;
+  lm->m_is_rotate_ts = false;
+  lm->m_rotate_size = 1024 * 1024;
+  lm->m_rotate_keep = 5;
+  log_mgr_init();
+  MY_PRINTF("rotate test ok");
+}
+
+/* @func:
+ *  单线程每条日志的耗时
+ */
+static void _log_mgr_bench(void) {
+  const size_t count = 200000;
+  struct timespec start;
+  log_mgr_t *lm = log_mgr();
+  char buf[LOG_MGR_LINE_MAX];
+  size_t i = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < count; i++)
+    _legacy_format(buf, sizeof(buf), LOG_MGR_LV_INFO, __FILE__, __FUNCTION__,
+                   __LINE__, "bench %d %s", (int)i, "hello");
+  MY_PRINTF("format legacy: %.1f ns/line", _ns_since(&start, count));
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < count; i++)
+    _fast_format(buf, sizeof(buf), LOG_MGR_LV_INFO, __FILE__, __FUNCTION__,
+                 __LINE__, "bench %d %s", (int)i, "hello");
+  MY_PRINTF("format cached: %.1f ns/line", _ns_since(&start, count));
+
+  lm->m_ts_precision = 3;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < count; i++)
+    _fast_format(buf, sizeof(buf), LOG_MGR_LV_INFO, __FILE__, __FUNCTION__,
+                 __LINE__, "bench %d %s", (int)i, "hello");
+  MY_PRINTF("format cached msec: %.1f ns/line", _ns_since(&start, count));
+
+  lm->m_log_mask = LOG_MGR_LV_ERROR;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < count * 10; i++)
+    log_mgr_info("bench %d %s", (int)i, "hello");
+  MY_PRINTF("disabled: %.1f ns/line", _ns_since(&start, count * 10));
+
+  snprintf(lm->m_path, sizeof(lm->m_path), "%s", "/tmp/kk/test_bench.dat");
+  lm->m_is_stdout = false;
+  lm->m_rotate_size = 1024 * 1024 * 1024;
+  lm->m_log_mask = LOG_MGR_LV_ALL;
+
+  unlink(lm->m_path);
+  lm->m_is_async = false;
+  log_mgr_init();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < count / 10; i++)
+    log_mgr_info("bench %d %s", (int)i, "hello");
+  MY_PRINTF("sync: %.1f ns/line", _ns_since(&start, count / 10));
+
+  unlink(lm->m_path);
+  lm->m_is_async = true;
+  lm->m_is_block = true;
+  lm->m_ring_size = 1024 * 1024;
+  log_mgr_init();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < count; i++)
+    log_mgr_info("bench %d %s", (int)i, "hello");
+  MY_PRINTF("async: %.1f ns/line", _ns_since(&start, count));
+  log_mgr_destroy();
+  assert(_line_count(lm->m_path) == count);
+
+  unlink(lm->m_path);
+  lm->m_is_binary = true;
+  log_mgr_init();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < count; i++)
+    log_mgr_info("bench %d %s", (int)i, "hello");
+  MY_PRINTF("binary: %.1f ns/line", _ns_since(&start, count));
+  log_mgr_destroy();
+  lm->m_is_binary = false;
+
+  unlink(lm->m_path);
+  lm->m_is_async = false;
+  lm->m_ts_precision = 0;
+}
+
+int main() {
+  size_t i = 0;
+  size_t max_num = 10240;
+  pthread_t pt[10];
+  log_mgr_t *lm = log_mgr();
+
+  snprintf(lm->m_path, sizeof(lm->m_path), "%s", "/tmp/kk/test.dat");
+  lm->m_is_stdout = false;
+  lm->m_rotate_size = 1024 * 1024;
+  lm->m_log_mask = LOG_MGR_LV_WARN | LOG_MGR_LV_DEBUG;
+
+  log_mgr_init();
+  log_mgr_dump();
+
+  for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++) {
+    pthread_create(&pt[i], NULL, ({
+      void *_(void *arg) {
+        char *str = "hello";
+        size_t j = 0;
+        for (j = 0; j < max_num; j++) {
+          log_mgr_trace("%s:%d", str, j);
+          log_mgr_debug("%s:%d", str, j);
+          log_mgr_info("%s:%d", str, j);
+          log_mgr_warn("%s:%d", str, j);
+          log_mgr_error("%s:%d", str, j);
+          log_mgr_fatal("%s:%d", str, j);
+        }
+        return arg;
+      };
+      _;
+    }),
+                   NULL);
+  }
+
+  for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++)
+    pthread_join(pt[i], NULL);
+
+  MY_PRINTF("OK");
+
+  _log_mgr_async_test();
+  _log_mgr_binary_test();
+  _log_mgr_level_test();
+  _log_mgr_rotate_test();
+  _log_mgr_bench();
 
   return 0;
 }
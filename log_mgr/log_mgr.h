@@ -1,5 +1,8 @@
 /* @desc:
  *      调试日志框架，支持stdout输出和输出到日志文件中;
+ *      异步模式下日志先写入线程自己的环形缓冲区，由后台线程批量写入一直打开的文件;
+ *      二进制模式下只记录格式串的编号和原始参数，由log_mgr_decode离线生成文本;
+ *      文件按大小或者整点/零点轮转，历史文件按序号或者时间命名，可以在后台压缩;
  */
 #ifndef _LOG_MGR_H_
 #define _LOG_MGR_H_
@@ -19,14 +22,80 @@
 #define LOG_MGR_LV_FATAL 32
 #define LOG_MGR_LV_ALL 63
 
+/* 编译期的最低日志级别，低于这个级别的宏展开为空，参数不会被求值 */
+#ifndef LOG_MGR_MIN_LEVEL
+#define LOG_MGR_MIN_LEVEL LOG_MGR_LV_TRACE
+#endif
+
+/* 调用点所属的模块，在包含头文件之前定义，默认是所在的文件 */
+#ifndef LOG_MGR_MODULE
+#define LOG_MGR_MODULE __FILE__
+#endif
+
+#define LOG_MGR_ARG_MAX 16 /* 二进制模式下一条日志最多的参数个数 */
+
+/* 二进制日志文件由若干条记录组成，第一个字节是记录类型，字段按本机字节序紧密排列
+ * HEAD: u32 magic; 每次打开文件时写入，之后的格式串编号重新定义
+ * DEF: u32 id, u8 level, i32 line, u8 arg_cnt, u8 arg_type[arg_cnt], u16 len + file, u16 len + func, u16 len + format
+ * LOG: u32 id, u64 ns, u16 args_len, args
+ * TEXT: u16 len + 已经格式化的一行日志，log_mgr_do写入的日志
+ */
+#define LOG_MGR_BIN_MAGIC 0x31424d4c /* "LMB1" */
+#define LOG_MGR_BIN_HEAD 0
+#define LOG_MGR_BIN_DEF 1
+#define LOG_MGR_BIN_LOG 2
+#define LOG_MGR_BIN_TEXT 3
+
+/* 二进制模式下参数的类型 */
+#define LOG_MGR_ARG_INT 1 /* int */
+#define LOG_MGR_ARG_LONG 2 /* long long */
+#define LOG_MGR_ARG_DOUBLE 3 /* double */
+#define LOG_MGR_ARG_LDOUBLE 4 /* long double */
+#define LOG_MGR_ARG_PTR 5 /* void* */
+#define LOG_MGR_ARG_STR 6 /* u16 len + 字符串内容 */
+
+/* 按时间轮转的周期 */
+#define LOG_MGR_ROTATE_NONE 0
+#define LOG_MGR_ROTATE_HOURLY 1
+#define LOG_MGR_ROTATE_DAILY 2
+
 typedef struct _log_mgr_t {
 	char m_path[PATH_MAX];
-	size_t m_rotate_size;
+	size_t m_rotate_size; /* 文件达到这个大小时轮转，0表示不按大小轮转 */
+	unsigned int m_rotate_keep; /* 保留的历史文件个数，0表示轮转时直接删除 */
+	unsigned char m_rotate_period; /* 按时间轮转，LOG_MGR_ROTATE_XXX */
+	bool m_is_rotate_ts; /* 历史文件用打开的时间命名，否则用序号，.1是最新的 */
+	bool m_is_compress; /* 后台线程用gzip压缩历史文件 */
 	unsigned char m_log_mask;
 	bool m_is_stdout;
+	bool m_is_async; /* 异步模式，在log_mgr_init之前设置 */
+	bool m_is_block; /* 异步模式下环形缓冲区满时等待后台线程，否则丢弃日志 */
+	size_t m_ring_size; /* 异步模式下每个线程环形缓冲区的大小 */
+	unsigned int m_flush_ms; /* 异步模式下后台线程最长的刷新间隔 */
+	size_t m_drop_count; /* 异步模式下因为缓冲区满丢弃的日志条数 */
+	bool m_is_binary; /* 二进制模式，需要写文件并且使用异步模式，在log_mgr_init之前设置 */
+	unsigned char m_ts_precision; /* 时间戳秒后面的小数位数，0-9，来自CLOCK_REALTIME_COARSE，精度是一个时钟节拍 */
+	unsigned int m_level_gen; /* 模块级别每次修改后加1，调用点据此重新查找自己的级别 */
 	pthread_mutex_t m_mutex;
 } log_mgr_t;
 
+/* 调用点的静态描述，二进制模式下第一次使用时分配编号 */
+typedef struct _log_mgr_fmt {
+	unsigned int m_id; /* 0: 还未分配 */
+	unsigned char m_level;
+	int m_line;
+	const char *m_file;
+	const char *m_func;
+	const char *m_format;
+	unsigned char m_arg_cnt;
+	unsigned char m_arg_type[LOG_MGR_ARG_MAX]; /* 由格式串解析得到 */
+	const char *m_module;
+	unsigned char *m_mask; /* 生效的日志级别，指向模块的级别或者全局的m_log_mask */
+	unsigned int m_gen; /* 和m_level_gen不同时需要重新查找m_mask */
+} log_mgr_fmt_t;
+
+extern log_mgr_t g_lm;
+
 /* @func:
  *  获取日志管理节点
  */
@@ -37,16 +106,108 @@ log_mgr_t *log_mgr(void);
  */
 void log_mgr_init(void);
 
+/* @func:
+ *	设置模块的日志级别，覆盖全局的m_log_mask
+ * @param:
+ *	module: 模块名或者文件名，匹配LOG_MGR_MODULE或者它的最后几级路径；为NULL时设置全局级别
+ */
+void log_mgr_level_set(const char *module, unsigned char mask);
+
+/* @func:
+ *	取消模块的日志级别，恢复使用全局的m_log_mask
+ */
+void log_mgr_level_reset(const char *module);
+
+/* @func:
+ *	异步模式下等待所有已经写入缓冲区的日志落盘
+ */
+void log_mgr_flush(void);
+
+/* @func:
+ *	停止异步模式的后台线程，写出剩余的日志并关闭文件
+ * @warn:
+ *	线程的环形缓冲区会被释放，调用前所有线程都必须停止写日志
+ */
+void log_mgr_destroy(void);
+
 /* @func:
  *	写日志文件
  */
 void log_mgr_do(unsigned char level, const char *file, const char *func, int line, const char *format, ...);
 
-#define log_mgr_trace(format, ...) log_mgr_do(LOG_MGR_LV_TRACE, __FILE__, __FUNCTION__, __LINE__, format, ##__VA_ARGS__)
-#define log_mgr_debug(format, ...) log_mgr_do(LOG_MGR_LV_DEBUG, __FILE__, __FUNCTION__, __LINE__, format, ##__VA_ARGS__)
-#define log_mgr_info(format, ...)  log_mgr_do(LOG_MGR_LV_INFO , __FILE__, __FUNCTION__, __LINE__, format, ##__VA_ARGS__)
-#define log_mgr_warn(format, ...)  log_mgr_do(LOG_MGR_LV_WARN , __FILE__, __FUNCTION__, __LINE__, format, ##__VA_ARGS__)
-#define log_mgr_error(format, ...) log_mgr_do(LOG_MGR_LV_ERROR, __FILE__, __FUNCTION__, __LINE__, format, ##__VA_ARGS__)
-#define log_mgr_fatal(format, ...) log_mgr_do(LOG_MGR_LV_FATAL, __FILE__, __FUNCTION__, __LINE__, format, ##__VA_ARGS__)
+/* @func:
+ *	通过调用点的描述写日志，二进制模式下只记录编号和原始参数
+ */
+void log_mgr_fmt_do(log_mgr_fmt_t *fmt, ...);
+
+/* @func:
+ *	使用调用点的级别和位置，按运行时的format写一条文本日志，二进制模式下也是文本记录
+ */
+void log_mgr_text_do(log_mgr_fmt_t *fmt, const char *format, ...);
+
+/* @func:
+ *	重新查找调用点的级别并缓存，返回调用点的级别是否打开
+ */
+bool log_mgr_fmt_resolve(log_mgr_fmt_t *fmt);
+
+/* @func:
+ *	调用点的级别是否打开，在调用log_mgr_fmt_do之前检查，避免参数求值和函数调用
+ *	第一次调用或者模块级别修改过时通过log_mgr_fmt_resolve重新查找
+ */
+static inline bool log_mgr_is_enabled(log_mgr_fmt_t *fmt)
+{
+	if (__atomic_load_n(&fmt->m_gen, __ATOMIC_ACQUIRE) != __atomic_load_n(&g_lm.m_level_gen, __ATOMIC_ACQUIRE))
+		return log_mgr_fmt_resolve(fmt);
+	return __atomic_load_n(__atomic_load_n(&fmt->m_mask, __ATOMIC_RELAXED), __ATOMIC_RELAXED) & fmt->m_level;
+}
+
+/* format是字符串常量时记录在调用点中，二进制模式下只写编号和参数；
+ * 运行时的format通过log_mgr_text_do格式化成文本 */
+#define log_mgr_emit(level, format, ...) do { \
+	static log_mgr_fmt_t _lm_fmt = { .m_level = level, .m_line = __LINE__, .m_file = __FILE__, \
+		.m_func = __FUNCTION__, .m_module = LOG_MGR_MODULE, \
+		.m_format = __builtin_choose_expr(__builtin_constant_p(format), format, NULL) }; \
+	if (!log_mgr_is_enabled(&_lm_fmt)) break; \
+	if (_lm_fmt.m_format) log_mgr_fmt_do(&_lm_fmt, ##__VA_ARGS__); \
+	else log_mgr_text_do(&_lm_fmt, format, ##__VA_ARGS__); \
+} while (0)
+
+#define log_mgr_none(format, ...) do { } while (0)
+
+#if LOG_MGR_MIN_LEVEL <= LOG_MGR_LV_TRACE
+#define log_mgr_trace(format, ...) log_mgr_emit(LOG_MGR_LV_TRACE, format, ##__VA_ARGS__)
+#else
+#define log_mgr_trace log_mgr_none
+#endif
+
+#if LOG_MGR_MIN_LEVEL <= LOG_MGR_LV_DEBUG
+#define log_mgr_debug(format, ...) log_mgr_emit(LOG_MGR_LV_DEBUG, format, ##__VA_ARGS__)
+#else
+#define log_mgr_debug log_mgr_none
+#endif
+
+#if LOG_MGR_MIN_LEVEL <= LOG_MGR_LV_INFO
+#define log_mgr_info(format, ...)  log_mgr_emit(LOG_MGR_LV_INFO , format, ##__VA_ARGS__)
+#else
+#define log_mgr_info log_mgr_none
+#endif
+
+#if LOG_MGR_MIN_LEVEL <= LOG_MGR_LV_WARN
+#define log_mgr_warn(format, ...)  log_mgr_emit(LOG_MGR_LV_WARN , format, ##__VA_ARGS__)
+#else
+#define log_mgr_warn log_mgr_none
+#endif
+
+#if LOG_MGR_MIN_LEVEL <= LOG_MGR_LV_ERROR
+#define log_mgr_error(format, ...) log_mgr_emit(LOG_MGR_LV_ERROR, format, ##__VA_ARGS__)
+#else
+#define log_mgr_error log_mgr_none
+#endif
+
+#if LOG_MGR_MIN_LEVEL <= LOG_MGR_LV_FATAL
+#define log_mgr_fatal(format, ...) log_mgr_emit(LOG_MGR_LV_FATAL, format, ##__VA_ARGS__)
+#else
+#define log_mgr_fatal log_mgr_none
+#endif
 
 #endif
@@ -0,0 +1,396 @@
+/* @desc:
+ *      将log_mgr二进制模式写入的日志文件还原成文本，输出到stdout;
+ *      用法: lmd [-p 时间戳小数位数] file
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log_mgr.h"
+
+#define MY_PRINTF(format, ...) fprintf(stderr, format "\n", ##__VA_ARGS__)
+#define LOG_MGR_DECODE_ERROR_LOG MY_PRINTF
+
+typedef struct _decode_fmt {
+  unsigned char m_level;
+  int m_line;
+  unsigned char m_arg_cnt;
+  unsigned char m_arg_type[LOG_MGR_ARG_MAX];
+  char *m_file;
+  char *m_func;
+  char *m_format;
+} decode_fmt_t;
+
+static decode_fmt_t *g_fmts = NULL; /* 下标是编号 */
+static unsigned int g_fmt_max = 0;
+static unsigned int g_def_cnt = 0; /* 文件头之后的定义记录个数，编号不会超过它 */
+static int g_precision = 0;
+
+static char _level_char_get(unsigned char level) {
+  switch (level) {
+  case LOG_MGR_LV_TRACE:
+    return 'T';
+  case LOG_MGR_LV_DEBUG:
+    return 'D';
+  case LOG_MGR_LV_INFO:
+    return 'I';
+  case LOG_MGR_LV_WARN:
+    return 'W';
+  case LOG_MGR_LV_ERROR:
+    return 'E';
+  case LOG_MGR_LV_FATAL:
+    return 'F';
+  }
+  return 'U';
+}
+
+/* @func:
+ *  读取整个文件
+ */
+static char *_file_read(const char *path, size_t *size) {
+  FILE *fp = NULL;
+  char *buf = NULL, *tmp = NULL;
+  size_t cap = 0, len = 0, byte = 0;
+
+  if (!(fp = fopen(path, "rb"))) {
+    LOG_MGR_DECODE_ERROR_LOG("fopen %s error, errno: %d - %s", path, errno,
+                             strerror(errno));
+    return NULL;
+  }
+
+  do {
+    if (len == cap) {
+      if (!(tmp = realloc(buf, cap = cap * 2 + 65536)))
+        goto err;
+      buf = tmp;
+    }
+    len += byte = fread(buf + len, 1, cap - len, fp);
+  } while (byte > 0);
+
+  fclose(fp);
+  *size = len;
+  return buf;
+
+err:
+  fclose(fp);
+  free(buf);
+  return NULL;
+}
+
+/* @func:
+ *  清空格式串的定义，遇到文件头时调用
+ */
+static void _fmt_reset(void) {
+  unsigned int i = 0;
+
+  g_def_cnt = 0;
+  if (!g_fmts)
+    return;
+  for (i = 0; i < g_fmt_max; i++) {
+    free(g_fmts[i].m_file);
+    free(g_fmts[i].m_func);
+    free(g_fmts[i].m_format);
+  }
+  memset(g_fmts, 0, sizeof(*g_fmts) * g_fmt_max);
+}
+
+/* @func:
+ *  读取u16长度的字符串，返回新分配的内存
+ */
+static char *_str_get(const char **ptr, const char *end) {
+  uint16_t len = 0;
+  char *str = NULL;
+
+  if (end - *ptr < (long)sizeof(len))
+    return NULL;
+  memcpy(&len, *ptr, sizeof(len));
+  if (end - *ptr - (long)sizeof(len) < len)
+    return NULL;
+  if (!(str = malloc(len + 1)))
+    return NULL;
+  memcpy(str, *ptr + sizeof(len), len);
+  str[len] = '\0';
+  *ptr += sizeof(len) + len;
+  return str;
+}
+
+/* @func:
+ *  解析定义记录，返回记录的结尾
+ */
+static const char *_def_parse(const char *ptr, const char *end) {
+  decode_fmt_t fmt, *fmts = NULL;
+  unsigned int id = 0, max = 0;
+
+  memset(&fmt, 0, sizeof(fmt));
+  if (end - ptr < (long)(sizeof(id) + 1 + sizeof(int) + 1))
+    return NULL;
+  memcpy(&id, ptr, sizeof(id)), ptr += sizeof(id);
+  fmt.m_level = *ptr++;
+  memcpy(&fmt.m_line, ptr, sizeof(int)), ptr += sizeof(int);
+  fmt.m_arg_cnt = *ptr++;
+  if (fmt.m_arg_cnt > LOG_MGR_ARG_MAX || end - ptr < fmt.m_arg_cnt)
+    return NULL;
+  memcpy(fmt.m_arg_type, ptr, fmt.m_arg_cnt), ptr += fmt.m_arg_cnt;
+
+  if (!(fmt.m_file = _str_get(&ptr, end)) ||
+      !(fmt.m_func = _str_get(&ptr, end)) ||
+      !(fmt.m_format = _str_get(&ptr, end)))
+    goto err;
+
+  /* 编号从1开始按顺序分配，超出已有的定义个数说明记录已损坏 */
+  if (!id || id > ++g_def_cnt)
+    goto err;
+  if (id >= g_fmt_max) {
+    for (max = g_fmt_max * 2 + 64; max <= id; max *= 2)
+      ;
+    if (!(fmts = realloc(g_fmts, sizeof(*fmts) * max)))
+      goto err;
+    memset(fmts + g_fmt_max, 0, sizeof(*fmts) * (max - g_fmt_max));
+    g_fmts = fmts, g_fmt_max = max;
+  }
+
+  free(g_fmts[id].m_file), free(g_fmts[id].m_func), free(g_fmts[id].m_format);
+  g_fmts[id] = fmt;
+  return ptr;
+
+err:
+  free(fmt.m_file), free(fmt.m_func), free(fmt.m_format);
+  return NULL;
+}
+
+/* @func:
+ *  输出时间戳，和log_mgr文本模式的格式相同
+ */
+static void _time_put(uint64_t ns) {
+  time_t sec = ns / 1000000000;
+  long frac = ns % 1000000000;
+  struct tm ltm;
+  char buf[64];
+  int i = 0;
+
+  localtime_r(&sec, &ltm);
+  strftime(buf, sizeof(buf), "%b %d %T", &ltm);
+  fputs(buf, stdout);
+  if (g_precision <= 0)
+    return;
+  for (i = g_precision; i < 9; i++)
+    frac /= 10;
+  printf(".%0*ld", g_precision, frac);
+}
+
+/* @func:
+ *  按照格式串和原始参数输出一条日志
+ */
+static bool _log_render(const decode_fmt_t *fmt, const char *ptr,
+                        const char *end) {
+  const char *format = fmt->m_format, *start = NULL;
+  char spec[64], *str = NULL;
+  int star[2], star_cnt = 0, arg = 0;
+  size_t len = 0;
+  union {
+    int m_int;
+    long long m_long;
+    double m_double;
+    long double m_ldouble;
+    void *m_ptr;
+  } v;
+
+#define _ARG_GET(field)                                                        \
+  do {                                                                         \
+    if (end - ptr < (long)sizeof(v.field))                                     \
+      return false;                                                            \
+    memcpy(&v.field, ptr, sizeof(v.field)), ptr += sizeof(v.field);            \
+  } while (0)
+
+#define _SPEC_PRINT(value)                                                     \
+  do {                                                                         \
+    if (star_cnt == 0)                                                         \
+      printf(spec, value);                                                     \
+    else if (star_cnt == 1)                                                    \
+      printf(spec, star[0], value);                                            \
+    else                                                                       \
+      printf(spec, star[0], star[1], value);                                   \
+  } while (0)
+
+  while (*format) {
+    if (*format != '%') {
+      putchar(*format++);
+      continue;
+    }
+
+    /* 复制一个完整的转换说明 */
+    start = format++;
+    while (*format && !strchr("diouxXcCeEfFgGaAsSpnm%", *format))
+      format++;
+    if (!*format || (len = format - start + 1) >= sizeof(spec))
+      return false;
+    memcpy(spec, start, len);
+    spec[len] = '\0';
+    format++;
+
+    if (spec[len - 1] == '%') {
+      putchar('%');
+      continue;
+    }
+    if (spec[len - 1] == 'm') {
+      fputs(spec, stdout);
+      continue;
+    }
+
+    for (star_cnt = 0, start = spec; (start = strchr(start, '*')); start++) {
+      if (arg >= fmt->m_arg_cnt || star_cnt >= 2)
+        return false;
+      arg++;
+      _ARG_GET(m_int);
+      star[star_cnt++] = v.m_int;
+    }
+
+    if (arg >= fmt->m_arg_cnt)
+      return false;
+    switch (fmt->m_arg_type[arg++]) {
+    case LOG_MGR_ARG_INT:
+      _ARG_GET(m_int);
+      _SPEC_PRINT(v.m_int);
+      break;
+    case LOG_MGR_ARG_LONG:
+      _ARG_GET(m_long);
+      _SPEC_PRINT(v.m_long);
+      break;
+    case LOG_MGR_ARG_DOUBLE:
+      _ARG_GET(m_double);
+      _SPEC_PRINT(v.m_double);
+      break;
+    case LOG_MGR_ARG_LDOUBLE:
+      _ARG_GET(m_ldouble);
+      _SPEC_PRINT(v.m_ldouble);
+      break;
+    case LOG_MGR_ARG_PTR:
+      _ARG_GET(m_ptr);
+      /* 不能还原指针指向的内容 */
+      if (spec[len - 1] == 'p')
+        _SPEC_PRINT(v.m_ptr);
+      else
+        printf("%p", v.m_ptr);
+      break;
+    case LOG_MGR_ARG_STR:
+      if (!(str = _str_get(&ptr, end)))
+        return false;
+      _SPEC_PRINT(str);
+      free(str);
+      break;
+    default:
+      return false;
+    }
+  }
+#undef _ARG_GET
+#undef _SPEC_PRINT
+  return true;
+}
+
+/* @func:
+ *  解析日志记录，返回记录的结尾
+ */
+static const char *_log_parse(const char *ptr, const char *end) {
+  unsigned int id = 0;
+  uint64_t ns = 0;
+  uint16_t len = 0;
+  decode_fmt_t *fmt = NULL;
+
+  if (end - ptr < (long)(sizeof(id) + sizeof(ns) + sizeof(len)))
+    return NULL;
+  memcpy(&id, ptr, sizeof(id)), ptr += sizeof(id);
+  memcpy(&ns, ptr, sizeof(ns)), ptr += sizeof(ns);
+  memcpy(&len, ptr, sizeof(len)), ptr += sizeof(len);
+  if (end - ptr < len)
+    return NULL;
+
+  if (id >= g_fmt_max || !(fmt = &g_fmts[id])->m_format) {
+    LOG_MGR_DECODE_ERROR_LOG("unknown format id: %u", id);
+    return ptr + len;
+  }
+
+  printf("[%c] [", _level_char_get(fmt->m_level));
+  _time_put(ns);
+  printf("] [%s] [%s:%d]: ", fmt->m_file, fmt->m_func, fmt->m_line);
+  if (!_log_render(fmt, ptr, ptr + len))
+    printf("<bad record, format: %s>", fmt->m_format);
+  putchar('\n');
+  return ptr + len;
+}
+
+int main(int argc, char *argv[]) {
+  const char *ptr = NULL, *end = NULL;
+  char *buf = NULL;
+  size_t size = 0;
+  unsigned int magic = 0;
+  uint16_t len = 0;
+  int opt = 0;
+
+  while ((opt = getopt(argc, argv, "p:")) != -1) {
+    if (opt == 'p') {
+      g_precision = atoi(optarg);
+      if (g_precision > 9)
+        g_precision = 9;
+    } else {
+      MY_PRINTF("usage: %s [-p precision] file", argv[0]);
+      return 1;
+    }
+  }
+  if (optind >= argc) {
+    MY_PRINTF("usage: %s [-p precision] file", argv[0]);
+    return 1;
+  }
+
+  if (!(buf = _file_read(argv[optind], &size)))
+    return 1;
+
+  for (ptr = buf, end = buf + size; ptr && ptr < end;) {
+    switch (*ptr++) {
+    case LOG_MGR_BIN_HEAD:
+      if (end - ptr < (long)sizeof(magic))
+        goto bad;
+      memcpy(&magic, ptr, sizeof(magic)), ptr += sizeof(magic);
+      if (magic != LOG_MGR_BIN_MAGIC)
+        goto bad;
+      _fmt_reset();
+      break;
+    case LOG_MGR_BIN_DEF:
+      ptr = _def_parse(ptr, end);
+      break;
+    case LOG_MGR_BIN_LOG:
+      ptr = _log_parse(ptr, end);
+      break;
+    case LOG_MGR_BIN_TEXT:
+      if (end - ptr < (long)sizeof(len))
+        goto bad;
+      memcpy(&len, ptr, sizeof(len)), ptr += sizeof(len);
+      if (end - ptr < len)
+        goto bad;
+      fwrite(ptr, 1, len, stdout);
+      ptr += len;
+      break;
+    default:
+      goto bad;
+    }
+  }
+  if (!ptr)
+    goto bad;
+
+  _fmt_reset();
+  free(g_fmts);
+  free(buf);
+  return 0;
+
+bad:
+  LOG_MGR_DECODE_ERROR_LOG("bad record at offset: %ld",
+                           ptr ? (long)(ptr - buf - 1) : -1L);
+  _fmt_reset();
+  free(g_fmts);
+  free(buf);
+  return 1;
+}
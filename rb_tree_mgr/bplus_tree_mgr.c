@@ -0,0 +1,558 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+#include "bplus_tree_mgr.h"
+
+/* 除了根，每个节点至少有一半的data */
+#define BPLUS_TREE_MGR_MIN (BPLUS_TREE_MGR_ORDER / 2)
+#define BPLUS_TREE_MGR_ALIGN 64
+
+#define MY_PRINTF(format, ...) printf(format"\n", ##__VA_ARGS__)
+#define BPLUS_TREE_MGR_TRACE_LOG MY_PRINTF
+#define BPLUS_TREE_MGR_ERROR_LOG MY_PRINTF
+
+static bplus_tree_node_t* _bplus_tree_node_new(bool is_leaf)
+{
+	void *node = NULL;
+
+	if ((errno = posix_memalign(&node, BPLUS_TREE_MGR_ALIGN, sizeof(bplus_tree_node_t)))) {
+		BPLUS_TREE_MGR_ERROR_LOG("posix_memalign error, errno: %d - %s", errno, strerror(errno));
+		return NULL;
+	}
+	memset(node, 0, sizeof(bplus_tree_node_t));
+	((bplus_tree_node_t*)node)->m_is_leaf = is_leaf;
+	return (bplus_tree_node_t*)node;
+}
+
+/* @func:
+ *	keys中小于key的个数，keys是升序的，一组里有不小于key的就不用再往后比了
+ */
+static unsigned int _bplus_tree_key_rank(const int64_t *keys, unsigned int cnt, int64_t key)
+{
+	unsigned int i = 0, rank = 0, mask = 0;
+
+#if defined(__AVX2__)
+	__m256i k = _mm256_set1_epi64x(key);
+
+	for (; i + 4 <= cnt; i += 4) {
+		mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, _mm256_loadu_si256((const __m256i*)(keys + i)))));
+		rank += __builtin_popcount(mask);
+		if (mask != 0XF) return rank;
+	}
+#elif defined(__SSE4_2__)
+	__m128i k = _mm_set1_epi64x(key);
+
+	for (; i + 2 <= cnt; i += 2) {
+		mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, _mm_loadu_si128((const __m128i*)(keys + i)))));
+		rank += __builtin_popcount(mask);
+		if (mask != 0X3) return rank;
+	}
+#endif
+	(void)mask;
+	for (; i < cnt && keys[i] < key; i++) rank++;
+	return rank;
+}
+
+/* @func:
+ *	节点中第一个不小于(is_upper为false)或大于(is_upper为true)sample的位置
+ *	有key时先比key，key相同的再用比较函数往后找；没有key时用比较函数二分
+ */
+static unsigned int _bplus_tree_node_search(bplus_tree_mgr_t *bt, bplus_tree_node_t *node, void *sample, int64_t key, bool is_upper)
+{
+	unsigned int lo = 0, hi = node->m_cnt, mid = 0;
+	int cmp = 0;
+
+	if (bt->m_key) {
+		for (lo = _bplus_tree_key_rank(node->m_key, node->m_cnt, key); lo < node->m_cnt && node->m_key[lo] == key; lo++) {
+			cmp = bt->m_cmp(node->m_data[lo], sample);
+			if (cmp > 0 || (cmp == 0 && !is_upper)) break;
+		}
+		return lo;
+	}
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		cmp = bt->m_cmp(node->m_data[mid], sample);
+		if (cmp < 0 || (cmp == 0 && is_upper)) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+/* @func:
+ *	从根走到叶子，内部节点按is_upper选子树，path和idx记录经过的节点和子树下标，返回叶子
+ */
+static bplus_tree_node_t* _bplus_tree_mgr_descend(bplus_tree_mgr_t *bt, void *sample, int64_t key, bool is_upper,
+								bplus_tree_node_t **path, unsigned int *idx, unsigned int *depth)
+{
+	bplus_tree_node_t *node = bt->m_root;
+	unsigned int i = 0;
+
+	*depth = 0;
+	while (node && !node->m_is_leaf) {
+		i = _bplus_tree_node_search(bt, node, sample, key, is_upper);
+		if (path) path[*depth] = node, idx[*depth] = i;
+		(*depth)++;
+		node = node->m_child[i];
+	}
+	return node;
+}
+
+static inline int64_t _bplus_tree_mgr_key(bplus_tree_mgr_t *bt, const void *data)
+{
+	return bt->m_key ? bt->m_key(data) : 0;
+}
+
+/* @func:
+ *	查找和sample相等的data；分隔值是右子树最小的data，等于分隔值时往右走才能找到它
+ */
+static void* _bplus_tree_mgr_find(bplus_tree_mgr_t *bt, void *sample)
+{
+	bplus_tree_node_t *leaf = NULL;
+	unsigned int pos = 0, depth = 0;
+	int64_t key = _bplus_tree_mgr_key(bt, sample);
+
+	if (!(leaf = _bplus_tree_mgr_descend(bt, sample, key, true, NULL, NULL, &depth))) return NULL;
+	pos = _bplus_tree_node_search(bt, leaf, sample, key, false);
+	if (pos < leaf->m_cnt && !bt->m_cmp(leaf->m_data[pos], sample)) return leaf->m_data[pos];
+	return NULL;
+}
+
+/* @func:
+ *	第一个不小于sample的位置，这个叶子里都比sample小时是下一个叶子的开头
+ */
+static bplus_tree_node_t* _bplus_tree_mgr_lower_bound(bplus_tree_mgr_t *bt, void *sample, unsigned int *pos)
+{
+	bplus_tree_node_t *leaf = NULL;
+	unsigned int depth = 0;
+	int64_t key = _bplus_tree_mgr_key(bt, sample);
+
+	if (!(leaf = _bplus_tree_mgr_descend(bt, sample, key, false, NULL, NULL, &depth))) return NULL;
+	if ((*pos = _bplus_tree_node_search(bt, leaf, sample, key, false)) < leaf->m_cnt) return leaf;
+	*pos = 0;
+	return leaf->m_next;
+}
+
+static bplus_tree_mgr_t* _bplus_tree_mgr_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp,
+								rb_tree_node_memcpy_t cpy, bplus_tree_key_t key, size_t max_node)
+{
+	if (!cmp || !max_node) return NULL;
+	if (!dealloc) dealloc = free;
+	if (!cpy) cpy = memcpy;
+	bplus_tree_mgr_t *bt = NULL;
+	pthread_rwlockattr_t attr;
+
+	if (!(bt = (bplus_tree_mgr_t*)calloc(1, sizeof(bplus_tree_mgr_t)))) {
+		BPLUS_TREE_MGR_ERROR_LOG("calloc error, errno: %d - %s", errno, strerror(errno));
+		return NULL;
+	}
+
+	/* 和rb_tree_mgr一样用写优先的读写锁 */
+	pthread_rwlockattr_init(&attr);
+	pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	if ((errno = pthread_rwlock_init(&bt->m_rwlock, &attr))) {
+		BPLUS_TREE_MGR_ERROR_LOG("pthread_rwlock_init error, errno: %d - %s", errno, strerror(errno));
+		pthread_rwlockattr_destroy(&attr);
+		free(bt);
+		return NULL;
+	}
+	pthread_rwlockattr_destroy(&attr);
+
+	bt->m_free = dealloc, bt->m_cmp = cmp;
+	bt->m_cpy = cpy, bt->m_key = key;
+	bt->m_max_node = max_node;
+	return bt;
+}
+
+/* @func:
+ *	分配一个管理器，参数和rb_tree_mgr_new相同
+ */
+bplus_tree_mgr_t* bplus_tree_mgr_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp,
+								rb_tree_node_memcpy_t cpy, size_t max_node)
+{
+	return _bplus_tree_mgr_new(dealloc, cmp, cpy, NULL, max_node);
+}
+
+/* @func:
+ *	分配一个带key的管理器，节点内用SIMD比较key
+ */
+bplus_tree_mgr_t* bplus_tree_mgr_key_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp,
+								rb_tree_node_memcpy_t cpy, bplus_tree_key_t key, size_t max_node)
+{
+	if (!key) return NULL;
+	return _bplus_tree_mgr_new(dealloc, cmp, cpy, key, max_node);
+}
+
+static void _bplus_tree_node_free(bplus_tree_node_t *node)
+{
+	unsigned int i = 0;
+
+	if (!node->m_is_leaf) {
+		for (i = 0; i <= node->m_cnt; i++) _bplus_tree_node_free(node->m_child[i]);
+	}
+	free(node);
+}
+
+/* @func:
+ *	销毁管理器和所有的data
+ */
+void bplus_tree_mgr_free(bplus_tree_mgr_t *bt)
+{
+	if (!bt) return ;
+	bplus_tree_node_t *leaf = NULL;
+	unsigned int i = 0;
+
+	pthread_rwlock_wrlock(&bt->m_rwlock);
+	for (leaf = bt->m_head; leaf; leaf = leaf->m_next) {
+		for (i = 0; i < leaf->m_cnt; i++) bt->m_free(leaf->m_data[i]);
+	}
+	if (bt->m_root) _bplus_tree_node_free(bt->m_root);
+	pthread_rwlock_unlock(&bt->m_rwlock);
+	pthread_rwlock_destroy(&bt->m_rwlock);
+	free(bt);
+}
+
+/* @func:
+ *	查找和sample相等的data，没有时返回NULL
+ */
+void* bplus_tree_mgr_find(bplus_tree_mgr_t *bt, void *sample)
+{
+	if (!bt || !sample) return NULL;
+	void *data = NULL;
+
+	pthread_rwlock_rdlock(&bt->m_rwlock);
+	data = _bplus_tree_mgr_find(bt, sample);
+	pthread_rwlock_unlock(&bt->m_rwlock);
+	return data;
+}
+
+/* @func:
+ *	根据sample去查找，找到则保存副本到dst中
+ */
+void* bplus_tree_mgr_cpy(bplus_tree_mgr_t *bt, void *sample, void *dst, size_t size)
+{
+	if (!bt || !sample || !dst || !size) return NULL;
+	void *data = NULL, *ret = NULL;
+
+	pthread_rwlock_rdlock(&bt->m_rwlock);
+	if ((data = _bplus_tree_mgr_find(bt, sample))) {
+		bt->m_cpy(dst, data, size);
+		ret = dst;
+	}
+	pthread_rwlock_unlock(&bt->m_rwlock);
+	return ret;
+}
+
+/* @func:
+ *	在pos处插入一个key和data，内部节点同时在pos + 1处插入右子树
+ */
+static void _bplus_tree_node_insert_at(bplus_tree_node_t *node, unsigned int pos, int64_t key, void *data, bplus_tree_node_t *child)
+{
+	unsigned int move = node->m_cnt - pos;
+
+	memmove(node->m_key + pos + 1, node->m_key + pos, move * sizeof(int64_t));
+	memmove(node->m_data + pos + 1, node->m_data + pos, move * sizeof(void*));
+	node->m_key[pos] = key;
+	node->m_data[pos] = data;
+	if (!node->m_is_leaf) {
+		memmove(node->m_child + pos + 2, node->m_child + pos + 1, move * sizeof(bplus_tree_node_t*));
+		node->m_child[pos + 1] = child;
+	}
+	node->m_cnt++;
+}
+
+/* @func:
+ *	删除pos处的key和data，内部节点同时删除pos + 1处的右子树
+ */
+static void _bplus_tree_node_remove_at(bplus_tree_node_t *node, unsigned int pos)
+{
+	unsigned int move = node->m_cnt - pos - 1;
+
+	memmove(node->m_key + pos, node->m_key + pos + 1, move * sizeof(int64_t));
+	memmove(node->m_data + pos, node->m_data + pos + 1, move * sizeof(void*));
+	if (!node->m_is_leaf) memmove(node->m_child + pos + 1, node->m_child + pos + 2, move * sizeof(bplus_tree_node_t*));
+	node->m_cnt--;
+}
+
+/* @func:
+ *	把多出一个data的节点的右半边移到r，要放进父节点的分隔值通过key和data返回
+ *	叶子的分隔值是右半边第一个data的副本；内部节点把中间的分隔值移到父节点
+ */
+static void _bplus_tree_node_split(bplus_tree_node_t *node, bplus_tree_node_t *r, int64_t *key, void **data)
+{
+	unsigned int half = node->m_cnt / 2;
+
+	r->m_is_leaf = node->m_is_leaf;
+	if (node->m_is_leaf) {
+		r->m_cnt = node->m_cnt - half;
+		memcpy(r->m_key, node->m_key + half, r->m_cnt * sizeof(int64_t));
+		memcpy(r->m_data, node->m_data + half, r->m_cnt * sizeof(void*));
+		r->m_prev = node, r->m_next = node->m_next;
+		if (node->m_next) node->m_next->m_prev = r;
+		node->m_next = r;
+		*key = r->m_key[0], *data = r->m_data[0];
+	} else {
+		r->m_cnt = node->m_cnt - half - 1;
+		memcpy(r->m_key, node->m_key + half + 1, r->m_cnt * sizeof(int64_t));
+		memcpy(r->m_data, node->m_data + half + 1, r->m_cnt * sizeof(void*));
+		memcpy(r->m_child, node->m_child + half + 1, (r->m_cnt + 1) * sizeof(bplus_tree_node_t*));
+		*key = node->m_key[half], *data = node->m_data[half];
+	}
+	node->m_cnt = half;
+}
+
+/* @func:
+ *	插入到叶子，满了就分裂，分隔值逐层往上放，根分裂时树长高一层
+ *	路径上从叶子往上连续满了的节点都会分裂，先把要用的节点分配好，分配失败时树不变
+ */
+static bool _bplus_tree_mgr_insert(bplus_tree_mgr_t *bt, void *data)
+{
+	bplus_tree_node_t *path[BPLUS_TREE_MGR_MAX_DEPTH], *spare[BPLUS_TREE_MGR_MAX_DEPTH + 1], *node = NULL, *root = NULL;
+	unsigned int idx[BPLUS_TREE_MGR_MAX_DEPTH], depth = 0, level = 0, spare_cnt = 0, i = 0;
+	int64_t key = _bplus_tree_mgr_key(bt, data), sep_key = 0;
+	void *sep_data = NULL;
+
+	if (!bt->m_root) {
+		if (!(bt->m_root = bt->m_head = _bplus_tree_node_new(true))) return false;
+	}
+
+	node = _bplus_tree_mgr_descend(bt, data, key, true, path, idx, &depth);
+	for (level = depth, root = node; root->m_cnt == BPLUS_TREE_MGR_ORDER; root = path[--level]) {
+		spare_cnt++;
+		if (!level) {
+			spare_cnt++;
+			break;
+		}
+	}
+	for (i = 0; i < spare_cnt; i++) {
+		if (!(spare[i] = _bplus_tree_node_new(false))) {
+			while (i-- > 0) free(spare[i]);
+			return false;
+		}
+	}
+
+	_bplus_tree_node_insert_at(node, _bplus_tree_node_search(bt, node, data, key, true), key, data, NULL);
+	for (i = 0; node->m_cnt > BPLUS_TREE_MGR_ORDER; i++) {
+		_bplus_tree_node_split(node, spare[i], &sep_key, &sep_data);
+		if (!depth) {
+			root = spare[++i];
+			root->m_child[0] = node;
+			_bplus_tree_node_insert_at(root, 0, sep_key, sep_data, spare[i - 1]);
+			bt->m_root = root;
+			break;
+		}
+		depth--;
+		_bplus_tree_node_insert_at(path[depth], idx[depth], sep_key, sep_data, spare[i]);
+		node = path[depth];
+	}
+	return true;
+}
+
+/* @func:
+ *	插入data，相等的data插在后面
+ */
+bool bplus_tree_mgr_insert(bplus_tree_mgr_t *bt, void *data)
+{
+	if (!bt || !data) return false;
+	bool ret = false;
+
+	pthread_rwlock_wrlock(&bt->m_rwlock);
+	if (bt->m_cur_node < bt->m_max_node) {
+		if ((ret = _bplus_tree_mgr_insert(bt, data))) bt->m_cur_node++;
+	}
+	pthread_rwlock_unlock(&bt->m_rwlock);
+	return ret;
+}
+
+/* @func:
+ *	node是parent的第i个子树，data不够了，向左右兄弟借一个，借不到就和兄弟合并
+ *	返回true表示合并了，parent少了一个分隔值，要继续检查parent
+ */
+static bool _bplus_tree_node_rebalance(bplus_tree_node_t *parent, unsigned int i, bplus_tree_node_t *node)
+{
+	bplus_tree_node_t *left = i > 0 ? parent->m_child[i - 1] : NULL;
+	bplus_tree_node_t *right = i < parent->m_cnt ? parent->m_child[i + 1] : NULL;
+	bplus_tree_node_t *child = NULL;
+
+	if (left && left->m_cnt > BPLUS_TREE_MGR_MIN) {
+		if (node->m_is_leaf) {
+			_bplus_tree_node_insert_at(node, 0, left->m_key[left->m_cnt - 1], left->m_data[left->m_cnt - 1], NULL);
+			parent->m_key[i - 1] = node->m_key[0], parent->m_data[i - 1] = node->m_data[0];
+		} else {
+			/* 父节点的分隔值降下来，左兄弟最后一个子树跟着过来，左兄弟最后一个分隔值升上去 */
+			child = node->m_child[0];
+			node->m_child[0] = left->m_child[left->m_cnt];
+			_bplus_tree_node_insert_at(node, 0, parent->m_key[i - 1], parent->m_data[i - 1], child);
+			parent->m_key[i - 1] = left->m_key[left->m_cnt - 1], parent->m_data[i - 1] = left->m_data[left->m_cnt - 1];
+		}
+		left->m_cnt--;
+		return false;
+	}
+
+	if (right && right->m_cnt > BPLUS_TREE_MGR_MIN) {
+		if (node->m_is_leaf) {
+			_bplus_tree_node_insert_at(node, node->m_cnt, right->m_key[0], right->m_data[0], NULL);
+			_bplus_tree_node_remove_at(right, 0);
+			parent->m_key[i] = right->m_key[0], parent->m_data[i] = right->m_data[0];
+		} else {
+			_bplus_tree_node_insert_at(node, node->m_cnt, parent->m_key[i], parent->m_data[i], right->m_child[0]);
+			parent->m_key[i] = right->m_key[0], parent->m_data[i] = right->m_data[0];
+			/* remove_at删的是m_child[1]，先把它挪到m_child[0]，等于删掉了m_child[0] */
+			right->m_child[0] = right->m_child[1];
+			_bplus_tree_node_remove_at(right, 0);
+		}
+		return false;
+	}
+
+	/* 合并到左边的节点，右边的释放掉 */
+	if (left) right = node, i--;
+	else left = node;
+	if (left->m_is_leaf) {
+		left->m_next = right->m_next;
+		if (right->m_next) right->m_next->m_prev = left;
+	} else {
+		left->m_key[left->m_cnt] = parent->m_key[i], left->m_data[left->m_cnt] = parent->m_data[i];
+		left->m_cnt++;
+		memcpy(left->m_child + left->m_cnt, right->m_child, (right->m_cnt + 1) * sizeof(bplus_tree_node_t*));
+	}
+	memcpy(left->m_key + left->m_cnt, right->m_key, right->m_cnt * sizeof(int64_t));
+	memcpy(left->m_data + left->m_cnt, right->m_data, right->m_cnt * sizeof(void*));
+	left->m_cnt += right->m_cnt;
+	_bplus_tree_node_remove_at(parent, i);
+	free(right);
+	return true;
+}
+
+/* @func:
+ *	删除一个和sample相等的data
+ *	分隔值始终是右子树最小的data，删掉叶子的第一个data时，要把引用它的分隔值换成叶子新的第一个；
+ *	这个分隔值在路径上第一个不是从最左子树下来的那层
+ */
+static bool _bplus_tree_mgr_del(bplus_tree_mgr_t *bt, void *sample)
+{
+	bplus_tree_node_t *path[BPLUS_TREE_MGR_MAX_DEPTH], *node = NULL, *root = NULL;
+	unsigned int idx[BPLUS_TREE_MGR_MAX_DEPTH], depth = 0, level = 0, pos = 0;
+	int64_t key = _bplus_tree_mgr_key(bt, sample);
+	void *data = NULL;
+
+	if (!(node = _bplus_tree_mgr_descend(bt, sample, key, true, path, idx, &depth))) return false;
+	pos = _bplus_tree_node_search(bt, node, sample, key, false);
+	if (pos >= node->m_cnt || bt->m_cmp(node->m_data[pos], sample)) return false;
+
+	data = node->m_data[pos];
+	_bplus_tree_node_remove_at(node, pos);
+	if (!pos && node->m_cnt) {
+		for (level = depth; level-- > 0; ) {
+			if (!idx[level]) continue;
+			if (path[level]->m_data[idx[level] - 1] == data) {
+				path[level]->m_key[idx[level] - 1] = node->m_key[0];
+				path[level]->m_data[idx[level] - 1] = node->m_data[0];
+			}
+			break;
+		}
+	}
+
+	while (depth && node->m_cnt < BPLUS_TREE_MGR_MIN) {
+		depth--;
+		if (!_bplus_tree_node_rebalance(path[depth], idx[depth], node)) break;
+		node = path[depth];
+	}
+
+	root = bt->m_root;
+	if (!root->m_cnt) {
+		if (root->m_is_leaf) bt->m_root = bt->m_head = NULL;
+		else bt->m_root = root->m_child[0];
+		free(root);
+	}
+	bt->m_free(data);
+	return true;
+}
+
+/* @func:
+ *	删除一个和sample相等的data
+ */
+bool bplus_tree_mgr_del(bplus_tree_mgr_t *bt, void *sample)
+{
+	if (!bt || !sample) return false;
+	bool ret = false;
+
+	pthread_rwlock_wrlock(&bt->m_rwlock);
+	if ((ret = _bplus_tree_mgr_del(bt, sample))) bt->m_cur_node--;
+	pthread_rwlock_unlock(&bt->m_rwlock);
+	return ret;
+}
+
+/* @func:
+ *	返回第一个不小于sample的data，没有时返回NULL
+ */
+void* bplus_tree_mgr_lower_bound(bplus_tree_mgr_t *bt, void *sample)
+{
+	if (!bt || !sample) return NULL;
+	bplus_tree_node_t *leaf = NULL;
+	unsigned int pos = 0;
+	void *data = NULL;
+
+	pthread_rwlock_rdlock(&bt->m_rwlock);
+	if ((leaf = _bplus_tree_mgr_lower_bound(bt, sample, &pos))) data = leaf->m_data[pos];
+	pthread_rwlock_unlock(&bt->m_rwlock);
+	return data;
+}
+
+/* @func:
+ *	按顺序遍历[low, high)范围内的data，low为NULL时从头开始，high为NULL时到末尾，
+ *	遍历时持有读锁，visit里不能再调用这个管理器的接口；返回遍历过的data数
+ *	找到起点后只沿着叶子链表往后走，一个叶子里的data是连续的
+ */
+size_t bplus_tree_mgr_range(bplus_tree_mgr_t *bt, void *low, void *high, rb_tree_mgr_visit_t visit, void *arg)
+{
+	if (!bt || !visit) return 0;
+	bplus_tree_node_t *leaf = NULL;
+	unsigned int pos = 0;
+	size_t cnt = 0;
+
+	pthread_rwlock_rdlock(&bt->m_rwlock);
+	leaf = low ? _bplus_tree_mgr_lower_bound(bt, low, &pos) : bt->m_head;
+	for (; leaf; leaf = leaf->m_next, pos = 0) {
+		for (; pos < leaf->m_cnt; pos++) {
+			if (high && bt->m_cmp(leaf->m_data[pos], high) >= 0) goto out;
+			cnt++;
+			if (!visit(leaf->m_data[pos], arg)) goto out;
+		}
+	}
+out:
+	pthread_rwlock_unlock(&bt->m_rwlock);
+	return cnt;
+}
+
+/* @func:
+ *	打印信息
+ */
+void bplus_tree_mgr_dump(bplus_tree_mgr_t *bt)
+{
+	if (!bt) return ;
+	bplus_tree_node_t *node = NULL;
+	size_t height = 0, leaf_cnt = 0;
+
+	pthread_rwlock_rdlock(&bt->m_rwlock);
+	for (node = bt->m_root; node; node = node->m_is_leaf ? NULL : node->m_child[0]) height++;
+	for (node = bt->m_head; node; node = node->m_next) leaf_cnt++;
+	BPLUS_TREE_MGR_TRACE_LOG("==========");
+	BPLUS_TREE_MGR_TRACE_LOG("root: %p", bt->m_root);
+	BPLUS_TREE_MGR_TRACE_LOG("cmp: %p", bt->m_cmp);
+	BPLUS_TREE_MGR_TRACE_LOG("key: %p", bt->m_key);
+	BPLUS_TREE_MGR_TRACE_LOG("height: %lu", height);
+	BPLUS_TREE_MGR_TRACE_LOG("leaf: %lu", leaf_cnt);
+	BPLUS_TREE_MGR_TRACE_LOG("max_node: %lu", bt->m_max_node);
+	BPLUS_TREE_MGR_TRACE_LOG("cur_node: %lu", bt->m_cur_node);
+	BPLUS_TREE_MGR_TRACE_LOG("==========");
+	pthread_rwlock_unlock(&bt->m_rwlock);
+}
@@ -0,0 +1,101 @@
+#ifndef _BPLUS_TREE_MGR_H_
+#define _BPLUS_TREE_MGR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "rb_tree_mgr.h"
+
+/* 一个节点最多的data数，加上分裂用的位置key和data各32个，正好各占4个cache line */
+#define BPLUS_TREE_MGR_ORDER 31
+/* 除了根每个内部节点至少有16个子树，16层足够 */
+#define BPLUS_TREE_MGR_MAX_DEPTH 16
+
+/* 从data取出int64的key，必须和比较函数保持顺序一致：key(a) < key(b)时cmp(a, b) < 0，
+ * key相同时再用比较函数区分；有key时节点里存一份，查找时用SIMD一次比较多个key */
+typedef int64_t (*bplus_tree_key_t) (const void *data);
+
+/* 叶子节点存data，内部节点的m_data[i]是m_child[i + 1]子树中最小的data；
+ * 多一个位置用来先插入再分裂 */
+typedef struct _bplus_tree_node {
+	int64_t m_key[BPLUS_TREE_MGR_ORDER + 1]; /* 节点按cache line对齐，key和data都从行首开始 */
+	void *m_data[BPLUS_TREE_MGR_ORDER + 1];
+	union {
+		struct _bplus_tree_node *m_child[BPLUS_TREE_MGR_ORDER + 2]; /* 内部节点 */
+		struct {
+			struct _bplus_tree_node *m_prev; /* 叶子节点按顺序串成双向链表 */
+			struct _bplus_tree_node *m_next;
+		};
+	};
+	unsigned int m_cnt;
+	bool m_is_leaf;
+} bplus_tree_node_t;
+
+/* B+树，接口和rb_tree_mgr相同，data都在叶子节点，叶子之间有链表，范围遍历不用回到上层 */
+typedef struct _bplus_tree_mgr {
+	bplus_tree_node_t *m_root;
+	bplus_tree_node_t *m_head; /* 最小的叶子 */
+	rb_tree_node_cmp_t m_cmp;
+	rb_tree_node_free_t m_free;
+	rb_tree_node_memcpy_t m_cpy;
+	bplus_tree_key_t m_key; /* 为NULL时在节点内用比较函数二分查找 */
+	size_t m_max_node;
+	size_t m_cur_node;
+	pthread_rwlock_t m_rwlock;
+} bplus_tree_mgr_t;
+
+/* @func:
+ *	分配一个管理器，参数和rb_tree_mgr_new相同
+ */
+bplus_tree_mgr_t* bplus_tree_mgr_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp,
+								rb_tree_node_memcpy_t cpy, size_t max_node);
+
+/* @func:
+ *	分配一个带key的管理器，节点内用SIMD比较key
+ */
+bplus_tree_mgr_t* bplus_tree_mgr_key_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp,
+								rb_tree_node_memcpy_t cpy, bplus_tree_key_t key, size_t max_node);
+
+/* @func:
+ *	销毁管理器和所有的data
+ */
+void bplus_tree_mgr_free(bplus_tree_mgr_t *bt);
+
+/* @func:
+ *	查找和sample相等的data，没有时返回NULL
+ */
+void* bplus_tree_mgr_find(bplus_tree_mgr_t *bt, void *sample);
+
+/* @func:
+ *	根据sample去查找，找到则保存副本到dst中
+ */
+void* bplus_tree_mgr_cpy(bplus_tree_mgr_t *bt, void *sample, void *dst, size_t size);
+
+/* @func:
+ *	插入data，相等的data插在后面
+ */
+bool bplus_tree_mgr_insert(bplus_tree_mgr_t *bt, void *data);
+
+/* @func:
+ *	删除一个和sample相等的data
+ */
+bool bplus_tree_mgr_del(bplus_tree_mgr_t *bt, void *sample);
+
+/* @func:
+ *	返回第一个不小于sample的data，没有时返回NULL
+ */
+void* bplus_tree_mgr_lower_bound(bplus_tree_mgr_t *bt, void *sample);
+
+/* @func:
+ *	按顺序遍历[low, high)范围内的data，low为NULL时从头开始，high为NULL时到末尾，
+ *	遍历时持有读锁，visit里不能再调用这个管理器的接口；返回遍历过的data数
+ */
+size_t bplus_tree_mgr_range(bplus_tree_mgr_t *bt, void *low, void *high, rb_tree_mgr_visit_t visit, void *arg);
+
+/* @func:
+ *	打印信息
+ */
+void bplus_tree_mgr_dump(bplus_tree_mgr_t *bt);
+
+#endif
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -11,6 +12,10 @@
 #define RB_TREE_NODE_COLOR_RED 0X0
 #define RB_TREE_NODE_COLOR_BLACK 0X1
 
+/* 节点池的内存块从64个节点开始，每次翻倍，最多2048个，小树不会浪费太多，大块也不会走mmap */
+#define RB_TREE_MGR_POOL_MIN 64
+#define RB_TREE_MGR_POOL_MAX 2048
+
 #define MY_PRINTF(format, ...) printf(format"\n", ##__VA_ARGS__)
 #define RB_TREE_MGR_TRACE_LOG MY_PRINTF
 #define RB_TREE_MGR_DEBUG_LOG MY_PRINTF
@@ -34,21 +39,77 @@ static bool _rb_tree_node_is_red (rb_tree_node_t *root)
   	return root->m_color == RB_TREE_NODE_COLOR_RED ? true : false;
 }
 
-static rb_tree_node_t *_rb_tree_node_new(void *data, unsigned char color)
+/* @func:
+ *	从节点池取一个节点，先用释放过的，再按顺序切当前内存块，用完了再分配一块
+ *	块头存下一个块的地址，节点按地址顺序切出来，相邻插入的节点在内存中也相邻
+ */
+static rb_tree_node_t* _rb_tree_mgr_pool_get(rb_tree_mgr_t *tm)
+{
+	void **slab = NULL;
+	rb_tree_node_t *tn = NULL;
+
+	if ((tn = tm->m_pool_free)) {
+		tm->m_pool_free = tn->m_right;
+		return tn;
+	}
+
+	if (tm->m_pool_next == tm->m_pool_end) {
+		if (!(slab = (void**)g_tm_alloc(sizeof(rb_tree_node_t) * (tm->m_pool_slab_node + 1)))) {
+			RB_TREE_MGR_WARN_LOG("g_tm_alloc error, errno: %d - %s", errno, strerror(errno));
+			return NULL;
+		}
+		*slab = tm->m_pool_slab;
+		tm->m_pool_slab = slab;
+		tm->m_pool_next = (rb_tree_node_t*)slab + 1;
+		tm->m_pool_end = tm->m_pool_next + tm->m_pool_slab_node;
+		if (tm->m_pool_slab_node < RB_TREE_MGR_POOL_MAX) tm->m_pool_slab_node *= 2;
+	}
+	return tm->m_pool_next++;
+}
+
+static rb_tree_node_t *_rb_tree_node_new(rb_tree_mgr_t *tm, void *data, unsigned char color)
 {
 	if (!data) return NULL;
  	rb_tree_node_t *tn = NULL;
 
-	if (!(tn = (rb_tree_node_t*)g_tm_alloc(sizeof(rb_tree_node_t)))) {
-		RB_TREE_MGR_WARN_LOG("g_tm_alloc error, errno: %d - %s", errno, strerror(errno));
-		return NULL;
-	}
+	if (tm->m_is_intrusive) tn = (rb_tree_node_t*)((char*)data + tm->m_node_offset);
+	else if (!tm->m_is_pooled) {
+		if (!(tn = (rb_tree_node_t*)g_tm_alloc(sizeof(rb_tree_node_t)))) {
+			RB_TREE_MGR_WARN_LOG("g_tm_alloc error, errno: %d - %s", errno, strerror(errno));
+			return NULL;
+		}
+	} else if (!(tn = _rb_tree_mgr_pool_get(tm))) return NULL;
 
+	tn->m_parent = tn->m_left = tn->m_right = NULL;
 	tn->m_color = color;
 	tn->m_data = data;
   	return tn;
 }
 
+/* @func:
+ *	归还节点，不释放data；侵入式时节点就在data里，什么都不用做
+ */
+static void _rb_tree_node_release(rb_tree_mgr_t *tm, rb_tree_node_t *tn)
+{
+	if (tm->m_is_intrusive) return ;
+	if (!tm->m_is_pooled) g_tm_free(tn);
+	else {
+		tn->m_right = tm->m_pool_free;
+		tm->m_pool_free = tn;
+	}
+}
+
+/* @func:
+ *	释放节点和data
+ */
+static void _rb_tree_node_free(rb_tree_mgr_t *tm, rb_tree_node_t *tn)
+{
+	void *data = tn->m_data;
+
+	_rb_tree_node_release(tm, tn);
+	tm->m_free(data);
+}
+
 static void _rb_tree_node_left_rotate(rb_tree_mgr_t *tm, rb_tree_node_t *node)
 {
 	if (!tm || !node) return ;
@@ -96,29 +157,34 @@ void rb_tree_mgr_init(rb_tree_mgr_alloc_t alloc, rb_tree_mgr_free_t dealloc)
 	else g_tm_alloc = alloc, g_tm_free = dealloc;
 }
 
-/* @func:
- *	分配一个管理器
- */
-rb_tree_mgr_t* rb_tree_mgr_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp,
-								rb_tree_node_memcpy_t cpy, size_t max_node)
+static rb_tree_mgr_t* _rb_tree_mgr_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp,
+								rb_tree_node_memcpy_t cpy, bool is_intrusive, bool is_pooled, size_t offset, size_t max_node)
 {
 	if (!cmp || !max_node) return NULL;
 	if (!dealloc) dealloc = free;
 	if (!cpy) cpy = memcpy;
 	rb_tree_mgr_t *tm = NULL;
+	pthread_rwlockattr_t attr;
 
 	if (!(tm = g_tm_alloc(sizeof(rb_tree_mgr_t)))) {
 		RB_TREE_MGR_ERROR_LOG("g_tm_alloc error, errno: %d - %s", errno, strerror(errno));
 		return NULL;
 	}
 
-	if (pthread_mutex_init(&tm->m_mutex, NULL)) {
-		RB_TREE_MGR_ERROR_LOG("pthread_mutex_init error, errno: %d - %s", errno, strerror(errno));
+	/* 默认的读优先会让写线程在读多的时候饿死 */
+	pthread_rwlockattr_init(&attr);
+	pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+	if ((errno = pthread_rwlock_init(&tm->m_rwlock, &attr))) {
+		RB_TREE_MGR_ERROR_LOG("pthread_rwlock_init error, errno: %d - %s", errno, strerror(errno));
+		pthread_rwlockattr_destroy(&attr);
 		goto err;
 	}
+	pthread_rwlockattr_destroy(&attr);
 
 	tm->m_free = dealloc, tm->m_cmp = cmp;
 	tm->m_cpy = cpy, tm->m_max_node = max_node;
+	tm->m_is_intrusive = is_intrusive, tm->m_node_offset = offset;
+	tm->m_is_pooled = is_pooled, tm->m_pool_slab_node = RB_TREE_MGR_POOL_MIN;
 	return tm;
 
 err:
@@ -126,6 +192,34 @@ err:
 	return NULL;
 }
 
+/* @func:
+ *	分配一个管理器
+ */
+rb_tree_mgr_t* rb_tree_mgr_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp,
+								rb_tree_node_memcpy_t cpy, size_t max_node)
+{
+	return _rb_tree_mgr_new(dealloc, cmp, cpy, false, true, 0, max_node);
+}
+
+/* @func:
+ *	分配一个不用节点池的管理器
+ */
+rb_tree_mgr_t* rb_tree_mgr_nopool_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp, 
+								rb_tree_node_memcpy_t cpy, size_t max_node)
+{
+	return _rb_tree_mgr_new(dealloc, cmp, cpy, false, false, 0, max_node);
+}
+
+/* @func:
+ *	分配一个侵入式的管理器，rb_tree_node_t嵌在data里，offset是它在data中的偏移，
+ *	插入删除不再分配释放节点；同一个data不能同时插入两次
+ */
+rb_tree_mgr_t* rb_tree_mgr_intrusive_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp, 
+								rb_tree_node_memcpy_t cpy, size_t offset, size_t max_node)
+{
+	return _rb_tree_mgr_new(dealloc, cmp, cpy, true, false, offset, max_node);
+}
+
 /* @func:
  *	销毁管理器和树上的节点
  */
@@ -133,20 +227,25 @@ void rb_tree_mgr_free(rb_tree_mgr_t *tm)
 {
 	if (!tm) return ;
 	rb_tree_node_t *it = NULL, *save = NULL;
+	void *slab = NULL;
 
-	pthread_mutex_lock(&tm->m_mutex);
+	pthread_rwlock_wrlock(&tm->m_rwlock);
 	for (it = tm->m_root; it; it = save) {
 		if (!it->m_left) {
 			save = it->m_right;
-			tm->m_free(it->m_data);
-			g_tm_free(it);
+			_rb_tree_node_free(tm, it);
 		} else {
 			save = it->m_left;
 			it->m_left = save->m_right;
 			save->m_right= it;
 		}
 	}
-	pthread_mutex_destroy(&tm->m_mutex);
+	while ((slab = tm->m_pool_slab)) {
+		tm->m_pool_slab = *(void**)slab;
+		g_tm_free(slab);
+	}
+	pthread_rwlock_unlock(&tm->m_rwlock);
+	pthread_rwlock_destroy(&tm->m_rwlock);
 	g_tm_free(tm);
 
 	return ;
@@ -179,9 +278,9 @@ rb_tree_node_t* rb_tree_mgr_node_find(rb_tree_mgr_t *tm, void *data)
 	if (!tm || !data) return NULL;
 	rb_tree_node_t *tn = NULL;
 
-	pthread_mutex_lock(&tm->m_mutex);
+	pthread_rwlock_rdlock(&tm->m_rwlock);
 	tn = _rb_tree_mgr_node_find(tm, data);
-	pthread_mutex_unlock(&tm->m_mutex);
+	pthread_rwlock_unlock(&tm->m_rwlock);
 
 	return tn;
 }
@@ -195,12 +294,12 @@ void* rb_tree_node_cpy(rb_tree_mgr_t *tm, void *sample, void *dst, size_t size)
 	rb_tree_node_t *tn = NULL;
 	void *ret = NULL;
 
-	pthread_mutex_lock(&tm->m_mutex);
+	pthread_rwlock_rdlock(&tm->m_rwlock);
 	if ((tn = _rb_tree_mgr_node_find(tm, sample))) {
 		tm->m_cpy(dst, tn->m_data, size);
 		ret = dst;
 	}
-	pthread_mutex_unlock(&tm->m_mutex);
+	pthread_rwlock_unlock(&tm->m_rwlock);
 
 	return ret;
 }
@@ -272,7 +371,7 @@ static bool _rb_tree_mgr_insert(rb_tree_mgr_t *tm, void *data)
 	rb_tree_node_t *tn_cur = NULL, *root = tm->m_root;
 	rb_tree_node_t *tn = NULL;
 
-	if (!(tn = _rb_tree_node_new(data, RB_TREE_NODE_COLOR_RED))) return false;
+	if (!(tn = _rb_tree_node_new(tm, data, RB_TREE_NODE_COLOR_RED))) return false;
 
 	while (root) {
 		tn_cur = root;
@@ -299,12 +398,12 @@ bool rb_tree_mgr_insert(rb_tree_mgr_t *tm, void *data)
 	if (!tm || !data) return false;
 	bool ret = false;
 
-	pthread_mutex_lock(&tm->m_mutex);
+	pthread_rwlock_wrlock(&tm->m_rwlock);
 	if (tm->m_cur_node < tm->m_max_node) {
 		if ((ret = _rb_tree_mgr_insert(tm, data)))
 			tm->m_cur_node++;
 	}
-	pthread_mutex_unlock(&tm->m_mutex);
+	pthread_rwlock_unlock(&tm->m_rwlock);
 	return ret;
 }
 
@@ -441,7 +540,7 @@ bool _rb_tree_mgr_del(rb_tree_mgr_t *tm, void *data)
 	}
 
 	if (color == RB_TREE_NODE_COLOR_BLACK) _rb_tree_delete_fixup(tm, tn_child, tn_parent);
-	tm->m_free(tn->m_data); g_tm_free(tn);
+	_rb_tree_node_free(tm, tn);
 
 	return true;
 }
@@ -454,10 +553,219 @@ bool rb_tree_mgr_del(rb_tree_mgr_t *tm, void *data)
 	if (!tm || !data) return false;
 	bool ret = false;
 
-	pthread_mutex_lock(&tm->m_mutex);
+	pthread_rwlock_wrlock(&tm->m_rwlock);
 	if ((ret = _rb_tree_mgr_del(tm, data))) tm->m_cur_node--;
-	pthread_mutex_unlock(&tm->m_mutex);
+	pthread_rwlock_unlock(&tm->m_rwlock);
+
+	return ret;
+}
+
+/* @func:
+ *	第一个不小于(is_upper为false)或大于(is_upper为true)data的节点
+ */
+static rb_tree_node_t* _rb_tree_mgr_bound(rb_tree_mgr_t *tm, void *data, bool is_upper)
+{
+	rb_tree_node_t *it = NULL, *ret = NULL;
+	int cmp = 0;
+
+	for (it = tm->m_root; it; ) {
+		cmp = tm->m_cmp(it->m_data, data);
+		if (cmp > 0 || (cmp == 0 && !is_upper)) ret = it, it = it->m_left;
+		else it = it->m_right;
+	}
+	return ret;
+}
+
+/* @func:
+ *	返回第一个不小于data的节点，没有时返回NULL
+ */
+rb_tree_node_t* rb_tree_mgr_lower_bound(rb_tree_mgr_t *tm, void *data)
+{
+	if (!tm || !data) return NULL;
+	rb_tree_node_t *tn = NULL;
+
+	pthread_rwlock_rdlock(&tm->m_rwlock);
+	tn = _rb_tree_mgr_bound(tm, data, false);
+	pthread_rwlock_unlock(&tm->m_rwlock);
+	return tn;
+}
+
+/* @func:
+ *	返回第一个大于data的节点，没有时返回NULL
+ */
+rb_tree_node_t* rb_tree_mgr_upper_bound(rb_tree_mgr_t *tm, void *data)
+{
+	if (!tm || !data) return NULL;
+	rb_tree_node_t *tn = NULL;
+
+	pthread_rwlock_rdlock(&tm->m_rwlock);
+	tn = _rb_tree_mgr_bound(tm, data, true);
+	pthread_rwlock_unlock(&tm->m_rwlock);
+	return tn;
+}
+
+static rb_tree_node_t* _rb_tree_node_min(rb_tree_node_t *tn)
+{
+	if (tn) while (tn->m_left) tn = tn->m_left;
+	return tn;
+}
+
+static rb_tree_node_t* _rb_tree_node_max(rb_tree_node_t *tn)
+{
+	if (tn) while (tn->m_right) tn = tn->m_right;
+	return tn;
+}
+
+/* @func:
+ *	中序的下一个节点：有右子树时是右子树的最小节点，否则往上找第一个从左边上来的祖先
+ */
+static rb_tree_node_t* _rb_tree_node_next(rb_tree_node_t *tn)
+{
+	if (tn->m_right) return _rb_tree_node_min(tn->m_right);
+	while (tn->m_parent && tn->m_parent->m_right == tn) tn = tn->m_parent;
+	return tn->m_parent;
+}
+
+static rb_tree_node_t* _rb_tree_node_prev(rb_tree_node_t *tn)
+{
+	if (tn->m_left) return _rb_tree_node_max(tn->m_left);
+	while (tn->m_parent && tn->m_parent->m_left == tn) tn = tn->m_parent;
+	return tn->m_parent;
+}
+
+/* @func:
+ *	返回最小的节点，树为空时返回NULL
+ */
+rb_tree_node_t* rb_tree_mgr_first(rb_tree_mgr_t *tm)
+{
+	if (!tm) return NULL;
+	rb_tree_node_t *tn = NULL;
+
+	pthread_rwlock_rdlock(&tm->m_rwlock);
+	tn = _rb_tree_node_min(tm->m_root);
+	pthread_rwlock_unlock(&tm->m_rwlock);
+	return tn;
+}
+
+/* @func:
+ *	返回最大的节点，树为空时返回NULL
+ */
+rb_tree_node_t* rb_tree_mgr_last(rb_tree_mgr_t *tm)
+{
+	if (!tm) return NULL;
+	rb_tree_node_t *tn = NULL;
+
+	pthread_rwlock_rdlock(&tm->m_rwlock);
+	tn = _rb_tree_node_max(tm->m_root);
+	pthread_rwlock_unlock(&tm->m_rwlock);
+	return tn;
+}
+
+/* @func:
+ *	按顺序返回下一个节点，没有时返回NULL
+ */
+rb_tree_node_t* rb_tree_mgr_next(rb_tree_mgr_t *tm, rb_tree_node_t *tn)
+{
+	if (!tm || !tn) return NULL;
+
+	pthread_rwlock_rdlock(&tm->m_rwlock);
+	tn = _rb_tree_node_next(tn);
+	pthread_rwlock_unlock(&tm->m_rwlock);
+	return tn;
+}
+
+/* @func:
+ *	按顺序返回上一个节点，没有时返回NULL
+ */
+rb_tree_node_t* rb_tree_mgr_prev(rb_tree_mgr_t *tm, rb_tree_node_t *tn)
+{
+	if (!tm || !tn) return NULL;
+
+	pthread_rwlock_rdlock(&tm->m_rwlock);
+	tn = _rb_tree_node_prev(tn);
+	pthread_rwlock_unlock(&tm->m_rwlock);
+	return tn;
+}
+
+/* @func:
+ *	按顺序遍历[low, high)范围内的节点，low为NULL时从头开始，high为NULL时到末尾，
+ *	遍历时持有读锁，visit里不能再调用这个管理器的接口；返回遍历过的节点数
+ */
+size_t rb_tree_mgr_range(rb_tree_mgr_t *tm, void *low, void *high, rb_tree_mgr_visit_t visit, void *arg)
+{
+	if (!tm || !visit) return 0;
+	rb_tree_node_t *tn = NULL;
+	size_t cnt = 0;
+
+	pthread_rwlock_rdlock(&tm->m_rwlock);
+	tn = low ? _rb_tree_mgr_bound(tm, low, false) : _rb_tree_node_min(tm->m_root);
+	for (; tn && (!high || tm->m_cmp(tn->m_data, high) < 0); tn = _rb_tree_node_next(tn)) {
+		cnt++;
+		if (!visit(tn->m_data, arg)) break;
+	}
+	pthread_rwlock_unlock(&tm->m_rwlock);
+	return cnt;
+}
+
+/* @func:
+ *	用nodes[lo, hi)建平衡的子树，中间的做根；最深一层的节点是红色，其他都是黑色，
+ *	这样每条路径的黑色节点数相同
+ */
+static rb_tree_node_t* _rb_tree_mgr_build(rb_tree_node_t **nodes, size_t lo, size_t hi, size_t depth, size_t red_depth)
+{
+	rb_tree_node_t *tn = NULL;
+	size_t mid = lo + (hi - lo) / 2;
+
+	if (lo >= hi) return NULL;
+	tn = nodes[mid];
+	tn->m_color = depth == red_depth ? RB_TREE_NODE_COLOR_RED : RB_TREE_NODE_COLOR_BLACK;
+	if ((tn->m_left = _rb_tree_mgr_build(nodes, lo, mid, depth + 1, red_depth))) tn->m_left->m_parent = tn;
+	if ((tn->m_right = _rb_tree_mgr_build(nodes, mid + 1, hi, depth + 1, red_depth))) tn->m_right->m_parent = tn;
+	return tn;
+}
+
+/* @func:
+ *	用升序排好的data建树，O(n)，不用逐个插入再调整；树必须为空，data不是升序时返回false
+ */
+bool rb_tree_mgr_build(rb_tree_mgr_t *tm, void **data, size_t cnt)
+{
+	if (!tm || (!data && cnt)) return false;
+	rb_tree_node_t **nodes = NULL;
+	size_t i = 0, red_depth = 0;
+	bool ret = false;
+
+	pthread_rwlock_wrlock(&tm->m_rwlock);
+	if (tm->m_root || cnt > tm->m_max_node) goto out;
+	for (i = 0; i < cnt; i++) {
+		if (!data[i] || (i && tm->m_cmp(data[i - 1], data[i]) > 0)) goto out;
+	}
+	if (!cnt) {
+		ret = true;
+		goto out;
+	}
+	if (!(nodes = (rb_tree_node_t**)malloc(cnt * sizeof(rb_tree_node_t*)))) {
+		RB_TREE_MGR_ERROR_LOG("malloc error, errno: %d - %s", errno, strerror(errno));
+		goto out;
+	}
+	for (i = 0; i < cnt; i++) {
+		if (!(nodes[i] = _rb_tree_node_new(tm, data[i], RB_TREE_NODE_COLOR_BLACK))) goto err;
+	}
+
+	/* 最深一层的深度是floor(log2(cnt)) */
+	for (red_depth = 0; (cnt >> (red_depth + 1)); red_depth++);
+	tm->m_root = _rb_tree_mgr_build(nodes, 0, cnt, 0, red_depth);
+	tm->m_root->m_parent = NULL;
+	tm->m_root->m_color = RB_TREE_NODE_COLOR_BLACK;
+	tm->m_cur_node = cnt;
+	ret = true;
+	goto out;
 
+err:
+	/* 只归还节点，data还是调用者的 */
+	while (i-- > 0) _rb_tree_node_release(tm, nodes[i]);
+out:
+	pthread_rwlock_unlock(&tm->m_rwlock);
+	free(nodes);
 	return ret;
 }
 
@@ -496,7 +804,7 @@ void rb_tree_mgr_dump(rb_tree_mgr_t *tm, bool is_dump_node)
 {
 	if (!tm) return ;
 
-	pthread_mutex_lock(&tm->m_mutex);
+	pthread_rwlock_rdlock(&tm->m_rwlock);
 	RB_TREE_MGR_TRACE_LOG("==========");
 	RB_TREE_MGR_TRACE_LOG("root: %p", tm->m_root);
 	RB_TREE_MGR_TRACE_LOG("cmp: %p", tm->m_cmp);
@@ -506,7 +814,7 @@ void rb_tree_mgr_dump(rb_tree_mgr_t *tm, bool is_dump_node)
 	RB_TREE_MGR_TRACE_LOG("cur_node: %lu", tm->m_cur_node);
 	if (is_dump_node) _rb_tree_node_dump(tm->m_root);
 	RB_TREE_MGR_TRACE_LOG("==========");
-	pthread_mutex_unlock(&tm->m_mutex);
+	pthread_rwlock_unlock(&tm->m_rwlock);
 }
 
 
@@ -520,6 +828,11 @@ void rb_tree_mgr_dump(rb_tree_mgr_t *tm, bool is_dump_node)
  *	5. 根节点是黑色
  */
 #include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "bplus_tree_mgr.h"
 
 static int _cmp(const void *ptr_1, const void *ptr_2)
 {
@@ -575,6 +888,522 @@ static void _test_every_path_black_node_count_is_same(rb_tree_node_t *root, size
 	_test_every_path_black_node_count_is_same(root->m_right, black_count);
 }
 
+/* @func:
+ *	检查红黑树的特征3、4、5
+ */
+static void _test_rb_tree_check(rb_tree_mgr_t *tm)
+{
+	size_t black_count = 0;
+
+	if (!tm->m_root) return ;
+	assert(!_rb_tree_node_is_red(tm->m_root));
+	_test_no_red_node_is_parent_child_relationship(tm->m_root);
+	_set_every_path_black_node_count(tm->m_root);
+	_test_every_path_black_node_count_is_same(tm->m_root, &black_count);
+}
+
+typedef struct _intrusive_node {
+	struct _node m_value;
+	rb_tree_node_t m_node;
+} _intrusive_node_t;
+
+/* @func:
+ *	侵入式：节点就在data里，删除和销毁时只调用data的释放函数
+ */
+static void _rb_tree_mgr_intrusive_test(void)
+{
+	#define intrusive_count 10000
+	static _intrusive_node_t nodes[intrusive_count];
+	static size_t free_count = 0;
+	struct _node sample = {0, 0};
+	rb_tree_node_t *tn = NULL;
+	rb_tree_mgr_t *tm = NULL;
+	size_t i = 0;
+
+	assert((tm = rb_tree_mgr_intrusive_new(({
+		void _(void *ptr) {
+			assert(ptr >= (void*)nodes && ptr < (void*)(nodes + intrusive_count));
+			free_count++;
+		}; _;}), _cmp, NULL, offsetof(_intrusive_node_t, m_node), intrusive_count)));
+	for (i = 0; i < intrusive_count; i++) {
+		nodes[i].m_value.m_num = i * 7919 % intrusive_count;
+		assert(rb_tree_mgr_insert(tm, &nodes[i]));
+	}
+	assert(!rb_tree_mgr_insert(tm, &sample));
+	_test_rb_tree_check(tm);
+	assert(!tm->m_pool_slab);
+
+	for (i = 0; i < intrusive_count; i++) {
+		sample.m_num = i * 7919 % intrusive_count;
+		assert((tn = rb_tree_mgr_node_find(tm, &sample)) == &nodes[i].m_node && tn->m_data == &nodes[i]);
+	}
+	for (i = 0; i < intrusive_count; i += 2) {
+		sample.m_num = i;
+		assert(rb_tree_mgr_del(tm, &sample));
+		assert(!rb_tree_mgr_node_find(tm, &sample));
+	}
+	_test_rb_tree_check(tm);
+	assert(free_count == intrusive_count / 2);
+	/* 删除后同一个data可以重新插入 */
+	for (i = 0; i < intrusive_count; i++) {
+		if (nodes[i].m_value.m_num % 2 == 0) assert(rb_tree_mgr_insert(tm, &nodes[i]));
+	}
+	_test_rb_tree_check(tm);
+	rb_tree_mgr_free(tm);
+	assert(free_count == intrusive_count / 2 + intrusive_count);
+	MY_PRINTF("intrusive OK");
+}
+
+/* @func:
+ *	不用节点池：每个节点单独分配，删除后立即释放，不会分配内存块
+ */
+static void _rb_tree_mgr_nopool_test(void)
+{
+	static struct _node nodes[1000];
+	struct _node sample = {0, 0};
+	rb_tree_mgr_t *tm = NULL;
+	size_t i = 0;
+
+	assert((tm = rb_tree_mgr_nopool_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, 1000)));
+	assert(!tm->m_is_pooled);
+	for (i = 0; i < 1000; i++) {
+		nodes[i].m_num = i * 7919 % 1000;
+		assert(rb_tree_mgr_insert(tm, &nodes[i]));
+	}
+	_test_rb_tree_check(tm);
+	for (i = 0; i < 1000; i += 2) {
+		sample.m_num = i;
+		assert(rb_tree_mgr_del(tm, &sample));
+	}
+	_test_rb_tree_check(tm);
+	assert(!tm->m_pool_slab && !tm->m_pool_free);
+	rb_tree_mgr_free(tm);
+	MY_PRINTF("nopool OK");
+}
+
+static double _ns_since(const struct timespec *start, size_t count)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec)) / count;
+}
+
+/* @func:
+ *	100万个节点，每个节点单独分配、节点池、侵入式三种方式插入、查找、删除的耗时
+ *	data都预先分配好，只比较节点的分配和访问；第一轮不计时，让每种方式面对的都是用过的堆
+ */
+static void _rb_tree_mgr_bench(void)
+{
+	#define bench_count (1024 * 1024)
+	const char *name[] = {"malloc", "pool", "intrusive"};
+	_intrusive_node_t *nodes = NULL;
+	struct _node sample = {0, 0};
+	rb_tree_mgr_t *tm = NULL;
+	struct timespec start;
+	size_t i = 0, mode = 0;
+
+	assert((nodes = calloc(bench_count, sizeof(_intrusive_node_t))));
+	for (i = 0; i < bench_count; i++) nodes[i].m_value.m_num = i * 7919 % bench_count;
+
+	assert((tm = rb_tree_mgr_nopool_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, bench_count)));
+	for (i = 0; i < bench_count; i++) rb_tree_mgr_insert(tm, &nodes[i]);
+	rb_tree_mgr_free(tm);
+
+	for (mode = 0; mode < 3; mode++) {
+		if (mode == 0) assert((tm = rb_tree_mgr_nopool_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, bench_count)));
+		else if (mode == 1) assert((tm = rb_tree_mgr_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, bench_count)));
+		else assert((tm = rb_tree_mgr_intrusive_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, 
+			offsetof(_intrusive_node_t, m_node), bench_count)));
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < bench_count; i++) rb_tree_mgr_insert(tm, &nodes[i]);
+		MY_PRINTF("%s insert: %.1f ns/op", name[mode], _ns_since(&start, bench_count));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < bench_count; i++) {
+			sample.m_num = i * 104729 % bench_count;
+			assert(rb_tree_mgr_node_find(tm, &sample));
+		}
+		MY_PRINTF("%s find: %.1f ns/op", name[mode], _ns_since(&start, bench_count));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < bench_count; i++) {
+			sample.m_num = i * 104729 % bench_count;
+			rb_tree_mgr_del(tm, &sample);
+		}
+		MY_PRINTF("%s del: %.1f ns/op", name[mode], _ns_since(&start, bench_count));
+		rb_tree_mgr_free(tm);
+	}
+	free(nodes);
+}
+
+/* @func:
+ *	上下界、正反向遍历、范围遍历和批量建树
+ */
+static void _rb_tree_mgr_order_test(void)
+{
+	#define order_count 1000
+	static struct _node nodes[order_count * 100];
+	void **data = NULL;
+	struct _node sample = {0, 0};
+	rb_tree_node_t *tn = NULL;
+	rb_tree_mgr_t *tm = NULL;
+	size_t i = 0, cnt = 0;
+	int last = 0;
+
+	/* 偶数 */
+	assert((tm = rb_tree_mgr_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, order_count * 100)));
+	assert(!rb_tree_mgr_first(tm) && !rb_tree_mgr_last(tm));
+	for (i = 0; i < order_count; i++) {
+		nodes[i].m_num = (i * 7919 % order_count) * 2;
+		assert(rb_tree_mgr_insert(tm, &nodes[i]));
+	}
+	for (i = 0; i < order_count * 2; i++) {
+		sample.m_num = i;
+		tn = rb_tree_mgr_lower_bound(tm, &sample);
+		if (i + i % 2 >= order_count * 2) assert(!tn);
+		else assert(tn && ((struct _node*)tn->m_data)->m_num == (int)(i + i % 2));
+		tn = rb_tree_mgr_upper_bound(tm, &sample);
+		if (i >= order_count * 2 - 2) assert(!tn);
+		else assert(tn && ((struct _node*)tn->m_data)->m_num == (int)(i + 2 - i % 2));
+	}
+	sample.m_num = -1;
+	assert(((struct _node*)rb_tree_mgr_lower_bound(tm, &sample)->m_data)->m_num == 0);
+	sample.m_num = order_count * 2;
+	assert(!rb_tree_mgr_lower_bound(tm, &sample));
+
+	for (cnt = 0, tn = rb_tree_mgr_first(tm); tn; tn = rb_tree_mgr_next(tm, tn), cnt++) {
+		assert(((struct _node*)tn->m_data)->m_num == (int)cnt * 2);
+	}
+	assert(cnt == order_count);
+	for (cnt = 0, tn = rb_tree_mgr_last(tm); tn; tn = rb_tree_mgr_prev(tm, tn), cnt++) {
+		assert(((struct _node*)tn->m_data)->m_num == (int)(order_count - 1 - cnt) * 2);
+	}
+	assert(cnt == order_count);
+
+	/* [100, 200)里有50个偶数 */
+	sample.m_num = 100;
+	assert(rb_tree_mgr_range(tm, &sample, &(struct _node){200, 0}, ({
+		bool _(void *data, void *arg) {
+			assert(*(int*)arg < ((struct _node*)data)->m_num);
+			*(int*)arg = ((struct _node*)data)->m_num;
+			return true;
+		}; _;}), &(int){99}) == 50);
+	assert(rb_tree_mgr_range(tm, NULL, NULL, ({ bool _(void *data, void *arg) { (void)data; return --*(int*)arg > 0; }; _;}), 
+		&(int){10}) == 10);
+	assert(rb_tree_mgr_range(tm, NULL, NULL, ({ bool _(void *data, void *arg) { (void)data; (void)arg; return true; }; _;}), 
+		NULL) == order_count);
+
+	/* 非空的树、乱序的data都不能建树 */
+	assert((data = malloc(order_count * 100 * sizeof(void*))));
+	for (i = 0; i < order_count * 100; i++) nodes[i].m_num = i, data[i] = &nodes[i];
+	assert(!rb_tree_mgr_build(tm, data, 10));
+	rb_tree_mgr_free(tm);
+
+	for (cnt = 0; cnt <= order_count * 100; cnt = cnt * 3 + 1) {
+		assert((tm = rb_tree_mgr_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, order_count * 100)));
+		if (cnt > 1) {
+			data[0] = &nodes[1], data[1] = &nodes[0];
+			assert(!rb_tree_mgr_build(tm, data, cnt));
+			data[0] = &nodes[0], data[1] = &nodes[1];
+		}
+		assert(rb_tree_mgr_build(tm, data, cnt));
+		assert(tm->m_cur_node == cnt);
+		_test_rb_tree_check(tm);
+		for (i = 0, last = -1, tn = rb_tree_mgr_first(tm); tn; tn = rb_tree_mgr_next(tm, tn), i++) {
+			assert(((struct _node*)tn->m_data)->m_num == last + 1);
+			last++;
+		}
+		assert(i == cnt);
+		/* 建出来的树可以正常增删 */
+		for (i = 0; i < cnt; i += 2) assert(rb_tree_mgr_del(tm, &nodes[i]));
+		_test_rb_tree_check(tm);
+		for (i = 0; i < cnt; i += 2) assert(rb_tree_mgr_insert(tm, &nodes[i]));
+		_test_rb_tree_check(tm);
+		rb_tree_mgr_free(tm);
+	}
+	free(data);
+	MY_PRINTF("order OK");
+}
+
+/* @func:
+ *	100万个升序的data，逐个插入和批量建树的耗时
+ */
+static void _rb_tree_mgr_build_bench(void)
+{
+	struct _node *nodes = NULL;
+	void **data = NULL;
+	rb_tree_mgr_t *tm = NULL;
+	struct timespec start;
+	size_t i = 0;
+
+	assert((nodes = calloc(bench_count, sizeof(struct _node))) && (data = malloc(bench_count * sizeof(void*))));
+	for (i = 0; i < bench_count; i++) nodes[i].m_num = i, data[i] = &nodes[i];
+
+	assert((tm = rb_tree_mgr_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, bench_count)));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < bench_count; i++) rb_tree_mgr_insert(tm, data[i]);
+	MY_PRINTF("sorted insert: %.1f ns/op", _ns_since(&start, bench_count));
+	rb_tree_mgr_free(tm);
+
+	assert((tm = rb_tree_mgr_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, bench_count)));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	assert(rb_tree_mgr_build(tm, data, bench_count));
+	MY_PRINTF("build: %.1f ns/op", _ns_since(&start, bench_count));
+	rb_tree_mgr_free(tm);
+	free(nodes);
+	free(data);
+}
+
+/* @func:
+ *	90%查找、10%删除再插入，线程数逐渐增加；每个线程只改自己那部分key，读所有key
+ */
+static void _rb_tree_mgr_rwlock_bench(void)
+{
+	#define rw_count 100000
+	#define rw_ops 400000
+	static struct _node nodes[rw_count];
+	rb_tree_mgr_t *tm = NULL;
+	pthread_t pt[8];
+	struct timespec start;
+	size_t thread_cnt = 0, i = 0;
+
+	assert((tm = rb_tree_mgr_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, rw_count)));
+	for (i = 0; i < rw_count; i++) {
+		nodes[i].m_num = i;
+		assert(rb_tree_mgr_insert(tm, &nodes[i]));
+	}
+
+	for (thread_cnt = 1; thread_cnt <= 8; thread_cnt *= 2) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < thread_cnt; i++) {
+			pthread_create(&pt[i], NULL, ({
+				void* _(void *arg) {
+					unsigned int seed = (uintptr_t)arg + 1;
+					struct _node sample = {0, 0};
+					size_t k = 0, key = 0;
+
+					for (k = 0; k < rw_ops / thread_cnt; k++) {
+						if (rand_r(&seed) % 10) {
+							/* 可能正好被别的线程删除了，不检查结果 */
+							sample.m_num = rand_r(&seed) % rw_count;
+							rb_tree_mgr_node_find(tm, &sample);
+						} else {
+							key = rand_r(&seed) % (rw_count / thread_cnt) * thread_cnt + (uintptr_t)arg;
+							assert(rb_tree_mgr_del(tm, &nodes[key]));
+							assert(rb_tree_mgr_insert(tm, &nodes[key]));
+						}
+					}
+					return NULL;
+				}; _;}), (void*)i);
+		}
+		for (i = 0; i < thread_cnt; i++) pthread_join(pt[i], NULL);
+		MY_PRINTF("%lu threads, 90%% reads: %.1f ns/op", thread_cnt, _ns_since(&start, rw_ops / thread_cnt * thread_cnt));
+	}
+	_test_rb_tree_check(tm);
+	rb_tree_mgr_free(tm);
+}
+
+/* @func:
+ *	检查B+树的子树：节点内有序、除根外至少半满、分隔值就是右子树最小的data、叶子都在同一层
+ *	min返回子树最小的data，返回子树的data数
+ */
+static size_t _test_bplus_tree_node_check(bplus_tree_mgr_t *bt, bplus_tree_node_t *node, bool is_root,
+								size_t depth, size_t *leaf_depth, void **min)
+{
+	void *child_min = NULL;
+	size_t i = 0, cnt = 0;
+
+	assert(node->m_cnt <= BPLUS_TREE_MGR_ORDER && (is_root || node->m_cnt >= BPLUS_TREE_MGR_ORDER / 2));
+	for (i = 0; i < node->m_cnt; i++) {
+		if (i) assert(bt->m_cmp(node->m_data[i - 1], node->m_data[i]) <= 0);
+		if (bt->m_key) assert(node->m_key[i] == bt->m_key(node->m_data[i]));
+	}
+	if (node->m_is_leaf) {
+		if (!*leaf_depth) *leaf_depth = depth;
+		assert(*leaf_depth == depth);
+		*min = node->m_cnt ? node->m_data[0] : NULL;
+		return node->m_cnt;
+	}
+	for (i = 0; i <= node->m_cnt; i++) {
+		cnt += _test_bplus_tree_node_check(bt, node->m_child[i], false, depth + 1, leaf_depth, &child_min);
+		if (i) assert(child_min == node->m_data[i - 1]);
+		else *min = child_min;
+	}
+	return cnt;
+}
+
+/* @func:
+ *	检查整棵B+树，叶子链表要按顺序串起所有data
+ */
+static void _test_bplus_tree_check(bplus_tree_mgr_t *bt)
+{
+	bplus_tree_node_t *leaf = NULL, *prev = NULL;
+	void *min = NULL, *last = NULL;
+	size_t leaf_depth = 0, cnt = 0, i = 0;
+
+	if (!bt->m_root) {
+		assert(!bt->m_head && !bt->m_cur_node);
+		return ;
+	}
+	assert(_test_bplus_tree_node_check(bt, bt->m_root, true, 1, &leaf_depth, &min) == bt->m_cur_node);
+	for (leaf = bt->m_head; leaf; prev = leaf, leaf = leaf->m_next) {
+		assert(leaf->m_is_leaf && leaf->m_prev == prev);
+		for (i = 0; i < leaf->m_cnt; i++, cnt++) {
+			if (last) assert(bt->m_cmp(last, leaf->m_data[i]) <= 0);
+			last = leaf->m_data[i];
+		}
+	}
+	assert(cnt == bt->m_cur_node);
+}
+
+/* @func:
+ *	B+树随机增删，和每个值的个数对比；三种方式：只用比较函数、key就是值、key是值的前缀(大量相同的key)
+ */
+static void _bplus_tree_mgr_test(void)
+{
+	#define bplus_range 2000
+	#define bplus_ops 40000
+	static size_t count[bplus_range];
+	struct _node sample = {0, 0}, dst = {0, 0}, *node = NULL;
+	bplus_tree_mgr_t *bt = NULL;
+	unsigned int seed = 1;
+	size_t mode = 0, i = 0, k = 0, expect = 0;
+	int lo = 0, hi = 0, v = 0, last_num = 0;
+
+	/* 叶子节点的key和data各占整数个cache line */
+	assert(offsetof(bplus_tree_node_t, m_data) == 4 * 64 && offsetof(bplus_tree_node_t, m_child) == 8 * 64);
+	for (mode = 0; mode < 3; mode++) {
+		memset(count, 0, sizeof(count));
+		if (mode == 0) assert((bt = bplus_tree_mgr_new(NULL, _cmp, NULL, bplus_ops)));
+		else if (mode == 1) assert((bt = bplus_tree_mgr_key_new(NULL, _cmp, NULL, ({
+			int64_t _(const void *data) { return ((const struct _node*)data)->m_num; }; _;}), bplus_ops)));
+		else assert((bt = bplus_tree_mgr_key_new(NULL, _cmp, NULL, ({
+			int64_t _(const void *data) { return ((const struct _node*)data)->m_num / 64; }; _;}), bplus_ops)));
+		assert(!bplus_tree_mgr_key_new(NULL, _cmp, NULL, NULL, bplus_ops));
+
+		for (i = 0; i < bplus_ops; i++) {
+			sample.m_num = v = rand_r(&seed) % bplus_range;
+			/* 前一半插入多，树长起来；后一半删除多，树缩回去 */
+			if (rand_r(&seed) % 10 < (i < bplus_ops / 2 ? 7 : 3)) {
+				assert((node = malloc(sizeof(struct _node))));
+				node->m_num = v;
+				assert(bplus_tree_mgr_insert(bt, node));
+				count[v]++;
+			} else {
+				assert(bplus_tree_mgr_del(bt, &sample) == !!count[v]);
+				if (count[v]) count[v]--;
+			}
+			assert(!bplus_tree_mgr_find(bt, &sample) == !count[v]);
+
+			sample.m_num = v = rand_r(&seed) % (bplus_range + 10) - 5;
+			for (k = v < 0 ? 0 : v; k < bplus_range && !count[k]; k++);
+			node = bplus_tree_mgr_lower_bound(bt, &sample);
+			if (k >= bplus_range) assert(!node);
+			else assert(node && node->m_num == (int)k);
+
+			if (i % 1000) continue;
+			_test_bplus_tree_check(bt);
+			lo = rand_r(&seed) % bplus_range, hi = lo + rand_r(&seed) % 300;
+			for (expect = 0, v = lo; v < hi && v < bplus_range; v++) expect += count[v];
+			last_num = lo - 1;
+			assert(bplus_tree_mgr_range(bt, &(struct _node){lo, 0}, &(struct _node){hi, 0}, ({
+				bool _(void *data, void *arg) {
+					(void)arg;
+					assert(((struct _node*)data)->m_num >= last_num && ((struct _node*)data)->m_num < hi);
+					last_num = ((struct _node*)data)->m_num;
+					return true;
+				}; _;}), NULL) == expect);
+		}
+		_test_bplus_tree_check(bt);
+		for (v = 0; v < bplus_range; v++) {
+			sample.m_num = v;
+			if (count[v]) assert(bplus_tree_mgr_cpy(bt, &sample, &dst, sizeof(dst)) == &dst && dst.m_num == v);
+			else assert(!bplus_tree_mgr_cpy(bt, &sample, &dst, sizeof(dst)));
+		}
+		assert(bplus_tree_mgr_range(bt, NULL, NULL, ({ bool _(void *data, void *arg) { (void)data; return --*(int*)arg > 0; }; _;}), 
+			&(int){10}) == (bt->m_cur_node < 10 ? bt->m_cur_node : 10));
+		if (mode == 2) {
+			/* 删空再用满 */
+			for (v = 0; v < bplus_range; v++) {
+				sample.m_num = v;
+				while (count[v]--) assert(bplus_tree_mgr_del(bt, &sample));
+			}
+			_test_bplus_tree_check(bt);
+			assert(!bt->m_root && !bplus_tree_mgr_lower_bound(bt, &sample));
+			for (i = 0; i < bplus_ops; i++) {
+				assert((node = malloc(sizeof(struct _node))));
+				node->m_num = i % bplus_range;
+				assert(bplus_tree_mgr_insert(bt, node));
+			}
+			assert(!bplus_tree_mgr_insert(bt, &sample));
+			_test_bplus_tree_check(bt);
+		}
+		bplus_tree_mgr_dump(bt);
+		bplus_tree_mgr_free(bt);
+	}
+	MY_PRINTF("bplus OK");
+}
+
+/* @func:
+ *	100万个节点，红黑树、B+树只用比较函数、B+树带key三种方式乱序插入、查找、整体遍历、删除的耗时
+ */
+static void _bplus_tree_mgr_bench(void)
+{
+	const char *name[] = {"rb_tree", "bplus_tree cmp", "bplus_tree key"};
+	struct _node *nodes = NULL, sample = {0, 0};
+	rb_tree_mgr_t *tm = NULL;
+	bplus_tree_mgr_t *bt = NULL;
+	struct timespec start;
+	size_t i = 0, j = 0, mode = 0, sum = 0;
+	unsigned int seed = 1;
+
+	/* 随机打乱，按步长插入时红黑树新插入的节点在节点池里挨着，占了便宜 */
+	assert((nodes = calloc(bench_count, sizeof(struct _node))));
+	for (i = 0; i < bench_count; i++) nodes[i].m_num = i;
+	for (i = bench_count - 1; i > 0; i--) {
+		j = rand_r(&seed) % (i + 1);
+		sample = nodes[i], nodes[i] = nodes[j], nodes[j] = sample;
+	}
+
+	for (mode = 0; mode < 3; mode++) {
+		if (mode == 0) assert((tm = rb_tree_mgr_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, bench_count)));
+		else if (mode == 1) assert((bt = bplus_tree_mgr_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, bench_count)));
+		else assert((bt = bplus_tree_mgr_key_new(({ void _(void *ptr) { (void)ptr; }; _;}), _cmp, NULL, ({
+			int64_t _(const void *data) { return ((const struct _node*)data)->m_num; }; _;}), bench_count)));
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < bench_count; i++) {
+			if (mode == 0) rb_tree_mgr_insert(tm, &nodes[i]);
+			else bplus_tree_mgr_insert(bt, &nodes[i]);
+		}
+		MY_PRINTF("%s insert: %.1f ns/op", name[mode], _ns_since(&start, bench_count));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < bench_count; i++) {
+			sample.m_num = i * 104729 % bench_count;
+			if (mode == 0) assert(rb_tree_mgr_node_find(tm, &sample));
+			else assert(bplus_tree_mgr_find(bt, &sample));
+		}
+		MY_PRINTF("%s find: %.1f ns/op", name[mode], _ns_since(&start, bench_count));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		sum = 0;
+		if (mode == 0) assert(rb_tree_mgr_range(tm, NULL, NULL, ({ 
+			bool _(void *data, void *arg) { *(size_t*)arg += ((struct _node*)data)->m_num; return true; }; _;}), &sum) == bench_count);
+		else assert(bplus_tree_mgr_range(bt, NULL, NULL, ({ 
+			bool _(void *data, void *arg) { *(size_t*)arg += ((struct _node*)data)->m_num; return true; }; _;}), &sum) == bench_count);
+		MY_PRINTF("%s scan: %.1f ns/op", name[mode], _ns_since(&start, bench_count));
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < bench_count; i++) {
+			sample.m_num = i * 104729 % bench_count;
+			if (mode == 0) rb_tree_mgr_del(tm, &sample);
+			else bplus_tree_mgr_del(bt, &sample);
+		}
+		MY_PRINTF("%s del: %.1f ns/op", name[mode], _ns_since(&start, bench_count));
+		if (mode == 0) rb_tree_mgr_free(tm);
+		else bplus_tree_mgr_free(bt);
+	}
+	free(nodes);
+}
+
 int main()
 {
 	pthread_t pt[10];
@@ -606,7 +1435,7 @@ int main()
 						assert(rb_tree_mgr_node_find(tm, &node_value));
 						assert(sample.m_num == ((struct _node*)rb_tree_node_cpy(tm, &sample, &dst, sizeof(struct _node)))->m_num);
 
-						pthread_mutex_lock(&tm->m_mutex);
+						pthread_rwlock_wrlock(&tm->m_rwlock);
 						if (tm->m_root) {
 							/* 测试跟节点是黑色(特征5) */
 							assert(!_rb_tree_node_is_red(tm->m_root));
@@ -617,7 +1446,7 @@ int main()
 							_set_every_path_black_node_count(tm->m_root);
 							_test_every_path_black_node_count_is_same(tm->m_root, &black_count);
 						}
-						pthread_mutex_unlock(&tm->m_mutex);
+						pthread_rwlock_unlock(&tm->m_rwlock);
 					}
 
 					for (j = 0; j < k; j++) {
@@ -625,7 +1454,7 @@ int main()
 						node_value.m_num = j;
 						assert(rb_tree_mgr_del(tm, &node_value));
 
-						pthread_mutex_lock(&tm->m_mutex);
+						pthread_rwlock_wrlock(&tm->m_rwlock);
 						if (tm->m_root) {
 							/* 测试跟节点是黑色(特征5) */
 							assert(!_rb_tree_node_is_red(tm->m_root));
@@ -636,7 +1465,7 @@ int main()
 							_set_every_path_black_node_count(tm->m_root);
 							_test_every_path_black_node_count_is_same(tm->m_root, &black_count);
 						}
-						pthread_mutex_unlock(&tm->m_mutex);
+						pthread_rwlock_unlock(&tm->m_rwlock);
 					}
 				}
 				return arg;
@@ -649,6 +1478,15 @@ int main()
 	rb_tree_mgr_dump(tm, true);
 	rb_tree_mgr_free(tm);
 	MY_PRINTF("OK");
+
+	_rb_tree_mgr_intrusive_test();
+	_rb_tree_mgr_nopool_test();
+	_rb_tree_mgr_bench();
+	_rb_tree_mgr_order_test();
+	_rb_tree_mgr_build_bench();
+	_rb_tree_mgr_rwlock_bench();
+	_bplus_tree_mgr_test();
+	_bplus_tree_mgr_bench();
 	return 0;
 }
 #endif
@@ -12,6 +12,9 @@ typedef void (*rb_tree_node_free_t) (void *ptr);
 /* rb_tree_node_t的data的复制函数 */
 typedef void* (*rb_tree_node_memcpy_t) (void *dst, const void *src, size_t size); 
 
+/* 范围遍历的回调，返回false时停止 */
+typedef bool (*rb_tree_mgr_visit_t) (void *data, void *arg);
+
 typedef void* (*rb_tree_mgr_alloc_t) (size_t size);
 typedef void (*rb_tree_mgr_free_t) (void *ptr);
 
@@ -25,12 +28,19 @@ typedef struct _rb_tree_node {
 
 typedef struct _rb_tree_mgr {
 	rb_tree_node_t *m_root;  // 树的根节点
+	bool m_is_intrusive;	// 节点嵌在data里，插入删除时不分配释放节点
+	size_t m_node_offset;	// 侵入式时节点在data中的偏移
+	bool m_is_pooled;	// 节点从节点池分配，创建时决定，否则每个节点单独分配
+	rb_tree_node_t *m_pool_free;	// 节点池中释放过的节点，用m_right串起来
+	rb_tree_node_t *m_pool_next, *m_pool_end;	// 当前内存块中还没用过的节点
+	void *m_pool_slab;	// 节点池的内存块链表
+	size_t m_pool_slab_node;	// 下一个内存块的节点数
 	rb_tree_node_cmp_t m_cmp;  // rb_tree_node_t的data的比较函数，1：左>右， 0：左==右， -1：左<右
 	rb_tree_node_free_t m_free; // rb_tree_node_t的data的释放函数
 	rb_tree_node_memcpy_t m_cpy; // rb_tree_node_t的data的复制函数
 	size_t m_max_node;	// 允许插入的最大节点数
 	size_t m_cur_node;	// 当前的节点数
-	pthread_mutex_t m_mutex;
+	pthread_rwlock_t m_rwlock;	// 查找和遍历加读锁，增删加写锁，写优先
 } rb_tree_mgr_t;
 
 /* @func:
@@ -44,6 +54,19 @@ void rb_tree_mgr_init(rb_tree_mgr_alloc_t alloc, rb_tree_mgr_free_t dealloc);
 rb_tree_mgr_t* rb_tree_mgr_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp, 
 								rb_tree_node_memcpy_t cpy, size_t max_node);
 								
+/* @func:
+ *	分配一个不用节点池的管理器，每个节点单独分配，删除时立即释放
+ */
+rb_tree_mgr_t* rb_tree_mgr_nopool_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp, 
+								rb_tree_node_memcpy_t cpy, size_t max_node);
+
+/* @func:
+ *	分配一个侵入式的管理器，rb_tree_node_t嵌在data里，offset是它在data中的偏移，
+ *	插入删除不再分配释放节点；同一个data不能同时插入两次
+ */
+rb_tree_mgr_t* rb_tree_mgr_intrusive_new(rb_tree_node_free_t dealloc, rb_tree_node_cmp_t cmp, 
+								rb_tree_node_memcpy_t cpy, size_t offset, size_t max_node);
+
 /* @func:
  *	销毁管理器和树上的节点
  */
@@ -70,6 +93,40 @@ bool rb_tree_mgr_insert(rb_tree_mgr_t *tm, void *data);
  */
 bool rb_tree_mgr_del(rb_tree_mgr_t *tm, void *data);
 
+/* @func:
+ *	返回第一个不小于data的节点，没有时返回NULL
+ */
+rb_tree_node_t* rb_tree_mgr_lower_bound(rb_tree_mgr_t *tm, void *data);
+
+/* @func:
+ *	返回第一个大于data的节点，没有时返回NULL
+ */
+rb_tree_node_t* rb_tree_mgr_upper_bound(rb_tree_mgr_t *tm, void *data);
+
+/* @func:
+ *	返回最小、最大的节点，树为空时返回NULL
+ */
+rb_tree_node_t* rb_tree_mgr_first(rb_tree_mgr_t *tm);
+rb_tree_node_t* rb_tree_mgr_last(rb_tree_mgr_t *tm);
+
+/* @func:
+ *	按顺序返回下一个、上一个节点，没有时返回NULL
+ *	和rb_tree_mgr_node_find一样，返回的节点在被删除之前有效
+ */
+rb_tree_node_t* rb_tree_mgr_next(rb_tree_mgr_t *tm, rb_tree_node_t *tn);
+rb_tree_node_t* rb_tree_mgr_prev(rb_tree_mgr_t *tm, rb_tree_node_t *tn);
+
+/* @func:
+ *	按顺序遍历[low, high)范围内的节点，low为NULL时从头开始，high为NULL时到末尾，
+ *	遍历时持有读锁，visit里不能再调用这个管理器的接口；返回遍历过的节点数
+ */
+size_t rb_tree_mgr_range(rb_tree_mgr_t *tm, void *low, void *high, rb_tree_mgr_visit_t visit, void *arg);
+
+/* @func:
+ *	用升序排好的data建树，O(n)，不用逐个插入再调整；树必须为空，data不是升序时返回false
+ */
+bool rb_tree_mgr_build(rb_tree_mgr_t *tm, void **data, size_t cnt);
+
 /* @func:
  *	打印信息
  */
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE /* renameat2 */
 #include <stdio.h>
 #include <string.h>
 #include <limits.h>
@@ -11,6 +12,7 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 
 #include "transfer_file_mgr.h"
@@ -22,6 +24,8 @@
 #define TRANSFER_FILE_MGR_INFO_LOG MY_PRINTF
 #define TRANSFER_FILE_MGR_TRACE_LOG MY_PRINTF
 
+#define TRANSFER_FILE_MGR_GROUP_MAX 64 /* 后台线程一次最多处理的文件数 */
+
 
 typedef void* (*g_alloc_t) (size_t size);
 typedef void (*g_free_t) (void *ptr);
@@ -106,6 +110,28 @@ static void _filename_get(transfer_file_mgr_t *tm, char *buf, size_t buf_size)
 				tm_s.tm_sec, (int)tv.tv_usec, tm->m_suffix);	
 }
 
+static uint64_t _now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* @func:
+ *	记录一个转移完成的文件
+ */
+static void _transfer_file_mgr_stat_add(transfer_file_mgr_stat_t *stat, size_t line, size_t byte, uint64_t latency_us)
+{
+	stat->m_batch_cnt++;
+	stat->m_line_total += line;
+	stat->m_byte_total += byte;
+	stat->m_latency_total_us += latency_us;
+	if (line > stat->m_line_max) stat->m_line_max = line;
+	if (byte > stat->m_byte_max) stat->m_byte_max = byte;
+	if (latency_us > stat->m_latency_max_us) stat->m_latency_max_us = latency_us;
+}
+
 /* @func:
  *  转移文件
  */
@@ -124,9 +150,197 @@ static void _transfer_file_mgr_do(transfer_file_mgr_t *tm)
 		TRANSFER_FILE_MGR_WARN_LOG("rename %s to %s error, errno: %d - %s", path_tmp, path_dst, errno, strerror(errno));
 		return ;
 	} 
+	_transfer_file_mgr_stat_add(&tm->m_stat, tm->m_write_line, 0, 0);
 	tm->m_write_line = 0;
 }
 
+/* @func:
+ *	缓冲模式下打开新的临时文件，每个文件的名字带序号
+ */
+static transfer_file_mgr_batch_t* _transfer_file_mgr_batch_new(transfer_file_mgr_t *tm)
+{
+	transfer_file_mgr_batch_t *batch = NULL;
+	char path[PATH_MAX] = {0};
+	size_t len = 0;
+
+	len = snprintf(path, sizeof(path), "%s%s.%u%s", tm->m_tmp_dir, tm->m_filename, tm->m_seq++, tm->m_suffix);
+	if (!(batch = (transfer_file_mgr_batch_t*)g_tm_alloc(sizeof(*batch) + len + 1))) {
+		TRANSFER_FILE_MGR_ERROR_LOG("g_tm_alloc error, errno: %d - %s", errno, strerror(errno));
+		return NULL;
+	}
+	memcpy(batch->m_path, path, len + 1);
+
+	if (!(batch->m_buf = (char*)g_tm_alloc(tm->m_buf_size))) {
+		TRANSFER_FILE_MGR_ERROR_LOG("g_tm_alloc error, errno: %d - %s", errno, strerror(errno));
+		goto err;
+	}
+
+	if (!(batch->m_fp = fopen(path, "ab"))) {
+		TRANSFER_FILE_MGR_WARN_LOG("fopen %s error, errno: %d - %s", path, errno, strerror(errno));
+		goto err;
+	}
+	setvbuf(batch->m_fp, batch->m_buf, _IOFBF, tm->m_buf_size);
+	batch->m_open_us = _now_us();
+	return batch;
+
+err:
+	g_tm_free(batch->m_buf);
+	g_tm_free(batch);
+	return NULL;
+}
+
+/* @func:
+ *	把正在写入的文件交给后台线程转移，下一行写入时再打开新文件
+ */
+static void _transfer_file_mgr_batch_put(transfer_file_mgr_t *tm)
+{
+	transfer_file_mgr_batch_t *batch = tm->m_batch;
+
+	if (!batch || !tm->m_write_line) return ;
+	batch->m_line = tm->m_write_line;
+	batch->m_put_us = _now_us();
+	tm->m_batch = NULL;
+	tm->m_write_line = 0;
+
+	pthread_mutex_lock(&tm->m_queue_mutex);
+	*tm->m_tail = batch;
+	tm->m_tail = &batch->m_next;
+	pthread_cond_signal(&tm->m_queue_cond);
+	pthread_mutex_unlock(&tm->m_queue_mutex);
+}
+
+/* @func:
+ *	关闭文件后转移
+ */
+static void _transfer_file_mgr_batch_move(transfer_file_mgr_t *tm, transfer_file_mgr_batch_t *batch)
+{
+	char path_dst[PATH_MAX] = {0};
+	long byte = ftell(batch->m_fp);
+	int i = 0;
+
+	if (fclose(batch->m_fp))
+		TRANSFER_FILE_MGR_WARN_LOG("fclose %s error, errno: %d - %s", batch->m_path, errno, strerror(errno));
+
+	/* 文件名精确到微秒，连续转移多个文件时可能重名，不能覆盖 */
+	for (i = 0; i < 1000; i++) {
+		_filename_get(tm, path_dst, sizeof(path_dst));
+		if (!renameat2(AT_FDCWD, batch->m_path, AT_FDCWD, path_dst, RENAME_NOREPLACE)) break;
+		if (errno == EEXIST) continue;
+		if ((errno == EINVAL || errno == ENOSYS) && !_is_file_exsit(path_dst)) {
+			if (!rename(batch->m_path, path_dst)) break;
+		}
+		if (errno == EINVAL || errno == ENOSYS) continue;
+
+		TRANSFER_FILE_MGR_WARN_LOG("rename %s to %s error, errno: %d - %s", batch->m_path, path_dst, errno, strerror(errno));
+		break;
+	}
+
+	pthread_mutex_lock(&tm->m_queue_mutex);
+	_transfer_file_mgr_stat_add(&tm->m_stat, batch->m_line, byte > 0 ? byte : 0, _now_us() - batch->m_put_us);
+	pthread_mutex_unlock(&tm->m_queue_mutex);
+
+	g_tm_free(batch->m_buf);
+	g_tm_free(batch);
+}
+
+/* @func:
+ *	按落盘策略处理一组文件后转移
+ *	SYNC_GROUP先让所有文件开始写回，再逐个等待完成，最后一次fsync目标目录保证改名落盘
+ */
+static void _transfer_file_mgr_group_move(transfer_file_mgr_t *tm, transfer_file_mgr_batch_t **batch, size_t cnt, int sync)
+{
+	size_t i = 0;
+	int fd = -1;
+
+	for (i = 0; i < cnt; i++) {
+		if (fflush(batch[i]->m_fp))
+			TRANSFER_FILE_MGR_WARN_LOG("fflush %s error, errno: %d - %s", batch[i]->m_path, errno, strerror(errno));
+		if (sync == TRANSFER_FILE_MGR_SYNC_GROUP)
+			sync_file_range(fileno(batch[i]->m_fp), 0, 0, SYNC_FILE_RANGE_WRITE);
+	}
+
+	for (i = 0; i < cnt; i++) {
+		if (sync != TRANSFER_FILE_MGR_SYNC_NONE && fdatasync(fileno(batch[i]->m_fp)))
+			TRANSFER_FILE_MGR_WARN_LOG("fdatasync %s error, errno: %d - %s", batch[i]->m_path, errno, strerror(errno));
+		_transfer_file_mgr_batch_move(tm, batch[i]);
+	}
+
+	if (sync == TRANSFER_FILE_MGR_SYNC_GROUP) {
+		if ((fd = open(tm->m_dst_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0 || fsync(fd))
+			TRANSFER_FILE_MGR_WARN_LOG("fsync %s error, errno: %d - %s", tm->m_dst_dir, errno, strerror(errno));
+		if (fd >= 0) close(fd);
+	}
+
+	pthread_mutex_lock(&tm->m_queue_mutex);
+	if (cnt > tm->m_stat.m_group_max) tm->m_stat.m_group_max = cnt;
+	pthread_mutex_unlock(&tm->m_queue_mutex);
+}
+
+/* @func:
+ *	正在写入的文件超时后交给后台线程，返回距离下次超时的毫秒数
+ */
+static unsigned int _transfer_file_mgr_age_check(transfer_file_mgr_t *tm)
+{
+	unsigned int max_age_ms = 0, wait_ms = 0;
+	uint64_t age_ms = 0;
+
+	pthread_mutex_lock(&tm->m_mutex);
+	wait_ms = max_age_ms = tm->m_max_age_ms;
+	if (max_age_ms && tm->m_batch && tm->m_write_line) {
+		age_ms = (_now_us() - tm->m_batch->m_open_us) / 1000;
+		if (age_ms >= max_age_ms) {
+			_transfer_file_mgr_batch_put(tm);
+			pthread_mutex_lock(&tm->m_queue_mutex);
+			tm->m_stat.m_age_cnt++;
+			pthread_mutex_unlock(&tm->m_queue_mutex);
+		} else wait_ms = max_age_ms - age_ms;
+	}
+	pthread_mutex_unlock(&tm->m_mutex);
+	return wait_ms;
+}
+
+/* @func:
+ *	后台线程，按写入的顺序转移文件，退出前转移完所有文件
+ */
+static void* _transfer_file_mgr_mover(void *arg)
+{
+	transfer_file_mgr_t *tm = (transfer_file_mgr_t*)arg;
+	transfer_file_mgr_batch_t *batch[TRANSFER_FILE_MGR_GROUP_MAX];
+	unsigned int wait_ms = 0;
+	struct timespec ts;
+	size_t cnt = 0;
+	int sync = 0;
+
+	for (;;) {
+		wait_ms = _transfer_file_mgr_age_check(tm);
+
+		pthread_mutex_lock(&tm->m_queue_mutex);
+		if (!tm->m_head && tm->m_is_running) {
+			if (!wait_ms) pthread_cond_wait(&tm->m_queue_cond, &tm->m_queue_mutex);
+			else {
+				clock_gettime(CLOCK_MONOTONIC, &ts);
+				ts.tv_sec += wait_ms / 1000;
+				ts.tv_nsec += (wait_ms % 1000) * 1000000;
+				if (ts.tv_nsec >= 1000000000) ts.tv_sec++, ts.tv_nsec -= 1000000000;
+				pthread_cond_timedwait(&tm->m_queue_cond, &tm->m_queue_mutex, &ts);
+			}
+		}
+		for (cnt = 0; tm->m_head && cnt < tm->m_group_size; cnt++) {
+			batch[cnt] = tm->m_head;
+			if (!(tm->m_head = batch[cnt]->m_next)) tm->m_tail = &tm->m_head;
+		}
+		sync = tm->m_sync;
+		if (!cnt && !tm->m_is_running) {
+			pthread_mutex_unlock(&tm->m_queue_mutex);
+			break;
+		}
+		pthread_mutex_unlock(&tm->m_queue_mutex);
+
+		if (cnt) _transfer_file_mgr_group_move(tm, batch, cnt, sync);
+	}
+	return arg;
+}
+
 /* @func:
  *	创建一个管理器
  * @param:
@@ -191,18 +405,114 @@ err:
 }
 
 
+/* @func:
+ *	创建一个缓冲模式的管理器
+ */
+transfer_file_mgr_t* transfer_file_mgr_buffered_new(const char *tmp_dir, const char *dst_dir,
+                            const char *filename, const char *suffix, size_t max_line, size_t buf_size)
+{
+	if (!buf_size) return NULL;
+	transfer_file_mgr_t *tm = NULL;
+	pthread_condattr_t attr;
+
+	if (!(tm = transfer_file_mgr_new(tmp_dir, dst_dir, filename, suffix, max_line))) return NULL;
+
+	tm->m_buf_size = buf_size;
+	tm->m_tail = &tm->m_head;
+	tm->m_group_size = 1;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	if (pthread_mutex_init(&tm->m_queue_mutex, NULL) || pthread_cond_init(&tm->m_queue_cond, &attr)) {
+		TRANSFER_FILE_MGR_ERROR_LOG("pthread init error, errno: %d - %s", errno, strerror(errno));
+		pthread_condattr_destroy(&attr);
+		goto err;
+	}
+	pthread_condattr_destroy(&attr);
+	tm->m_is_buffered = true;
+
+	tm->m_is_running = true;
+	if ((errno = pthread_create(&tm->m_mover, NULL, _transfer_file_mgr_mover, tm))) {
+		TRANSFER_FILE_MGR_ERROR_LOG("pthread_create error, errno: %d - %s", errno, strerror(errno));
+		tm->m_is_running = false;
+		goto err;
+	}
+	return tm;
+
+err:
+	transfer_file_mgr_free(tm);
+	return NULL;
+}
+
+/* @func:
+ *	设置缓冲模式下的超时时间和落盘策略
+ */
+void transfer_file_mgr_policy_set(transfer_file_mgr_t *tm, unsigned int max_age_ms, int sync, size_t group_size)
+{
+	if (!tm || !tm->m_is_buffered) return ;
+
+	if (group_size < 1) group_size = 1;
+	if (group_size > TRANSFER_FILE_MGR_GROUP_MAX) group_size = TRANSFER_FILE_MGR_GROUP_MAX;
+
+	pthread_mutex_lock(&tm->m_mutex);
+	pthread_mutex_lock(&tm->m_queue_mutex);
+	tm->m_max_age_ms = max_age_ms;
+	tm->m_sync = sync;
+	tm->m_group_size = group_size;
+	/* 唤醒后台线程按新的超时时间等待 */
+	pthread_cond_signal(&tm->m_queue_cond);
+	pthread_mutex_unlock(&tm->m_queue_mutex);
+	pthread_mutex_unlock(&tm->m_mutex);
+}
+
+/* @func:
+ *	获取统计信息
+ */
+void transfer_file_mgr_stat_get(transfer_file_mgr_t *tm, transfer_file_mgr_stat_t *stat)
+{
+	if (!tm || !stat) return ;
+	pthread_mutex_t *mutex = tm->m_is_buffered ? &tm->m_queue_mutex : &tm->m_mutex;
+
+	pthread_mutex_lock(mutex);
+	*stat = tm->m_stat;
+	pthread_mutex_unlock(mutex);
+}
+
 /* @func:
  *	销毁管理器
  */
 void transfer_file_mgr_free(transfer_file_mgr_t *tm)
 {
 	if (!tm) return ;
+
+	if (tm->m_is_buffered) {
+		pthread_mutex_lock(&tm->m_mutex);
+		_transfer_file_mgr_batch_put(tm);
+		/* 没有写入内容的文件直接删除 */
+		if (tm->m_batch) {
+			fclose(tm->m_batch->m_fp);
+			unlink(tm->m_batch->m_path);
+			g_tm_free(tm->m_batch->m_buf);
+			g_tm_free(tm->m_batch);
+		}
+		pthread_mutex_unlock(&tm->m_mutex);
+
+		if (tm->m_is_running) {
+			pthread_mutex_lock(&tm->m_queue_mutex);
+			tm->m_is_running = false;
+			pthread_cond_signal(&tm->m_queue_cond);
+			pthread_mutex_unlock(&tm->m_queue_mutex);
+			pthread_join(tm->m_mover, NULL);
+		}
+		pthread_cond_destroy(&tm->m_queue_cond);
+		pthread_mutex_destroy(&tm->m_queue_mutex);
+	}
 	
 	pthread_mutex_lock(&tm->m_mutex);
 	g_tm_free(tm->m_filename);
 	g_tm_free(tm->m_dst_dir);
 	g_tm_free(tm->m_tmp_dir);
 	g_tm_free(tm->m_suffix);
+	pthread_mutex_unlock(&tm->m_mutex);
 	pthread_mutex_destroy(&tm->m_mutex);
 	g_tm_free(tm);
 }
@@ -219,6 +529,18 @@ ssize_t transfer_file_mgr_printf(transfer_file_mgr_t *tm, const char *fm, ...)
 	int write_len = 0;
 
 	pthread_mutex_lock(&tm->m_mutex);
+	if (tm->m_is_buffered) {
+		/* 只写入缓冲区，满了才写文件 */
+		if (!tm->m_batch && !(tm->m_batch = _transfer_file_mgr_batch_new(tm))) {
+			write_len = -1; goto unlock;
+		}
+		va_start(ap, fm); write_len = vfprintf(tm->m_batch->m_fp, fm, ap); va_end(ap);
+		if (write_len < 0) write_len = -1;
+		else tm->m_write_line++;
+		if (tm->m_write_line >= tm->m_max_line) _transfer_file_mgr_batch_put(tm);
+		goto unlock;
+	}
+
 	snprintf(path, sizeof(path), "%s%s%s", tm->m_tmp_dir, tm->m_filename, tm->m_suffix);
 	if (!(fp = fopen(path, "ab+"))) {
 		TRANSFER_FILE_MGR_WARN_LOG("fopen %s error, errno: %d - %s", path, errno, strerror(errno));
@@ -233,6 +555,7 @@ ssize_t transfer_file_mgr_printf(transfer_file_mgr_t *tm, const char *fm, ...)
 out:
 	if (fp) { fflush(fp); fclose(fp); }
 	if (tm->m_write_line >= tm->m_max_line) _transfer_file_mgr_do(tm);
+unlock:
 	pthread_mutex_unlock(&tm->m_mutex);
 	return write_len;
 
@@ -246,12 +569,160 @@ void transfer_file_mgr_do(transfer_file_mgr_t* tm)
 	if (!tm) return ;
 	
 	pthread_mutex_lock(&tm->m_mutex);
-	_transfer_file_mgr_do(tm);
+	if (tm->m_is_buffered) _transfer_file_mgr_batch_put(tm);
+	else _transfer_file_mgr_do(tm);
 	pthread_mutex_unlock(&tm->m_mutex);
 }
 
 #if 1
 #include <assert.h>
+#include <dirent.h>
+
+/* @func:
+ *	目录中所有文件的个数和总行数，clean为true时删除
+ */
+static size_t _dir_line_count(const char *dir, size_t *file_cnt, bool clean)
+{
+	char path[PATH_MAX * 2];
+	struct dirent *ent = NULL;
+	size_t count = 0;
+	FILE *fp = NULL;
+	DIR *dp = NULL;
+	int ch = 0;
+
+	*file_cnt = 0;
+	if (!(dp = opendir(dir))) return 0;
+	while ((ent = readdir(dp))) {
+		if (ent->d_name[0] == '.') continue;
+		snprintf(path, sizeof(path), "%s%s", dir, ent->d_name);
+		if (!(fp = fopen(path, "rb"))) continue;
+		while ((ch = fgetc(fp)) != EOF)
+			if (ch == '\n') count++;
+		fclose(fp);
+		(*file_cnt)++;
+		if (clean) unlink(path);
+	}
+	closedir(dp);
+	return count;
+}
+
+static double _ns_since(const struct timespec *start, size_t count)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec)) / count;
+}
+
+/* @func:
+ *	缓冲模式，多线程写入，每个转移的文件都是完整的批次
+ */
+static void _transfer_file_mgr_buffered_test(void)
+{
+	transfer_file_mgr_t *tm = NULL;
+	size_t i = 0, file_cnt = 0;
+	pthread_t pt[8];
+
+	_dir_line_count("/tmp/kk/tm_dst/", &file_cnt, true);
+	assert((tm = transfer_file_mgr_buffered_new("/tmp/kk/tm/", "/tmp/kk/tm_dst/", "test", ".dat", 70, 64 * 1024)));
+
+	for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++) {
+		pthread_create(&pt[i], NULL, ({
+			void* _(void *arg) {
+				int j = 0;
+				for (j = 0; j < 1000; j++)
+					assert(transfer_file_mgr_printf(tm, "%s:%d - %d\n", __FILE__, __LINE__, j) > 0);
+				return arg;
+		}; _;}), NULL);
+	}
+	for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++)
+		pthread_join(pt[i], NULL);
+
+	/* 手动转移不满的文件 */
+	transfer_file_mgr_do(tm);
+	transfer_file_mgr_free(tm);
+	assert(_dir_line_count("/tmp/kk/tm_dst/", &file_cnt, false) == 8000);
+	assert(file_cnt == (8000 + 69) / 70);
+	_dir_line_count("/tmp/kk/tm_dst/", &file_cnt, true);
+	assert(_dir_line_count("/tmp/kk/tm/", &file_cnt, false) == 0 && file_cnt == 0);
+	MY_PRINTF("buffered test ok");
+}
+
+/* @func:
+ *	超时转移和各种落盘策略，检查统计信息
+ */
+static void _transfer_file_mgr_policy_test(void)
+{
+	transfer_file_mgr_t *tm = NULL;
+	transfer_file_mgr_stat_t stat;
+	size_t i = 0, file_cnt = 0;
+	int sync = 0;
+
+	_dir_line_count("/tmp/kk/tm_dst/", &file_cnt, true);
+
+	/* 流量很小时不调用transfer_file_mgr_do也会按时转移 */
+	assert((tm = transfer_file_mgr_buffered_new("/tmp/kk/tm/", "/tmp/kk/tm_dst/", "age", ".dat", 1000, 4096)));
+	transfer_file_mgr_policy_set(tm, 50, TRANSFER_FILE_MGR_SYNC_NONE, 1);
+	for (i = 0; i < 10; i++) assert(transfer_file_mgr_printf(tm, "age - %zu\n", i) > 0);
+	usleep(300 * 1000);
+	assert(_dir_line_count("/tmp/kk/tm_dst/", &file_cnt, false) == 10 && file_cnt == 1);
+	transfer_file_mgr_stat_get(tm, &stat);
+	assert(stat.m_batch_cnt == 1 && stat.m_age_cnt == 1 && stat.m_line_total == 10);
+	transfer_file_mgr_free(tm);
+	_dir_line_count("/tmp/kk/tm_dst/", &file_cnt, true);
+
+	for (sync = TRANSFER_FILE_MGR_SYNC_NONE; sync <= TRANSFER_FILE_MGR_SYNC_GROUP; sync++) {
+		assert((tm = transfer_file_mgr_buffered_new("/tmp/kk/tm/", "/tmp/kk/tm_dst/", "sync", ".dat", 100, 4096)));
+		transfer_file_mgr_policy_set(tm, 0, sync, 8);
+		for (i = 0; i < 1050; i++) assert(transfer_file_mgr_printf(tm, "sync - %zu\n", i) > 0);
+		transfer_file_mgr_do(tm);
+		/* 等待后台线程转移完再取统计信息 */
+		for (i = 0; i < 1000; i++) {
+			transfer_file_mgr_stat_get(tm, &stat);
+			if (stat.m_batch_cnt == 11) break;
+			usleep(1000);
+		}
+		transfer_file_mgr_free(tm);
+
+		assert(stat.m_batch_cnt == 11 && stat.m_line_total == 1050 && stat.m_line_max == 100);
+		assert(stat.m_byte_total > 0 && stat.m_byte_max <= stat.m_byte_total && stat.m_group_max <= 8);
+		assert(stat.m_latency_max_us * stat.m_batch_cnt >= stat.m_latency_total_us);
+		assert(_dir_line_count("/tmp/kk/tm_dst/", &file_cnt, true) == 1050 && file_cnt == 11);
+		MY_PRINTF("sync %d: group max %zu, latency avg %.1f us, max %llu us", sync, stat.m_group_max,
+				(double)stat.m_latency_total_us / stat.m_batch_cnt, (unsigned long long)stat.m_latency_max_us);
+	}
+	MY_PRINTF("policy test ok");
+}
+
+/* @func:
+ *	每次打开文件和缓冲模式在各种落盘策略下每行的耗时（包括转移完所有文件）
+ */
+static void _transfer_file_mgr_bench(void)
+{
+	const size_t count = 100000;
+	transfer_file_mgr_t *tm = NULL;
+	struct timespec start;
+	size_t i = 0, file_cnt = 0;
+	int sync = 0;
+
+	assert((tm = transfer_file_mgr_new("/tmp/kk/tm/", "/tmp/kk/tm_dst/", "bench", ".dat", 10000)));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count / 10; i++) transfer_file_mgr_printf(tm, "%s - %zu\n", __FILE__, i);
+	MY_PRINTF("open per line: %.1f ns/line", _ns_since(&start, count / 10));
+	transfer_file_mgr_do(tm);
+	transfer_file_mgr_free(tm);
+
+	for (sync = TRANSFER_FILE_MGR_SYNC_NONE; sync <= TRANSFER_FILE_MGR_SYNC_GROUP; sync++) {
+		assert((tm = transfer_file_mgr_buffered_new("/tmp/kk/tm/", "/tmp/kk/tm_dst/", "bench", ".dat", 1000, 64 * 1024)));
+		transfer_file_mgr_policy_set(tm, 0, sync, 16);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < count; i++) transfer_file_mgr_printf(tm, "%s - %zu\n", __FILE__, i);
+		transfer_file_mgr_free(tm);
+		MY_PRINTF("buffered sync %d: %.1f ns/line", sync, _ns_since(&start, count));
+	}
+
+	assert(_dir_line_count("/tmp/kk/tm_dst/", &file_cnt, true) == count * 3 + count / 10);
+}
 
 int main()
 {
@@ -293,6 +764,10 @@ int main()
 		pthread_join(pt[i], NULL);
 
 	transfer_file_mgr_free(tm);
+
+	_transfer_file_mgr_buffered_test();
+	_transfer_file_mgr_policy_test();
+	_transfer_file_mgr_bench();
 	return 0;
 }
 
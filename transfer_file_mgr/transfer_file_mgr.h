@@ -1,9 +1,45 @@
 /* @desc:
  *	1. 写语句到文件中，到达指定的行数对文件进行转移
+ *	2. 缓冲模式下临时文件一直打开，行数在内存中计数，由后台线程关闭文件并转移
+ *	3. 缓冲模式下文件超过指定时间也会转移，转移前可以落盘
  */
 #ifndef _TRANSFER_FILE_MGR_H_
 #define _TRANSFER_FILE_MGR_H_
 
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* 转移前的落盘策略 */
+#define TRANSFER_FILE_MGR_SYNC_NONE 0 /* 不落盘 */
+#define TRANSFER_FILE_MGR_SYNC_DATA 1 /* 每个文件fdatasync后再转移 */
+#define TRANSFER_FILE_MGR_SYNC_GROUP 2 /* 多个文件一起写回，全部落盘后转移，最后fsync目标目录 */
+
+/* 统计信息 */
+typedef struct _transfer_file_mgr_stat {
+	size_t m_batch_cnt; /* 转移的文件数 */
+	size_t m_age_cnt; /* 因为超时转移的文件数 */
+	size_t m_line_total;
+	size_t m_line_max;
+	size_t m_byte_total;
+	size_t m_byte_max;
+	size_t m_group_max; /* 一次落盘的最多文件数 */
+	uint64_t m_latency_total_us; /* 交给后台线程到转移完成的耗时 */
+	uint64_t m_latency_max_us;
+} transfer_file_mgr_stat_t;
+
+/* 缓冲模式下等待转移的文件 */
+typedef struct _transfer_file_mgr_batch {
+	struct _transfer_file_mgr_batch *m_next;
+	FILE *m_fp;
+	char *m_buf;	/* m_fp使用的缓冲区 */
+	size_t m_line;
+	uint64_t m_open_us; /* 打开的时间，CLOCK_MONOTONIC */
+	uint64_t m_put_us; /* 交给后台线程的时间 */
+	char m_path[];	/* 临时文件 */
+} transfer_file_mgr_batch_t;
+
 typedef struct _transfer_file_mgr {
 	char *m_tmp_dir; /* 临时目录 */
 	char *m_dst_dir; /* 最终转移的目录 */
@@ -12,12 +48,50 @@ typedef struct _transfer_file_mgr {
 	size_t m_max_line; /* 最大行数 */
 	size_t m_write_line; /* 当前写入的行数 */
 	pthread_mutex_t m_mutex;
+
+	/* 缓冲模式 */
+	bool m_is_buffered;
+	size_t m_buf_size;
+	transfer_file_mgr_batch_t *m_batch; /* 正在写入的文件 */
+	unsigned int m_seq; /* 临时文件的序号，转移之前的文件不会被覆盖 */
+	bool m_is_running;
+	pthread_t m_mover;
+	transfer_file_mgr_batch_t *m_head; /* 等待转移的文件 */
+	transfer_file_mgr_batch_t **m_tail;
+	pthread_mutex_t m_queue_mutex;
+	pthread_cond_t m_queue_cond; /* 使用CLOCK_MONOTONIC */
+	unsigned int m_max_age_ms; /* 文件打开超过这个时间就转移，0表示只按行数 */
+	int m_sync; /* TRANSFER_FILE_MGR_SYNC_XXX */
+	size_t m_group_size; /* 一次最多处理的文件数 */
+	transfer_file_mgr_stat_t m_stat; /* 缓冲模式下由m_queue_mutex保护，否则由m_mutex保护 */
 } transfer_file_mgr_t;
 
 transfer_file_mgr_t* transfer_file_mgr_new(const char *tmp_dir, const char *dst_dir, 
                             const char *filename, const char *suffix, size_t max_line);
 /* @func:
- *	销毁管理器
+ *	创建一个缓冲模式的管理器
+ * @param:
+ *	buf_size: 临时文件的缓冲区大小，满了才写入文件
+ */
+transfer_file_mgr_t* transfer_file_mgr_buffered_new(const char *tmp_dir, const char *dst_dir,
+                            const char *filename, const char *suffix, size_t max_line, size_t buf_size);
+
+/* @func:
+ *	设置缓冲模式下的超时时间和落盘策略
+ * @param:
+ *	max_age_ms: 文件从第一行写入开始超过这个时间就转移，0表示只按行数
+ *	sync: TRANSFER_FILE_MGR_SYNC_XXX
+ *	group_size: 后台线程一次最多处理的文件数，SYNC_GROUP时一起落盘
+ */
+void transfer_file_mgr_policy_set(transfer_file_mgr_t *tm, unsigned int max_age_ms, int sync, size_t group_size);
+
+/* @func:
+ *	获取统计信息
+ */
+void transfer_file_mgr_stat_get(transfer_file_mgr_t *tm, transfer_file_mgr_stat_t *stat);
+
+/* @func:
+ *	销毁管理器，缓冲模式下等待所有文件转移完成
  */
 void transfer_file_mgr_free(transfer_file_mgr_t *tm);
 
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE /* O_DIRECT, fallocate */
 #include <stdio.h>
 #include <string.h>
 #include <limits.h>
@@ -7,6 +8,10 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sched.h>
 
 #include "write_file_mgr.h"
 
@@ -17,6 +22,12 @@
 #define WRITE_FILE_MGR_WARN_LOG MY_PRINTF
 #define WRITE_FILE_MGR_ERROR_LOG MY_PRINTF
 
+#define WRITE_FILE_MGR_PREALLOC_MAX (64 * 1024 * 1024) /* 每次最多预分配的大小 */
+
+#define WRITE_FILE_MGR_SEALED (1ULL << 63)
+#define WRITE_FILE_MGR_WRITERS 0xffffffffULL
+#define WRITE_FILE_MGR_OFF(state) (((state) >> 32) & 0x7fffffff)
+
 typedef void* (*g_alloc_t) (size_t size);
 typedef void (*g_free_t) (void *ptr);
 
@@ -119,16 +130,440 @@ err:
 	return NULL;
 }
 
+static uint64_t _now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* @func:
+ *	从off开始写完所有数据
+ */
+static bool _write_file_mgr_pwritev_all(write_file_mgr_t *wm, struct iovec *iov, int cnt, off_t off)
+{
+	ssize_t len = 0;
+	int flags = 0;
+
+	while (cnt > 0) {
+		if ((len = pwritev(wm->m_fd, iov, cnt, off)) < 0) {
+			if (errno == EINTR) continue;
+			/* 有的文件系统可以用O_DIRECT打开但是不支持这样写 */
+			if (errno == EINVAL && wm->m_is_direct) {
+				WRITE_FILE_MGR_WARN_LOG("O_DIRECT write error, fallback to buffered io");
+				flags = fcntl(wm->m_fd, F_GETFL);
+				fcntl(wm->m_fd, F_SETFL, flags & ~O_DIRECT);
+				wm->m_is_direct = false;
+				continue;
+			}
+			WRITE_FILE_MGR_WARN_LOG("pwritev error, errno: %d - %s", errno, strerror(errno));
+			return false;
+		}
+		off += len;
+		for (; cnt > 0 && (size_t)len >= iov->iov_len; cnt--, iov++)
+			len -= iov->iov_len;
+		if (cnt > 0) {
+			iov->iov_base = (char*)iov->iov_base + len;
+			iov->iov_len -= len;
+		}
+	}
+	return true;
+}
+
+/* @func:
+ *	预分配到end为止的空间，使用FALLOC_FL_KEEP_SIZE，读文件的程序看不到多出来的部分
+ */
+static void _write_file_mgr_prealloc(write_file_mgr_t *wm, off_t end)
+{
+	off_t len = wm->m_rotate_size < WRITE_FILE_MGR_PREALLOC_MAX ? wm->m_rotate_size : WRITE_FILE_MGR_PREALLOC_MAX;
+
+	if (!wm->m_is_prealloc || end <= wm->m_alloc_end) return ;
+	if (len < end - wm->m_file_off) len = end - wm->m_file_off;
+	if (fallocate(wm->m_fd, FALLOC_FL_KEEP_SIZE, wm->m_file_off, len)) {
+		WRITE_FILE_MGR_WARN_LOG("fallocate error, errno: %d - %s", errno, strerror(errno));
+		wm->m_is_prealloc = false;
+		return ;
+	}
+	wm->m_alloc_end = wm->m_file_off + len;
+}
+
+/* @func:
+ *	打开文件，O_DIRECT时不完整的最后一块读到缓冲区中，以后整块重写
+ */
+static bool _write_file_mgr_open(write_file_mgr_t *wm, bool is_trunc)
+{
+	char path[PATH_MAX] = {0};
+	int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (is_trunc ? O_TRUNC : 0);
+	struct stat st;
+	size_t tail = 0;
+
+	snprintf(path, sizeof(path), "%s%s", wm->m_dir, wm->m_filename);
+	wm->m_fd = -1;
+	if (wm->m_is_direct && (wm->m_fd = open(path, (flags & ~O_WRONLY) | O_RDWR | O_DIRECT, 0644)) < 0) {
+		WRITE_FILE_MGR_WARN_LOG("open %s with O_DIRECT error, errno: %d - %s", path, errno, strerror(errno));
+		wm->m_is_direct = false;
+	}
+	if (wm->m_fd < 0 && (wm->m_fd = open(path, flags, 0644)) < 0) {
+		WRITE_FILE_MGR_WARN_LOG("open %s error, errno: %d - %s", path, errno, strerror(errno));
+		return false;
+	}
+
+	if (fstat(wm->m_fd, &st)) st.st_size = 0;
+	wm->m_buf_len = 0;
+	wm->m_file_off = st.st_size;
+	wm->m_alloc_end = 0;
+	wm->m_flush_time = _now_ms();
+	if (!wm->m_is_direct) return true;
+
+	tail = st.st_size & (WRITE_FILE_MGR_ALIGN - 1);
+	wm->m_file_off = st.st_size - tail;
+	if (tail && pread(wm->m_fd, wm->m_buf, WRITE_FILE_MGR_ALIGN, wm->m_file_off) < (ssize_t)tail) {
+		WRITE_FILE_MGR_WARN_LOG("pread %s error, errno: %d - %s", path, errno, strerror(errno));
+		close(wm->m_fd); wm->m_fd = -1;
+		return false;
+	}
+	wm->m_buf_len = tail;
+	return true;
+}
+
+/* @func:
+ *	写出缓冲区
+ * @param:
+ *	is_all: O_DIRECT时是否写出不完整的最后一块，补齐写入后截断文件，这一块留在缓冲区中
+ */
+static bool _write_file_mgr_flush(write_file_mgr_t *wm, bool is_all)
+{
+	struct iovec iov;
+	size_t len = wm->m_buf_len, tail = 0, keep = 0;
+
+	if (wm->m_fd < 0 || !len) return true;
+	if (wm->m_is_direct) {
+		tail = len & (WRITE_FILE_MGR_ALIGN - 1);
+		if (!is_all) len -= tail;
+		else if (tail) {
+			memset(wm->m_buf + wm->m_buf_len, 0, WRITE_FILE_MGR_ALIGN - tail);
+			len += WRITE_FILE_MGR_ALIGN - tail;
+			keep = WRITE_FILE_MGR_ALIGN;
+		}
+		if (!len) return true;
+	}
+
+	_write_file_mgr_prealloc(wm, wm->m_file_off + len);
+	iov.iov_base = wm->m_buf, iov.iov_len = len;
+	if (!_write_file_mgr_pwritev_all(wm, &iov, 1, wm->m_file_off)) return false;
+	if (keep && ftruncate(wm->m_fd, wm->m_file_off + wm->m_buf_len))
+		WRITE_FILE_MGR_WARN_LOG("ftruncate error, errno: %d - %s", errno, strerror(errno));
+
+	/* 不完整的最后一块留在缓冲区中 */
+	len -= keep;
+	wm->m_buf_len -= len;
+	memmove(wm->m_buf, wm->m_buf + len, wm->m_buf_len);
+	wm->m_file_off += len;
+	wm->m_flush_time = _now_ms();
+	return true;
+}
+
+/* @func:
+ *	缓冲模式下写入，放不下时和缓冲区中的数据一起用一次pwritev写出
+ */
+static size_t _write_file_mgr_buffered_do(write_file_mgr_t *wm, const char *buf, size_t buf_len)
+{
+	struct iovec iov[2];
+	size_t len = 0;
+
+	if (wm->m_fd < 0 && !_write_file_mgr_open(wm, false)) return 0;
+
+	if ((size_t)wm->m_file_off + wm->m_buf_len >= wm->m_rotate_size) {
+		WRITE_FILE_MGR_DEBUG_LOG("rotate %s%s, size: %ld", wm->m_dir, wm->m_filename,
+			(long)(wm->m_file_off + wm->m_buf_len));
+		/* 文件会被重写，缓冲区中还没写出的数据和文件一起丢弃 */
+		wm->m_buf_len = 0;
+		close(wm->m_fd);
+		if (!_write_file_mgr_open(wm, true)) return 0;
+	}
+
+	/* 大块数据不复制，和缓冲区中的数据一起写出 */
+	if (!wm->m_is_direct && (wm->m_buf_len + buf_len > wm->m_buf_size || buf_len >= wm->m_buf_size / 2)) {
+		iov[0].iov_base = wm->m_buf, iov[0].iov_len = wm->m_buf_len;
+		iov[1].iov_base = (void*)buf, iov[1].iov_len = buf_len;
+		_write_file_mgr_prealloc(wm, wm->m_file_off + wm->m_buf_len + buf_len);
+		if (!_write_file_mgr_pwritev_all(wm, iov, 2, wm->m_file_off)) return 0;
+		wm->m_file_off += wm->m_buf_len + buf_len;
+		wm->m_buf_len = 0;
+		wm->m_flush_time = _now_ms();
+		return 1;
+	}
+
+	/* O_DIRECT只能整块写，用户的数据需要先复制到对齐的缓冲区 */
+	while (buf_len > 0) {
+		len = wm->m_buf_size - wm->m_buf_len;
+		if (len > buf_len) len = buf_len;
+		memcpy(wm->m_buf + wm->m_buf_len, buf, len);
+		wm->m_buf_len += len; buf += len; buf_len -= len;
+		if (wm->m_buf_len == wm->m_buf_size && !_write_file_mgr_flush(wm, false)) return 0;
+	}
+
+	if (_now_ms() - wm->m_flush_time >= wm->m_flush_ms && !_write_file_mgr_flush(wm, false)) return 0;
+	return 1;
+}
+
+/* @func:
+ *	创建一个缓冲模式的管理器
+ */
+write_file_mgr_t* write_file_mgr_buffered_new(const char *dir, const char *filename, size_t rotate_size,
+		size_t buf_size, unsigned int flush_ms, int flags)
+{
+	write_file_mgr_t *wm = NULL;
+
+	if (!buf_size) return NULL;
+	if (!(wm = write_file_mgr_new(dir, filename, rotate_size))) return NULL;
+
+	wm->m_is_buffered = true;
+	wm->m_is_direct = flags & WRITE_FILE_MGR_DIRECT;
+	wm->m_is_prealloc = flags & WRITE_FILE_MGR_PREALLOC;
+	wm->m_flush_ms = flush_ms;
+	wm->m_fd = -1;
+	wm->m_buf_size = (buf_size + WRITE_FILE_MGR_ALIGN - 1) & ~(size_t)(WRITE_FILE_MGR_ALIGN - 1);
+	if ((errno = posix_memalign((void**)&wm->m_buf, WRITE_FILE_MGR_ALIGN, wm->m_buf_size))) {
+		WRITE_FILE_MGR_ERROR_LOG("posix_memalign error, errno: %d - %s", errno, strerror(errno));
+		wm->m_buf = NULL;
+		goto err;
+	}
+
+	if (!_write_file_mgr_open(wm, false)) goto err;
+	return wm;
+
+err:
+	write_file_mgr_free(wm);
+	return NULL;
+}
+
+/* @func:
+ *	清空封住的缓冲区，预留失败的线程还没有退出时等待，否则它减少线程数时会借位
+ */
+static void _write_file_mgr_unseal(write_file_mgr_dbuf_t *dbuf)
+{
+	uint64_t state = __atomic_load_n(&dbuf->m_state, __ATOMIC_ACQUIRE);
+
+	for (;;) {
+		if (state & WRITE_FILE_MGR_WRITERS) {
+			sched_yield();
+			state = __atomic_load_n(&dbuf->m_state, __ATOMIC_ACQUIRE);
+		} else if (__atomic_compare_exchange_n(&dbuf->m_state, &state, 0, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			return ;
+		}
+	}
+}
+
+/* @func:
+ *	封住当前的缓冲区，等正在复制的线程完成后交换，再写入文件，调用者持有m_mutex
+ */
+static void _write_file_mgr_swap(write_file_mgr_t *wm)
+{
+	write_file_mgr_dbuf_t *dbuf = __atomic_load_n(&wm->m_cur, __ATOMIC_ACQUIRE), *next = NULL;
+	uint64_t state = __atomic_load_n(&dbuf->m_state, __ATOMIC_ACQUIRE);
+	size_t len = 0;
+
+	if (!WRITE_FILE_MGR_OFF(state)) return ;
+
+	/* 封住之后的预留都会失败，第一个放不下的线程记录了m_len */
+	len = WRITE_FILE_MGR_OFF(__atomic_fetch_or(&dbuf->m_state, WRITE_FILE_MGR_SEALED, __ATOMIC_ACQ_REL));
+	while (__atomic_load_n(&dbuf->m_state, __ATOMIC_ACQUIRE) & WRITE_FILE_MGR_WRITERS)
+		sched_yield();
+	if (len > __atomic_load_n(&dbuf->m_len, __ATOMIC_ACQUIRE)) len = dbuf->m_len;
+
+	/* 另一个缓冲区在上次交换后已经写完，解封后成为当前的缓冲区 */
+	next = dbuf == &wm->m_dbuf[0] ? &wm->m_dbuf[1] : &wm->m_dbuf[0];
+	_write_file_mgr_unseal(next);
+	__atomic_store_n(&wm->m_cur, next, __ATOMIC_RELEASE);
+	pthread_mutex_lock(&wm->m_swap_mutex);
+	__atomic_add_fetch(&wm->m_swap_gen, 1, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&wm->m_swap_cond);
+	pthread_mutex_unlock(&wm->m_swap_mutex);
+
+	/* 写完后仍然封住，交换前拿到旧指针的线程预留会失败，等交换后重新获取m_cur */
+	_write_file_mgr_buffered_do(wm, dbuf->m_data, len);
+	_write_file_mgr_flush(wm, false);
+	dbuf->m_len = SIZE_MAX;
+}
+
+/* @func:
+ *	后台线程，缓冲区满或者超时后交换缓冲区
+ */
+static void* _write_file_mgr_flusher(void *arg)
+{
+	write_file_mgr_t *wm = (write_file_mgr_t*)arg;
+	write_file_mgr_dbuf_t *dbuf = NULL;
+	struct timespec ts;
+	bool is_running = true;
+
+	while (is_running) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += wm->m_flush_ms / 1000;
+		ts.tv_nsec += (wm->m_flush_ms % 1000) * 1000000;
+		if (ts.tv_nsec >= 1000000000) ts.tv_sec++, ts.tv_nsec -= 1000000000;
+
+		pthread_mutex_lock(&wm->m_swap_mutex);
+		dbuf = __atomic_load_n(&wm->m_cur, __ATOMIC_ACQUIRE);
+		if ((is_running = wm->m_is_running) && !(__atomic_load_n(&dbuf->m_state, __ATOMIC_ACQUIRE) & WRITE_FILE_MGR_SEALED))
+			pthread_cond_timedwait(&wm->m_flush_cond, &wm->m_swap_mutex, &ts);
+		pthread_mutex_unlock(&wm->m_swap_mutex);
+
+		pthread_mutex_lock(&wm->m_mutex);
+		_write_file_mgr_swap(wm);
+		pthread_mutex_unlock(&wm->m_mutex);
+	}
+	return arg;
+}
+
+/* @func:
+ *	异步模式下写入，预留空间后复制，当前缓冲区放不下时封住它并等待交换
+ */
+static size_t _write_file_mgr_async_do(write_file_mgr_t *wm, const char *buf, size_t buf_len)
+{
+	write_file_mgr_dbuf_t *dbuf = NULL;
+	uint64_t state = 0, off = 0;
+	size_t ret = 0;
+	unsigned int gen = 0;
+	bool is_sealed = false;
+
+	/* 先交换写出当前缓冲区，保证同一线程之前写入的数据在前面 */
+	if (buf_len > wm->m_buf_size) {
+		pthread_mutex_lock(&wm->m_mutex);
+		_write_file_mgr_swap(wm);
+		ret = _write_file_mgr_buffered_do(wm, buf, buf_len);
+		pthread_mutex_unlock(&wm->m_mutex);
+		return ret;
+	}
+
+	for (;;) {
+		gen = __atomic_load_n(&wm->m_swap_gen, __ATOMIC_ACQUIRE);
+		dbuf = __atomic_load_n(&wm->m_cur, __ATOMIC_ACQUIRE);
+		state = __atomic_fetch_add(&dbuf->m_state, ((uint64_t)buf_len << 32) + 1, __ATOMIC_ACQ_REL);
+		off = WRITE_FILE_MGR_OFF(state);
+		if (!(state & WRITE_FILE_MGR_SEALED) && off + buf_len <= wm->m_buf_size) {
+			memcpy(dbuf->m_data + off, buf, buf_len);
+			__atomic_fetch_sub(&dbuf->m_state, 1, __ATOMIC_RELEASE);
+			return 1;
+		}
+
+		/* 预留是连续的，只有第一个放不下的线程满足off <= m_buf_size，由它封住缓冲区 */
+		is_sealed = !(state & WRITE_FILE_MGR_SEALED) && off <= wm->m_buf_size;
+		if (is_sealed) {
+			__atomic_store_n(&dbuf->m_len, off, __ATOMIC_RELEASE);
+			__atomic_fetch_or(&dbuf->m_state, WRITE_FILE_MGR_SEALED, __ATOMIC_ACQ_REL);
+		}
+		__atomic_fetch_sub(&dbuf->m_state, 1, __ATOMIC_RELEASE);
+		if (is_sealed) {
+			pthread_mutex_lock(&wm->m_swap_mutex);
+			pthread_cond_signal(&wm->m_flush_cond);
+			pthread_mutex_unlock(&wm->m_swap_mutex);
+		}
+
+		__atomic_add_fetch(&wm->m_wait_count, 1, __ATOMIC_RELAXED);
+		pthread_mutex_lock(&wm->m_swap_mutex);
+		/* 缓冲区可能已经交换两次又回到dbuf，所以比较交换的次数 */
+		while (__atomic_load_n(&wm->m_swap_gen, __ATOMIC_ACQUIRE) == gen)
+			pthread_cond_wait(&wm->m_swap_cond, &wm->m_swap_mutex);
+		pthread_mutex_unlock(&wm->m_swap_mutex);
+	}
+}
+
+/* @func:
+ *	创建一个异步模式的管理器
+ */
+write_file_mgr_t* write_file_mgr_async_new(const char *dir, const char *filename, size_t rotate_size,
+		size_t buf_size, unsigned int flush_ms, int flags)
+{
+	write_file_mgr_t *wm = NULL;
+	size_t i = 0;
+
+	/* 预留失败的线程也会增加m_state中的长度，留出余量 */
+	if (buf_size > 0x10000000) return NULL;
+	if (!(wm = write_file_mgr_buffered_new(dir, filename, rotate_size, buf_size, flush_ms, flags))) return NULL;
+
+	if (pthread_mutex_init(&wm->m_swap_mutex, NULL) || pthread_cond_init(&wm->m_swap_cond, NULL) ||
+			pthread_cond_init(&wm->m_flush_cond, NULL)) {
+		WRITE_FILE_MGR_ERROR_LOG("pthread init error, errno: %d - %s", errno, strerror(errno));
+		goto err;
+	}
+	wm->m_is_async = true;
+	wm->m_cur = &wm->m_dbuf[0];
+	if (!wm->m_flush_ms) wm->m_flush_ms = 1;
+
+	for (i = 0; i < sizeof(wm->m_dbuf) / sizeof(wm->m_dbuf[0]); i++) {
+		if (!(wm->m_dbuf[i].m_data = (char*)g_wm_alloc(wm->m_buf_size))) {
+			WRITE_FILE_MGR_ERROR_LOG("g_wm_alloc error, errno: %d - %s", errno, strerror(errno));
+			goto err;
+		}
+		wm->m_dbuf[i].m_len = SIZE_MAX;
+	}
+	/* 不是当前的缓冲区一直封住 */
+	wm->m_dbuf[1].m_state = WRITE_FILE_MGR_SEALED;
+
+	wm->m_is_running = true;
+	if ((errno = pthread_create(&wm->m_flusher, NULL, _write_file_mgr_flusher, wm))) {
+		WRITE_FILE_MGR_ERROR_LOG("pthread_create error, errno: %d - %s", errno, strerror(errno));
+		wm->m_is_running = false;
+		goto err;
+	}
+	return wm;
+
+err:
+	write_file_mgr_free(wm);
+	return NULL;
+}
+
+/* @func:
+ *	缓冲模式下写出缓冲区中的所有数据
+ */
+bool write_file_mgr_flush(write_file_mgr_t *wm)
+{
+	if (!wm || !wm->m_is_buffered) return false;
+	bool ret = false;
+
+	pthread_mutex_lock(&wm->m_mutex);
+	if (wm->m_is_async) _write_file_mgr_swap(wm);
+	ret = _write_file_mgr_flush(wm, true);
+	pthread_mutex_unlock(&wm->m_mutex);
+	return ret;
+}
+
 /* @func:
  *	销毁管理器
  */
 void write_file_mgr_free(write_file_mgr_t *wm)
 {
 	if (!wm) return ;
+	size_t i = 0;
+
+	/* 后台线程退出前会写出剩余的数据 */
+	if (wm->m_is_running) {
+		pthread_mutex_lock(&wm->m_swap_mutex);
+		wm->m_is_running = false;
+		pthread_cond_signal(&wm->m_flush_cond);
+		pthread_mutex_unlock(&wm->m_swap_mutex);
+		pthread_join(wm->m_flusher, NULL);
+	}
 	
 	pthread_mutex_lock(&wm->m_mutex);
+	if (wm->m_is_async) {
+		_write_file_mgr_swap(wm);
+		for (i = 0; i < sizeof(wm->m_dbuf) / sizeof(wm->m_dbuf[0]); i++)
+			g_wm_free(wm->m_dbuf[i].m_data);
+		pthread_cond_destroy(&wm->m_flush_cond);
+		pthread_cond_destroy(&wm->m_swap_cond);
+		pthread_mutex_destroy(&wm->m_swap_mutex);
+	}
+	if (wm->m_is_buffered) {
+		_write_file_mgr_flush(wm, true);
+		if (wm->m_fd >= 0) close(wm->m_fd);
+		free(wm->m_buf);
+	}
 	g_wm_free(wm->m_dir);
 	g_wm_free(wm->m_filename);
+	pthread_mutex_unlock(&wm->m_mutex);
 	pthread_mutex_destroy(&wm->m_mutex);
 	g_wm_free(wm);
 }
@@ -171,8 +606,12 @@ size_t write_file_mgr_do(write_file_mgr_t *wm, const char *buf, size_t buf_len)
 	if(!wm || !buf || !buf_len) return 0;
 	size_t ret = 0;
 
+	/* 异步模式下不持有m_mutex */
+	if (wm->m_is_async) return _write_file_mgr_async_do(wm, buf, buf_len);
+
 	pthread_mutex_lock(&wm->m_mutex);
-	ret = _write_file_mgr_do(wm, buf, buf_len);
+	if (wm->m_is_buffered) ret = _write_file_mgr_buffered_do(wm, buf, buf_len);
+	else ret = _write_file_mgr_do(wm, buf, buf_len);
 	pthread_mutex_unlock(&wm->m_mutex);
 	return ret;
 }
@@ -189,6 +628,18 @@ void write_file_mgr_dump(write_file_mgr_t *wm)
 	WRITE_FILE_MGR_TRACE_LOG("dir: %s", wm->m_dir);
 	WRITE_FILE_MGR_TRACE_LOG("filename: %s", wm->m_filename);
 	WRITE_FILE_MGR_TRACE_LOG("rotate_size: %ld", wm->m_rotate_size);
+	WRITE_FILE_MGR_TRACE_LOG("is_buffered: %d", wm->m_is_buffered);
+	if (wm->m_is_buffered) {
+		WRITE_FILE_MGR_TRACE_LOG("is_direct: %d", wm->m_is_direct);
+		WRITE_FILE_MGR_TRACE_LOG("is_prealloc: %d", wm->m_is_prealloc);
+		WRITE_FILE_MGR_TRACE_LOG("buf_size: %ld", wm->m_buf_size);
+		WRITE_FILE_MGR_TRACE_LOG("buf_len: %ld", wm->m_buf_len);
+		WRITE_FILE_MGR_TRACE_LOG("file_off: %ld", (long)wm->m_file_off);
+		WRITE_FILE_MGR_TRACE_LOG("flush_ms: %u", wm->m_flush_ms);
+		WRITE_FILE_MGR_TRACE_LOG("is_async: %d", wm->m_is_async);
+	}
+	if (wm->m_is_async)
+		WRITE_FILE_MGR_TRACE_LOG("wait_count: %ld", wm->m_wait_count);
 	WRITE_FILE_MGR_TRACE_LOG("==============");
 	pthread_mutex_unlock(&wm->m_mutex);
 }
@@ -197,6 +648,227 @@ void write_file_mgr_dump(write_file_mgr_t *wm)
 
 #include <assert.h>
 
+static size_t _line_count(const char *path, size_t *size)
+{
+	FILE *fp = NULL;
+	size_t count = 0;
+	int ch = 0;
+
+	*size = 0;
+	if (!(fp = fopen(path, "rb"))) return 0;
+	while ((ch = fgetc(fp)) != EOF) {
+		(*size)++;
+		if (ch == '\n') count++;
+	}
+	fclose(fp);
+	return count;
+}
+
+static double _ns_since(const struct timespec *start, size_t count)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return ((end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec)) / count;
+}
+
+/* @func:
+ *	缓冲模式，多线程写入后检查内容完整
+ */
+static void _write_file_mgr_buffered_test(int flags, size_t buf_size)
+{
+	write_file_mgr_t *wm = NULL;
+	size_t i = 0, size = 0;
+	size_t max_num = 10240;
+	pthread_t pt[4];
+
+	unlink("/tmp/kk/b.dat");
+	assert((wm = write_file_mgr_buffered_new("/tmp/kk/", "b.dat", 1024 * 1024 * 1024, buf_size, 100, flags)));
+
+	for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++) {
+		pthread_create(&pt[i], NULL, ({
+			void* _(void *arg) {
+				char buf[8192] = {0};
+				ssize_t len = 0;
+				size_t j = 0;
+				for (j = 0; j < max_num; j++) {
+					len = snprintf(buf, sizeof(buf), "%s - %ld\n", __FILE__, j);
+					/* 偶尔写一块比缓冲区大的数据 */
+					if (j % 1000 == 999) {
+						memset(buf, 'x', sizeof(buf) - 1);
+						buf[sizeof(buf) - 1] = '\n';
+						len = sizeof(buf);
+					}
+					assert(write_file_mgr_do(wm, buf, len) == 1);
+				}
+				return arg;
+			}; _;}), NULL);
+	}
+	for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++)
+		pthread_join(pt[i], NULL);
+
+	/* 截断后不完整的一块留在缓冲区中，继续写入后文件仍然连续 */
+	assert(write_file_mgr_flush(wm));
+	assert(_line_count("/tmp/kk/b.dat", &size) == max_num * sizeof(pt) / sizeof(pt[0]));
+	assert(write_file_mgr_do(wm, "tail\n", 5) == 1);
+	write_file_mgr_dump(wm);
+	write_file_mgr_free(wm);
+	assert(_line_count("/tmp/kk/b.dat", &size) == max_num * sizeof(pt) / sizeof(pt[0]) + 1);
+
+	/* 重新打开后追加 */
+	assert((wm = write_file_mgr_buffered_new("/tmp/kk/", "b.dat", 1024 * 1024 * 1024, buf_size, 100, flags)));
+	assert(write_file_mgr_do(wm, "again\n", 6) == 1);
+	write_file_mgr_free(wm);
+	assert(_line_count("/tmp/kk/b.dat", &i) == max_num * sizeof(pt) / sizeof(pt[0]) + 2);
+	assert(i == size + 6);
+
+	/* 达到大小后重写 */
+	assert((wm = write_file_mgr_buffered_new("/tmp/kk/", "b.dat", 10240, buf_size, 100, flags)));
+	for (i = 0; i < 1000; i++)
+		assert(write_file_mgr_do(wm, "0123456789\n", 11) == 1);
+	write_file_mgr_free(wm);
+	assert(_line_count("/tmp/kk/b.dat", &size) > 0 && size < 10240 + buf_size);
+	unlink("/tmp/kk/b.dat");
+	MY_PRINTF("buffered test ok, flags: %d", flags);
+}
+
+/* @func:
+ *	异步模式，多线程写入后检查每一行都完整
+ */
+static void _write_file_mgr_async_test(int flags, size_t buf_size)
+{
+	write_file_mgr_t *wm = NULL;
+	char line[256];
+	FILE *fp = NULL;
+	size_t i = 0, size = 0, count = 0;
+	size_t max_num = 20000;
+	pthread_t pt[8];
+	size_t seen[8] = {0};
+	unsigned long id = 0, seq = 0;
+
+	unlink("/tmp/kk/d.dat");
+	assert((wm = write_file_mgr_async_new("/tmp/kk/", "d.dat", 1024 * 1024 * 1024, buf_size, 10, flags)));
+
+	for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++) {
+		pthread_create(&pt[i], NULL, ({
+			void* _(void *arg) {
+				char buf[128] = {0}, *big = NULL;
+				ssize_t len = 0;
+				size_t j = 0, k = 0;
+				assert((big = malloc(buf_size + sizeof(buf))));
+				for (j = 0; j < max_num; k++) {
+					/* 偶尔写一块比缓冲区大的数据，由多行组成 */
+					if (k % 500 == 499) {
+						for (len = 0; (size_t)len <= buf_size && j < max_num; j++)
+							len += snprintf(big + len, sizeof(buf), "%lu %zu %s\n", (unsigned long)arg, j, "0123456789abcdef");
+						assert(write_file_mgr_do(wm, big, len) == 1);
+						continue;
+					}
+					len = snprintf(buf, sizeof(buf), "%lu %zu %s\n", (unsigned long)arg, j++, "0123456789abcdef");
+					assert(write_file_mgr_do(wm, buf, len) == 1);
+				}
+				free(big);
+				return arg;
+			}; _;}), (void*)i);
+	}
+	for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++)
+		pthread_join(pt[i], NULL);
+
+	/* 超时后后台线程会写出不满的缓冲区，O_DIRECT时不完整的最后一块除外 */
+	assert(write_file_mgr_do(wm, "tail\n", 5) == 1);
+	usleep(100 * 1000);
+	count = _line_count("/tmp/kk/d.dat", &size);
+	assert((flags & WRITE_FILE_MGR_DIRECT) || count == max_num * sizeof(pt) / sizeof(pt[0]) + 1);
+	write_file_mgr_dump(wm);
+	write_file_mgr_free(wm);
+	assert(_line_count("/tmp/kk/d.dat", &size) == max_num * sizeof(pt) / sizeof(pt[0]) + 1);
+
+	/* 同一个线程写入的行保持顺序 */
+	assert((fp = fopen("/tmp/kk/d.dat", "rb")));
+	while (fgets(line, sizeof(line), fp)) {
+		if (!strcmp(line, "tail\n")) continue;
+		assert(sscanf(line, "%lu %lu", &id, &seq) == 2 && id < sizeof(pt) / sizeof(pt[0]));
+		assert(seq == seen[id]++);
+	}
+	fclose(fp);
+	unlink("/tmp/kk/d.dat");
+	MY_PRINTF("async test ok, flags: %d", flags);
+}
+
+/* @func:
+ *	多线程写入时缓冲模式和异步模式的耗时
+ */
+static void _write_file_mgr_mt_bench(write_file_mgr_t *wm, const char *name)
+{
+	const size_t count = 200000;
+	struct timespec start;
+	pthread_t pt[4];
+	size_t i = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++) {
+		pthread_create(&pt[i], NULL, ({
+			void* _(void *arg) {
+				char buf[128];
+				size_t j = 0, len = 0;
+				len = snprintf(buf, sizeof(buf), "%s - bench line\n", __FILE__);
+				for (j = 0; j < count; j++) write_file_mgr_do(wm, buf, len);
+				return arg;
+			}; _;}), NULL);
+	}
+	for (i = 0; i < sizeof(pt) / sizeof(pt[0]); i++)
+		pthread_join(pt[i], NULL);
+	write_file_mgr_flush(wm);
+	MY_PRINTF("%s %zu threads: %.1f ns/write", name, sizeof(pt) / sizeof(pt[0]),
+		_ns_since(&start, count * sizeof(pt) / sizeof(pt[0])));
+	write_file_mgr_free(wm);
+	unlink("/tmp/kk/c.dat");
+}
+
+/* @func:
+ *	每次打开文件和缓冲模式的单线程耗时
+ */
+static void _write_file_mgr_bench(void)
+{
+	const size_t count = 200000;
+	write_file_mgr_t *wm = NULL;
+	struct timespec start;
+	char buf[128];
+	size_t i = 0, len = 0;
+
+	len = snprintf(buf, sizeof(buf), "%s - bench line\n", __FILE__);
+
+	unlink("/tmp/kk/c.dat");
+	assert((wm = write_file_mgr_new("/tmp/kk/", "c.dat", 1024 * 1024 * 1024)));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count / 10; i++) write_file_mgr_do(wm, buf, len);
+	MY_PRINTF("open per write: %.1f ns/write", _ns_since(&start, count / 10));
+	write_file_mgr_free(wm);
+
+	unlink("/tmp/kk/c.dat");
+	assert((wm = write_file_mgr_buffered_new("/tmp/kk/", "c.dat", 1024 * 1024 * 1024, 1024 * 1024, 100, 0)));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) write_file_mgr_do(wm, buf, len);
+	write_file_mgr_flush(wm);
+	MY_PRINTF("buffered: %.1f ns/write", _ns_since(&start, count));
+	write_file_mgr_free(wm);
+
+	unlink("/tmp/kk/c.dat");
+	assert((wm = write_file_mgr_buffered_new("/tmp/kk/", "c.dat", 1024 * 1024 * 1024, 1024 * 1024, 100,
+		WRITE_FILE_MGR_DIRECT | WRITE_FILE_MGR_PREALLOC)));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) write_file_mgr_do(wm, buf, len);
+	write_file_mgr_flush(wm);
+	MY_PRINTF("buffered direct prealloc: %.1f ns/write", _ns_since(&start, count));
+	write_file_mgr_free(wm);
+	unlink("/tmp/kk/c.dat");
+
+	_write_file_mgr_mt_bench(write_file_mgr_buffered_new("/tmp/kk/", "c.dat", 1024 * 1024 * 1024,
+		1024 * 1024, 100, 0), "buffered");
+	_write_file_mgr_mt_bench(write_file_mgr_async_new("/tmp/kk/", "c.dat", 1024 * 1024 * 1024,
+		1024 * 1024, 100, 0), "async");
+}
+
 int main()
 {
 	write_file_mgr_t *wm = NULL;
@@ -226,6 +898,13 @@ int main()
 		pthread_join(pt[i], NULL);
 
 	write_file_mgr_free(wm);
+
+	_write_file_mgr_buffered_test(0, 4096);
+	_write_file_mgr_buffered_test(WRITE_FILE_MGR_PREALLOC, 64 * 1024);
+	_write_file_mgr_buffered_test(WRITE_FILE_MGR_DIRECT | WRITE_FILE_MGR_PREALLOC, 64 * 1024);
+	_write_file_mgr_async_test(0, 4096);
+	_write_file_mgr_async_test(WRITE_FILE_MGR_DIRECT, 64 * 1024);
+	_write_file_mgr_bench();
 	
 	return 0;
 }
@@ -1,16 +1,62 @@
 /* @fdesc：
  *	1. 写入文件，到达指定大小后会重写文件
+ *	2. 缓冲模式下文件一直打开，小块数据先合并到缓冲区，缓冲区满或者超时后一次写出
+ *	3. 异步模式下写入线程只向内存中的双缓冲追加，由后台线程交换缓冲区后写文件
  */
 
 #ifndef _WRITE_FILE_MGR_H_
 #define _WRITE_FILE_MGR_H_
 #include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define WRITE_FILE_MGR_ALIGN 4096 /* O_DIRECT要求的对齐 */
+
+/* 缓冲模式的选项 */
+#define WRITE_FILE_MGR_DIRECT 1 /* 使用O_DIRECT，文件系统不支持时退回普通写 */
+#define WRITE_FILE_MGR_PREALLOC 2 /* 用fallocate预先分配空间，不改变文件大小 */
+
+/* 异步模式的缓冲区
+ * m_state: 最高位表示已经封住，32-62位是已经预留的长度，低32位是正在复制的线程数
+ * 不是当前的缓冲区一直封住，交换回来时才清空
+ */
+typedef struct _write_file_mgr_dbuf {
+	char *m_data;
+	uint64_t m_state;
+	size_t m_len;	/* 第一个放不下的线程预留的位置，之前的数据是完整的 */
+} write_file_mgr_dbuf_t;
 
 typedef struct _write_file_mgr {
 	char *m_dir; /* 文件保存的路径 */
 	char *m_filename;	/* 文件名 */
 	size_t m_rotate_size;	/* 重写文件大小 */
 	pthread_mutex_t m_mutex;
+
+	/* 缓冲模式 */
+	bool m_is_buffered;
+	bool m_is_direct;
+	bool m_is_prealloc;
+	int m_fd;	/* 一直保持打开 */
+	char *m_buf;	/* O_DIRECT时按WRITE_FILE_MGR_ALIGN对齐 */
+	size_t m_buf_size;
+	size_t m_buf_len;
+	off_t m_file_off;	/* m_buf中的数据在文件中的偏移 */
+	off_t m_alloc_end;	/* 已经预分配的结尾 */
+	unsigned int m_flush_ms;	/* 缓冲区中的数据最长保留的时间 */
+	uint64_t m_flush_time;	/* 上次写出的时间，毫秒 */
+
+	/* 异步模式 */
+	bool m_is_async;
+	bool m_is_running;
+	write_file_mgr_dbuf_t m_dbuf[2];
+	write_file_mgr_dbuf_t *m_cur;	/* 写入线程追加的缓冲区，另一个由后台线程写文件 */
+	pthread_t m_flusher;
+	pthread_mutex_t m_swap_mutex;
+	pthread_cond_t m_swap_cond;	/* 缓冲区已经交换 */
+	pthread_cond_t m_flush_cond;	/* 唤醒后台线程 */
+	unsigned int m_swap_gen;	/* 交换的次数 */
+	size_t m_wait_count;	/* 写入线程等待交换的次数 */
 } write_file_mgr_t;
 
 
@@ -21,6 +67,31 @@ typedef struct _write_file_mgr {
  */
 write_file_mgr_t* write_file_mgr_new(const char *dir, const char *filename, size_t rotate_size);
 
+/* @func:
+ *	创建一个缓冲模式的管理器
+ * @param:
+ *	buf_size: 缓冲区大小，O_DIRECT时向上对齐到WRITE_FILE_MGR_ALIGN
+ *	flush_ms: 写入时检查，缓冲区中的数据超过这个时间就写出
+ *	flags: WRITE_FILE_MGR_DIRECT | WRITE_FILE_MGR_PREALLOC
+ */
+write_file_mgr_t* write_file_mgr_buffered_new(const char *dir, const char *filename, size_t rotate_size,
+		size_t buf_size, unsigned int flush_ms, int flags);
+
+/* @func:
+ *	创建一个异步模式的管理器，写入线程不会等待磁盘，只在两个缓冲区都满时等待
+ * @param:
+ *	buf_size: 每个缓冲区的大小，超过这个大小的数据直接写文件
+ *	flush_ms: 后台线程最长的写出间隔
+ *	flags: 同write_file_mgr_buffered_new
+ */
+write_file_mgr_t* write_file_mgr_async_new(const char *dir, const char *filename, size_t rotate_size,
+		size_t buf_size, unsigned int flush_ms, int flags);
+
+/* @func:
+ *	缓冲模式下写出缓冲区中的所有数据，O_DIRECT时最后一块补齐后再截断文件
+ */
+bool write_file_mgr_flush(write_file_mgr_t *wm);
+
 /* @func:
  *	销毁管理器
  */